@@ -0,0 +1,185 @@
+/**************************************************************************************************/
+/**
+ * @file binlog.h
+ * @author Ryan Jing (r5jing@uwaterloo.ca)
+ * @brief Deferred-format binary logging
+ *
+ * Call sites only capture the address of the format string, the address of the tag and the raw
+ * 32-bit argument words. Records are queued in a ring buffer and drained over UART by a low
+ * priority task; tools/binlog_decode.py rebuilds the text from the firmware ELF.
+ *
+ * @version 0.1
+ * @date 2025-11-20
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+/**************************************************************************************************/
+
+#ifndef BINLOG_H
+#define BINLOG_H
+
+/*------------------------------------------------------------------------------------------------*/
+// HEADERS                                                                                        */
+/*------------------------------------------------------------------------------------------------*/
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "esp_log.h"
+#include "driver/uart.h"
+
+/*------------------------------------------------------------------------------------------------*/
+// MACROS                                                                                         */
+/*------------------------------------------------------------------------------------------------*/
+
+// Transport
+#define BINLOG_UART_NUM         UART_NUM_0      // Shares the console UART (text logs are off)
+#define BINLOG_UART_BAUD        921600          // Drain rate, well above the worst case log rate
+#define BINLOG_RING_SIZE        4096            // Ring buffer size in bytes
+#define BINLOG_MAX_ARGS         8               // Maximum arguments per log call
+#define BINLOG_MAX_WORDS        (2 * BINLOG_MAX_ARGS)  // Argument words per frame (64-bit arguments take two)
+#define BINLOG_MAX_TAGS         16              // Tags tracked for runtime level control
+#define BINLOG_DEFAULT_LEVEL    ESP_LOG_INFO    // Level for tags that were never configured
+
+// Frame format (little-endian):
+// Sync(2) + Length(1) + Level(3 bits)/NumWords(5 bits)(1) + Timestamp_us(4) + Tag(4) + Format(4) +
+// Args(4*N) + Sum(1)
+#define BINLOG_SYNC_0           0xB1
+#define BINLOG_SYNC_1           0x06
+#define BINLOG_HEADER_SIZE      16
+#define BINLOG_LEVEL_SHIFT      5
+#define BINLOG_FRAME_MAX        (BINLOG_HEADER_SIZE + 4 * BINLOG_MAX_WORDS + 1)
+
+// Argument packing - every argument becomes one 32-bit word (64-bit integers become two, low
+// word first), the host decoder uses the conversion in the format string to interpret them.
+// Floats are sent as IEEE-754 single bits, pointers (strings included) as their address.
+#define BINLOG_ARG_VALUE(x) _Generic((x),                                                       \
+    float: (x),                                                                                 \
+    double: (x),                                                                                \
+    long long: (x),                                                                             \
+    unsigned long long: (x),                                                                    \
+    default: (uintptr_t)(x))
+
+#define BINLOG_ARG(x) (_binlog_cursor = _Generic((x),                                           \
+    float: binlog_put_float,                                                                    \
+    double: binlog_put_float,                                                                   \
+    long long: binlog_put_wide,                                                                 \
+    unsigned long long: binlog_put_wide,                                                        \
+    default: binlog_put_word)(_binlog_cursor, BINLOG_ARG_VALUE(x)))
+
+#define BINLOG_CAT_(a, b)       a##b
+#define BINLOG_CAT(a, b)        BINLOG_CAT_(a, b)
+#define BINLOG_NARGS_(_0, _1, _2, _3, _4, _5, _6, _7, _8, N, ...) N
+#define BINLOG_NARGS(...)       BINLOG_NARGS_(0, ##__VA_ARGS__, 8, 7, 6, 5, 4, 3, 2, 1, 0)
+
+#define BINLOG_ARGS_0()
+#define BINLOG_ARGS_1(a)                    BINLOG_ARG(a)
+#define BINLOG_ARGS_2(a, b)                 BINLOG_ARGS_1(a), BINLOG_ARG(b)
+#define BINLOG_ARGS_3(a, b, c)              BINLOG_ARGS_2(a, b), BINLOG_ARG(c)
+#define BINLOG_ARGS_4(a, b, c, d)           BINLOG_ARGS_3(a, b, c), BINLOG_ARG(d)
+#define BINLOG_ARGS_5(a, b, c, d, e)        BINLOG_ARGS_4(a, b, c, d), BINLOG_ARG(e)
+#define BINLOG_ARGS_6(a, b, c, d, e, f)     BINLOG_ARGS_5(a, b, c, d, e), BINLOG_ARG(f)
+#define BINLOG_ARGS_7(a, b, c, d, e, f, g)  BINLOG_ARGS_6(a, b, c, d, e, f), BINLOG_ARG(g)
+#define BINLOG_ARGS_8(a, b, c, d, e, f, g, h) BINLOG_ARGS_7(a, b, c, d, e, f, g), BINLOG_ARG(h)
+#define BINLOG_ARGS(...)        BINLOG_CAT(BINLOG_ARGS_, BINLOG_NARGS(__VA_ARGS__))(__VA_ARGS__)
+
+// Log call - no formatting happens on the device. Arguments are packed in order through a
+// cursor, so the word count covers 64-bit arguments; a frame holds all BINLOG_MAX_WORDS of them.
+#define BINLOG(tag, level, format, ...)                                                         \
+    do {                                                                                        \
+        if (binlog_level_enabled((tag), (level))) {                                             \
+            uint32_t _binlog_args[BINLOG_MAX_WORDS];                                            \
+            uint32_t *_binlog_cursor = _binlog_args;                                            \
+            (void)_binlog_cursor;                                                               \
+            BINLOG_ARGS(__VA_ARGS__);                                                           \
+            binlog_write((tag), (level), (format), _binlog_args,                                \
+                         (uint8_t)(_binlog_cursor - _binlog_args));                             \
+        }                                                                                       \
+    } while (0)
+
+/*------------------------------------------------------------------------------------------------*/
+// FUNCTION DECLARATIONS                                                                          */
+/*------------------------------------------------------------------------------------------------*/
+
+/**************************************************************************************************/
+/**
+ * @brief Create the ring buffer and install the UART driver
+ * @return esp_err_t ESP_OK on success
+ */
+/**************************************************************************************************/
+esp_err_t binlog_init(void);
+
+/**************************************************************************************************/
+/**
+ * @brief Set the runtime log level of a tag (also applied to esp_log for text mode)
+ * @param tag Tag name, e.g. "SENSORS"
+ * @param level Maximum level that is emitted for this tag
+ */
+/**************************************************************************************************/
+void binlog_set_level(const char *tag, esp_log_level_t level);
+
+/**************************************************************************************************/
+/**
+ * @brief Check whether a record for this tag and level would be emitted
+ * @param tag Tag pointer as passed to the log macros
+ * @param level Level of the record
+ * @return true if the record should be written
+ */
+/**************************************************************************************************/
+bool binlog_level_enabled(const char *tag, esp_log_level_t level);
+
+/**************************************************************************************************/
+/**
+ * @brief Queue one record (task or ISR context, never blocks)
+ * @param tag Tag pointer (its address identifies the tag in the ELF)
+ * @param level Level of the record
+ * @param format Format string pointer (its address identifies the string in the ELF)
+ * @param args Argument words packed with BINLOG_ARG()
+ * @param num_args Number of argument words (64-bit arguments take two)
+ */
+/**************************************************************************************************/
+void binlog_write(const char *tag, esp_log_level_t level, const char *format,
+                  const uint32_t *args, uint8_t num_args);
+
+/**************************************************************************************************/
+/**
+ * @brief Stream queued records to the UART and apply pending host commands
+ * @param timeout_ms Time to wait for records when the ring buffer is empty
+ */
+/**************************************************************************************************/
+void binlog_drain(uint32_t timeout_ms);
+
+/**************************************************************************************************/
+/**
+ * @brief Number of records dropped because the ring buffer was full
+ * @return uint32_t Dropped record count since boot
+ */
+/**************************************************************************************************/
+uint32_t binlog_get_dropped(void);
+
+/*------------------------------------------------------------------------------------------------*/
+// INLINE HELPERS                                                                                 */
+/*------------------------------------------------------------------------------------------------*/
+
+static inline uint32_t *binlog_put_word(uint32_t *cursor, uintptr_t value)
+{
+    *cursor = (uint32_t)value;
+    return cursor + 1;
+}
+
+static inline uint32_t *binlog_put_wide(uint32_t *cursor, uint64_t value)
+{
+    cursor[0] = (uint32_t)value;
+    cursor[1] = (uint32_t)(value >> 32);
+    return cursor + 2;
+}
+
+static inline uint32_t *binlog_put_float(uint32_t *cursor, float value)
+{
+    union { float f; uint32_t u; } bits = { .f = value };
+    *cursor = bits.u;
+    return cursor + 1;
+}
+
+#endif // BINLOG_H
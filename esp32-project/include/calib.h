@@ -0,0 +1,143 @@
+/**************************************************************************************************/
+/**
+ * @file calib.h
+ * @author Ryan Jing (r5jing@uwaterloo.ca)
+ * @brief Calibration profile persisted in NVS
+ *
+ * @version 0.1
+ * @date 2025-11-21
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+/**************************************************************************************************/
+
+#ifndef CALIB_H
+#define CALIB_H
+
+/*------------------------------------------------------------------------------------------------*/
+// HEADERS                                                                                        */
+/*------------------------------------------------------------------------------------------------*/
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "sensors.h"
+
+/*------------------------------------------------------------------------------------------------*/
+// MACROS                                                                                         */
+/*------------------------------------------------------------------------------------------------*/
+
+#define CALIB_VERSION               1       // Bump when calib_profile_t changes layout
+
+// Potentiometer indices
+#define CALIB_POT_VOLUME            0
+#define CALIB_POT_SLIDER            1
+#define CALIB_NUM_POTS              2
+
+#define CALIB_MOTOR_CURVE_POINTS    4       // Duty-to-RPM curve points, sorted by duty
+#define CALIB_MOTOR_ENCODER         ENCODER_1   // Encoder on the motor-driven platter
+
+/*------------------------------------------------------------------------------------------------*/
+// TYPE DEFINITIONS                                                                               */
+/*------------------------------------------------------------------------------------------------*/
+
+// Potentiometer endpoints (raw ADC values at both ends of travel)
+typedef struct __attribute__((packed)) {
+    uint16_t min;
+    uint16_t max;
+} calib_pot_t;
+
+// One point of the motor duty-to-RPM curve
+typedef struct __attribute__((packed)) {
+    uint8_t duty;           // PWM duty (0-255)
+    uint16_t rpm_x10;       // Platter speed at this duty (RPM x 10)
+} calib_motor_point_t;
+
+// Calibration profile - stored as one NVS blob and sent as-is by the RPi (30 bytes, packed,
+// little-endian; see CALIBRATION_FORMAT in rpi/config.py)
+typedef struct __attribute__((packed)) {
+    uint8_t version;                                        // CALIB_VERSION
+    calib_pot_t pots[CALIB_NUM_POTS];                       // Volume, slider
+    calib_motor_point_t motor_curve[CALIB_MOTOR_CURVE_POINTS];
+    uint16_t motor_target_rpm_x10;                          // Platter speed at normal playback
+    int8_t encoder_direction[NUM_ENCODERS];                 // +1 or -1
+    uint16_t encoder_ppr[NUM_ENCODERS];                     // Pulses per revolution
+    uint8_t i2c_address;                                    // 7-bit I2C slave address
+} calib_profile_t;
+
+/*------------------------------------------------------------------------------------------------*/
+// FUNCTION DECLARATIONS                                                                          */
+/*------------------------------------------------------------------------------------------------*/
+
+/**************************************************************************************************/
+/**
+ * @brief Initialize NVS and load the calibration profile with a single blob read
+ *
+ * Falls back to defaults if no valid profile is stored (see calib_is_stored()).
+ *
+ * @return esp_err_t ESP_OK on success (also when defaults are used)
+ */
+/**************************************************************************************************/
+esp_err_t calib_init(void);
+
+/**************************************************************************************************/
+/**
+ * @brief Get the active calibration profile
+ * @return const calib_profile_t* Active profile (never NULL)
+ */
+/**************************************************************************************************/
+const calib_profile_t *calib_get(void);
+
+/**************************************************************************************************/
+/**
+ * @brief Whether the active profile was loaded from NVS (false on first boot)
+ * @return true if a stored profile is in use
+ */
+/**************************************************************************************************/
+bool calib_is_stored(void);
+
+/**************************************************************************************************/
+/**
+ * @brief Validate, apply and persist a new profile
+ *
+ * Writes flash, which stalls both cores for a few milliseconds. Only call from a low priority
+ * task, never from the sampling path.
+ *
+ * @param profile New profile
+ * @return esp_err_t ESP_OK on success, ESP_ERR_INVALID_ARG if the profile is rejected
+ */
+/**************************************************************************************************/
+esp_err_t calib_save(const calib_profile_t *profile);
+
+/**************************************************************************************************/
+/**
+ * @brief Measure the motor duty-to-RPM curve on the calibration encoder and save the profile
+ *
+ * Only needed on first boot - takes about two seconds, which is what a stored profile skips.
+ *
+ * @return esp_err_t ESP_OK on success
+ */
+/**************************************************************************************************/
+esp_err_t calib_run_motor_sweep(void);
+
+/**************************************************************************************************/
+/**
+ * @brief Look up the PWM duty for a platter speed using the motor curve
+ * @param rpm_x10 Platter speed (RPM x 10)
+ * @return uint8_t PWM duty (0-255), linearly interpolated between curve points
+ */
+/**************************************************************************************************/
+uint8_t calib_motor_duty_for_rpm(uint16_t rpm_x10);
+
+/**************************************************************************************************/
+/**
+ * @brief Stretch a raw potentiometer reading to the full 0-4095 range using its endpoints
+ * @param pot CALIB_POT_VOLUME or CALIB_POT_SLIDER
+ * @param raw Raw 12-bit ADC value
+ * @return uint16_t Calibrated value (0-4095)
+ */
+/**************************************************************************************************/
+uint16_t calib_scale_pot(uint8_t pot, uint16_t raw);
+
+#endif // CALIB_H
@@ -20,6 +20,7 @@
 /*------------------------------------------------------------------------------------------------*/
 
 #include <stdio.h>
+#include <stdbool.h>
 
 #include "driver/i2c.h"
 
@@ -49,8 +50,33 @@
 
 // I2C Data Packet Size
 // Encoder1_Pos(4) + Encoder1_Vel(4) + Encoder2_Pos(4) + Encoder2_Vel(4) +
-// Timestamp(4) + ButtonFlags(1) + VolumePot(2) + SliderPot(2) = 25 bytes
-#define I2C_DATA_PACKET_SIZE    25
+// Timestamp(4) + ButtonFlags(1) + VolumePot(2) + SliderPot(2) +
+// CmdAckSeq(1) + CmdStatus(1) = 27 bytes
+#define I2C_DATA_PACKET_SIZE    27
+
+// I2C Command Frames (RPi -> ESP32, written into the RX buffer)
+// Command(1) + PayloadLength(1) + Payload(PayloadLength)
+// Several frames can go in one write; a trailing COMMIT frame makes the ESP32 report the
+// sequence number and the combined status of the frames before it in CmdAckSeq/CmdStatus.
+#define I2C_CMD_HEADER_SIZE     2
+#define I2C_CMD_COMMIT          0x01            // Payload: seq(1), 1-255
+#define I2C_CMD_CALIBRATION     0x10            // Payload: calib_profile_t (see calib.h)
+#define I2C_CMD_MOTOR_SETPOINT  0x20            // Payload: deck(1) + rpm_x10(2, signed, <0 = backward)
+#define I2C_CMD_LED_PATTERN     0x21            // Payload: pattern(1) + beat_phase(2, 0-65535) + beat_period_us(4)
+#define I2C_CMD_LCD_TEXT        0x22            // Payload: row(1) + text(0-LCD_COLS, not terminated)
+#define I2C_CMD_LED_LEVEL       0x23            // Payload: level(1) for LED_PATTERN_VU
+#define I2C_CMD_LCD_TITLE       0x24            // Payload: title(0-LCD_COLS, not terminated)
+#define I2C_CMD_LCD_STATUS      0x25            // Payload: bpm_x10(2) + pitch_x10(2, signed, %) + elapsed_s(2)
+
+// Command status (first error since the previous COMMIT wins)
+#define I2C_CMD_STATUS_OK           0
+#define I2C_CMD_STATUS_UNKNOWN      1           // Unknown command ID
+#define I2C_CMD_STATUS_BAD_LENGTH   2           // Payload length does not match the command
+#define I2C_CMD_STATUS_BAD_ARG      3           // Payload value out of range
+#define I2C_CMD_STATUS_FAILED       4           // Valid command, applying it failed
+#define I2C_CMD_STATUS_FRAMING      5           // Truncated or oversized frame
+
+#define I2C_CMD_FRAME_TIMEOUT_MS    20          // Rest of a frame must follow its first byte within this
 
 /*------------------------------------------------------------------------------------------------*/
 // FUNCTION DECLARATIONS                                                                          */
@@ -72,4 +98,62 @@ esp_err_t comm_init(void);
 /**************************************************************************************************/
 esp_err_t comm_update_encoder_data(void);
 
+/**************************************************************************************************/
+/**
+ * @brief Read one command frame written by the RPi and apply it (call from a low priority task)
+ *
+ * Returns as soon as the frame is complete, so latency is bounded by task scheduling rather than
+ * by the timeout.
+ *
+ * @param timeout_ms Time to wait for the next frame
+ * @return esp_err_t ESP_OK if a frame was applied, ESP_ERR_TIMEOUT if none arrived,
+ *                   ESP_ERR_INVALID_SIZE for a truncated or oversized frame
+ */
+/**************************************************************************************************/
+esp_err_t comm_process_commands(uint32_t timeout_ms);
+
+/**************************************************************************************************/
+/**
+ * @brief Worst time from the first byte of a frame to the command being applied
+ * @return int64_t Microseconds since boot
+ */
+/**************************************************************************************************/
+int64_t comm_get_max_command_latency_us(void);
+
+/**************************************************************************************************/
+/**
+ * @brief Time from boot to the first packet placed in the TX buffer
+ * @return int64_t Microseconds since boot, 0 if no packet has been sent yet
+ */
+/**************************************************************************************************/
+int64_t comm_get_ready_time_us(void);
+
+/**************************************************************************************************/
+/**
+ * @brief Remove the I2C slave driver and arm SDA as a light sleep wake source (see power.h)
+ *
+ * The driver holds an APB lock that blocks light sleep. Tasks using the driver must be parked
+ * in power_wait_active() first.
+ *
+ * @return esp_err_t ESP_OK on success
+ */
+/**************************************************************************************************/
+esp_err_t comm_suspend(void);
+
+/**************************************************************************************************/
+/**
+ * @brief Disarm the SDA wake source and reinstall the I2C slave driver
+ * @return esp_err_t ESP_OK on success
+ */
+/**************************************************************************************************/
+esp_err_t comm_resume(void);
+
+/**************************************************************************************************/
+/**
+ * @brief Check for bus traffic since the previous call (one falling SDA edge is enough)
+ * @return true if the bus was active
+ */
+/**************************************************************************************************/
+bool comm_poll_bus_activity(void);
+
 #endif // COMM_H
\ No newline at end of file
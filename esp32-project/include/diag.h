@@ -0,0 +1,71 @@
+/**************************************************************************************************/
+/**
+ * @file diag.h
+ * @author Ryan Jing (r5jing@uwaterloo.ca)
+ * @brief Timing diagnostics - sampling loop jitter and the cost of the visual tasks
+ *
+ * @version 0.1
+ * @date 2025-11-23
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+/**************************************************************************************************/
+
+#ifndef DIAG_H
+#define DIAG_H
+
+/*------------------------------------------------------------------------------------------------*/
+// HEADERS                                                                                        */
+/*------------------------------------------------------------------------------------------------*/
+
+#include <stdint.h>
+
+/*------------------------------------------------------------------------------------------------*/
+// MACROS                                                                                         */
+/*------------------------------------------------------------------------------------------------*/
+
+#define DIAG_ENABLED                1       // 0 = no diagnostics task
+#define DIAG_REPORT_PERIOD_MS       10000   // Report (and reset) interval
+
+/*------------------------------------------------------------------------------------------------*/
+// TYPE DEFINITIONS                                                                               */
+/*------------------------------------------------------------------------------------------------*/
+
+// Sampling loop timing since the last report
+typedef struct {
+    uint32_t samples;               // Loop iterations
+    int64_t min_interval_us;        // Shortest time between two iterations
+    int64_t max_interval_us;        // Longest time between two iterations
+    int64_t mean_interval_us;
+} diag_sample_stats_t;
+
+/*------------------------------------------------------------------------------------------------*/
+// FUNCTION DECLARATIONS                                                                          */
+/*------------------------------------------------------------------------------------------------*/
+
+/**************************************************************************************************/
+/**
+ * @brief Timestamp one iteration of the sampling loop (call from i2c_comm_task)
+ */
+/**************************************************************************************************/
+void diag_note_sample(void);
+
+/**************************************************************************************************/
+/**
+ * @brief Copy the sampling loop timing and start a new window
+ * @param stats Destination
+ */
+/**************************************************************************************************/
+void diag_get_sample_stats(diag_sample_stats_t *stats);
+
+/**************************************************************************************************/
+/**
+ * @brief Log sampling jitter, the LED engine cost and LCD flush load, then reset the window
+ *
+ * Nothing is logged for a window without samples (device parked).
+ */
+/**************************************************************************************************/
+void diag_report(void);
+
+#endif // DIAG_H
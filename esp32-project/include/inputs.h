@@ -98,4 +98,13 @@ uint16_t inputs_read_volume_potentiometer(void);
 /**************************************************************************************************/
 uint16_t inputs_read_slider_potentiometer(void);
 
+/**************************************************************************************************/
+/**
+ * @brief Arm or disarm the buttons as light sleep wake sources (see power.h)
+ * @param enable true to wake on a press, false to return to edge interrupts
+ * @return esp_err_t ESP_OK on success
+ */
+/**************************************************************************************************/
+esp_err_t inputs_set_wakeup(bool enable);
+
 #endif // INPUTS_H
\ No newline at end of file
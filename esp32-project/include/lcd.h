@@ -1,67 +1,145 @@
-// /**************************************************************************************************/
-// /**
-//  * @file lcd.h
-//  * @author Ryan Jing (r5jing@uwaterloo.ca)
-//  * @brief
-//  *
-//  * @version 0.1
-//  * @date 2025-11-08
-//  *
-//  * @copyright Copyright (c) 2025
-//  *
-//  */
-// /**************************************************************************************************/
-
-// #ifndef LCD_H
-// #define LCD_H
-
-// /*------------------------------------------------------------------------------------------------*/
-// // HEADERS                                                                                        */
-// /*------------------------------------------------------------------------------------------------*/
-
-// // #include "hd44780.h"
-// #include "esp_err.h"
-
-// /*------------------------------------------------------------------------------------------------*/
-// // GLOBAL VARIABLES                                                                               */
-// /*------------------------------------------------------------------------------------------------*/
-
-
-
-// /*------------------------------------------------------------------------------------------------*/
-// // CLASS DECLARATIONS                                                                             */
-// /*------------------------------------------------------------------------------------------------*/
-
-
-
-// /*------------------------------------------------------------------------------------------------*/
-// // FUNCTION DECLARATIONS                                                                          */
-// /*------------------------------------------------------------------------------------------------*/
-
-// /**************************************************************************************************/
-// /**
-//  * @name
-//  * @brief
-//  *
-//  *
-//  *
-//  * @return esp_err_t
-//  */
-// /**************************************************************************************************/
-// esp_err_t lcd_init(void);
-
-
-// /**************************************************************************************************/
-// /**
-//  * @name
-//  * @brief
-//  *
-//  *
-//  * @param song_name
-//  *
-//  * @return esp_err_t
-//  */
-// /**************************************************************************************************/
-// esp_err_t lcd_show_now_playing(const char *song_name);
-
-// #endif // LCD_H
\ No newline at end of file
+/**************************************************************************************************/
+/**
+ * @file lcd.h
+ * @author Ryan Jing (r5jing@uwaterloo.ca)
+ * @brief HD44780 character LCD - RAM framebuffer flushed in the background
+ *
+ * All lcd_show_* / lcd_write_text calls only write the framebuffer and never touch the bus, so
+ * they are safe from any task. lcd_flush() (from the LCD task) sends the cells that differ from
+ * what is on the display, at most LCD_FLUSH_BUDGET_BYTES per call.
+ *
+ * @version 0.1
+ * @date 2025-11-08
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+/**************************************************************************************************/
+
+#ifndef LCD_H
+#define LCD_H
+
+/*------------------------------------------------------------------------------------------------*/
+// HEADERS                                                                                        */
+/*------------------------------------------------------------------------------------------------*/
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+/*------------------------------------------------------------------------------------------------*/
+// MACROS                                                                                         */
+/*------------------------------------------------------------------------------------------------*/
+
+#define LCD_ENABLED                 1       // 0 = no LCD task (compare sampling jitter without it)
+
+// Display geometry - 2x16 or 4x20
+#define LCD_ROWS                    2
+#define LCD_COLS                    16
+
+// Flush pacing
+#define LCD_FLUSH_PERIOD_MS         20      // LCD task period
+#define LCD_FLUSH_BUDGET_BYTES      8       // HD44780 bytes (cells + cursor moves) per flush
+
+// Rate bar - a marker that moves across LCD_FIELD_RATE_BAR as the pitch changes
+#define LCD_RATE_BAR_RANGE_X10      80      // Pitch at either end of the bar (+-8.0 %)
+
+/*------------------------------------------------------------------------------------------------*/
+// TYPE DEFINITIONS                                                                               */
+/*------------------------------------------------------------------------------------------------*/
+
+// Flush statistics since the last lcd_get_stats() call
+typedef struct {
+    bool present;                   // Display answered during lcd_init()
+    uint32_t flushes;               // lcd_flush() calls
+    uint32_t bytes;                 // HD44780 bytes sent
+    uint32_t max_flush_us;          // Longest lcd_flush() (time the LCD task spent on the bus)
+    uint16_t dirty_cells;           // Cells still waiting to be sent
+    uint32_t errors;                // Failed bus writes
+} lcd_stats_t;
+
+/*------------------------------------------------------------------------------------------------*/
+// FUNCTION DECLARATIONS                                                                          */
+/*------------------------------------------------------------------------------------------------*/
+
+/**************************************************************************************************/
+/**
+ * @brief Initialize the I2C backpack and the display, load the rate bar glyphs (blocks ~60 ms)
+ * @return esp_err_t ESP_OK on success, ESP_ERR_NOT_FOUND if no display answers (the framebuffer
+ *                   still works, lcd_flush() just drops it)
+ */
+/**************************************************************************************************/
+esp_err_t lcd_init(void);
+
+/**************************************************************************************************/
+/**
+ * @brief Send changed cells to the display (call every LCD_FLUSH_PERIOD_MS from the LCD task)
+ * @return int Number of HD44780 bytes sent
+ */
+/**************************************************************************************************/
+int lcd_flush(void);
+
+/**************************************************************************************************/
+/**
+ * @brief Overwrite a whole row with text (padded with spaces)
+ * @param row Row index (0 to LCD_ROWS - 1)
+ * @param text Characters, not necessarily terminated
+ * @param len Number of characters (truncated to LCD_COLS)
+ * @return esp_err_t ESP_OK on success, ESP_ERR_INVALID_ARG for a bad row
+ */
+/**************************************************************************************************/
+esp_err_t lcd_write_text(uint8_t row, const char *text, uint8_t len);
+
+/**************************************************************************************************/
+/**
+ * @brief Show the track title
+ * @param song_name Title (truncated to the title field)
+ * @return esp_err_t ESP_OK on success
+ */
+/**************************************************************************************************/
+esp_err_t lcd_show_now_playing(const char *song_name);
+
+/**************************************************************************************************/
+/**
+ * @brief Show the tempo
+ * @param bpm_x10 BPM x 10 (0 = blank)
+ */
+/**************************************************************************************************/
+void lcd_show_bpm(uint16_t bpm_x10);
+
+/**************************************************************************************************/
+/**
+ * @brief Show the pitch percentage and move the rate bar marker
+ * @param pitch_x10 Pitch in percent x 10 (e.g. 25 = +2.5 %)
+ */
+/**************************************************************************************************/
+void lcd_show_pitch(int16_t pitch_x10);
+
+/**************************************************************************************************/
+/**
+ * @brief Show the elapsed play time as m:ss
+ * @param seconds Elapsed time
+ */
+/**************************************************************************************************/
+void lcd_show_elapsed(uint16_t seconds);
+
+/**************************************************************************************************/
+/**
+ * @brief Switch the backlight
+ *
+ * Writes the backpack directly - only call while the LCD task is parked or from the LCD task.
+ *
+ * @param on true to light the display
+ */
+/**************************************************************************************************/
+void lcd_set_backlight(bool on);
+
+/**************************************************************************************************/
+/**
+ * @brief Copy the flush statistics and reset the counters
+ * @param stats Destination
+ */
+/**************************************************************************************************/
+void lcd_get_stats(lcd_stats_t *stats);
+
+#endif // LCD_H
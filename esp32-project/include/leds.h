@@ -2,7 +2,7 @@
 /**
  * @file leds.h
  * @author Ryan Jing (r5jing@uwaterloo.ca)
- * @brief LED control module for scrolling light effects
+ * @brief LED pattern engine - LEDC PWM with gamma correction, phase-locked to the RPi beat
  *
  * @version 0.1
  * @date 2025-11-08
@@ -19,6 +19,7 @@
 // HEADERS                                                                                        */
 /*------------------------------------------------------------------------------------------------*/
 
+#include <stdint.h>
 #include "esp_err.h"
 
 /*------------------------------------------------------------------------------------------------*/
@@ -27,13 +28,45 @@
 
 #define NUM_LEDS    3    // Number of LEDs in the scroll sequence
 
+// Patterns (set by the RPi with I2C_CMD_LED_PATTERN)
+#define LED_PATTERN_OFF         0   // All off
+#define LED_PATTERN_SCROLL      1   // One LED per beat, previous LED fading out (default)
+#define LED_PATTERN_PULSE       2   // All LEDs flash on the beat and decay
+#define LED_PATTERN_VU          3   // Bar graph of the level set with leds_set_level()
+#define LED_PATTERN_STROBE      4   // Short flashes on every sixteenth note
+#define LED_PATTERN_SOLID       5   // All on
+#define NUM_LED_PATTERNS        6
+
+#define LEDS_DEFAULT_PERIOD_US  500000  // Beat period until the RPi sends one (120 BPM)
+#define LEDS_MIN_PERIOD_US      100000  // 600 BPM
+#define LEDS_MAX_PERIOD_US      2000000 // 30 BPM
+#define LEDS_UPDATE_PERIOD_MS   10      // leds_update() call period
+
+// Phase correction - errors below LEDS_PHASE_SNAP are slewed out over a few updates instead of
+// jumping, so a late command does not make the pattern stutter
+#define LEDS_PHASE_SNAP         0x40000000u // Quarter beat (Q32)
+#define LEDS_PHASE_SLEW_SHIFT   2           // Apply 1/4 of the remaining error per update
+
+/*------------------------------------------------------------------------------------------------*/
+// TYPE DEFINITIONS                                                                               */
+/*------------------------------------------------------------------------------------------------*/
+
+// Pattern engine cost, for the diagnostics report
+typedef struct {
+    uint32_t updates;               // leds_update() calls since the last reset
+    uint32_t kernel_cycles_last;    // CPU cycles of the last pattern evaluation
+    uint32_t kernel_cycles_max;     // Worst pattern evaluation
+    uint32_t update_cycles_max;     // Worst full update (evaluation + LEDC writes)
+    int32_t phase_error_us;         // Last phase error reported by the RPi (before slewing)
+} leds_stats_t;
+
 /*------------------------------------------------------------------------------------------------*/
 // FUNCTION DECLARATIONS                                                                          */
 /*------------------------------------------------------------------------------------------------*/
 
 /**************************************************************************************************/
 /**
- * @brief Initialize all LED GPIOs as outputs (active-low sinks)
+ * @brief Set up the LEDC channels (active-low sinks) and build the lookup tables
  * @return esp_err_t ESP_OK on success
  */
 /**************************************************************************************************/
@@ -61,4 +94,42 @@ void leds_set(uint8_t led_index);
 /**************************************************************************************************/
 void leds_all_off(void);
 
+/**************************************************************************************************/
+/**
+ * @brief Select the LED pattern and lock it to the RPi beat
+ *
+ * Re-sending the same pattern with a fresh phase only corrects the phase (slewed, see
+ * LEDS_PHASE_SLEW_SHIFT), so the RPi can send it every beat to keep the LEDs in sync.
+ *
+ * @param pattern LED_PATTERN_*
+ * @param beat_phase Position within the current beat when the command was sent (0-65535 = 0-1)
+ * @param beat_period_us Beat length (LEDS_MIN_PERIOD_US - LEDS_MAX_PERIOD_US)
+ * @return esp_err_t ESP_OK on success, ESP_ERR_INVALID_ARG for an unknown pattern or bad period
+ */
+/**************************************************************************************************/
+esp_err_t leds_set_pattern(uint8_t pattern, uint16_t beat_phase, uint32_t beat_period_us);
+
+/**************************************************************************************************/
+/**
+ * @brief Set the level shown by LED_PATTERN_VU
+ * @param level Audio level (0-255)
+ */
+/**************************************************************************************************/
+void leds_set_level(uint8_t level);
+
+/**************************************************************************************************/
+/**
+ * @brief Advance the active pattern (call every LEDS_UPDATE_PERIOD_MS)
+ */
+/**************************************************************************************************/
+void leds_update(void);
+
+/**************************************************************************************************/
+/**
+ * @brief Copy the pattern engine statistics and reset the maxima
+ * @param stats Destination
+ */
+/**************************************************************************************************/
+void leds_get_stats(leds_stats_t *stats);
+
 #endif // LEDS_H
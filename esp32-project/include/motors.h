@@ -20,6 +20,7 @@
 /*------------------------------------------------------------------------------------------------*/
 
 #include <stdio.h>
+#include <stdint.h>
 #include "esp_err.h"
 
 /*------------------------------------------------------------------------------------------------*/
@@ -34,6 +35,14 @@
 
 
 
+/*------------------------------------------------------------------------------------------------*/
+// MACROS                                                                                         */
+/*------------------------------------------------------------------------------------------------*/
+
+// Decks with a motor-driven platter (motor B drives deck 1, deck 2 is hand-only)
+#define MOTOR_DECK_1        0
+#define NUM_MOTOR_DECKS     1
+
 /*------------------------------------------------------------------------------------------------*/
 // FUNCTION DECLARATIONS                                                                          */
 /*------------------------------------------------------------------------------------------------*/
@@ -89,4 +98,23 @@ esp_err_t motors_backward(uint8_t speed);
 /**************************************************************************************************/
 esp_err_t motors_stop(void);
 
+/**************************************************************************************************/
+/**
+ * @brief Drive a deck's platter at a speed using the calibrated motor curve
+ * @param deck Deck index (MOTOR_DECK_1)
+ * @param rpm_x10 Platter speed (RPM x 10), negative = backward, 0 = stop
+ * @return esp_err_t ESP_OK on success, ESP_ERR_NOT_SUPPORTED if the deck has no motor
+ */
+/**************************************************************************************************/
+esp_err_t motors_set_rpm(uint8_t deck, int16_t rpm_x10);
+
+/**************************************************************************************************/
+/**
+ * @brief Last speed requested with motors_set_rpm() (restored after power parking)
+ * @param deck Deck index (MOTOR_DECK_1)
+ * @return int16_t Platter speed (RPM x 10), 0 for decks without a motor
+ */
+/**************************************************************************************************/
+int16_t motors_get_rpm_setpoint(uint8_t deck);
+
 #endif // MOTORS_H
\ No newline at end of file
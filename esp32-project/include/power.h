@@ -0,0 +1,170 @@
+/**************************************************************************************************/
+/**
+ * @file power.h
+ * @author Ryan Jing (r5jing@uwaterloo.ca)
+ * @brief Power management - DFS, idle parking and light sleep
+ *
+ * Three states:
+ *  - ACTIVE: CPU locked at POWER_MAX_FREQ_MHZ
+ *  - IDLE:   no user input for POWER_DFS_IDLE_MS - CPU lock released, DFS drops to
+ *            POWER_MIN_FREQ_MHZ while the I2C slave keeps answering
+ *  - PARKED: no user input for POWER_IDLE_TIMEOUT_MS and no bus traffic for POWER_BUS_IDLE_MS -
+ *            motors and LEDs off, I2C driver removed and automatic light sleep allowed
+ *
+ * A parked device wakes on any encoder edge, a button press or the START condition of an I2C
+ * transaction (SDA low). The slave cannot answer while asleep, so the transaction that wakes it
+ * is NACKed and the RPi picks up the next poll.
+ *
+ * @version 0.1
+ * @date 2025-11-22
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+/**************************************************************************************************/
+
+#ifndef POWER_H
+#define POWER_H
+
+/*------------------------------------------------------------------------------------------------*/
+// HEADERS                                                                                        */
+/*------------------------------------------------------------------------------------------------*/
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "lcd.h"
+
+/*------------------------------------------------------------------------------------------------*/
+// MACROS                                                                                         */
+/*------------------------------------------------------------------------------------------------*/
+
+#define POWER_MANAGEMENT_ENABLED    1       // 0 = always run at full rate (bench supply)
+
+// DFS range - 80 MHz is the lowest step that keeps APB (I2C, PCNT, LEDC) at 80 MHz
+#define POWER_MAX_FREQ_MHZ          240
+#define POWER_MIN_FREQ_MHZ          80
+
+// Idle detection
+#define POWER_CHECK_PERIOD_MS       500     // Idle check interval
+#define POWER_DFS_IDLE_MS           5000    // No user input -> drop to POWER_MIN_FREQ_MHZ
+#define POWER_IDLE_TIMEOUT_MS       60000   // No user input -> park and allow light sleep
+#define POWER_BUS_IDLE_MS           2000    // Never park while the RPi is still polling
+#define POWER_PARK_TIMEOUT_MS       500     // Time for tasks to reach power_wait_active()
+
+// First scratch after a wake must reach the TX buffer within this bound (measured from the
+// encoder wake interrupt to the first packet that carries the new position)
+#define POWER_WAKE_LATENCY_BOUND_US 20000
+
+// Tasks that must be blocked in power_wait_active() before the device parks
+#define POWER_TASK_COMM             (1 << 1)
+#define POWER_TASK_COMMAND          (1 << 2)
+#define POWER_TASK_LEDS             (1 << 3)
+#define POWER_TASK_LCD              (1 << 4)
+#if LCD_ENABLED
+#define POWER_TASKS_ALL             (POWER_TASK_COMM | POWER_TASK_COMMAND | POWER_TASK_LEDS | \
+                                     POWER_TASK_LCD)
+#else
+#define POWER_TASKS_ALL             (POWER_TASK_COMM | POWER_TASK_COMMAND | POWER_TASK_LEDS)
+#endif
+
+/*------------------------------------------------------------------------------------------------*/
+// TYPE DEFINITIONS                                                                               */
+/*------------------------------------------------------------------------------------------------*/
+
+typedef enum {
+    POWER_STATE_ACTIVE = 0,
+    POWER_STATE_IDLE,
+    POWER_STATE_PARKED,
+} power_state_t;
+
+typedef enum {
+    POWER_WAKE_ENCODER = 0,
+    POWER_WAKE_BUTTON,
+    POWER_WAKE_BUS,
+} power_wake_source_t;
+
+// Wake statistics since boot
+typedef struct {
+    uint32_t parks;                     // Times the device parked
+    uint32_t wakes;                     // Times the device woke from parked
+    power_wake_source_t last_source;    // Source of the last wake
+    int64_t last_resume_us;             // Wake interrupt -> sampling resumed
+    int64_t last_latency_us;            // Encoder wake interrupt -> first packet with movement
+    int64_t max_latency_us;             // Worst encoder wake latency
+    uint32_t latency_violations;        // Encoder wakes slower than POWER_WAKE_LATENCY_BOUND_US
+} power_stats_t;
+
+/*------------------------------------------------------------------------------------------------*/
+// FUNCTION DECLARATIONS                                                                          */
+/*------------------------------------------------------------------------------------------------*/
+
+/**************************************************************************************************/
+/**
+ * @brief Configure DFS and light sleep and take the full speed locks
+ *
+ * Without CONFIG_PM_ENABLE the device still parks motors and LEDs, it just never sleeps.
+ *
+ * @return esp_err_t ESP_OK on success
+ */
+/**************************************************************************************************/
+esp_err_t power_init(void);
+
+/**************************************************************************************************/
+/**
+ * @brief Run one step of the power state machine (call in a loop from the power task)
+ *
+ * Waits up to POWER_CHECK_PERIOD_MS while awake. While parked it blocks until a wake source
+ * fires, then brings the device back up before returning.
+ */
+/**************************************************************************************************/
+void power_update(void);
+
+/**************************************************************************************************/
+/**
+ * @brief Record user activity (encoder movement, pot movement, button press, RPi command)
+ */
+/**************************************************************************************************/
+void power_notify_activity(void);
+
+/**************************************************************************************************/
+/**
+ * @brief Wake a parked device (ISR context - called by the armed wake sources)
+ * @param source What woke the device
+ */
+/**************************************************************************************************/
+void power_wake_from_isr(power_wake_source_t source);
+
+/**************************************************************************************************/
+/**
+ * @brief Safe point for tasks that touch parked peripherals - blocks while the device is parked
+ * @param task_bit POWER_TASK_* bit of the calling task
+ */
+/**************************************************************************************************/
+void power_wait_active(uint32_t task_bit);
+
+/**************************************************************************************************/
+/**
+ * @brief Feed the wake latency measurement (call once per packet from the sampling path)
+ * @param encoder_moved true if either encoder position changed since the previous packet
+ */
+/**************************************************************************************************/
+void power_note_sample(bool encoder_moved);
+
+/**************************************************************************************************/
+/**
+ * @brief Get the current power state
+ * @return power_state_t Current state
+ */
+/**************************************************************************************************/
+power_state_t power_get_state(void);
+
+/**************************************************************************************************/
+/**
+ * @brief Copy the wake statistics
+ * @param stats Destination
+ */
+/**************************************************************************************************/
+void power_get_stats(power_stats_t *stats);
+
+#endif // POWER_H
@@ -20,6 +20,7 @@
 /*------------------------------------------------------------------------------------------------*/
 
 #include <stdio.h>
+#include <stdbool.h>
 #include "esp_err.h"
 
 /*------------------------------------------------------------------------------------------------*/
@@ -81,4 +82,16 @@ void encoder_reset_position(uint8_t encoder_id);
 /**************************************************************************************************/
 float encoder_get_velocity(uint8_t encoder_id, uint32_t sample_period_ms);
 
+/**************************************************************************************************/
+/**
+ * @brief Arm or disarm the encoder pins as light sleep wake sources (see power.h)
+ *
+ * While armed, the first edge on any encoder pin wakes a parked device.
+ *
+ * @param enable true to arm, false to return the pins to PCNT-only use
+ * @return esp_err_t ESP_OK on success
+ */
+/**************************************************************************************************/
+esp_err_t sensors_set_wakeup(bool enable);
+
 #endif // SENSORS_H
\ No newline at end of file
@@ -29,11 +29,23 @@
 #define ERROR_LOGGING_ONLY    1 // Only show errors and warnings
 #define FULL_LOGGING          0 // Show all logs (info, debug, errors, warnings)
 
+// Binary logging - overrides the text modes above. Records are queued without formatting and
+// decoded on the host with tools/binlog_decode.py, levels are adjustable per tag at runtime.
+#define BINARY_LOGGING        0
+
 /*------------------------------------------------------------------------------------------------*/
 // LOGGING MACROS                                                                                 */
 /*------------------------------------------------------------------------------------------------*/
 
-#if FULL_LOGGING
+#if BINARY_LOGGING
+    // Binary logging - format string address + raw arguments, filtered by runtime tag level
+    #include "binlog.h"
+    #define LOG_INFO(tag, format, ...)    BINLOG(tag, ESP_LOG_INFO, format, ##__VA_ARGS__)
+    #define LOG_DEBUG(tag, format, ...)   BINLOG(tag, ESP_LOG_DEBUG, format, ##__VA_ARGS__)
+    #define LOG_WARN(tag, format, ...)    BINLOG(tag, ESP_LOG_WARN, format, ##__VA_ARGS__)
+    #define LOG_ERROR(tag, format, ...)   BINLOG(tag, ESP_LOG_ERROR, format, ##__VA_ARGS__)
+
+#elif FULL_LOGGING
     // Full logging - all levels enabled
     #define LOG_INFO(tag, format, ...)    ESP_LOGI(tag, format, ##__VA_ARGS__)
     #define LOG_DEBUG(tag, format, ...)   ESP_LOGD(tag, format, ##__VA_ARGS__)
@@ -0,0 +1,314 @@
+/**************************************************************************************************/
+/**
+ * @file binlog.c
+ * @author Ryan Jing (r5jing@uwaterloo.ca)
+ * @brief Deferred-format binary logging
+ *
+ * The hot path (binlog_write) copies at most 49 bytes into a byte ring buffer and returns. It
+ * never formats, never blocks and is safe from ISRs. binlog_drain() is called from a low priority
+ * task and streams the ring buffer out of the UART, and also accepts runtime level commands from
+ * the host on the same UART ("L <TAG> <LEVEL>\n").
+ *
+ * @version 0.1
+ * @date 2025-11-20
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+/**************************************************************************************************/
+
+/*------------------------------------------------------------------------------------------------*/
+/* HEADERS                                                                                        */
+/*------------------------------------------------------------------------------------------------*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "esp_err.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "driver/uart.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/ringbuf.h"
+#include "binlog.h"
+
+/*------------------------------------------------------------------------------------------------*/
+/* MACROS                                                                                         */
+/*------------------------------------------------------------------------------------------------*/
+
+#define BINLOG_UART_RX_BUF_LEN      256     // Host command buffer
+#define BINLOG_UART_TX_BUF_LEN      1024    // Lets the drain task hand off a chunk without waiting
+#define BINLOG_DRAIN_CHUNK          256     // Max bytes written to the UART per drain call
+#define BINLOG_TAG_NAME_LEN         16      // Tag names are short ("SENSORS", "COMM", ...)
+#define BINLOG_CMD_LINE_LEN         32      // "L <TAG> <LEVEL>\n"
+
+/*------------------------------------------------------------------------------------------------*/
+/* TYPE DEFINITIONS                                                                               */
+/*------------------------------------------------------------------------------------------------*/
+
+typedef struct {
+    const char *tag;                        // Tag pointer seen at the call site (NULL until used)
+    char name[BINLOG_TAG_NAME_LEN];         // Tag name, used to match binlog_set_level()
+    volatile uint8_t level;                 // Maximum emitted level
+} binlog_tag_t;
+
+/*------------------------------------------------------------------------------------------------*/
+/* GLOBAL VARIABLES                                                                               */
+/*------------------------------------------------------------------------------------------------*/
+
+static const char *TAG = "BINLOG";
+
+static RingbufHandle_t binlog_ring = NULL;
+static volatile uint32_t binlog_dropped = 0;
+static uint32_t binlog_dropped_reported = 0;
+
+static binlog_tag_t binlog_tags[BINLOG_MAX_TAGS];
+static volatile uint8_t binlog_num_tags = 0;
+static portMUX_TYPE binlog_tags_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static char binlog_cmd_line[BINLOG_CMD_LINE_LEN];
+static size_t binlog_cmd_len = 0;
+
+/*------------------------------------------------------------------------------------------------*/
+/* FUNCTION PROTOTYPES                                                                            */
+/*------------------------------------------------------------------------------------------------*/
+
+/**************************************************************************************************/
+/**
+ * @name binlog_register_tag
+ * @brief Slow path of binlog_level_enabled() for a tag pointer not yet in the table
+ *
+ * Adopts an entry created by binlog_set_level() with the same name, or adds a new entry at the
+ * default level so the next lookup for this pointer is a plain pointer compare.
+ *
+ * @param tag Tag pointer
+ *
+ * @return uint8_t Level configured for the tag
+ */
+/**************************************************************************************************/
+static uint8_t binlog_register_tag(const char *tag);
+
+/**************************************************************************************************/
+/**
+ * @name binlog_poll_commands
+ * @brief Read host commands from the UART without blocking and apply them
+ */
+/**************************************************************************************************/
+static void binlog_poll_commands(void);
+
+/*------------------------------------------------------------------------------------------------*/
+/* FUNCTION DEFINITIONS                                                                           */
+/*------------------------------------------------------------------------------------------------*/
+
+static uint8_t binlog_register_tag(const char *tag)
+{
+    uint8_t level = BINLOG_DEFAULT_LEVEL;
+
+    portENTER_CRITICAL_SAFE(&binlog_tags_lock);
+
+    uint8_t i;
+    for (i = 0; i < binlog_num_tags; i++) {
+        if (binlog_tags[i].tag == tag) {
+            break;
+        }
+        if (binlog_tags[i].tag == NULL &&
+            strncmp(binlog_tags[i].name, tag, BINLOG_TAG_NAME_LEN) == 0) {
+            binlog_tags[i].tag = tag;
+            break;
+        }
+    }
+
+    if (i < binlog_num_tags) {
+        level = binlog_tags[i].level;
+    } else if (binlog_num_tags < BINLOG_MAX_TAGS) {
+        binlog_tag_t *entry = &binlog_tags[binlog_num_tags];
+        strlcpy(entry->name, tag, BINLOG_TAG_NAME_LEN);
+        entry->level = BINLOG_DEFAULT_LEVEL;
+        entry->tag = tag;
+        binlog_num_tags++;
+    }
+
+    portEXIT_CRITICAL_SAFE(&binlog_tags_lock);
+    return level;
+}
+
+static void binlog_poll_commands(void)
+{
+    uint8_t byte;
+
+    while (uart_read_bytes(BINLOG_UART_NUM, &byte, 1, 0) == 1) {
+        if (byte != '\n' && byte != '\r') {
+            if (binlog_cmd_len < BINLOG_CMD_LINE_LEN - 1) {
+                binlog_cmd_line[binlog_cmd_len++] = (char)byte;
+            }
+            continue;
+        }
+
+        binlog_cmd_line[binlog_cmd_len] = '\0';
+        binlog_cmd_len = 0;
+
+        // "L <TAG> <LEVEL>" - LEVEL is 0 (none) to 5 (verbose), matching esp_log_level_t
+        char name[BINLOG_TAG_NAME_LEN];
+        int level;
+        if (sscanf(binlog_cmd_line, "L %15s %d", name, &level) == 2 &&
+            level >= ESP_LOG_NONE && level <= ESP_LOG_VERBOSE) {
+            binlog_set_level(name, (esp_log_level_t)level);
+            BINLOG(TAG, ESP_LOG_INFO, "Runtime level command applied (level %d)", level);
+        }
+    }
+}
+
+esp_err_t binlog_init(void)
+{
+    esp_err_t ret;
+
+    binlog_ring = xRingbufferCreate(BINLOG_RING_SIZE, RINGBUF_TYPE_BYTEBUF);
+    if (binlog_ring == NULL) {
+        ESP_LOGE(TAG, "Failed to create binlog ring buffer");
+        return ESP_ERR_NO_MEM;
+    }
+
+    uart_config_t uart_conf = {
+        .baud_rate = BINLOG_UART_BAUD,
+        .data_bits = UART_DATA_8_BITS,
+        .parity = UART_PARITY_DISABLE,
+        .stop_bits = UART_STOP_BITS_1,
+        .flow_ctrl = UART_HW_FLOWCTRL_DISABLE,
+        .source_clk = UART_SCLK_DEFAULT,
+    };
+
+    ret = uart_driver_install(BINLOG_UART_NUM, BINLOG_UART_RX_BUF_LEN, BINLOG_UART_TX_BUF_LEN,
+                              0, NULL, 0);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to install UART driver: %s", esp_err_to_name(ret));
+        return ret;
+    }
+
+    ret = uart_param_config(BINLOG_UART_NUM, &uart_conf);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to configure UART: %s", esp_err_to_name(ret));
+        return ret;
+    }
+
+    BINLOG(TAG, ESP_LOG_INFO, "Binary logging on UART%d at %d baud",
+           BINLOG_UART_NUM, BINLOG_UART_BAUD);
+    return ESP_OK;
+}
+
+void binlog_set_level(const char *tag, esp_log_level_t level)
+{
+    // Keep text mode in step so the same control works with ESP_LOGx
+    esp_log_level_set(tag, level);
+
+    bool found = false;
+
+    portENTER_CRITICAL_SAFE(&binlog_tags_lock);
+
+    for (uint8_t i = 0; i < binlog_num_tags; i++) {
+        if (strncmp(binlog_tags[i].name, tag, BINLOG_TAG_NAME_LEN) == 0) {
+            binlog_tags[i].level = (uint8_t)level;
+            found = true;
+        }
+    }
+
+    // Not logged yet - remember the name, the pointer is adopted on first use
+    if (!found && binlog_num_tags < BINLOG_MAX_TAGS) {
+        binlog_tag_t *entry = &binlog_tags[binlog_num_tags];
+        strlcpy(entry->name, tag, BINLOG_TAG_NAME_LEN);
+        entry->level = (uint8_t)level;
+        entry->tag = NULL;
+        binlog_num_tags++;
+    }
+
+    portEXIT_CRITICAL_SAFE(&binlog_tags_lock);
+}
+
+bool binlog_level_enabled(const char *tag, esp_log_level_t level)
+{
+    uint8_t num_tags = binlog_num_tags;
+
+    for (uint8_t i = 0; i < num_tags; i++) {
+        if (binlog_tags[i].tag == tag) {
+            return (uint8_t)level <= binlog_tags[i].level;
+        }
+    }
+
+    return (uint8_t)level <= binlog_register_tag(tag);
+}
+
+void binlog_write(const char *tag, esp_log_level_t level, const char *format,
+                  const uint32_t *args, uint8_t num_args)
+{
+    if (binlog_ring == NULL) {
+        return;
+    }
+
+    if (num_args > BINLOG_MAX_WORDS) {
+        num_args = BINLOG_MAX_WORDS;
+    }
+
+    uint8_t frame[BINLOG_FRAME_MAX];
+    uint8_t len = BINLOG_HEADER_SIZE + 4 * num_args + 1;
+    uint32_t timestamp = (uint32_t)esp_timer_get_time();
+    uint32_t tag_addr = (uint32_t)(uintptr_t)tag;
+    uint32_t format_addr = (uint32_t)(uintptr_t)format;
+
+    frame[0] = BINLOG_SYNC_0;
+    frame[1] = BINLOG_SYNC_1;
+    frame[2] = len;
+    frame[3] = (uint8_t)((level << BINLOG_LEVEL_SHIFT) | num_args);
+    memcpy(&frame[4], &timestamp, 4);
+    memcpy(&frame[8], &tag_addr, 4);
+    memcpy(&frame[12], &format_addr, 4);
+    memcpy(&frame[BINLOG_HEADER_SIZE], args, 4 * num_args);
+
+    uint8_t sum = 0;
+    for (uint8_t i = 2; i < len - 1; i++) {
+        sum += frame[i];
+    }
+    frame[len - 1] = sum;
+
+    BaseType_t sent;
+    if (xPortInIsrContext()) {
+        BaseType_t higher_priority_woken = pdFALSE;
+        sent = xRingbufferSendFromISR(binlog_ring, frame, len, &higher_priority_woken);
+        if (higher_priority_woken) {
+            portYIELD_FROM_ISR();
+        }
+    } else {
+        sent = xRingbufferSend(binlog_ring, frame, len, 0);
+    }
+
+    if (sent != pdTRUE) {
+        binlog_dropped++;
+    }
+}
+
+void binlog_drain(uint32_t timeout_ms)
+{
+    if (binlog_ring == NULL) {
+        return;
+    }
+
+    size_t len = 0;
+    uint8_t *data = xRingbufferReceiveUpTo(binlog_ring, &len, pdMS_TO_TICKS(timeout_ms),
+                                           BINLOG_DRAIN_CHUNK);
+    if (data != NULL) {
+        uart_write_bytes(BINLOG_UART_NUM, data, len);
+        vRingbufferReturnItem(binlog_ring, data);
+    }
+
+    uint32_t dropped = binlog_dropped;
+    if (dropped != binlog_dropped_reported) {
+        BINLOG(TAG, ESP_LOG_WARN, "%lu records dropped (ring full)",
+               (unsigned long)(dropped - binlog_dropped_reported));
+        binlog_dropped_reported = dropped;
+    }
+
+    binlog_poll_commands();
+}
+
+uint32_t binlog_get_dropped(void)
+{
+    return binlog_dropped;
+}
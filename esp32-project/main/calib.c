@@ -0,0 +1,308 @@
+/**************************************************************************************************/
+/**
+ * @file calib.c
+ * @author Ryan Jing (r5jing@uwaterloo.ca)
+ * @brief Calibration profile persisted in NVS
+ *
+ * The whole profile is one packed blob so boot costs a single nvs_get_blob(). Consumers read the
+ * active profile through calib_get() every time they need a value, so a profile sent by the RPi
+ * takes effect without a reboot (except the I2C address, which is applied at the next boot).
+ *
+ * @version 0.1
+ * @date 2025-11-21
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+/**************************************************************************************************/
+
+/*------------------------------------------------------------------------------------------------*/
+/* HEADERS                                                                                        */
+/*------------------------------------------------------------------------------------------------*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "esp_err.h"
+#include "esp_log.h"
+#include "nvs.h"
+#include "nvs_flash.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "calib.h"
+#include "comm.h"
+#include "motors.h"
+#include "sensors.h"
+#include "utils.h"
+
+/*------------------------------------------------------------------------------------------------*/
+/* MACROS                                                                                         */
+/*------------------------------------------------------------------------------------------------*/
+
+#define CALIB_NVS_NAMESPACE         "boxdj"
+#define CALIB_NVS_KEY               "calib"
+
+#define CALIB_ADC_MAX               4095
+
+// Motor sweep timing
+#define CALIB_SWEEP_SETTLE_MS       400     // Let the platter reach steady state
+#define CALIB_SWEEP_MEASURE_MS      200     // Count window per duty point
+
+/*------------------------------------------------------------------------------------------------*/
+/* GLOBAL VARIABLES                                                                               */
+/*------------------------------------------------------------------------------------------------*/
+
+static const char *TAG = "CALIB";
+
+// Defaults reproduce the previous hardcoded behaviour (duty 200 at the target speed)
+static const calib_profile_t calib_defaults = {
+    .version = CALIB_VERSION,
+    .pots = {
+        [CALIB_POT_VOLUME] = { .min = 0, .max = CALIB_ADC_MAX },
+        [CALIB_POT_SLIDER] = { .min = 0, .max = CALIB_ADC_MAX },
+    },
+    .motor_curve = {
+        { .duty = 0,   .rpm_x10 = 0 },
+        { .duty = 100, .rpm_x10 = 150 },
+        { .duty = 200, .rpm_x10 = 333 },
+        { .duty = 255, .rpm_x10 = 450 },
+    },
+    .motor_target_rpm_x10 = 333,
+    .encoder_direction = { 1, 1 },
+    .encoder_ppr = { 24, 24 },
+    .i2c_address = I2C_SLAVE_ADDR,
+};
+
+static calib_profile_t calib_active;
+static bool calib_stored = false;
+static portMUX_TYPE calib_lock = portMUX_INITIALIZER_UNLOCKED;
+
+/*------------------------------------------------------------------------------------------------*/
+/* FUNCTION PROTOTYPES                                                                            */
+/*------------------------------------------------------------------------------------------------*/
+
+/**************************************************************************************************/
+/**
+ * @name calib_validate
+ * @brief Check that every field of a profile is in range
+ *
+ * @param profile Profile to check
+ *
+ * @return true if the profile can be applied
+ */
+/**************************************************************************************************/
+static bool calib_validate(const calib_profile_t *profile);
+
+/*------------------------------------------------------------------------------------------------*/
+/* FUNCTION DEFINITIONS                                                                           */
+/*------------------------------------------------------------------------------------------------*/
+
+static bool calib_validate(const calib_profile_t *profile)
+{
+    if (profile->version != CALIB_VERSION) {
+        return false;
+    }
+
+    for (int i = 0; i < CALIB_NUM_POTS; i++) {
+        if (profile->pots[i].min >= profile->pots[i].max ||
+            profile->pots[i].max > CALIB_ADC_MAX) {
+            return false;
+        }
+    }
+
+    for (int i = 1; i < CALIB_MOTOR_CURVE_POINTS; i++) {
+        if (profile->motor_curve[i].duty <= profile->motor_curve[i - 1].duty ||
+            profile->motor_curve[i].rpm_x10 < profile->motor_curve[i - 1].rpm_x10) {
+            return false;
+        }
+    }
+
+    for (int i = 0; i < NUM_ENCODERS; i++) {
+        if ((profile->encoder_direction[i] != 1 && profile->encoder_direction[i] != -1) ||
+            profile->encoder_ppr[i] == 0) {
+            return false;
+        }
+    }
+
+    // Reserved 7-bit address ranges
+    if (profile->i2c_address < 0x08 || profile->i2c_address > 0x77) {
+        return false;
+    }
+
+    return true;
+}
+
+esp_err_t calib_init(void)
+{
+    esp_err_t ret;
+
+    ret = nvs_flash_init();
+    if (ret == ESP_ERR_NVS_NO_FREE_PAGES || ret == ESP_ERR_NVS_NEW_VERSION_FOUND) {
+        // Partition layout changed - erase and start over
+        LOG_WARN(TAG, "NVS partition needs erase: %s", esp_err_to_name(ret));
+        ret = nvs_flash_erase();
+        if (ret == ESP_OK) {
+            ret = nvs_flash_init();
+        }
+    }
+    if (ret != ESP_OK) {
+        LOG_ERROR(TAG, "Failed to initialize NVS: %s", esp_err_to_name(ret));
+        return ret;
+    }
+
+    calib_active = calib_defaults;
+    calib_stored = false;
+
+    nvs_handle_t handle;
+    ret = nvs_open(CALIB_NVS_NAMESPACE, NVS_READONLY, &handle);
+    if (ret != ESP_OK) {
+        // Namespace does not exist until the first save
+        LOG_INFO(TAG, "No stored calibration (%s), using defaults", esp_err_to_name(ret));
+        return ESP_OK;
+    }
+
+    calib_profile_t profile;
+    size_t size = sizeof(profile);
+    ret = nvs_get_blob(handle, CALIB_NVS_KEY, &profile, &size);
+    nvs_close(handle);
+
+    if (ret != ESP_OK || size != sizeof(profile) || !calib_validate(&profile)) {
+        LOG_WARN(TAG, "Stored calibration unusable (%s, %d bytes), using defaults",
+                 esp_err_to_name(ret), (int)size);
+        return ESP_OK;
+    }
+
+    calib_active = profile;
+    calib_stored = true;
+
+    LOG_INFO(TAG, "Calibration loaded: target %d.%d RPM, I2C 0x%02X",
+             profile.motor_target_rpm_x10 / 10, profile.motor_target_rpm_x10 % 10,
+             profile.i2c_address);
+    return ESP_OK;
+}
+
+const calib_profile_t *calib_get(void)
+{
+    return &calib_active;
+}
+
+bool calib_is_stored(void)
+{
+    return calib_stored;
+}
+
+esp_err_t calib_save(const calib_profile_t *profile)
+{
+    if (profile == NULL || !calib_validate(profile)) {
+        LOG_WARN(TAG, "Rejected invalid calibration profile");
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    if (profile->i2c_address != calib_active.i2c_address) {
+        LOG_WARN(TAG, "I2C address 0x%02X takes effect after reboot", profile->i2c_address);
+    }
+
+    portENTER_CRITICAL(&calib_lock);
+    calib_active = *profile;
+    portEXIT_CRITICAL(&calib_lock);
+
+    nvs_handle_t handle;
+    esp_err_t ret = nvs_open(CALIB_NVS_NAMESPACE, NVS_READWRITE, &handle);
+    if (ret != ESP_OK) {
+        LOG_ERROR(TAG, "Failed to open NVS: %s", esp_err_to_name(ret));
+        return ret;
+    }
+
+    ret = nvs_set_blob(handle, CALIB_NVS_KEY, profile, sizeof(*profile));
+    if (ret == ESP_OK) {
+        ret = nvs_commit(handle);
+    }
+    nvs_close(handle);
+
+    if (ret != ESP_OK) {
+        LOG_ERROR(TAG, "Failed to store calibration: %s", esp_err_to_name(ret));
+        return ret;
+    }
+
+    calib_stored = true;
+    LOG_INFO(TAG, "Calibration saved");
+    return ESP_OK;
+}
+
+esp_err_t calib_run_motor_sweep(void)
+{
+    calib_profile_t profile = calib_active;
+    const uint8_t duties[CALIB_MOTOR_CURVE_POINTS] = { 0, 100, 200, 255 };
+    uint32_t counts_per_rev = 4u * profile.encoder_ppr[CALIB_MOTOR_ENCODER];  // x4 quadrature
+
+    LOG_INFO(TAG, "Running motor sweep on encoder %d", CALIB_MOTOR_ENCODER);
+
+    for (int i = 0; i < CALIB_MOTOR_CURVE_POINTS; i++) {
+        motors_forward(duties[i]);
+        vTaskDelay(pdMS_TO_TICKS(CALIB_SWEEP_SETTLE_MS));
+
+        int32_t start = encoder_get_position(CALIB_MOTOR_ENCODER);
+        vTaskDelay(pdMS_TO_TICKS(CALIB_SWEEP_MEASURE_MS));
+        int32_t counts = abs(encoder_get_position(CALIB_MOTOR_ENCODER) - start);
+
+        // counts/window -> RPM x 10
+        uint32_t rpm_x10 = ((uint32_t)counts * 60u * 10u * 1000u) /
+                           (counts_per_rev * CALIB_SWEEP_MEASURE_MS);
+
+        profile.motor_curve[i].duty = duties[i];
+        profile.motor_curve[i].rpm_x10 = (uint16_t)rpm_x10;
+        LOG_INFO(TAG, "  duty %3d -> %lu.%lu RPM", duties[i],
+                 (unsigned long)(rpm_x10 / 10), (unsigned long)(rpm_x10 % 10));
+    }
+
+    motors_stop();
+
+    // A stalled or disconnected motor gives a flat curve - keep the default curve in that case
+    // but still store the profile so the sweep is not repeated on every boot
+    if (profile.motor_curve[CALIB_MOTOR_CURVE_POINTS - 1].rpm_x10 == 0 ||
+        !calib_validate(&profile)) {
+        LOG_WARN(TAG, "Motor sweep gave no usable curve, keeping defaults");
+        memcpy(profile.motor_curve, calib_defaults.motor_curve, sizeof(profile.motor_curve));
+    }
+
+    return calib_save(&profile);
+}
+
+uint8_t calib_motor_duty_for_rpm(uint16_t rpm_x10)
+{
+    const calib_motor_point_t *curve = calib_active.motor_curve;
+
+    if (rpm_x10 <= curve[0].rpm_x10) {
+        return curve[0].duty;
+    }
+
+    for (int i = 1; i < CALIB_MOTOR_CURVE_POINTS; i++) {
+        if (rpm_x10 <= curve[i].rpm_x10) {
+            uint32_t span_rpm = curve[i].rpm_x10 - curve[i - 1].rpm_x10;
+            uint32_t span_duty = curve[i].duty - curve[i - 1].duty;
+            uint32_t offset = rpm_x10 - curve[i - 1].rpm_x10;
+            return (uint8_t)(curve[i - 1].duty + (offset * span_duty + span_rpm / 2) / span_rpm);
+        }
+    }
+
+    return curve[CALIB_MOTOR_CURVE_POINTS - 1].duty;
+}
+
+uint16_t calib_scale_pot(uint8_t pot, uint16_t raw)
+{
+    if (pot >= CALIB_NUM_POTS) {
+        return raw;
+    }
+
+    uint16_t min = calib_active.pots[pot].min;
+    uint16_t max = calib_active.pots[pot].max;
+
+    if (raw <= min) {
+        return 0;
+    }
+    if (raw >= max) {
+        return CALIB_ADC_MAX;
+    }
+
+    return (uint16_t)(((uint32_t)(raw - min) * CALIB_ADC_MAX) / (max - min));
+}
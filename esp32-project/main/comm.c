@@ -17,21 +17,28 @@
 /*------------------------------------------------------------------------------------------------*/
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include "esp_err.h"
 #include "esp_timer.h"
 #include "esp_log.h"
 #include "driver/i2c.h"
+#include "freertos/FreeRTOS.h"
 #include "comm.h"
 #include "sensors.h"
 #include "utils.h"
 #include "inputs.h"
+#include "calib.h"
+#include "motors.h"
+#include "leds.h"
+#include "lcd.h"
+#include "power.h"
 
 /*------------------------------------------------------------------------------------------------*/
 /* MACROS                                                                                         */
 /*------------------------------------------------------------------------------------------------*/
 
-// I2C data packet structure (25 bytes total)
+// I2C data packet structure (27 bytes total)
 #define I2C_DATA_ENC1_POS_OFFSET      0   // Offset for encoder 1 position (4 bytes)
 #define I2C_DATA_ENC1_VEL_OFFSET      4   // Offset for encoder 1 velocity (4 bytes)
 #define I2C_DATA_ENC2_POS_OFFSET      8   // Offset for encoder 2 position (4 bytes)
@@ -40,6 +47,11 @@
 #define I2C_DATA_BUTTON_OFFSET        20  // Offset for button flags (1 byte)
 #define I2C_DATA_VOLUME_POT_OFFSET    21  // Offset for volume potentiometer (2 bytes)
 #define I2C_DATA_SLIDER_POT_OFFSET    23  // Offset for slider potentiometer (2 bytes)
+#define I2C_DATA_CMD_ACK_OFFSET       25  // Offset for last committed command sequence (1 byte)
+#define I2C_DATA_CMD_STATUS_OFFSET    26  // Offset for status of that commit (1 byte)
+
+// Pot change that counts as user activity for power management (ADC noise is ~20 counts)
+#define COMM_POT_ACTIVITY_DEADBAND    64
 
 /*------------------------------------------------------------------------------------------------*/
 /* GLOBAL VARIABLES                                                                               */
@@ -50,16 +62,204 @@ static uint8_t i2c_data_buffer[I2C_DATA_PACKET_SIZE];
 
 static input_data_t last_input_data = {0};
 
+// One command frame (header + payload)
+static uint8_t comm_rx_buffer[I2C_SLAVE_RX_BUF_LEN];
+
+// Command acknowledgement - reported in every packet
+static volatile uint8_t comm_cmd_ack_seq = 0;       // 0 = nothing committed since boot
+static volatile uint8_t comm_cmd_ack_status = I2C_CMD_STATUS_OK;
+static uint8_t comm_cmd_pending_status = I2C_CMD_STATUS_OK;
+static int64_t comm_cmd_max_latency_us = 0;
+
+static int64_t comm_ready_time_us = 0;
+
+// Power management - previous positions for wake latency, SDA edge flag for idle detection
+static int32_t comm_last_enc1_position = 0;
+static int32_t comm_last_enc2_position = 0;
+static volatile bool comm_bus_active = false;
+static volatile bool comm_suspended = false;
+static bool comm_bus_handler_added = false;
+
 /*------------------------------------------------------------------------------------------------*/
 /* FUNCTION PROTOTYPES                                                                            */
 /*------------------------------------------------------------------------------------------------*/
 
+/**************************************************************************************************/
+/**
+ * @name comm_handle_command
+ * @brief Apply one complete command frame
+ *
+ * @param cmd Command ID (I2C_CMD_*)
+ * @param payload Payload bytes
+ * @param len Payload length
+ *
+ * @return uint8_t I2C_CMD_STATUS_*
+ */
+/**************************************************************************************************/
+static uint8_t comm_handle_command(uint8_t cmd, const uint8_t *payload, uint8_t len);
+
+/**************************************************************************************************/
+/**
+ * @name comm_read_exact
+ * @brief Read exactly len bytes from the RX buffer
+ *
+ * The driver only returns early once the request is filled, so reading the exact frame size is
+ * what keeps command latency independent of the timeout.
+ *
+ * @param data Destination
+ * @param len Number of bytes
+ * @param timeout_ms Time to wait for all bytes
+ *
+ * @return int Bytes read (less than len on timeout)
+ */
+/**************************************************************************************************/
+static int comm_read_exact(uint8_t *data, size_t len, uint32_t timeout_ms);
 
+/**************************************************************************************************/
+/**
+ * @name comm_bus_isr_handler
+ * @brief Falling SDA edge - marks bus activity and wakes a suspended device
+ *
+ * One-shot: the interrupt disables itself and is re-armed by comm_poll_bus_activity().
+ *
+ * @param arg Unused
+ *
+ */
+/**************************************************************************************************/
+static void comm_bus_isr_handler(void *arg);
 
 /*------------------------------------------------------------------------------------------------*/
 /* FUNCTION DEFINITIONS                                                                           */
 /*------------------------------------------------------------------------------------------------*/
 
+static void IRAM_ATTR comm_bus_isr_handler(void *arg)
+{
+    gpio_intr_disable(I2C_SLAVE_SDA_IO);
+    comm_bus_active = true;
+
+    if (comm_suspended) {
+        power_wake_from_isr(POWER_WAKE_BUS);
+    }
+}
+
+static uint8_t comm_handle_command(uint8_t cmd, const uint8_t *payload, uint8_t len)
+{
+    power_notify_activity();
+
+    switch (cmd) {
+        case I2C_CMD_COMMIT: {
+            if (len != 1 || payload[0] == 0) {
+                return I2C_CMD_STATUS_BAD_LENGTH;
+            }
+
+            // Publish the status of everything since the previous commit
+            comm_cmd_ack_status = comm_cmd_pending_status;
+            comm_cmd_ack_seq = payload[0];
+            comm_cmd_pending_status = I2C_CMD_STATUS_OK;
+            return I2C_CMD_STATUS_OK;
+        }
+
+        case I2C_CMD_CALIBRATION: {
+            calib_profile_t profile;
+            if (len != sizeof(profile)) {
+                LOG_WARN(TAG, "Calibration command has %d bytes, expected %d",
+                         len, (int)sizeof(profile));
+                return I2C_CMD_STATUS_BAD_LENGTH;
+            }
+
+            memcpy(&profile, payload, sizeof(profile));
+            if (calib_save(&profile) != ESP_OK) {
+                return I2C_CMD_STATUS_BAD_ARG;
+            }
+
+            // Re-apply the platter speed from the new motor curve
+            motors_set_rpm(MOTOR_DECK_1, (int16_t)profile.motor_target_rpm_x10);
+            return I2C_CMD_STATUS_OK;
+        }
+
+        case I2C_CMD_MOTOR_SETPOINT: {
+            if (len != 3) {
+                return I2C_CMD_STATUS_BAD_LENGTH;
+            }
+
+            int16_t rpm_x10 = (int16_t)(payload[1] | (payload[2] << 8));
+            esp_err_t ret = motors_set_rpm(payload[0], rpm_x10);
+            if (ret == ESP_ERR_NOT_SUPPORTED) {
+                return I2C_CMD_STATUS_BAD_ARG;
+            }
+            return ret == ESP_OK ? I2C_CMD_STATUS_OK : I2C_CMD_STATUS_FAILED;
+        }
+
+        case I2C_CMD_LED_PATTERN: {
+            if (len != 7) {
+                return I2C_CMD_STATUS_BAD_LENGTH;
+            }
+
+            uint16_t beat_phase = (uint16_t)(payload[1] | (payload[2] << 8));
+            uint32_t beat_period_us = (uint32_t)payload[3] | ((uint32_t)payload[4] << 8) |
+                                      ((uint32_t)payload[5] << 16) | ((uint32_t)payload[6] << 24);
+            if (leds_set_pattern(payload[0], beat_phase, beat_period_us) != ESP_OK) {
+                return I2C_CMD_STATUS_BAD_ARG;
+            }
+            return I2C_CMD_STATUS_OK;
+        }
+
+        case I2C_CMD_LED_LEVEL: {
+            if (len != 1) {
+                return I2C_CMD_STATUS_BAD_LENGTH;
+            }
+
+            leds_set_level(payload[0]);
+            return I2C_CMD_STATUS_OK;
+        }
+
+        case I2C_CMD_LCD_TEXT: {
+            if (len < 1 || len > 1 + LCD_COLS) {
+                return I2C_CMD_STATUS_BAD_LENGTH;
+            }
+
+            // Only fills the framebuffer - the LCD task sends it
+            if (lcd_write_text(payload[0], (const char *)&payload[1], len - 1) != ESP_OK) {
+                return I2C_CMD_STATUS_BAD_ARG;
+            }
+            return I2C_CMD_STATUS_OK;
+        }
+
+        case I2C_CMD_LCD_TITLE: {
+            if (len > LCD_COLS) {
+                return I2C_CMD_STATUS_BAD_LENGTH;
+            }
+
+            char title[LCD_COLS + 1];
+            memcpy(title, payload, len);
+            title[len] = '\0';
+            lcd_show_now_playing(title);
+            return I2C_CMD_STATUS_OK;
+        }
+
+        case I2C_CMD_LCD_STATUS: {
+            if (len != 6) {
+                return I2C_CMD_STATUS_BAD_LENGTH;
+            }
+
+            lcd_show_bpm((uint16_t)(payload[0] | (payload[1] << 8)));
+            lcd_show_pitch((int16_t)(payload[2] | (payload[3] << 8)));
+            lcd_show_elapsed((uint16_t)(payload[4] | (payload[5] << 8)));
+            return I2C_CMD_STATUS_OK;
+        }
+
+        default:
+            LOG_WARN(TAG, "Unknown command 0x%02X (%d bytes)", cmd, len);
+            return I2C_CMD_STATUS_UNKNOWN;
+    }
+}
+
+static int comm_read_exact(uint8_t *data, size_t len, uint32_t timeout_ms)
+{
+    int received = i2c_slave_read_buffer(I2C_SLAVE_NUM, data, len, pdMS_TO_TICKS(timeout_ms));
+    return received < 0 ? 0 : received;
+}
+
 esp_err_t comm_init(void)
 {
     esp_err_t ret;
@@ -72,7 +272,7 @@ esp_err_t comm_init(void)
         .sda_pullup_en = GPIO_PULLUP_ENABLE,
         .scl_pullup_en = GPIO_PULLUP_ENABLE,
         .slave.addr_10bit_en = 0,
-        .slave.slave_addr = I2C_SLAVE_ADDR,
+        .slave.slave_addr = calib_get()->i2c_address,
         .slave.maximum_speed = 100000,  // 100kHz
     };
 
@@ -93,7 +293,7 @@ esp_err_t comm_init(void)
     memset(i2c_data_buffer, 0, I2C_DATA_PACKET_SIZE);
 
     LOG_INFO(TAG, "I2C slave initialized on SDA=%d, SCL=%d, Address=0x%02X, PacketSize=%d bytes (2 encoders, 2 pots)",
-             I2C_SLAVE_SDA_IO, I2C_SLAVE_SCL_IO, I2C_SLAVE_ADDR, I2C_DATA_PACKET_SIZE);
+             I2C_SLAVE_SDA_IO, I2C_SLAVE_SCL_IO, conf_slave.slave.slave_addr, I2C_DATA_PACKET_SIZE);
 
     return ESP_OK;
 }
@@ -112,8 +312,19 @@ esp_err_t comm_update_encoder_data(void)
     uint32_t timestamp = (uint32_t)(esp_timer_get_time() / 1000);  // Convert to ms
 
     // Get input data (buttons + potentiometer)
+    uint16_t prev_volume = last_input_data.volume_potentiometer;
+    uint16_t prev_slider = last_input_data.slider_potentiometer;
     inputs_get_data(&last_input_data);
 
+    // Platter movement, buttons and pots are the user inputs that keep the device out of idle
+    bool encoder_moved = enc1_position != comm_last_enc1_position ||
+                         enc2_position != comm_last_enc2_position;
+    if (encoder_moved || last_input_data.button_flags != 0 ||
+        abs((int)last_input_data.volume_potentiometer - (int)prev_volume) > COMM_POT_ACTIVITY_DEADBAND ||
+        abs((int)last_input_data.slider_potentiometer - (int)prev_slider) > COMM_POT_ACTIVITY_DEADBAND) {
+        power_notify_activity();
+    }
+
     // Pack data into buffer (little-endian format)
 
     // Encoder 1 Position (4 bytes)
@@ -159,6 +370,10 @@ esp_err_t comm_update_encoder_data(void)
     i2c_data_buffer[I2C_DATA_SLIDER_POT_OFFSET + 0] = (last_input_data.slider_potentiometer >> 0) & 0xFF;
     i2c_data_buffer[I2C_DATA_SLIDER_POT_OFFSET + 1] = (last_input_data.slider_potentiometer >> 8) & 0xFF;
 
+    // Command acknowledgement (1 byte each)
+    i2c_data_buffer[I2C_DATA_CMD_ACK_OFFSET] = comm_cmd_ack_seq;
+    i2c_data_buffer[I2C_DATA_CMD_STATUS_OFFSET] = comm_cmd_ack_status;
+
     // Write data to I2C slave buffer (ready for master to read)
     int written = i2c_slave_write_buffer(I2C_SLAVE_NUM, i2c_data_buffer,
                                          I2C_DATA_PACKET_SIZE, 0);
@@ -170,5 +385,121 @@ esp_err_t comm_update_encoder_data(void)
     // Clear button flags after successful transmission
     inputs_clear_button_flags();
 
+    // First packet carrying movement after a wake closes the wake latency measurement
+    power_note_sample(encoder_moved);
+    comm_last_enc1_position = enc1_position;
+    comm_last_enc2_position = enc2_position;
+
+    if (comm_ready_time_us == 0) {
+        comm_ready_time_us = esp_timer_get_time();
+        LOG_INFO(TAG, "First packet ready %lld ms after boot (calibration %s)",
+                 comm_ready_time_us / 1000, calib_is_stored() ? "loaded from NVS" : "defaults");
+    }
+
     return ESP_OK;
-}
\ No newline at end of file
+}
+
+esp_err_t comm_process_commands(uint32_t timeout_ms)
+{
+    uint8_t *frame = comm_rx_buffer;
+
+    // Block for the first byte only, the rest of the frame is already in flight
+    if (comm_read_exact(frame, 1, timeout_ms) != 1) {
+        return ESP_ERR_TIMEOUT;
+    }
+    int64_t start_us = esp_timer_get_time();
+
+    uint8_t status;
+    if (comm_read_exact(&frame[1], 1, I2C_CMD_FRAME_TIMEOUT_MS) != 1) {
+        status = I2C_CMD_STATUS_FRAMING;
+    } else if (I2C_CMD_HEADER_SIZE + (size_t)frame[1] > sizeof(comm_rx_buffer)) {
+        status = I2C_CMD_STATUS_FRAMING;
+    } else if (comm_read_exact(&frame[I2C_CMD_HEADER_SIZE], frame[1],
+                               I2C_CMD_FRAME_TIMEOUT_MS) != frame[1]) {
+        status = I2C_CMD_STATUS_FRAMING;
+    } else {
+        status = comm_handle_command(frame[0], &frame[I2C_CMD_HEADER_SIZE], frame[1]);
+    }
+
+    if (status == I2C_CMD_STATUS_FRAMING) {
+        // Lost sync - drop whatever is left of this write and resynchronize on the next one
+        while (comm_read_exact(comm_rx_buffer, sizeof(comm_rx_buffer),
+                               I2C_CMD_FRAME_TIMEOUT_MS) > 0) {
+        }
+        LOG_WARN(TAG, "Discarded malformed command data");
+    }
+
+    if (status != I2C_CMD_STATUS_OK && comm_cmd_pending_status == I2C_CMD_STATUS_OK) {
+        comm_cmd_pending_status = status;
+    }
+
+    int64_t latency_us = esp_timer_get_time() - start_us;
+    if (latency_us > comm_cmd_max_latency_us) {
+        comm_cmd_max_latency_us = latency_us;
+        LOG_DEBUG(TAG, "Command 0x%02X applied in %lld us (new max)", frame[0], latency_us);
+    }
+
+    return status == I2C_CMD_STATUS_FRAMING ? ESP_ERR_INVALID_SIZE : ESP_OK;
+}
+
+int64_t comm_get_ready_time_us(void)
+{
+    return comm_ready_time_us;
+}
+
+esp_err_t comm_suspend(void)
+{
+    esp_err_t ret = i2c_driver_delete(I2C_SLAVE_NUM);
+    if (ret != ESP_OK) {
+        LOG_ERROR(TAG, "Failed to remove I2C driver: %s", esp_err_to_name(ret));
+        return ret;
+    }
+
+    comm_suspended = true;
+
+    // SDA idles high, the master's START condition pulls it low
+    ret = gpio_wakeup_enable(I2C_SLAVE_SDA_IO, GPIO_INTR_LOW_LEVEL);
+    if (ret != ESP_OK) {
+        LOG_ERROR(TAG, "Failed to enable wakeup on SDA: %s", esp_err_to_name(ret));
+        return ret;
+    }
+    gpio_intr_enable(I2C_SLAVE_SDA_IO);
+
+    LOG_INFO(TAG, "I2C slave suspended, waking on SDA activity");
+    return ESP_OK;
+}
+
+esp_err_t comm_resume(void)
+{
+    gpio_intr_disable(I2C_SLAVE_SDA_IO);
+    gpio_wakeup_disable(I2C_SLAVE_SDA_IO);
+    comm_suspended = false;
+
+    return comm_init();
+}
+
+bool comm_poll_bus_activity(void)
+{
+    if (!comm_bus_handler_added) {
+        esp_err_t ret = gpio_isr_handler_add(I2C_SLAVE_SDA_IO, comm_bus_isr_handler, NULL);
+        if (ret != ESP_OK) {
+            LOG_ERROR(TAG, "Failed to add SDA activity handler: %s", esp_err_to_name(ret));
+            return true;  // Cannot tell - assume the bus is busy so the device never parks
+        }
+        comm_bus_handler_added = true;
+    }
+
+    bool active = comm_bus_active;
+    comm_bus_active = false;
+
+    // Re-arm the one-shot edge interrupt for the next interval
+    gpio_set_intr_type(I2C_SLAVE_SDA_IO, GPIO_INTR_NEGEDGE);
+    gpio_intr_enable(I2C_SLAVE_SDA_IO);
+
+    return active;
+}
+
+int64_t comm_get_max_command_latency_us(void)
+{
+    return comm_cmd_max_latency_us;
+}
@@ -0,0 +1,121 @@
+/**************************************************************************************************/
+/**
+ * @file diag.c
+ * @author Ryan Jing (r5jing@uwaterloo.ca)
+ * @brief Timing diagnostics - sampling loop jitter and the cost of the visual tasks
+ *
+ * The sampling task only stores a timestamp and updates three counters per iteration; all
+ * formatting happens in diag_report() from the lowest priority task.
+ *
+ * @version 0.1
+ * @date 2025-11-23
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+/**************************************************************************************************/
+
+/*------------------------------------------------------------------------------------------------*/
+/* HEADERS                                                                                        */
+/*------------------------------------------------------------------------------------------------*/
+
+#include <stdio.h>
+#include <stdint.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "diag.h"
+#include "lcd.h"
+#include "leds.h"
+#include "utils.h"
+
+/*------------------------------------------------------------------------------------------------*/
+/* MACROS                                                                                         */
+/*------------------------------------------------------------------------------------------------*/
+
+#define DIAG_GAP_US     1000000     // Longer gaps between samples mean the loop was parked
+
+/*------------------------------------------------------------------------------------------------*/
+/* GLOBAL VARIABLES                                                                               */
+/*------------------------------------------------------------------------------------------------*/
+
+static const char *TAG = "DIAG";
+
+// Sampling loop window - written by i2c_comm_task (core 1), read by the diagnostics task
+static portMUX_TYPE diag_lock = portMUX_INITIALIZER_UNLOCKED;
+static int64_t diag_last_sample_us = 0;
+static uint32_t diag_samples = 0;
+static int64_t diag_interval_sum_us = 0;
+static int64_t diag_interval_min_us = INT64_MAX;
+static int64_t diag_interval_max_us = 0;
+
+/*------------------------------------------------------------------------------------------------*/
+/* FUNCTION DEFINITIONS                                                                           */
+/*------------------------------------------------------------------------------------------------*/
+
+void diag_note_sample(void)
+{
+    int64_t now = esp_timer_get_time();
+
+    portENTER_CRITICAL(&diag_lock);
+    int64_t interval = now - diag_last_sample_us;
+    diag_last_sample_us = now;
+
+    // The first sample after boot or a park only sets the reference
+    if (interval < DIAG_GAP_US) {
+        diag_samples++;
+        diag_interval_sum_us += interval;
+        if (interval < diag_interval_min_us) {
+            diag_interval_min_us = interval;
+        }
+        if (interval > diag_interval_max_us) {
+            diag_interval_max_us = interval;
+        }
+    }
+    portEXIT_CRITICAL(&diag_lock);
+}
+
+void diag_get_sample_stats(diag_sample_stats_t *stats)
+{
+    portENTER_CRITICAL(&diag_lock);
+    stats->samples = diag_samples;
+    stats->min_interval_us = diag_samples ? diag_interval_min_us : 0;
+    stats->max_interval_us = diag_interval_max_us;
+    stats->mean_interval_us = diag_samples ? diag_interval_sum_us / diag_samples : 0;
+
+    diag_samples = 0;
+    diag_interval_sum_us = 0;
+    diag_interval_min_us = INT64_MAX;
+    diag_interval_max_us = 0;
+    portEXIT_CRITICAL(&diag_lock);
+}
+
+void diag_report(void)
+{
+    diag_sample_stats_t sample;
+    leds_stats_t led;
+    lcd_stats_t lcd;
+
+    diag_get_sample_stats(&sample);
+    leds_get_stats(&led);
+    lcd_get_stats(&lcd);
+
+    if (sample.samples == 0) {
+        return;
+    }
+
+    LOG_INFO(TAG, "Sampling: %lu iterations, interval %lld/%lld/%lld us (min/mean/max), "
+             "jitter %lld us, LCD %s", (unsigned long)sample.samples, sample.min_interval_us,
+             sample.mean_interval_us, sample.max_interval_us,
+             sample.max_interval_us - sample.min_interval_us,
+             (LCD_ENABLED && lcd.present) ? "on" : "off");
+    LOG_INFO(TAG, "LEDs: %lu updates, kernel %lu cycles (max %lu), update max %lu cycles, "
+             "phase error %ld us", (unsigned long)led.updates,
+             (unsigned long)led.kernel_cycles_last, (unsigned long)led.kernel_cycles_max,
+             (unsigned long)led.update_cycles_max, (long)led.phase_error_us);
+    if (lcd.present) {
+        LOG_INFO(TAG, "LCD: %lu flushes, %lu bytes, longest flush %lu us, %u cells pending, "
+                 "%lu errors", (unsigned long)lcd.flushes, (unsigned long)lcd.bytes,
+                 (unsigned long)lcd.max_flush_us, lcd.dirty_cells, (unsigned long)lcd.errors);
+    }
+}
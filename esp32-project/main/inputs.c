@@ -28,6 +28,8 @@
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "inputs.h"
+#include "calib.h"
+#include "power.h"
 #include "utils.h"
 
 /*------------------------------------------------------------------------------------------------*/
@@ -75,6 +77,9 @@ static const gpio_num_t button_gpios[NUM_BUTTONS] = {
 static adc_oneshot_unit_handle_t adc_handle = NULL;
 static adc_cali_handle_t adc_cali_handle = NULL;
 
+// Buttons are level-triggered wake sources while the device is parked
+static volatile bool buttons_wakeup_armed = false;
+
 /*------------------------------------------------------------------------------------------------*/
 /* FUNCTION PROTOTYPES                                                                            */
 /*------------------------------------------------------------------------------------------------*/
@@ -151,6 +156,12 @@ static void IRAM_ATTR button_isr_handler(void *arg)
 
     if (button_idx < 0) return;
 
+    if (buttons_wakeup_armed) {
+        // Low-level wake interrupt - fires once, edge interrupts return on resume
+        gpio_intr_disable(gpio);
+        power_wake_from_isr(POWER_WAKE_BUTTON);
+    }
+
     uint32_t now = (uint32_t)(esp_timer_get_time());
     uint32_t time_since_last = now - button_states[button_idx].last_press;
 
@@ -248,6 +259,13 @@ static esp_err_t volume_potentiometer_init(void)
         return ret;
     }
 
+    // Stored pot endpoints already account for ADC non-linearity at the travel ends, so the
+    // line fitting scheme is only created when running uncalibrated
+    if (calib_is_stored()) {
+        LOG_INFO(TAG, "Potentiometer initialized on ADC1_CH6 (GPIO 34), stored endpoints");
+        return ESP_OK;
+    }
+
     // Setup calibration (optional but recommended for accuracy)
     // ESP32 uses line fitting calibration scheme
     adc_cali_line_fitting_config_t cali_config = {
@@ -330,11 +348,13 @@ esp_err_t inputs_get_data(input_data_t *data)
         }
     }
 
-    // Read volume potentiometer value
-    data->volume_potentiometer = inputs_read_volume_potentiometer();
+    // Read volume potentiometer value (stretched to 0-4095 between calibrated endpoints)
+    data->volume_potentiometer = calib_scale_pot(CALIB_POT_VOLUME,
+                                                 inputs_read_volume_potentiometer());
 
     // Read slider potentiometer value
-    data->slider_potentiometer = inputs_read_slider_potentiometer();
+    data->slider_potentiometer = calib_scale_pot(CALIB_POT_SLIDER,
+                                                 inputs_read_slider_potentiometer());
 
     return ESP_OK;
 }
@@ -377,3 +397,30 @@ uint16_t inputs_read_slider_potentiometer(void)
     // Return 12-bit value (0-4095)
     return (uint16_t)raw_value;
 }
+
+esp_err_t inputs_set_wakeup(bool enable)
+{
+    esp_err_t ret;
+
+    buttons_wakeup_armed = enable;
+
+    for (int i = 0; i < NUM_BUTTONS; i++) {
+        gpio_num_t gpio = button_gpios[i];
+
+        if (enable) {
+            // Pulled up, pressed = low
+            ret = gpio_wakeup_enable(gpio, GPIO_INTR_LOW_LEVEL);
+        } else {
+            gpio_wakeup_disable(gpio);
+            ret = gpio_set_intr_type(gpio, GPIO_INTR_NEGEDGE);
+        }
+        if (ret != ESP_OK) {
+            LOG_ERROR(TAG, "Failed to %s wakeup on GPIO %d: %s", enable ? "enable" : "disable",
+                      gpio, esp_err_to_name(ret));
+            return ret;
+        }
+        gpio_intr_enable(gpio);
+    }
+
+    return ESP_OK;
+}
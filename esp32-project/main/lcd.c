@@ -1,89 +1,500 @@
-// /**************************************************************************************************/
-// /**
-//  * @file lcd.c
-//  * @author Ryan Jing (r5jing@uwaterloo.ca)
-//  * @brief
-//  *
-//  * @version 0.1
-//  * @date 2025-11-08
-//  *
-//  * @copyright Copyright (c) 2025
-//  *
-//  */
-// /**************************************************************************************************/
-
-// /*------------------------------------------------------------------------------------------------*/
-// /* HEADERS                                                                                        */
-// /*------------------------------------------------------------------------------------------------*/
-
-// #include <stdio.h>
-// #include "esp_err.h"
-// #include "esp_log.h"
-// #include "driver/gpio.h"
-// #include "lcd.h"
-
-
-// /*------------------------------------------------------------------------------------------------*/
-// /* MACROS                                                                                         */
-// /*------------------------------------------------------------------------------------------------*/
-
-
-// /*------------------------------------------------------------------------------------------------*/
-// /* GLOBAL VARIABLES                                                                               */
-// /*------------------------------------------------------------------------------------------------*/
-
-
-// static hd44780_t lcd = {
-//     .pins = {
-//         .rs = GPIO_NUM_18,
-//         .e  = GPIO_NUM_19,
-//         .d4 = GPIO_NUM_23,
-//         .d5 = GPIO_NUM_22,
-//         .d6 = GPIO_NUM_21,
-//         .d7 = GPIO_NUM_5,
-//         .bl = HD44780_NOT_USED  // Or assign a GPIO if you wired backlight
-//     },
-//     .font = HD44780_FONT_5X8,
-//     .lines = 2
-// };
-
-// /*------------------------------------------------------------------------------------------------*/
-// /* FUNCTION PROTOTYPES                                                                            */
-// /*------------------------------------------------------------------------------------------------*/
-
-
-
-// /*------------------------------------------------------------------------------------------------*/
-// /* FUNCTION DEFINITIONS                                                                           */
-// /*------------------------------------------------------------------------------------------------*/
-
-// esp_err_t lcd_init(void)
-// {
-//     esp_err_t ret = hd44780_init(&lcd);
-
-//     if (ret != ESP_OK) {
-//         ESP_LOGE("LCD", "Failed to initialize LCD: %s", esp_err_to_name(ret));
-//         return ret;
-//     }
-
-//     hd44780_clear(&lcd);
-//     hd44780_puts(&lcd, "LCD Ready");
-//     return ret;
-// }
-
-// esp_err_t lcd_show_now_playing(const char *song_name)
-// {
-//     esp_err_t ret;
-//     hd44780_clear(&lcd);
-//     hd44780_gotoxy(&lcd, 0, 0);
-//     hd44780_puts(&lcd, "Now Playing:");
-
-//     hd44780_gotoxy(&lcd, 0, 1);
-//     ret = hd44780_puts(&lcd, song_name);
-
-//     if (ret != ESP_OK) {
-//         ESP_LOGE("LCD", "Failed to display song name: %s", esp_err_to_name(ret));
-//     }
-
-//     return ret;
-// }
\ No newline at end of file
+/**************************************************************************************************/
+/**
+ * @file lcd.c
+ * @author Ryan Jing (r5jing@uwaterloo.ca)
+ * @brief HD44780 character LCD - RAM framebuffer flushed in the background
+ *
+ * Hardware Configuration:
+ * - HD44780 with a PCF8574 I2C backpack (P0 = RS, P1 = RW, P2 = E, P3 = backlight, P4-P7 = D4-D7)
+ * - I2C_NUM_1 master on GPIO 2 (SDA) / GPIO 0 (SCL) at 100 kHz - the old 4-bit parallel wiring
+ *   shares pins with the LEDs and the motor driver, and I2C_NUM_0 is the RPi slave
+ *
+ * Every HD44780 byte is four backpack writes (high nibble with E high, E low, low nibble with E
+ * high, E low), which at 100 kHz also covers the 37 us execution time, so a whole flush goes out
+ * as one bus transaction. The clear and home commands (1.5 ms) are only used by lcd_init().
+ *
+ * @version 0.1
+ * @date 2025-11-08
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+/**************************************************************************************************/
+
+/*------------------------------------------------------------------------------------------------*/
+/* HEADERS                                                                                        */
+/*------------------------------------------------------------------------------------------------*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "esp_err.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "driver/gpio.h"
+#include "driver/i2c.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "lcd.h"
+#include "utils.h"
+
+/*------------------------------------------------------------------------------------------------*/
+/* MACROS                                                                                         */
+/*------------------------------------------------------------------------------------------------*/
+
+// I2C master for the backpack (off the strapping pins 0/2/5/12/15, the backpack pulls the bus
+// up and would hold GPIO2 high / GPIO0 low in the wrong state at reset)
+#define LCD_I2C_PORT            I2C_NUM_1
+#define LCD_I2C_SDA             GPIO_NUM_26
+#define LCD_I2C_SCL             GPIO_NUM_27
+#define LCD_I2C_FREQ_HZ         100000
+#define LCD_I2C_ADDR            0x27
+#define LCD_I2C_TIMEOUT_MS      20
+
+// PCF8574 pins
+#define LCD_PIN_RS              0x01
+#define LCD_PIN_E               0x04
+#define LCD_PIN_BL              0x08
+
+// HD44780 commands
+#define LCD_CMD_CLEAR           0x01
+#define LCD_CMD_ENTRY_MODE      0x06    // Increment, no shift
+#define LCD_CMD_DISPLAY_OFF     0x08
+#define LCD_CMD_DISPLAY_ON      0x0C    // Display on, cursor off, blink off
+#define LCD_CMD_FUNCTION_SET    0x28    // 4-bit, 2 lines, 5x8 font
+#define LCD_CMD_SET_CGRAM       0x40
+#define LCD_CMD_SET_DDRAM       0x80
+
+#define LCD_CELLS               (LCD_ROWS * LCD_COLS)
+#define LCD_BYTES_PER_WRITE     4       // Backpack writes per HD44780 byte
+
+// Rate bar glyphs (CGRAM slots, 0 is skipped so the framebuffer never holds a NUL)
+#define LCD_GLYPH_MARKER(col)   (1 + (col))     // Track with a marker in pixel column 0-4
+#define LCD_GLYPH_TRACK         6               // Track only
+#define LCD_GLYPH_WIDTH         5
+
+/*------------------------------------------------------------------------------------------------*/
+/* TYPE DEFINITIONS                                                                               */
+/*------------------------------------------------------------------------------------------------*/
+
+// Screen region owned by one lcd_show_* call
+typedef struct {
+    uint8_t row;
+    uint8_t col;
+    uint8_t width;
+} lcd_field_t;
+
+/*------------------------------------------------------------------------------------------------*/
+/* GLOBAL VARIABLES                                                                               */
+/*------------------------------------------------------------------------------------------------*/
+
+static const char *TAG = "LCD";
+
+// Layout
+#if LCD_ROWS >= 4
+// "TITLE..............." / "128.0 +2.5%    12:34" / rate bar across the whole row
+static const lcd_field_t lcd_field_title    = { 0, 0, LCD_COLS };
+static const lcd_field_t lcd_field_bpm      = { 1, 0, 5 };
+static const lcd_field_t lcd_field_pitch    = { 1, 6, 6 };
+static const lcd_field_t lcd_field_elapsed  = { 1, LCD_COLS - 5, 5 };
+static const lcd_field_t lcd_field_rate_bar = { 2, 0, LCD_COLS };
+#else
+// "TITLE..... 12:34" / "128.0 +2.5% ----"
+static const lcd_field_t lcd_field_title    = { 0, 0, LCD_COLS - 6 };
+static const lcd_field_t lcd_field_elapsed  = { 0, LCD_COLS - 5, 5 };
+static const lcd_field_t lcd_field_bpm      = { 1, 0, 5 };
+static const lcd_field_t lcd_field_pitch    = { 1, 6, 6 };
+static const lcd_field_t lcd_field_rate_bar = { 1, 12, LCD_COLS - 12 };
+#endif
+
+static const uint8_t lcd_row_offsets[4] = { 0x00, 0x40, 0x14, 0x54 };
+
+// Framebuffer - written by any task, read by the LCD task
+static uint8_t lcd_fb[LCD_ROWS][LCD_COLS];
+static portMUX_TYPE lcd_fb_lock = portMUX_INITIALIZER_UNLOCKED;
+
+// Display state - LCD task only
+static uint8_t lcd_shown[LCD_ROWS][LCD_COLS];   // What the display currently shows
+static int lcd_cursor = -1;                     // Cell the DDRAM address points at, -1 = unknown
+static int lcd_scan_start = 0;                  // Where the next flush starts looking
+static bool lcd_present = false;
+static bool lcd_backlight = true;
+
+static lcd_stats_t lcd_stats;
+
+/*------------------------------------------------------------------------------------------------*/
+/* FUNCTION PROTOTYPES                                                                            */
+/*------------------------------------------------------------------------------------------------*/
+
+/**************************************************************************************************/
+/**
+ * @name lcd_encode
+ * @brief Expand one HD44780 byte into backpack writes
+ *
+ * @param out Destination, LCD_BYTES_PER_WRITE bytes
+ * @param value Command or character
+ * @param rs LCD_PIN_RS for data, 0 for a command
+ *
+ * @return int Number of bytes written to out
+ */
+/**************************************************************************************************/
+static int lcd_encode(uint8_t *out, uint8_t value, uint8_t rs);
+
+/**************************************************************************************************/
+/**
+ * @name lcd_send
+ * @brief Send one HD44780 byte (init only - lcd_flush() batches its bytes)
+ *
+ * @param value Command or character
+ * @param rs LCD_PIN_RS for data, 0 for a command
+ *
+ * @return esp_err_t ESP_OK on success
+ */
+/**************************************************************************************************/
+static esp_err_t lcd_send(uint8_t value, uint8_t rs);
+
+/**************************************************************************************************/
+/**
+ * @name lcd_send_nibble
+ * @brief Send a single high nibble (8-bit to 4-bit switch during init)
+ *
+ * @param nibble Value in the high 4 bits
+ *
+ * @return esp_err_t ESP_OK on success
+ */
+/**************************************************************************************************/
+static esp_err_t lcd_send_nibble(uint8_t nibble);
+
+/**************************************************************************************************/
+/**
+ * @name lcd_put_field
+ * @brief Write text into a field, right-aligned or left-aligned and padded with spaces
+ *
+ * @param field Target field
+ * @param text NUL-terminated text (truncated to the field width)
+ * @param right_align true for numbers
+ */
+/**************************************************************************************************/
+static void lcd_put_field(const lcd_field_t *field, const char *text, bool right_align);
+
+/*------------------------------------------------------------------------------------------------*/
+/* FUNCTION DEFINITIONS                                                                           */
+/*------------------------------------------------------------------------------------------------*/
+
+static int lcd_encode(uint8_t *out, uint8_t value, uint8_t rs)
+{
+    uint8_t bl = lcd_backlight ? LCD_PIN_BL : 0;
+    uint8_t high = (value & 0xF0) | rs | bl;
+    uint8_t low = ((value << 4) & 0xF0) | rs | bl;
+
+    out[0] = high | LCD_PIN_E;
+    out[1] = high;
+    out[2] = low | LCD_PIN_E;
+    out[3] = low;
+    return LCD_BYTES_PER_WRITE;
+}
+
+static esp_err_t lcd_send(uint8_t value, uint8_t rs)
+{
+    uint8_t buf[LCD_BYTES_PER_WRITE];
+    int len = lcd_encode(buf, value, rs);
+    return i2c_master_write_to_device(LCD_I2C_PORT, LCD_I2C_ADDR, buf, len,
+                                      pdMS_TO_TICKS(LCD_I2C_TIMEOUT_MS));
+}
+
+static esp_err_t lcd_send_nibble(uint8_t nibble)
+{
+    uint8_t bl = lcd_backlight ? LCD_PIN_BL : 0;
+    uint8_t buf[2] = { (nibble & 0xF0) | bl | LCD_PIN_E, (nibble & 0xF0) | bl };
+    return i2c_master_write_to_device(LCD_I2C_PORT, LCD_I2C_ADDR, buf, sizeof(buf),
+                                      pdMS_TO_TICKS(LCD_I2C_TIMEOUT_MS));
+}
+
+static void lcd_put_field(const lcd_field_t *field, const char *text, bool right_align)
+{
+    uint8_t cells[LCD_COLS];
+    size_t len = strlen(text);
+    if (len > field->width) {
+        len = field->width;
+    }
+
+    memset(cells, ' ', field->width);
+    memcpy(&cells[right_align ? field->width - len : 0], text, len);
+
+    portENTER_CRITICAL(&lcd_fb_lock);
+    memcpy(&lcd_fb[field->row][field->col], cells, field->width);
+    portEXIT_CRITICAL(&lcd_fb_lock);
+}
+
+esp_err_t lcd_init(void)
+{
+    esp_err_t ret;
+
+    memset(lcd_fb, ' ', sizeof(lcd_fb));
+    memset(&lcd_stats, 0, sizeof(lcd_stats));
+
+    i2c_config_t conf = {
+        .mode = I2C_MODE_MASTER,
+        .sda_io_num = LCD_I2C_SDA,
+        .scl_io_num = LCD_I2C_SCL,
+        .sda_pullup_en = GPIO_PULLUP_ENABLE,
+        .scl_pullup_en = GPIO_PULLUP_ENABLE,
+        .master.clk_speed = LCD_I2C_FREQ_HZ,
+    };
+
+    ret = i2c_param_config(LCD_I2C_PORT, &conf);
+    if (ret != ESP_OK) {
+        LOG_ERROR(TAG, "Failed to configure LCD I2C: %s", esp_err_to_name(ret));
+        return ret;
+    }
+
+    ret = i2c_driver_install(LCD_I2C_PORT, I2C_MODE_MASTER, 0, 0, 0);
+    if (ret != ESP_OK) {
+        LOG_ERROR(TAG, "Failed to install LCD I2C driver: %s", esp_err_to_name(ret));
+        return ret;
+    }
+
+    // Power-on wait, then the datasheet's 8-bit -> 4-bit sequence
+    vTaskDelay(pdMS_TO_TICKS(50));
+    ret = lcd_send_nibble(0x30);
+    if (ret != ESP_OK) {
+        LOG_WARN(TAG, "No LCD at 0x%02X (%s), display disabled", LCD_I2C_ADDR,
+                 esp_err_to_name(ret));
+        return ESP_ERR_NOT_FOUND;
+    }
+    vTaskDelay(pdMS_TO_TICKS(5));
+    lcd_send_nibble(0x30);
+    vTaskDelay(pdMS_TO_TICKS(1));
+    lcd_send_nibble(0x30);
+    vTaskDelay(pdMS_TO_TICKS(1));
+    lcd_send_nibble(0x20);
+
+    lcd_send(LCD_CMD_FUNCTION_SET, 0);
+    lcd_send(LCD_CMD_DISPLAY_OFF, 0);
+    lcd_send(LCD_CMD_CLEAR, 0);
+    vTaskDelay(pdMS_TO_TICKS(2));
+    lcd_send(LCD_CMD_ENTRY_MODE, 0);
+
+    // Rate bar glyphs - a baseline track, marker glyphs add one lit pixel column
+    for (int glyph = LCD_GLYPH_MARKER(0); glyph <= LCD_GLYPH_TRACK; glyph++) {
+        lcd_send(LCD_CMD_SET_CGRAM | (glyph << 3), 0);
+        for (int line = 0; line < 8; line++) {
+            uint8_t bits = 0;
+            if (line == 7) {
+                bits = 0x1F;
+            } else if (line >= 1 && glyph != LCD_GLYPH_TRACK) {
+                bits = 0x10 >> (glyph - LCD_GLYPH_MARKER(0));
+            }
+            lcd_send(bits, LCD_PIN_RS);
+        }
+    }
+
+    ret = lcd_send(LCD_CMD_DISPLAY_ON, 0);
+    if (ret != ESP_OK) {
+        LOG_ERROR(TAG, "LCD initialization failed: %s", esp_err_to_name(ret));
+        return ret;
+    }
+
+    // The clear left spaces everywhere and the address counter in CGRAM
+    memset(lcd_shown, ' ', sizeof(lcd_shown));
+    lcd_cursor = -1;
+    lcd_present = true;
+    lcd_stats.present = true;
+
+    LOG_INFO(TAG, "LCD %dx%d initialized on I2C%d (SDA %d, SCL %d, addr 0x%02X)",
+             LCD_ROWS, LCD_COLS, LCD_I2C_PORT, LCD_I2C_SDA, LCD_I2C_SCL, LCD_I2C_ADDR);
+    return ESP_OK;
+}
+
+int lcd_flush(void)
+{
+    if (!lcd_present) {
+        return 0;
+    }
+
+    uint8_t snapshot[LCD_ROWS][LCD_COLS];
+    uint8_t tx[LCD_FLUSH_BUDGET_BYTES * LCD_BYTES_PER_WRITE];
+    uint8_t cells[LCD_FLUSH_BUDGET_BYTES];
+    int tx_len = 0;
+    int sent = 0;
+    int num_cells = 0;
+    int cursor = lcd_cursor;
+    int next_start = lcd_scan_start;
+
+    int64_t start = esp_timer_get_time();
+
+    portENTER_CRITICAL(&lcd_fb_lock);
+    memcpy(snapshot, lcd_fb, sizeof(snapshot));
+    portEXIT_CRITICAL(&lcd_fb_lock);
+
+    // Round robin from where the previous flush stopped so a busy field cannot starve the rest
+    for (int n = 0; n < LCD_CELLS; n++) {
+        int cell = (lcd_scan_start + n) % LCD_CELLS;
+        int row = cell / LCD_COLS;
+        int col = cell % LCD_COLS;
+
+        if (snapshot[row][col] == lcd_shown[row][col]) {
+            continue;
+        }
+
+        int cost = (cursor == cell) ? 1 : 2;
+        if (sent + cost > LCD_FLUSH_BUDGET_BYTES) {
+            break;
+        }
+
+        if (cursor != cell) {
+            tx_len += lcd_encode(&tx[tx_len], LCD_CMD_SET_DDRAM | (lcd_row_offsets[row] + col), 0);
+        }
+        tx_len += lcd_encode(&tx[tx_len], snapshot[row][col], LCD_PIN_RS);
+        sent += cost;
+        cells[num_cells++] = (uint8_t)cell;
+
+        // The address counter does not wrap from the end of one row to the start of the next
+        cursor = (col + 1 < LCD_COLS) ? cell + 1 : -1;
+        next_start = (cell + 1) % LCD_CELLS;
+    }
+
+    if (tx_len == 0) {
+        return 0;
+    }
+
+    esp_err_t ret = i2c_master_write_to_device(LCD_I2C_PORT, LCD_I2C_ADDR, tx, tx_len,
+                                               pdMS_TO_TICKS(LCD_I2C_TIMEOUT_MS));
+    if (ret != ESP_OK) {
+        // Unknown how much arrived - resend the same cells with a fresh address next time
+        lcd_cursor = -1;
+        lcd_stats.errors++;
+        return 0;
+    }
+
+    for (int i = 0; i < num_cells; i++) {
+        int row = cells[i] / LCD_COLS;
+        int col = cells[i] % LCD_COLS;
+        lcd_shown[row][col] = snapshot[row][col];
+    }
+    lcd_cursor = cursor;
+    lcd_scan_start = next_start;
+
+    uint32_t elapsed_us = (uint32_t)(esp_timer_get_time() - start);
+    lcd_stats.flushes++;
+    lcd_stats.bytes += sent;
+    if (elapsed_us > lcd_stats.max_flush_us) {
+        lcd_stats.max_flush_us = elapsed_us;
+    }
+
+    return sent;
+}
+
+esp_err_t lcd_write_text(uint8_t row, const char *text, uint8_t len)
+{
+    if (row >= LCD_ROWS) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (len > LCD_COLS) {
+        len = LCD_COLS;
+    }
+
+    portENTER_CRITICAL(&lcd_fb_lock);
+    memset(lcd_fb[row], ' ', LCD_COLS);
+    memcpy(lcd_fb[row], text, len);
+    portEXIT_CRITICAL(&lcd_fb_lock);
+
+    return ESP_OK;
+}
+
+esp_err_t lcd_show_now_playing(const char *song_name)
+{
+    if (song_name == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    lcd_put_field(&lcd_field_title, song_name, false);
+    return ESP_OK;
+}
+
+void lcd_show_bpm(uint16_t bpm_x10)
+{
+    char text[8] = "";
+
+    if (bpm_x10 > 0) {
+        snprintf(text, sizeof(text), "%u.%u", bpm_x10 / 10, bpm_x10 % 10);
+    }
+    lcd_put_field(&lcd_field_bpm, text, true);
+}
+
+void lcd_show_pitch(int16_t pitch_x10)
+{
+    char text[12];
+    int magnitude = abs(pitch_x10);
+
+    snprintf(text, sizeof(text), "%c%d.%d%%", pitch_x10 < 0 ? '-' : '+',
+             magnitude / 10, magnitude % 10);
+    lcd_put_field(&lcd_field_pitch, text, true);
+
+    // Marker position in pixel columns across the bar, centre = 0 %
+    int pixels = lcd_field_rate_bar.width * LCD_GLYPH_WIDTH;
+    int clamped = pitch_x10;
+    if (clamped < -LCD_RATE_BAR_RANGE_X10) {
+        clamped = -LCD_RATE_BAR_RANGE_X10;
+    } else if (clamped > LCD_RATE_BAR_RANGE_X10) {
+        clamped = LCD_RATE_BAR_RANGE_X10;
+    }
+    int marker = ((clamped + LCD_RATE_BAR_RANGE_X10) * (pixels - 1) + LCD_RATE_BAR_RANGE_X10) /
+                 (2 * LCD_RATE_BAR_RANGE_X10);
+
+    uint8_t cells[LCD_COLS];
+    for (int i = 0; i < lcd_field_rate_bar.width; i++) {
+        cells[i] = (i == marker / LCD_GLYPH_WIDTH) ? LCD_GLYPH_MARKER(marker % LCD_GLYPH_WIDTH)
+                                                   : LCD_GLYPH_TRACK;
+    }
+
+    portENTER_CRITICAL(&lcd_fb_lock);
+    memcpy(&lcd_fb[lcd_field_rate_bar.row][lcd_field_rate_bar.col], cells,
+           lcd_field_rate_bar.width);
+    portEXIT_CRITICAL(&lcd_fb_lock);
+}
+
+void lcd_show_elapsed(uint16_t seconds)
+{
+    char text[8];
+    unsigned minutes = seconds / 60;
+
+    if (minutes > 99) {
+        minutes = 99;
+    }
+    snprintf(text, sizeof(text), "%u:%02u", minutes, seconds % 60);
+    lcd_put_field(&lcd_field_elapsed, text, true);
+}
+
+void lcd_set_backlight(bool on)
+{
+    lcd_backlight = on;
+    if (!lcd_present) {
+        return;
+    }
+
+    uint8_t value = on ? LCD_PIN_BL : 0;
+    i2c_master_write_to_device(LCD_I2C_PORT, LCD_I2C_ADDR, &value, 1,
+                               pdMS_TO_TICKS(LCD_I2C_TIMEOUT_MS));
+}
+
+void lcd_get_stats(lcd_stats_t *stats)
+{
+    uint16_t dirty = 0;
+
+    portENTER_CRITICAL(&lcd_fb_lock);
+    for (int row = 0; row < LCD_ROWS; row++) {
+        for (int col = 0; col < LCD_COLS; col++) {
+            dirty += (lcd_fb[row][col] != lcd_shown[row][col]);
+        }
+    }
+    portEXIT_CRITICAL(&lcd_fb_lock);
+
+    *stats = lcd_stats;
+    stats->dirty_cells = dirty;
+
+    lcd_stats.flushes = 0;
+    lcd_stats.bytes = 0;
+    lcd_stats.max_flush_us = 0;
+    lcd_stats.errors = 0;
+}
@@ -2,12 +2,20 @@
 /**
  * @file leds.c
  * @author Ryan Jing (r5jing@uwaterloo.ca)
- * @brief LED control module for scrolling light effects
+ * @brief LED pattern engine - LEDC PWM with gamma correction, phase-locked to the RPi beat
  *
  * Hardware Configuration:
  * - 3.3V -> 150Ω resistor -> LED anode -> LED cathode -> GPIO (sink) -> GND
- * - GPIO LOW = LED ON (sinking current)
- * - GPIO HIGH = LED OFF (high impedance)
+ * - GPIO LOW = LED ON (sinking current), so the LEDC outputs are inverted
+ *
+ * Beat tracking:
+ * - The beat position is a Q32.32 accumulator (integer part = beat count, fraction = phase)
+ *   advanced from esp_timer microseconds, so the phase resolution is far below 1 ms
+ * - Each I2C_CMD_LED_PATTERN carries the RPi beat phase; the difference to the local phase is
+ *   slewed out over a few updates (LEDS_PHASE_SLEW_SHIFT) rather than applied as a jump
+ *
+ * Pattern evaluation is one call through a kernel table plus two table lookups per LED (shape and
+ * gamma), all integer. Its cycle count is kept in leds_stats_t for the diagnostics report.
  *
  * @version 0.1
  * @date 2025-11-08
@@ -22,8 +30,14 @@
 /*------------------------------------------------------------------------------------------------*/
 
 #include <stdio.h>
+#include <stdbool.h>
+#include <math.h>
 #include "driver/gpio.h"
+#include "driver/ledc.h"
+#include "esp_cpu.h"
 #include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
 #include "leds.h"
 #include "utils.h"
 
@@ -36,9 +50,31 @@
 #define LED_2_GPIO    GPIO_NUM_19
 #define LED_3_GPIO    GPIO_NUM_21
 
-// LED states (active-low logic)
-#define LED_ON        0    // GPIO LOW = sink current = LED ON
-#define LED_OFF       1    // GPIO HIGH = LED OFF
+// LEDC configuration (motor PWM uses LEDC_TIMER_0 / LEDC_CHANNEL_1)
+#define LED_PWM_MODE        LEDC_LOW_SPEED_MODE
+#define LED_PWM_TIMER       LEDC_TIMER_1
+#define LED_PWM_RESOLUTION  LEDC_TIMER_12_BIT
+#define LED_PWM_MAX_DUTY    4095
+#define LED_PWM_FREQUENCY   5000    // 5 kHz, well above visible flicker
+
+#define LED_GAMMA           2.2f    // Perceived brightness -> duty
+#define LED_DECAY_RATE      4.0f    // Pulse envelope: exp(-rate * phase)
+
+#define LED_BRIGHTNESS_MAX  255
+
+// Strobe: four flashes per beat, each on for 1/8 of its sixteenth note
+#define LED_STROBE_SHIFT    2
+#define LED_STROBE_WIDTH    0x20000000u
+
+// Phase increment is Q32 beats per microsecond with 8 extra fraction bits
+#define LED_INC_FRAC_BITS   8
+
+/*------------------------------------------------------------------------------------------------*/
+/* TYPE DEFINITIONS                                                                               */
+/*------------------------------------------------------------------------------------------------*/
+
+// Pattern kernel - fills one brightness (0-255) per LED from the beat position
+typedef void (*led_kernel_t)(uint32_t beat, uint32_t phase, uint8_t level, uint8_t *out);
 
 /*------------------------------------------------------------------------------------------------*/
 /* GLOBAL VARIABLES                                                                               */
@@ -53,37 +89,212 @@ static const gpio_num_t led_gpios[NUM_LEDS] = {
     LED_3_GPIO
 };
 
-// Current active LED index
+static const ledc_channel_t led_channels[NUM_LEDS] = {
+    LEDC_CHANNEL_2,
+    LEDC_CHANNEL_3,
+    LEDC_CHANNEL_4
+};
+
+// Lookup tables, filled once by leds_init()
+static uint16_t led_gamma_lut[LED_BRIGHTNESS_MAX + 1];  // Brightness -> 12-bit duty
+static uint8_t led_decay_lut[256];                      // Phase (top 8 bits) -> pulse brightness
+
+// Current active LED index (leds_scroll / leds_set)
 static uint8_t current_led = 0;
 
+// Pattern state - written by the command task, read by the LED task
+static portMUX_TYPE led_lock = portMUX_INITIALIZER_UNLOCKED;
+static uint8_t led_pattern = LED_PATTERN_SCROLL;
+static uint8_t led_level = 0;
+static uint64_t led_beat_pos = 0;               // Q32.32 beats at led_beat_time_us
+static int64_t led_beat_time_us = 0;
+static uint32_t led_beat_period_us = LEDS_DEFAULT_PERIOD_US;
+static uint32_t led_beat_inc = 0;               // Beat increment per microsecond
+static int32_t led_phase_correction = 0;        // Q32 phase error still to be slewed out
+
+static uint16_t led_duty_shown[NUM_LEDS];       // Duty currently on each channel
+static leds_stats_t led_stats;
+
+/*------------------------------------------------------------------------------------------------*/
+/* FUNCTION PROTOTYPES                                                                            */
+/*------------------------------------------------------------------------------------------------*/
+
+/**************************************************************************************************/
+/**
+ * @name led_write
+ * @brief Set one channel to a duty if it differs from what is shown
+ *
+ * @param led LED index
+ * @param duty 12-bit duty (0 = off)
+ */
+/**************************************************************************************************/
+static void led_write(uint8_t led, uint16_t duty);
+
+/**************************************************************************************************/
+/**
+ * @name led_advance
+ * @brief Move the beat accumulator to a point in time (call with led_lock held)
+ *
+ * @param now_us esp_timer time
+ */
+/**************************************************************************************************/
+static void led_advance(int64_t now_us);
+
+/**************************************************************************************************/
+/**
+ * @name led_kernel_*
+ * @brief Pattern kernels, one per LED_PATTERN_* (see led_kernels)
+ *
+ * @param beat Beat count
+ * @param phase Position in the beat (Q32)
+ * @param level VU level (0-255)
+ * @param out Brightness per LED (0-255)
+ */
+/**************************************************************************************************/
+static void led_kernel_off(uint32_t beat, uint32_t phase, uint8_t level, uint8_t *out);
+static void led_kernel_scroll(uint32_t beat, uint32_t phase, uint8_t level, uint8_t *out);
+static void led_kernel_pulse(uint32_t beat, uint32_t phase, uint8_t level, uint8_t *out);
+static void led_kernel_vu(uint32_t beat, uint32_t phase, uint8_t level, uint8_t *out);
+static void led_kernel_strobe(uint32_t beat, uint32_t phase, uint8_t level, uint8_t *out);
+static void led_kernel_solid(uint32_t beat, uint32_t phase, uint8_t level, uint8_t *out);
+
+static const led_kernel_t led_kernels[NUM_LED_PATTERNS] = {
+    [LED_PATTERN_OFF]    = led_kernel_off,
+    [LED_PATTERN_SCROLL] = led_kernel_scroll,
+    [LED_PATTERN_PULSE]  = led_kernel_pulse,
+    [LED_PATTERN_VU]     = led_kernel_vu,
+    [LED_PATTERN_STROBE] = led_kernel_strobe,
+    [LED_PATTERN_SOLID]  = led_kernel_solid,
+};
+
 /*------------------------------------------------------------------------------------------------*/
 /* FUNCTION DEFINITIONS                                                                           */
 /*------------------------------------------------------------------------------------------------*/
 
+static void led_write(uint8_t led, uint16_t duty)
+{
+    if (duty == led_duty_shown[led]) {
+        return;
+    }
+    ledc_set_duty(LED_PWM_MODE, led_channels[led], duty);
+    ledc_update_duty(LED_PWM_MODE, led_channels[led]);
+    led_duty_shown[led] = duty;
+}
+
+static void led_advance(int64_t now_us)
+{
+    uint64_t elapsed_us = (uint64_t)(now_us - led_beat_time_us);
+    led_beat_pos += (elapsed_us * led_beat_inc) >> LED_INC_FRAC_BITS;
+    led_beat_time_us = now_us;
+}
+
+static void led_kernel_off(uint32_t beat, uint32_t phase, uint8_t level, uint8_t *out)
+{
+    for (uint8_t i = 0; i < NUM_LEDS; i++) {
+        out[i] = 0;
+    }
+}
+
+static void led_kernel_scroll(uint32_t beat, uint32_t phase, uint8_t level, uint8_t *out)
+{
+    uint8_t current = beat % NUM_LEDS;
+    uint8_t previous = (current + NUM_LEDS - 1) % NUM_LEDS;
+
+    for (uint8_t i = 0; i < NUM_LEDS; i++) {
+        out[i] = 0;
+    }
+    out[previous] = led_decay_lut[phase >> 24];
+    out[current] = LED_BRIGHTNESS_MAX;
+}
+
+static void led_kernel_pulse(uint32_t beat, uint32_t phase, uint8_t level, uint8_t *out)
+{
+    uint8_t brightness = led_decay_lut[phase >> 24];
+
+    for (uint8_t i = 0; i < NUM_LEDS; i++) {
+        out[i] = brightness;
+    }
+}
+
+static void led_kernel_vu(uint32_t beat, uint32_t phase, uint8_t level, uint8_t *out)
+{
+    // Bar length in 1/255 LED steps - full LEDs below the top one, partial brightness on it
+    int32_t bar = (int32_t)level * NUM_LEDS;
+
+    for (uint8_t i = 0; i < NUM_LEDS; i++) {
+        int32_t fill = bar - (int32_t)i * LED_BRIGHTNESS_MAX;
+        out[i] = fill <= 0 ? 0 : (fill >= LED_BRIGHTNESS_MAX ? LED_BRIGHTNESS_MAX : (uint8_t)fill);
+    }
+}
+
+static void led_kernel_strobe(uint32_t beat, uint32_t phase, uint8_t level, uint8_t *out)
+{
+    uint8_t brightness = (phase << LED_STROBE_SHIFT) < LED_STROBE_WIDTH ? LED_BRIGHTNESS_MAX : 0;
+
+    for (uint8_t i = 0; i < NUM_LEDS; i++) {
+        out[i] = brightness;
+    }
+}
+
+static void led_kernel_solid(uint32_t beat, uint32_t phase, uint8_t level, uint8_t *out)
+{
+    for (uint8_t i = 0; i < NUM_LEDS; i++) {
+        out[i] = LED_BRIGHTNESS_MAX;
+    }
+}
+
 esp_err_t leds_init(void)
 {
     esp_err_t ret;
 
-    // Configure all LED GPIOs as outputs
-    gpio_config_t io_conf = {
-        .pin_bit_mask = (1ULL << LED_1_GPIO) | (1ULL << LED_2_GPIO) | (1ULL << LED_3_GPIO),
-        .mode = GPIO_MODE_OUTPUT,
-        .pull_up_en = GPIO_PULLUP_DISABLE,
-        .pull_down_en = GPIO_PULLDOWN_DISABLE,
-        .intr_type = GPIO_INTR_DISABLE
-    };
+    // Lookup tables - the only floating point in this module
+    for (int i = 0; i <= LED_BRIGHTNESS_MAX; i++) {
+        float x = (float)i / LED_BRIGHTNESS_MAX;
+        led_gamma_lut[i] = (uint16_t)lroundf(powf(x, LED_GAMMA) * LED_PWM_MAX_DUTY);
+    }
+    for (int i = 0; i < 256; i++) {
+        float x = (float)i / 256.0f;
+        led_decay_lut[i] = (uint8_t)lroundf(expf(-LED_DECAY_RATE * x) * LED_BRIGHTNESS_MAX);
+    }
 
-    ret = gpio_config(&io_conf);
+    // Configure PWM timer
+    ledc_timer_config_t timer_conf = {
+        .speed_mode = LED_PWM_MODE,
+        .duty_resolution = LED_PWM_RESOLUTION,
+        .timer_num = LED_PWM_TIMER,
+        .freq_hz = LED_PWM_FREQUENCY,
+        .clk_cfg = LEDC_AUTO_CLK
+    };
+    ret = ledc_timer_config(&timer_conf);
     if (ret != ESP_OK) {
-        LOG_ERROR(TAG, "Failed to configure LED GPIOs: %s", esp_err_to_name(ret));
+        LOG_ERROR(TAG, "Failed to configure LED PWM timer: %s", esp_err_to_name(ret));
         return ret;
     }
 
-    // Turn off all LEDs initially (set HIGH for active-low)
-    leds_all_off();
+    // One channel per LED, inverted so duty 0 leaves the pin HIGH (LED off)
+    for (uint8_t i = 0; i < NUM_LEDS; i++) {
+        ledc_channel_config_t channel_conf = {
+            .gpio_num = led_gpios[i],
+            .speed_mode = LED_PWM_MODE,
+            .channel = led_channels[i],
+            .timer_sel = LED_PWM_TIMER,
+            .duty = 0,
+            .hpoint = 0,
+            .flags.output_invert = 1
+        };
+        ret = ledc_channel_config(&channel_conf);
+        if (ret != ESP_OK) {
+            LOG_ERROR(TAG, "Failed to configure LED %d PWM: %s", i, esp_err_to_name(ret));
+            return ret;
+        }
+        led_duty_shown[i] = 0;
+    }
 
-    LOG_INFO(TAG, "LEDs initialized on GPIO %d, %d, %d (active-low sinks)",
-            LED_1_GPIO, LED_2_GPIO, LED_3_GPIO);
+    led_beat_time_us = esp_timer_get_time();
+    led_beat_inc = (uint32_t)((1ULL << (32 + LED_INC_FRAC_BITS)) / led_beat_period_us);
+
+    LOG_INFO(TAG, "LEDs initialized on GPIO %d, %d, %d (active-low, %d Hz PWM)",
+            LED_1_GPIO, LED_2_GPIO, LED_3_GPIO, LED_PWM_FREQUENCY);
 
     // Turn on the first LED
     leds_set(0);
@@ -94,13 +305,13 @@ esp_err_t leds_init(void)
 void leds_scroll(void)
 {
     // Turn off current LED
-    gpio_set_level(led_gpios[current_led], LED_OFF);
+    led_write(current_led, 0);
 
     // Move to next LED (circular)
     current_led = (current_led + 1) % NUM_LEDS;
 
     // Turn on next LED
-    gpio_set_level(led_gpios[current_led], LED_ON);
+    led_write(current_led, LED_PWM_MAX_DUTY);
 
     LOG_DEBUG(TAG, "Scrolled to LED %d (GPIO %d)", current_led, led_gpios[current_led]);
 }
@@ -116,7 +327,7 @@ void leds_set(uint8_t led_index)
     leds_all_off();
 
     // Turn on the selected LED
-    gpio_set_level(led_gpios[led_index], LED_ON);
+    led_write(led_index, LED_PWM_MAX_DUTY);
     current_led = led_index;
 
     LOG_DEBUG(TAG, "LED %d turned on (GPIO %d)", led_index, led_gpios[led_index]);
@@ -125,8 +336,97 @@ void leds_set(uint8_t led_index)
 void leds_all_off(void)
 {
     for (uint8_t i = 0; i < NUM_LEDS; i++) {
-        gpio_set_level(led_gpios[i], LED_OFF);
+        led_write(i, 0);
     }
 
     LOG_DEBUG(TAG, "All LEDs turned off");
 }
+
+esp_err_t leds_set_pattern(uint8_t pattern, uint16_t beat_phase, uint32_t beat_period_us)
+{
+    if (pattern >= NUM_LED_PATTERNS ||
+        beat_period_us < LEDS_MIN_PERIOD_US || beat_period_us > LEDS_MAX_PERIOD_US) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    uint32_t inc = (uint32_t)((1ULL << (32 + LED_INC_FRAC_BITS)) / beat_period_us);
+    uint32_t target = (uint32_t)beat_phase << 16;
+    int64_t now = esp_timer_get_time();
+
+    portENTER_CRITICAL(&led_lock);
+    led_advance(now);
+    int32_t error = (int32_t)(target - (uint32_t)led_beat_pos);
+
+    if (pattern != led_pattern || error >= (int32_t)LEDS_PHASE_SNAP ||
+        error <= -(int32_t)LEDS_PHASE_SNAP) {
+        // New pattern or far off - jump straight to the reported phase
+        led_beat_pos += (int64_t)error;
+        led_phase_correction = 0;
+    } else {
+        // Newest measurement replaces whatever is left of the previous one
+        led_phase_correction = error;
+    }
+
+    led_pattern = pattern;
+    led_beat_period_us = beat_period_us;
+    led_beat_inc = inc;
+    led_stats.phase_error_us = (int32_t)(((int64_t)error * beat_period_us) >> 32);
+    portEXIT_CRITICAL(&led_lock);
+
+    LOG_DEBUG(TAG, "Pattern %d (phase %u/65536, period %lu us, error %ld us)", pattern,
+              beat_phase, (unsigned long)beat_period_us, (long)led_stats.phase_error_us);
+    return ESP_OK;
+}
+
+void leds_set_level(uint8_t level)
+{
+    led_level = level;
+}
+
+void leds_update(void)
+{
+    uint8_t brightness[NUM_LEDS];
+    int64_t now = esp_timer_get_time();
+    uint32_t start = esp_cpu_get_cycle_count();
+
+    portENTER_CRITICAL(&led_lock);
+    led_advance(now);
+
+    // Slew out part of the phase error, the last few units in one go
+    int32_t step = led_phase_correction >> LEDS_PHASE_SLEW_SHIFT;
+    if (step == 0) {
+        step = led_phase_correction;
+    }
+    led_beat_pos += (int64_t)step;
+    led_phase_correction -= step;
+
+    uint64_t pos = led_beat_pos;
+    uint8_t pattern = led_pattern;
+    portEXIT_CRITICAL(&led_lock);
+
+    led_kernels[pattern]((uint32_t)(pos >> 32), (uint32_t)pos, led_level, brightness);
+    uint32_t kernel_cycles = esp_cpu_get_cycle_count() - start;
+
+    // Only touch the LEDC registers for channels whose duty changed
+    for (uint8_t i = 0; i < NUM_LEDS; i++) {
+        led_write(i, led_gamma_lut[brightness[i]]);
+    }
+    uint32_t update_cycles = esp_cpu_get_cycle_count() - start;
+
+    led_stats.updates++;
+    led_stats.kernel_cycles_last = kernel_cycles;
+    if (kernel_cycles > led_stats.kernel_cycles_max) {
+        led_stats.kernel_cycles_max = kernel_cycles;
+    }
+    if (update_cycles > led_stats.update_cycles_max) {
+        led_stats.update_cycles_max = update_cycles;
+    }
+}
+
+void leds_get_stats(leds_stats_t *stats)
+{
+    *stats = led_stats;
+    led_stats.updates = 0;
+    led_stats.kernel_cycles_max = 0;
+    led_stats.update_cycles_max = 0;
+}
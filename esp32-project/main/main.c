@@ -29,6 +29,9 @@
 #include "utils.h"
 #include "inputs.h"
 #include "leds.h"
+#include "calib.h"
+#include "power.h"
+#include "diag.h"
 
 /*------------------------------------------------------------------------------------------------*/
 /* MACROS                                                                                         */
@@ -90,6 +93,46 @@ void i2c_comm_task(void *pvParameters);
 /**************************************************************************************************/
 void led_task(void *pvParameters);
 
+/**************************************************************************************************/
+/**
+ * @brief Command task - applies command frames written by the RPi (low priority)
+ * @param pvParameters Task parameters (unused)
+ */
+/**************************************************************************************************/
+void command_task(void *pvParameters);
+
+/**************************************************************************************************/
+/**
+ * @brief Log drain task - streams binary log records over UART (BINARY_LOGGING only)
+ * @param pvParameters Task parameters (unused)
+ */
+/**************************************************************************************************/
+void log_drain_task(void *pvParameters);
+
+/**************************************************************************************************/
+/**
+ * @brief Power task - idle detection, DFS and light sleep parking (see power.h)
+ * @param pvParameters Task parameters (unused)
+ */
+/**************************************************************************************************/
+void power_task(void *pvParameters);
+
+/**************************************************************************************************/
+/**
+ * @brief Diagnostics task - periodic sampling jitter, LED and LCD cost report (see diag.h)
+ * @param pvParameters Task parameters (unused)
+ */
+/**************************************************************************************************/
+void diag_task(void *pvParameters);
+
+/**************************************************************************************************/
+/**
+ * @brief LCD task - flushes changed framebuffer cells to the display (lowest priority)
+ * @param pvParameters Task parameters (unused)
+ */
+/**************************************************************************************************/
+void lcd_task(void *pvParameters);
+
 /**************************************************************************************************/
 /**
  * @name start_motors
@@ -110,6 +153,13 @@ esp_err_t initialize_main(void)
 {
     esp_err_t ret = ESP_OK;
 
+    // Calibration first - the other modules read their settings from the active profile
+    ret = calib_init();
+    if (ret != ESP_OK) {
+        LOG_ERROR(TAG, "Failed to initialize calibration: %s", esp_err_to_name(ret));
+        return ret;
+    }
+
     ret = motors_init();
     if (ret != ESP_OK) {
         LOG_ERROR(TAG, "Failed to initialize motors: %s", esp_err_to_name(ret));
@@ -140,11 +190,24 @@ esp_err_t initialize_main(void)
         return ret;
     }
 
-    // ret = lcd_init();
-    // if (ret != ESP_OK) {
-    //     LOG_ERROR(TAG, "Failed to initialize LCD: %s", esp_err_to_name(ret));
-    //     return ret;
-    // }
+#if LCD_ENABLED
+    // A missing display is not fatal - the framebuffer keeps working without it
+    ret = lcd_init();
+    if (ret == ESP_ERR_NOT_FOUND) {
+        LOG_WARN(TAG, "Continuing without LCD");
+    } else if (ret != ESP_OK) {
+        LOG_ERROR(TAG, "Failed to initialize LCD: %s", esp_err_to_name(ret));
+        return ret;
+    }
+#endif
+
+    // Last - power management parks the modules above
+    ret = power_init();
+    if (ret != ESP_OK) {
+        LOG_ERROR(TAG, "Failed to initialize power management: %s", esp_err_to_name(ret));
+        return ret;
+    }
+
 
     LOG_INFO(TAG, "Initialization complete");
     return ESP_OK;
@@ -153,12 +216,13 @@ esp_err_t initialize_main(void)
 esp_err_t start_motors(void)
 {
     esp_err_t ret;
-    const uint8_t motor_speed = 200; // Set desired speed (0-255)
-    ret = motors_forward(motor_speed);
+    // Calibrated platter speed (duty 200 with the default curve) - the RPi can change it later
+    const uint16_t rpm_x10 = calib_get()->motor_target_rpm_x10;
+    ret = motors_set_rpm(MOTOR_DECK_1, (int16_t)rpm_x10);
     if (ret != ESP_OK) {
         LOG_ERROR(TAG, "Failed to start motors: %s", esp_err_to_name(ret));
     } else {
-        LOG_INFO(TAG, "Motors started at speed %d", motor_speed);
+        LOG_INFO(TAG, "Motors started at %d.%d RPM", rpm_x10 / 10, rpm_x10 % 10);
     }
 
     return ret;
@@ -230,6 +294,10 @@ void i2c_comm_task(void *pvParameters)
     const uint32_t update_period_ms = 10;  // Update I2C buffer every 2ms (faster than encoder reading)
 
     while (1) {
+        // Blocks while the device is parked (I2C driver removed)
+        power_wait_active(POWER_TASK_COMM);
+        diag_note_sample();
+
         // Update I2C data buffer with latest encoder data
         esp_err_t ret = comm_update_encoder_data();
         if (ret != ESP_OK) {
@@ -243,25 +311,101 @@ void i2c_comm_task(void *pvParameters)
 
 void led_task(void *pvParameters)
 {
-    LOG_INFO(TAG, "LED scroll task started on core %d", xPortGetCoreID());
+    LOG_INFO(TAG, "LED pattern task started on core %d", xPortGetCoreID());
+
+    while (1) {
+        power_wait_active(POWER_TASK_LEDS);
+        leds_update();  // Pattern set by the RPi (scroll by default)
+        vTaskDelay(pdMS_TO_TICKS(LEDS_UPDATE_PERIOD_MS));
+    }
+}
+
+void command_task(void *pvParameters)
+{
+    LOG_INFO(TAG, "Command task started on core %d", xPortGetCoreID());
+
+    while (1) {
+        power_wait_active(POWER_TASK_COMMAND);
+
+        // Blocks on the RX buffer, so the task only runs when the RPi writes
+        comm_process_commands(100);
+    }
+}
+
+void power_task(void *pvParameters)
+{
+    LOG_INFO(TAG, "Power task started on core %d", xPortGetCoreID());
 
-    const uint32_t scroll_period_ms = 200;  // Scroll every 200ms
+    while (1) {
+        power_update();
+    }
+}
+
+void lcd_task(void *pvParameters)
+{
+    LOG_INFO(TAG, "LCD task started on core %d", xPortGetCoreID());
 
     while (1) {
-        leds_scroll();
-        vTaskDelay(pdMS_TO_TICKS(scroll_period_ms));
+        power_wait_active(POWER_TASK_LCD);
+        lcd_flush();    // At most LCD_FLUSH_BUDGET_BYTES, blocks only this task on the bus
+        vTaskDelay(pdMS_TO_TICKS(LCD_FLUSH_PERIOD_MS));
+    }
+}
+
+void diag_task(void *pvParameters)
+{
+    LOG_INFO(TAG, "Diagnostics task started on core %d", xPortGetCoreID());
+
+    while (1) {
+        vTaskDelay(pdMS_TO_TICKS(DIAG_REPORT_PERIOD_MS));
+        diag_report();
+    }
+}
+
+void log_drain_task(void *pvParameters)
+{
+    LOG_INFO(TAG, "Log drain task started on core %d", xPortGetCoreID());
+
+    while (1) {
+#if BINARY_LOGGING
+        binlog_drain(50);
+#else
+        vTaskDelay(portMAX_DELAY);
+#endif
     }
 }
 
 void app_main(void)
 {
+    esp_err_t ret;
+
+#if BINARY_LOGGING
+    // Bring up binary logging first so initialization messages are captured
+    ret = binlog_init();
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to initialize binary logging: %s", esp_err_to_name(ret));
+        return;
+    }
+#endif
+
     // Initialize all systems
-    esp_err_t ret = initialize_main();
+    ret = initialize_main();
     if (ret != ESP_OK) {
         LOG_ERROR(TAG, "Initialization failed!");
         return;
     }
 
+    // First boot only - a stored profile skips the motor sweep
+    if (!calib_is_stored()) {
+        ret = calib_run_motor_sweep();
+        if (ret != ESP_OK) {
+            LOG_WARN(TAG, "Motor calibration failed: %s", esp_err_to_name(ret));
+        }
+    }
+
+    LOG_INFO(TAG, "Boot: initialization done %lld ms after power-on",
+             esp_timer_get_time() / 1000);
+
     // Start motors
     ret = start_motors();
     if (ret != ESP_OK) {
@@ -269,11 +413,11 @@ void app_main(void)
         return;
     }
 
-    // ret = lcd_show_now_playing("GNARLY");
-    // if (ret != ESP_OK) {
-    //     LOG_ERROR(TAG, "Failed to display on LCD: %s", esp_err_to_name(ret));
-    //     return;
-    // }
+    ret = lcd_show_now_playing("GNARLY");
+    if (ret != ESP_OK) {
+        LOG_ERROR(TAG, "Failed to display on LCD: %s", esp_err_to_name(ret));
+        return;
+    }
 
     LOG_INFO(TAG, "System initialized successfully");
     LOG_INFO(TAG, "Creating FreeRTOS tasks with dual-core configuration...");
@@ -326,6 +470,94 @@ void app_main(void)
         return;
     }
 
+    // Create command task - LOW PRIORITY on Core 0 (RPi -> ESP32 commands)
+    BaseType_t command_task_created = xTaskCreatePinnedToCore(
+        command_task,            // Task function
+        "command",               // Task name
+        4096,                    // Stack size (bytes)
+        NULL,                    // Task parameters
+        2,                       // Priority (low - not time critical)
+        NULL,                    // Task handle
+        0                        // Core 0
+    );
+
+    if (command_task_created != pdPASS) {
+        LOG_ERROR(TAG, "Failed to create command task");
+        return;
+    }
+
+#if POWER_MANAGEMENT_ENABLED
+    // Create power task - LOW PRIORITY on Core 0 (runs every 500ms, blocks while parked)
+    BaseType_t power_task_created = xTaskCreatePinnedToCore(
+        power_task,              // Task function
+        "power",                 // Task name
+        3072,                    // Stack size (bytes)
+        NULL,                    // Task parameters
+        2,                       // Priority (low - not time critical)
+        NULL,                    // Task handle
+        0                        // Core 0
+    );
+
+    if (power_task_created != pdPASS) {
+        LOG_ERROR(TAG, "Failed to create power task");
+        return;
+    }
+#endif
+
+#if LCD_ENABLED
+    // Create LCD task - LOWEST PRIORITY on Core 0 (display updates never delay sampling)
+    BaseType_t lcd_task_created = xTaskCreatePinnedToCore(
+        lcd_task,                // Task function
+        "lcd",                   // Task name
+        3072,                    // Stack size (bytes)
+        NULL,                    // Task parameters
+        1,                       // Priority (lowest)
+        NULL,                    // Task handle
+        0                        // Core 0
+    );
+
+    if (lcd_task_created != pdPASS) {
+        LOG_ERROR(TAG, "Failed to create LCD task");
+        return;
+    }
+#endif
+
+#if DIAG_ENABLED
+    // Create diagnostics task - LOWEST PRIORITY on Core 0 (wakes every 10s to log)
+    BaseType_t diag_task_created = xTaskCreatePinnedToCore(
+        diag_task,               // Task function
+        "diag",                  // Task name
+        3072,                    // Stack size (bytes)
+        NULL,                    // Task parameters
+        1,                       // Priority (lowest)
+        NULL,                    // Task handle
+        0                        // Core 0
+    );
+
+    if (diag_task_created != pdPASS) {
+        LOG_ERROR(TAG, "Failed to create diagnostics task");
+        return;
+    }
+#endif
+
+#if BINARY_LOGGING
+    // Create log drain task - LOWEST PRIORITY on Core 0 (never competes with sampling)
+    BaseType_t log_task_created = xTaskCreatePinnedToCore(
+        log_drain_task,          // Task function
+        "log_drain",             // Task name
+        3072,                    // Stack size (bytes)
+        NULL,                    // Task parameters
+        1,                       // Priority (lowest)
+        NULL,                    // Task handle
+        0                        // Core 0
+    );
+
+    if (log_task_created != pdPASS) {
+        LOG_ERROR(TAG, "Failed to create log drain task");
+        return;
+    }
+#endif
+
     // // Create motor control task - LOWER PRIORITY on Core 0 (same as encoder)
     // BaseType_t motor_task_created = xTaskCreatePinnedToCore(
     //     motor_control_task,      // Task function
@@ -344,6 +576,6 @@ void app_main(void)
 
     LOG_INFO(TAG, "All tasks created successfully");
     LOG_INFO(TAG, "Task Configuration:");
-    LOG_INFO(TAG, "  Core 0: encoder_read (priority 10), led_scroll (priority 3)");
+    LOG_INFO(TAG, "  Core 0: encoder_read (priority 10), led_scroll (priority 3), command (priority 2), power (priority 2), lcd (priority 1), diag (priority 1)");
     LOG_INFO(TAG, "  Core 1: i2c_comm (priority 10)");
 }
\ No newline at end of file
@@ -25,6 +25,7 @@
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "motors.h"
+#include "calib.h"
 #include "utils.h"
 
 /*------------------------------------------------------------------------------------------------*/
@@ -57,6 +58,9 @@
 
 static const char *TAG = "MOTORS";
 
+// Requested platter speed per deck (RPM x 10)
+static int16_t motor_rpm_setpoints[NUM_MOTOR_DECKS] = {0};
+
 /*------------------------------------------------------------------------------------------------*/
 /* FUNCTION PROTOTYPES                                                                            */
 /*------------------------------------------------------------------------------------------------*/
@@ -307,4 +311,29 @@ esp_err_t motors_stop(void)
 
     LOG_INFO(TAG, "Motors stopped");
     return ESP_OK;
-}
\ No newline at end of file
+}
+
+esp_err_t motors_set_rpm(uint8_t deck, int16_t rpm_x10)
+{
+    if (deck >= NUM_MOTOR_DECKS) {
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+
+    motor_rpm_setpoints[deck] = rpm_x10;
+
+    if (rpm_x10 == 0) {
+        return motors_stop();
+    }
+
+    uint8_t duty = calib_motor_duty_for_rpm((uint16_t)(rpm_x10 < 0 ? -rpm_x10 : rpm_x10));
+    return rpm_x10 > 0 ? motors_forward(duty) : motors_backward(duty);
+}
+
+int16_t motors_get_rpm_setpoint(uint8_t deck)
+{
+    if (deck >= NUM_MOTOR_DECKS) {
+        return 0;
+    }
+
+    return motor_rpm_setpoints[deck];
+}
@@ -0,0 +1,364 @@
+/**************************************************************************************************/
+/**
+ * @file power.c
+ * @author Ryan Jing (r5jing@uwaterloo.ca)
+ * @brief Power management - DFS, idle parking and light sleep
+ *
+ * The legacy I2C slave driver holds an APB_FREQ_MAX lock for as long as it is installed, which
+ * blocks light sleep. Parking therefore removes the driver (comm_suspend()) and arms SDA as a GPIO
+ * wake source instead; comm_resume() reinstalls it on wake.
+ *
+ * All lock and peripheral changes happen in the power task. ISRs and the sampling path only write
+ * timestamps and send task notifications.
+ *
+ * @version 0.1
+ * @date 2025-11-22
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+/**************************************************************************************************/
+
+/*------------------------------------------------------------------------------------------------*/
+/* HEADERS                                                                                        */
+/*------------------------------------------------------------------------------------------------*/
+
+#include <stdio.h>
+#include "esp_err.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "sdkconfig.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/event_groups.h"
+#ifdef CONFIG_PM_ENABLE
+#include "esp_pm.h"
+#include "esp_sleep.h"
+#endif
+#include "power.h"
+#include "comm.h"
+#include "inputs.h"
+#include "lcd.h"
+#include "leds.h"
+#include "motors.h"
+#include "sensors.h"
+#include "utils.h"
+
+/*------------------------------------------------------------------------------------------------*/
+/* MACROS                                                                                         */
+/*------------------------------------------------------------------------------------------------*/
+
+#define POWER_BIT_ACTIVE        (1 << 0)    // Set while tasks may use the peripherals
+
+/*------------------------------------------------------------------------------------------------*/
+/* GLOBAL VARIABLES                                                                               */
+/*------------------------------------------------------------------------------------------------*/
+
+static const char *TAG = "POWER";
+
+static EventGroupHandle_t power_events = NULL;
+static TaskHandle_t power_task_handle = NULL;
+static volatile power_state_t power_state = POWER_STATE_ACTIVE;
+
+static volatile int64_t power_last_activity_us = 0;
+static int64_t power_last_bus_us = 0;
+static int64_t power_parked_at_us = 0;
+
+// Wake measurement - written by the wake ISR, read by the power task and the sampling path
+static volatile bool power_wake_armed = false;
+static volatile int64_t power_wake_edge_us = 0;
+static volatile power_wake_source_t power_wake_source = POWER_WAKE_ENCODER;
+static volatile bool power_latency_pending = false;
+
+static power_stats_t power_stats = {0};
+
+#ifdef CONFIG_PM_ENABLE
+static esp_pm_lock_handle_t power_cpu_lock = NULL;      // Held while ACTIVE
+static esp_pm_lock_handle_t power_awake_lock = NULL;    // Held while not PARKED
+#endif
+
+/*------------------------------------------------------------------------------------------------*/
+/* FUNCTION PROTOTYPES                                                                            */
+/*------------------------------------------------------------------------------------------------*/
+
+/**************************************************************************************************/
+/**
+ * @name power_park
+ * @brief Stop the motors and LEDs, hand the wake pins to the sleep controller and allow light sleep
+ *
+ * Gives up (and stays awake) if the tasks do not reach power_wait_active() in time.
+ *
+ */
+/**************************************************************************************************/
+static void power_park(void);
+
+/**************************************************************************************************/
+/**
+ * @name power_resume
+ * @brief Bring the device back up after a wake source fired
+ *
+ */
+/**************************************************************************************************/
+static void power_resume(void);
+
+/*------------------------------------------------------------------------------------------------*/
+/* FUNCTION DEFINITIONS                                                                           */
+/*------------------------------------------------------------------------------------------------*/
+
+static void power_park(void)
+{
+    // Stop the tasks at their safe points before pulling the peripherals from under them
+    xEventGroupClearBits(power_events, POWER_BIT_ACTIVE);
+    EventBits_t bits = xEventGroupWaitBits(power_events, POWER_TASKS_ALL, pdFALSE, pdTRUE,
+                                           pdMS_TO_TICKS(POWER_PARK_TIMEOUT_MS));
+    if ((bits & POWER_TASKS_ALL) != POWER_TASKS_ALL) {
+        LOG_WARN(TAG, "Tasks busy (0x%02X), staying awake", (unsigned)(bits & POWER_TASKS_ALL));
+        power_last_activity_us = esp_timer_get_time();
+        xEventGroupSetBits(power_events, POWER_BIT_ACTIVE);
+        return;
+    }
+
+    motors_stop();
+    leds_all_off();
+    lcd_set_backlight(false);
+
+    esp_err_t ret = comm_suspend();
+    if (ret != ESP_OK) {
+        LOG_WARN(TAG, "Failed to suspend I2C, staying awake: %s", esp_err_to_name(ret));
+        power_last_activity_us = esp_timer_get_time();
+        xEventGroupSetBits(power_events, POWER_BIT_ACTIVE);
+        return;
+    }
+
+    // Drop stale notifications so only a real wake ends the parked wait
+    ulTaskNotifyTake(pdTRUE, 0);
+    power_wake_armed = true;
+    sensors_set_wakeup(true);
+    inputs_set_wakeup(true);
+
+    power_state = POWER_STATE_PARKED;
+    power_parked_at_us = esp_timer_get_time();
+    power_stats.parks++;
+
+    LOG_INFO(TAG, "Idle for %d s - motors and LEDs parked, light sleep allowed",
+             POWER_IDLE_TIMEOUT_MS / 1000);
+
+#ifdef CONFIG_PM_ENABLE
+    esp_pm_lock_release(power_awake_lock);
+#endif
+}
+
+static void power_resume(void)
+{
+#ifdef CONFIG_PM_ENABLE
+    esp_pm_lock_acquire(power_awake_lock);
+    esp_pm_lock_acquire(power_cpu_lock);
+#endif
+
+    power_wake_armed = false;
+    inputs_set_wakeup(false);
+    sensors_set_wakeup(false);
+
+    esp_err_t ret = comm_resume();
+    if (ret != ESP_OK) {
+        LOG_ERROR(TAG, "Failed to resume I2C: %s", esp_err_to_name(ret));
+    }
+
+    int64_t now = esp_timer_get_time();
+    power_last_activity_us = now;
+    power_last_bus_us = now;
+    power_latency_pending = (power_wake_source == POWER_WAKE_ENCODER);
+    power_state = POWER_STATE_ACTIVE;
+
+    // Sampling restarts here - motors and LEDs can follow
+    xEventGroupSetBits(power_events, POWER_BIT_ACTIVE);
+
+    power_stats.wakes++;
+    power_stats.last_source = power_wake_source;
+    power_stats.last_resume_us = esp_timer_get_time() - power_wake_edge_us;
+
+    motors_set_rpm(MOTOR_DECK_1, motors_get_rpm_setpoint(MOTOR_DECK_1));
+    lcd_set_backlight(true);
+
+    LOG_INFO(TAG, "Woke on %s after %lld s parked, sampling resumed %lld us after wake",
+             power_wake_source == POWER_WAKE_ENCODER ? "encoder" :
+             power_wake_source == POWER_WAKE_BUTTON ? "button" : "I2C",
+             (power_wake_edge_us - power_parked_at_us) / 1000000, power_stats.last_resume_us);
+}
+
+esp_err_t power_init(void)
+{
+    power_events = xEventGroupCreate();
+    if (power_events == NULL) {
+        LOG_ERROR(TAG, "Failed to create power event group");
+        return ESP_ERR_NO_MEM;
+    }
+    xEventGroupSetBits(power_events, POWER_BIT_ACTIVE);
+
+    power_last_activity_us = esp_timer_get_time();
+    power_last_bus_us = power_last_activity_us;
+
+#if POWER_MANAGEMENT_ENABLED && defined(CONFIG_PM_ENABLE)
+    esp_err_t ret;
+
+    ret = esp_pm_lock_create(ESP_PM_CPU_FREQ_MAX, 0, "power_cpu", &power_cpu_lock);
+    if (ret == ESP_OK) {
+        ret = esp_pm_lock_create(ESP_PM_NO_LIGHT_SLEEP, 0, "power_awake", &power_awake_lock);
+    }
+    if (ret != ESP_OK) {
+        LOG_ERROR(TAG, "Failed to create PM locks: %s", esp_err_to_name(ret));
+        return ret;
+    }
+
+    // Take both locks before enabling light sleep so boot runs at full speed
+    esp_pm_lock_acquire(power_cpu_lock);
+    esp_pm_lock_acquire(power_awake_lock);
+
+    esp_pm_config_t pm_config = {
+        .max_freq_mhz = POWER_MAX_FREQ_MHZ,
+        .min_freq_mhz = POWER_MIN_FREQ_MHZ,
+        .light_sleep_enable = true,
+    };
+    ret = esp_pm_configure(&pm_config);
+    if (ret != ESP_OK) {
+        LOG_ERROR(TAG, "Failed to configure power management: %s", esp_err_to_name(ret));
+        return ret;
+    }
+
+    ret = esp_sleep_enable_gpio_wakeup();
+    if (ret != ESP_OK) {
+        LOG_ERROR(TAG, "Failed to enable GPIO wakeup: %s", esp_err_to_name(ret));
+        return ret;
+    }
+
+    LOG_INFO(TAG, "DFS %d-%d MHz, light sleep after %d s idle (wake bound %d us)",
+             POWER_MIN_FREQ_MHZ, POWER_MAX_FREQ_MHZ, POWER_IDLE_TIMEOUT_MS / 1000,
+             POWER_WAKE_LATENCY_BOUND_US);
+#elif POWER_MANAGEMENT_ENABLED
+    LOG_WARN(TAG, "CONFIG_PM_ENABLE not set - idle parking only, no DFS or light sleep");
+#endif
+
+    return ESP_OK;
+}
+
+void power_update(void)
+{
+    if (power_task_handle == NULL) {
+        power_task_handle = xTaskGetCurrentTaskHandle();
+    }
+
+    if (power_state == POWER_STATE_PARKED) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        power_resume();
+        return;
+    }
+
+    // Woken early by power_notify_activity() when IDLE
+    ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(POWER_CHECK_PERIOD_MS));
+
+    int64_t now = esp_timer_get_time();
+    if (comm_poll_bus_activity()) {
+        power_last_bus_us = now;
+    }
+
+    int64_t user_idle_ms = (now - power_last_activity_us) / 1000;
+    int64_t bus_idle_ms = (now - power_last_bus_us) / 1000;
+
+    if (user_idle_ms < POWER_DFS_IDLE_MS) {
+        if (power_state == POWER_STATE_IDLE) {
+#ifdef CONFIG_PM_ENABLE
+            esp_pm_lock_acquire(power_cpu_lock);
+#endif
+            power_state = POWER_STATE_ACTIVE;
+            LOG_DEBUG(TAG, "Active - CPU at %d MHz", POWER_MAX_FREQ_MHZ);
+        }
+        return;
+    }
+
+    if (power_state == POWER_STATE_ACTIVE) {
+#ifdef CONFIG_PM_ENABLE
+        esp_pm_lock_release(power_cpu_lock);
+#endif
+        power_state = POWER_STATE_IDLE;
+        LOG_DEBUG(TAG, "Idle - CPU down to %d MHz", POWER_MIN_FREQ_MHZ);
+    }
+
+    if (user_idle_ms >= POWER_IDLE_TIMEOUT_MS && bus_idle_ms >= POWER_BUS_IDLE_MS) {
+        power_park();
+    }
+}
+
+void power_notify_activity(void)
+{
+    power_last_activity_us = esp_timer_get_time();
+
+    // Restore full speed right away instead of at the next check
+    if (power_state == POWER_STATE_IDLE && power_task_handle != NULL) {
+        xTaskNotifyGive(power_task_handle);
+    }
+}
+
+void IRAM_ATTR power_wake_from_isr(power_wake_source_t source)
+{
+    // Only the first source to fire is recorded
+    if (!power_wake_armed) {
+        return;
+    }
+    power_wake_armed = false;
+    power_wake_edge_us = esp_timer_get_time();
+    power_wake_source = source;
+
+    BaseType_t higher_priority_woken = pdFALSE;
+    vTaskNotifyGiveFromISR(power_task_handle, &higher_priority_woken);
+    if (higher_priority_woken) {
+        portYIELD_FROM_ISR();
+    }
+}
+
+void power_wait_active(uint32_t task_bit)
+{
+    if (power_events == NULL || (xEventGroupGetBits(power_events) & POWER_BIT_ACTIVE)) {
+        return;
+    }
+
+    // Tell the power task this task is parked, then wait for the resume
+    xEventGroupSetBits(power_events, task_bit);
+    xEventGroupWaitBits(power_events, POWER_BIT_ACTIVE, pdFALSE, pdTRUE, portMAX_DELAY);
+    xEventGroupClearBits(power_events, task_bit);
+}
+
+void power_note_sample(bool encoder_moved)
+{
+    if (!power_latency_pending || !encoder_moved) {
+        return;
+    }
+    power_latency_pending = false;
+
+    int64_t latency_us = esp_timer_get_time() - power_wake_edge_us;
+    power_stats.last_latency_us = latency_us;
+    if (latency_us > power_stats.max_latency_us) {
+        power_stats.max_latency_us = latency_us;
+    }
+
+    if (latency_us > POWER_WAKE_LATENCY_BOUND_US) {
+        power_stats.latency_violations++;
+        LOG_WARN(TAG, "Wake latency %lld us exceeds bound of %d us (%lu violations)",
+                 latency_us, POWER_WAKE_LATENCY_BOUND_US,
+                 (unsigned long)power_stats.latency_violations);
+    } else {
+        LOG_INFO(TAG, "Wake latency %lld us (max %lld us)", latency_us,
+                 power_stats.max_latency_us);
+    }
+}
+
+power_state_t power_get_state(void)
+{
+    return power_state;
+}
+
+void power_get_stats(power_stats_t *stats)
+{
+    if (stats != NULL) {
+        *stats = power_stats;
+    }
+}
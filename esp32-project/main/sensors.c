@@ -25,15 +25,19 @@
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "sensors.h"
+#include "calib.h"
+#include "power.h"
 #include "utils.h"
 
 /*------------------------------------------------------------------------------------------------*/
 /* MACROS                                                                                         */
 /*------------------------------------------------------------------------------------------------*/
 
-// Encoder 1 pins (Deck 1)
-#define ENCODER_1_PIN_A       GPIO_NUM_26  // Phase A
-#define ENCODER_1_PIN_B       GPIO_NUM_27  // Phase B
+// Encoder 1 pins (Deck 1) - input-only pins without internal pull-ups, the encoder board needs
+// its own (10k to 3.3V). The PCNT glitch filter also hides the short low pulse these two pins
+// see when the ADC powers up (ESP32 errata 3.11).
+#define ENCODER_1_PIN_A       GPIO_NUM_36  // Phase A
+#define ENCODER_1_PIN_B       GPIO_NUM_39  // Phase B
 
 // Encoder 2 pins (Deck 2)
 #define ENCODER_2_PIN_A       GPIO_NUM_14  // Phase A
@@ -64,6 +68,8 @@ typedef struct {
 static const char *TAG = "SENSORS";
 
 // Array of encoder states
+static bool encoder_wake_handlers_added = false;
+
 static encoder_state_t encoders[NUM_ENCODERS] = {
     [ENCODER_1] = {
         .pcnt_unit = NULL,
@@ -91,10 +97,29 @@ static encoder_state_t encoders[NUM_ENCODERS] = {
 
 static esp_err_t encoder_gpio_init(uint8_t encoder_id);
 
+/**************************************************************************************************/
+/**
+ * @name encoder_wake_isr_handler
+ * @brief Wake a parked device on the first encoder edge
+ *
+ * Light sleep wakeup is level triggered, so the interrupt disables itself after firing once.
+ *
+ * @param arg GPIO number
+ *
+ */
+/**************************************************************************************************/
+static void encoder_wake_isr_handler(void *arg);
+
 /*------------------------------------------------------------------------------------------------*/
 /* FUNCTION DEFINITIONS                                                                           */
 /*------------------------------------------------------------------------------------------------*/
 
+static void IRAM_ATTR encoder_wake_isr_handler(void *arg)
+{
+    gpio_intr_disable((gpio_num_t)(uint32_t)arg);
+    power_wake_from_isr(POWER_WAKE_ENCODER);
+}
+
 static esp_err_t encoder_gpio_init(uint8_t encoder_id)
 {
     if (encoder_id >= NUM_ENCODERS) {
@@ -105,11 +130,11 @@ static esp_err_t encoder_gpio_init(uint8_t encoder_id)
     esp_err_t ret;
     encoder_state_t *enc = &encoders[encoder_id];
 
-    // Configure GPIO pull-ups for mechanical encoder
+    // Configure GPIO pull-ups for mechanical encoder (input-only pins have none, see the pin map)
     gpio_config_t io_conf = {
         .pin_bit_mask = (1ULL << enc->pin_a) | (1ULL << enc->pin_b),
         .mode = GPIO_MODE_INPUT,
-        .pull_up_en = GPIO_PULLUP_ENABLE,
+        .pull_up_en = GPIO_IS_VALID_OUTPUT_GPIO(enc->pin_a) ? GPIO_PULLUP_ENABLE : GPIO_PULLUP_DISABLE,
         .pull_down_en = GPIO_PULLDOWN_DISABLE,
         .intr_type = GPIO_INTR_DISABLE
     };
@@ -247,7 +272,8 @@ int32_t encoder_get_position(uint8_t encoder_id)
         return enc->offset;
     }
 
-    return count + enc->offset;
+    // Direction comes from the calibration profile so a reversed encoder is fixed without rewiring
+    return (count + enc->offset) * calib_get()->encoder_direction[encoder_id];
 }
 
 void encoder_reset_position(uint8_t encoder_id)
@@ -294,3 +320,46 @@ float encoder_get_velocity(uint8_t encoder_id, uint32_t sample_period_ms)
 
     return velocity;
 }
+
+esp_err_t sensors_set_wakeup(bool enable)
+{
+    esp_err_t ret;
+
+    for (uint8_t i = 0; i < NUM_ENCODERS; i++) {
+        const gpio_num_t pins[2] = { encoders[i].pin_a, encoders[i].pin_b };
+
+        for (int p = 0; p < 2; p++) {
+            gpio_num_t pin = pins[p];
+
+            if (!enable) {
+                gpio_intr_disable(pin);
+                gpio_wakeup_disable(pin);
+                continue;
+            }
+
+            if (!encoder_wake_handlers_added) {
+                ret = gpio_isr_handler_add(pin, encoder_wake_isr_handler, (void *)(uint32_t)pin);
+                if (ret != ESP_OK) {
+                    LOG_ERROR(TAG, "Failed to add wake handler for GPIO %d: %s",
+                              pin, esp_err_to_name(ret));
+                    return ret;
+                }
+            }
+
+            // Wake on the opposite of the current level, i.e. on the next edge
+            gpio_int_type_t level = gpio_get_level(pin) ? GPIO_INTR_LOW_LEVEL : GPIO_INTR_HIGH_LEVEL;
+            ret = gpio_wakeup_enable(pin, level);
+            if (ret != ESP_OK) {
+                LOG_ERROR(TAG, "Failed to enable wakeup on GPIO %d: %s", pin, esp_err_to_name(ret));
+                return ret;
+            }
+            gpio_intr_enable(pin);
+        }
+    }
+
+    if (enable) {
+        encoder_wake_handlers_added = true;
+    }
+
+    return ESP_OK;
+}
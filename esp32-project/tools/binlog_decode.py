@@ -0,0 +1,235 @@
+#!/usr/bin/env python3
+"""
+Binary Log Decoder
+Rebuilds text from the ESP32 binary log stream (BINARY_LOGGING in utils.h)
+
+Each frame carries the address of the tag and format strings plus raw 32-bit
+argument words. Strings are looked up in the firmware ELF, so the ELF must match
+the flashed build (build/esp32-project.elf).
+
+Usage:
+    python3 binlog_decode.py build/esp32-project.elf --port /dev/ttyUSB0
+    python3 binlog_decode.py build/esp32-project.elf --port /dev/ttyUSB0 --set SENSORS=4
+    python3 binlog_decode.py build/esp32-project.elf --file capture.bin
+"""
+
+import argparse
+import itertools
+import re
+import struct
+import sys
+
+from elftools.elf.elffile import ELFFile
+
+# Must match binlog.h
+SYNC = b"\xB1\x06"
+HEADER_SIZE = 16
+LEVEL_SHIFT = 5
+WORDS_MASK = 0x1F
+BAUD_RATE = 921600
+
+LEVEL_NAMES = {1: "E", 2: "W", 3: "I", 4: "D", 5: "V"}
+LEVEL_VALUES = {"none": 0, "error": 1, "warn": 2, "info": 3, "debug": 4, "verbose": 5}
+
+# printf conversion: flags, width, precision, length modifier, conversion
+CONVERSION_RE = re.compile(r"%([-+ #0]*\d*(?:\.\d+)?)(hh|h|ll|l|z|j|t|L)?([diouxXeEfgGcsp%])")
+
+
+class ElfStrings:
+    """Resolves addresses to NUL-terminated strings from the loadable ELF sections"""
+
+    def __init__(self, elf_path):
+        self.sections = []
+        self.cache = {}
+
+        with open(elf_path, "rb") as f:
+            elf = ELFFile(f)
+            for section in elf.iter_sections():
+                if section["sh_addr"] and section["sh_type"] == "SHT_PROGBITS":
+                    self.sections.append((section["sh_addr"], section.data()))
+
+    def lookup(self, address):
+        """Return the string at address, or None when it is not in the image"""
+        if address in self.cache:
+            return self.cache[address]
+
+        text = None
+        for base, data in self.sections:
+            offset = address - base
+            if 0 <= offset < len(data):
+                end = data.find(b"\0", offset)
+                text = data[offset:end if end >= 0 else len(data)].decode("utf-8", "replace")
+                break
+
+        self.cache[address] = text
+        return text
+
+
+def format_record(strings, fmt, words):
+    """
+    Apply a printf-style format to raw argument words (64-bit conversions take two, low first).
+    Conversions left without words print as <missing> and the record is marked as short.
+    """
+    args = iter(words)
+    missing = []
+
+    def convert(match):
+        spec, length, conv = match.groups()
+        if conv == "%":
+            return "%"
+
+        wide = length in ("ll", "j") and conv in "diouxX"
+        taken = list(itertools.islice(args, 2 if wide else 1))
+        if len(taken) < (2 if wide else 1):
+            missing.append(match.group(0))
+            return "<missing>"
+        word = taken[0]
+        if wide:
+            word |= taken[1] << 32
+            if conv in "di":
+                value = struct.unpack("<q", struct.pack("<Q", word))[0]
+            else:
+                value = word
+        elif conv in "di":
+            value = struct.unpack("<i", struct.pack("<I", word))[0]
+        elif conv in "eEfgG":
+            value = struct.unpack("<f", struct.pack("<I", word))[0]
+        elif conv == "s":
+            value = strings.lookup(word)
+            if value is None:
+                return f"<0x{word:08X}>"
+        elif conv == "c":
+            value = chr(word & 0xFF)
+        elif conv == "p":
+            return f"0x{word:08x}"
+        else:
+            value = word
+
+        return ("%" + spec + conv) % value
+
+    text = CONVERSION_RE.sub(convert, fmt)
+    if missing:
+        text = text.rstrip() + f" [SHORT FRAME: {len(words)} words, no words for {' '.join(missing)}]"
+    return text
+
+
+class FrameDecoder:
+    """Splits the byte stream into frames; bytes outside frames are passed through as text"""
+
+    def __init__(self, strings, out=sys.stdout):
+        self.strings = strings
+        self.out = out
+        self.buffer = bytearray()
+        self.last_timestamp = None
+        self.time_base_us = 0
+        self.bad_frames = 0
+
+    def feed(self, data):
+        self.buffer.extend(data)
+
+        while True:
+            start = self.buffer.find(SYNC)
+            if start < 0:
+                # Keep a possible partial sync byte, emit the rest as console text
+                keep = 1 if self.buffer.endswith(SYNC[:1]) else 0
+                self._passthrough(self.buffer[:len(self.buffer) - keep])
+                del self.buffer[:len(self.buffer) - keep]
+                return
+
+            if start > 0:
+                self._passthrough(self.buffer[:start])
+                del self.buffer[:start]
+
+            if len(self.buffer) < 3:
+                return
+            length = self.buffer[2]
+            if length < HEADER_SIZE + 1 or (length - HEADER_SIZE - 1) % 4:
+                del self.buffer[:2]
+                self.bad_frames += 1
+                continue
+            if len(self.buffer) < length:
+                return
+
+            frame = bytes(self.buffer[:length])
+            if sum(frame[2:length - 1]) & 0xFF != frame[length - 1]:
+                del self.buffer[:2]
+                self.bad_frames += 1
+                continue
+
+            del self.buffer[:length]
+            self._emit(frame)
+
+    def _passthrough(self, data):
+        if data:
+            self.out.write(data.decode("utf-8", "replace"))
+
+    def _emit(self, frame):
+        level = frame[3] >> LEVEL_SHIFT
+        num_args = frame[3] & WORDS_MASK
+        if HEADER_SIZE + 4 * num_args + 1 != len(frame):
+            self.bad_frames += 1
+            return
+        timestamp, tag_addr, fmt_addr = struct.unpack_from("<III", frame, 4)
+        words = struct.unpack_from(f"<{num_args}I", frame, HEADER_SIZE)
+
+        # Device timestamps are 32-bit microseconds and wrap every ~71 minutes
+        if self.last_timestamp is not None and timestamp < self.last_timestamp:
+            self.time_base_us += 1 << 32
+        self.last_timestamp = timestamp
+        time_ms = (self.time_base_us + timestamp) // 1000
+
+        tag = self.strings.lookup(tag_addr) or f"0x{tag_addr:08X}"
+        fmt = self.strings.lookup(fmt_addr)
+        if fmt is None:
+            text = f"<unknown format 0x{fmt_addr:08X}> " + " ".join(f"{w:08X}" for w in words)
+        else:
+            text = format_record(self.strings, fmt, words)
+
+        self.out.write(f"{LEVEL_NAMES.get(level, '?')} ({time_ms}) {tag}: {text.rstrip()}\n")
+        self.out.flush()
+
+
+def parse_level(text):
+    """Accept a level number (0-5) or name"""
+    if text.isdigit():
+        return int(text)
+    return LEVEL_VALUES[text.lower()]
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Decode ESP32 binary logs")
+    parser.add_argument("elf", help="Firmware ELF matching the flashed image")
+    source = parser.add_mutually_exclusive_group(required=True)
+    source.add_argument("--port", help="Serial port, e.g. /dev/ttyUSB0")
+    source.add_argument("--file", help="Raw capture file ('-' for stdin)")
+    parser.add_argument("--baud", type=int, default=BAUD_RATE)
+    parser.add_argument("--set", action="append", default=[], metavar="TAG=LEVEL",
+                        help="Set a runtime tag level on the device (serial only)")
+    args = parser.parse_args()
+
+    decoder = FrameDecoder(ElfStrings(args.elf))
+
+    if args.file:
+        stream = sys.stdin.buffer if args.file == "-" else open(args.file, "rb")
+        with stream:
+            while chunk := stream.read(4096):
+                decoder.feed(chunk)
+        return
+
+    import serial
+
+    with serial.Serial(args.port, args.baud, timeout=0.1) as port:
+        for item in args.set:
+            tag, level = item.split("=", 1)
+            port.write(f"L {tag} {parse_level(level)}\n".encode())
+
+        try:
+            while True:
+                decoder.feed(port.read(4096))
+        except KeyboardInterrupt:
+            if decoder.bad_frames:
+                print(f"\n{decoder.bad_frames} corrupt frames skipped")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,192 @@
+#!/usr/bin/env python3
+"""
+Encoder Acquisition Module
+Polls the ESP32s from a dedicated thread at a fixed period and hands the decoded samples to the
+mixer through single-producer/single-consumer rings, so GLib main loop stalls (bus messages,
+GC, prints) no longer shift the sampling instants
+"""
+
+import os
+import threading
+import time
+from poller import DevicePoller
+from config import (
+    I2C_POLL_RATE_MS, ACQ_RING_SIZE, ACQ_SCHED_FIFO_PRIORITY, ACQ_CPU
+)
+
+
+class SpscRing:
+    """
+    Fixed-size single-producer/single-consumer ring
+
+    Only the producer writes `head` and only the consumer writes `tail`; each index is published
+    with a single attribute store (atomic under the GIL), after the slot it covers is written,
+    so no lock is needed. A full ring drops the new item and counts it.
+    """
+
+    def __init__(self, capacity=ACQ_RING_SIZE):
+        if capacity & (capacity - 1):
+            raise ValueError("capacity must be a power of two")
+        self.slots = [None] * capacity
+        self.mask = capacity - 1
+        self.head = 0       # Next slot to write (producer)
+        self.tail = 0       # Next slot to read (consumer)
+        self.dropped = 0
+
+    def push(self, item):
+        """Producer side - returns False (and drops the item) if the ring is full"""
+        head = self.head
+        if head - self.tail > self.mask:
+            self.dropped += 1
+            return False
+        self.slots[head & self.mask] = item
+        self.head = head + 1
+        return True
+
+    def pop(self):
+        """Consumer side - oldest item, or None if the ring is empty"""
+        tail = self.tail
+        if tail == self.head:
+            return None
+        index = tail & self.mask
+        item = self.slots[index]
+        self.slots[index] = None
+        self.tail = tail + 1
+        return item
+
+    def __len__(self):
+        return self.head - self.tail
+
+
+class LatencyHistogram:
+    """Histogram of durations in microseconds with fixed bucket edges"""
+
+    EDGES_US = (50, 100, 200, 500, 1000, 2000, 5000, 10000, 20000, 50000)
+
+    def __init__(self, name):
+        self.name = name
+        self.reset()
+
+    def reset(self):
+        self.counts = [0] * (len(self.EDGES_US) + 1)
+        self.total = 0
+        self.sum_us = 0.0
+        self.max_us = 0.0
+
+    def add(self, us):
+        us = abs(us)
+        index = 0
+        while index < len(self.EDGES_US) and us >= self.EDGES_US[index]:
+            index += 1
+        self.counts[index] += 1
+        self.total += 1
+        self.sum_us += us
+        if us > self.max_us:
+            self.max_us = us
+
+    def percentile(self, fraction):
+        """Upper edge of the bucket holding the given fraction of samples (µs)"""
+        if self.total == 0:
+            return 0.0
+        target = fraction * self.total
+        seen = 0
+        for index, count in enumerate(self.counts):
+            seen += count
+            if seen >= target:
+                return self.EDGES_US[index] if index < len(self.EDGES_US) else self.max_us
+        return self.max_us
+
+    def summary(self):
+        if self.total == 0:
+            return f"{self.name}: no samples"
+        mean = self.sum_us / self.total
+        return (f"{self.name}: n={self.total} mean={mean:.0f}µs p50<{self.percentile(0.5):.0f}µs "
+                f"p99<{self.percentile(0.99):.0f}µs max={self.max_us:.0f}µs")
+
+    def buckets(self):
+        """Bucket labels and counts, for printing the full histogram"""
+        labels = [f"<{edge}µs" for edge in self.EDGES_US] + [f">={self.EDGES_US[-1]}µs"]
+        return list(zip(labels, self.counts))
+
+
+class AcquisitionThread(threading.Thread):
+    """
+    Runs a DevicePoller once per period and pushes each (read_time_ns, data) into the ring of
+    the reader it came from
+
+    on_sample sees each sample as it is read, ahead of the mixer's next tick (SFX pads trigger
+    from here). Deadlines are absolute (start + n * period), so a late wake-up does not push the following
+    samples back. Missed periods are skipped and counted rather than read in a burst.
+    """
+
+    def __init__(self, readers=(), period_ms=I2C_POLL_RATE_MS, priority=ACQ_SCHED_FIFO_PRIORITY,
+                 cpu=ACQ_CPU, poller=None):
+        super().__init__(name="acquisition", daemon=True)
+        self.poller = poller if poller is not None else DevicePoller.from_readers(readers)
+        self.rings = {id(reader): SpscRing() for reader in self.poller.readers}
+        self.period_ns = int(period_ms * 1_000_000)
+        self.priority = priority
+        self.cpu = cpu
+        self.running = False
+        self.missed_periods = 0
+        self.on_sample = None   # callable(reader, read_time_ns, data), called on this thread (SFX triggers)
+
+        self.wake_jitter = LatencyHistogram("acq wake jitter")
+        self.read_latency = LatencyHistogram("acq read time")
+
+    def ring_for(self, reader):
+        """Ring carrying the samples of one reader"""
+        return self.rings[id(reader)]
+
+    def _set_realtime(self):
+        """SCHED_FIFO and CPU pinning for this thread - best effort, needs CAP_SYS_NICE"""
+        if self.cpu is not None:
+            try:
+                os.sched_setaffinity(0, {self.cpu})
+            except (AttributeError, OSError) as e:
+                print(f"Acquisition: cannot pin to CPU {self.cpu}: {e}")
+        if self.priority:
+            try:
+                os.sched_setscheduler(0, os.SCHED_FIFO, os.sched_param(self.priority))
+            except (AttributeError, OSError) as e:
+                print(f"Acquisition: SCHED_FIFO {self.priority} not available ({e}), using normal scheduling")
+
+    def run(self):
+        self._set_realtime()
+        self.running = True
+        for reader in self.poller.readers:
+            reader.acquired = True
+        deadline = time.monotonic_ns() + self.period_ns
+
+        while self.running:
+            now = time.monotonic_ns()
+            if deadline > now:
+                time.sleep((deadline - now) / 1e9)
+                now = time.monotonic_ns()
+            self.wake_jitter.add((now - deadline) / 1000.0)
+
+            for reader, data in self.poller.poll(now):
+                self.ring_for(reader).push((now, data))
+                if self.on_sample is not None:
+                    self.on_sample(reader, now, data)
+            self.read_latency.add((time.monotonic_ns() - now) / 1000.0)
+
+            deadline += self.period_ns
+            now = time.monotonic_ns()
+            if now - deadline >= self.period_ns:
+                missed = (now - deadline) // self.period_ns
+                self.missed_periods += missed
+                deadline += missed * self.period_ns
+
+        for reader in self.poller.readers:
+            reader.acquired = False
+
+    def stop(self):
+        self.running = False
+        if self.is_alive():
+            self.join(timeout=1.0)
+
+    def summary(self):
+        dropped = sum(ring.dropped for ring in self.rings.values())
+        return [self.wake_jitter.summary(), self.read_latency.summary(),
+                f"missed periods={self.missed_periods} ring drops={dropped}"] + self.poller.summary()
@@ -0,0 +1,952 @@
+#!/usr/bin/env python3
+"""
+Micro-benchmarks for the RPi control path
+Runs against fake devices, so no ESP32 or I2C bus is needed
+
+Usage:
+    python3 bench.py            # all benchmarks
+    python3 bench.py i2c_read   # selected benchmarks
+"""
+
+import ctypes
+import struct
+import sys
+import time
+
+BENCHMARKS = {}
+
+
+def benchmark(func):
+    """Register a benchmark under its function name (without the bench_ prefix)"""
+    BENCHMARKS[func.__name__[len('bench_'):]] = func
+    return func
+
+
+def time_per_call_us(func, iterations=20000, rounds=5):
+    """Best-of-rounds time per call in microseconds (best = least disturbed by the scheduler)"""
+    best = float('inf')
+    for _ in range(rounds):
+        start = time.perf_counter_ns()
+        for _ in range(iterations):
+            func()
+        elapsed = (time.perf_counter_ns() - start) / iterations / 1000.0
+        best = min(best, elapsed)
+    return best
+
+
+def report(name, us):
+    print(f"  {name:<44} {us:8.2f} µs/call")
+
+
+# ==================== FAKE DEVICES ====================
+
+# Packet as the ESP32 sends it (see comm.h): positions, velocities x100, timestamp, buttons,
+# pots, command ack
+FAKE_PACKET = struct.pack('<iiiiIBHHBB', 1234, -2550, -42, 100, 987654, 0b000101, 2048, 4095, 7, 0)
+
+
+class FakeBus:
+    """smbus2.SMBus stand-in that answers every read with a fixed packet"""
+    fd = None   # No kernel device, so EncoderReader stays on the Python path
+
+    def __init__(self, packet=FAKE_PACKET):
+        self.packet = packet
+
+    def i2c_rdwr(self, *msgs):
+        for msg in msgs:
+            ctypes.memmove(msg.buf, self.packet, min(len(self.packet), msg.len))
+
+
+
+class FakeMultiBus(FakeBus):
+    """FakeBus that answers on every address and takes as long as a real bus to clock the bytes"""
+
+    def __init__(self, packet=FAKE_PACKET, bus_khz=400):
+        super().__init__(packet)
+        self.bit_ns = 1_000_000 // bus_khz
+        self.transactions = 0
+
+    def i2c_rdwr(self, *msgs):
+        self.transactions += 1
+        # Start + address byte + data bytes (9 clocks each with ACK) per message, then stop
+        bits = sum(1 + 9 * (1 + msg.len) for msg in msgs) + 1
+        end = time.perf_counter_ns() + bits * self.bit_ns
+        super().i2c_rdwr(*msgs)
+        while time.perf_counter_ns() < end:
+            pass
+
+# ==================== BENCHMARKS ====================
+
+@benchmark
+def bench_i2c_read():
+    """Python (smbus2 + struct) vs native (fasti2c) read path, fake device"""
+    from i2c import EncoderReader, fasti2c
+
+    python_reader = EncoderReader(FakeBus(), 0x42, use_native=False)
+    assert python_reader.read_raw_data() is not None
+
+    report("python read_raw_data()", time_per_call_us(python_reader.read_raw_data))
+    report("python read() (dict API)", time_per_call_us(python_reader.read))
+
+    if fasti2c is None:
+        print("  fasti2c not built - run: python3 setup.py build_ext --inplace")
+        return
+
+    native_reader = EncoderReader(FakeBus(), 0x42, use_native=False)
+    native_reader.device = fasti2c.Device(0, 0x42, loopback=FAKE_PACKET)
+    assert native_reader.read_raw_data() == python_reader.read_raw_data()
+
+    report("native Device.read() (reused record)", time_per_call_us(native_reader.device.read))
+    report("native read_raw_data()", time_per_call_us(native_reader.read_raw_data))
+    report("native read() (dict API)", time_per_call_us(native_reader.read))
+
+
+@benchmark
+def bench_spsc_ring():
+    """Push/pop cost of the acquisition ring"""
+    from acquisition import SpscRing
+
+    ring = SpscRing(64)
+    sample = (0, {'enc1_velocity': 0.0})
+
+    def push_pop():
+        ring.push(sample)
+        ring.pop()
+
+    report("SpscRing push() + pop()", time_per_call_us(push_pop))
+
+
+@benchmark
+def bench_acquisition_jitter(duration_s=2.0):
+    """Wake-up jitter: acquisition thread vs a busy GLib timer, fake device"""
+    from i2c import EncoderReader
+    from acquisition import AcquisitionThread, LatencyHistogram
+    from config import I2C_POLL_RATE_MS
+
+    reader = EncoderReader(FakeBus(), 0x42)
+    thread = AcquisitionThread([reader])
+    ring = thread.ring_for(reader)
+    thread.start()
+    end = time.monotonic() + duration_s
+    while time.monotonic() < end:
+        time.sleep(0.005)
+        while ring.pop() is not None:
+            pass
+    thread.stop()
+    for line in thread.summary():
+        print(f"  {line}")
+
+    try:
+        from gi.repository import GLib
+    except ImportError:
+        print("  GLib not available - skipping timer comparison")
+        return
+
+    # Same period on the GLib timer, with an idle handler standing in for other main loop work
+    jitter = LatencyHistogram("glib timer jitter")
+    loop = GLib.MainLoop()
+    state = {'last': None}
+
+    def on_timer():
+        now = time.monotonic_ns()
+        if state['last'] is not None:
+            jitter.add((now - state['last']) / 1000.0 - I2C_POLL_RATE_MS * 1000.0)
+        state['last'] = now
+        reader.read()
+        return True
+
+    def other_work():
+        sum(range(20000))
+        return True
+
+    GLib.timeout_add(I2C_POLL_RATE_MS, on_timer)
+    GLib.timeout_add(7, other_work)
+    GLib.timeout_add(int(duration_s * 1000), loop.quit)
+    loop.run()
+    print(f"  {jitter.summary()}")
+
+
+
+@benchmark
+def bench_poller_scaling(period_ms=5, duration_s=1.0):
+    """Achieved sample rate per device with 1/2/4/8 ESP32s on a simulated 400 kHz bus"""
+    from i2c import EncoderReader
+    from acquisition import AcquisitionThread
+    from poller import DevicePoller
+
+    print(f"  target {1000 / period_ms:.0f} Hz per device")
+    for count in (1, 2, 4, 8):
+        for max_batch in (1, 8):
+            bus = FakeMultiBus()
+            poller = DevicePoller(max_batch=max_batch)
+            for index in range(count):
+                poller.add_reader(EncoderReader(bus, 0x42 + index, use_native=False), period_ms=period_ms)
+
+            thread = AcquisitionThread(poller=poller, period_ms=period_ms, priority=0, cpu=None)
+            thread.start()
+            time.sleep(duration_s)
+            thread.stop()
+
+            rates = [device.attempts / duration_s for device in poller.devices]
+            print(f"  {count} device(s), batch {max_batch}: {min(rates):6.1f}-{max(rates):6.1f} Hz/device, "
+                  f"{bus.transactions / duration_s:6.1f} ioctl/s, missed periods {thread.missed_periods}")
+
+
+
+def record_emulated_session(path, scenario='scratch', seconds=30.0, period_s=0.02):
+    """Record an emulator scenario at 50 Hz of virtual time (same file every run)"""
+    from emulator import EmulatedESP32, VirtualClock
+    from recording import SessionRecorder
+
+    clock = VirtualClock()
+    device = EmulatedESP32(scenario, clock)
+    recorder = SessionRecorder(path)
+    for step in range(int(seconds / period_s)):
+        clock.advance(period_s)
+        recorder.record(0x42, device.read_packet(), t_ns=int(clock() * 1e9))
+    recorder.close()
+
+
+@benchmark
+def bench_replay():
+    """Deterministic replay of a recorded scratch session through both velocity estimators"""
+    import os
+    import tempfile
+    from i2c import EncoderReader
+    from recording import Session, replay_decoded
+
+    path = os.path.join(tempfile.mkdtemp(), 'scratch.bdj')
+    record_emulated_session(path)
+    session = Session(path)
+    print(f"  session: {len(session)} packets, {session.duration_s:.1f} s, "
+          f"{os.path.getsize(path)} bytes")
+
+    for predictive in (True, False):
+        def make_reader(address):
+            return EncoderReader(FakeBus(), address, use_predictive=predictive, use_native=False)
+
+        start = time.perf_counter_ns()
+        first = replay_decoded(session, make_reader)[0x42]
+        elapsed_us = (time.perf_counter_ns() - start) / 1000.0
+        second = replay_decoded(session, make_reader)[0x42]
+
+        velocities = [data['enc1_velocity'] for _, data in first]
+        error = sum(abs(data['enc1_velocity'] - data['enc1_velocity_raw'])
+                    for _, data in first) / len(first)
+        name = "predictive" if predictive else "window smoother"
+        report(f"{name} replay per packet", elapsed_us / len(first))
+        print(f"    deterministic: {first == second}, mean |v - v_esp32| {error:.1f} counts/s, "
+              f"range {min(velocities):.0f}..{max(velocities):.0f}")
+
+
+
+@benchmark
+def bench_estimators():
+    """Velocity estimators on a recorded session: cost, roughness and lag (BENCH_SESSION=file)"""
+    import os
+    import tempfile
+    from i2c import EncoderReader
+    from recording import Session, replay_decoded
+
+    path = os.environ.get('BENCH_SESSION')
+    if path is None:
+        path = os.path.join(tempfile.mkdtemp(), 'scratch.bdj')
+        record_emulated_session(path)
+    session = Session(path)
+    address = session.addresses[0]
+    print(f"  session {path}: {len(session)} packets, {session.duration_s:.1f} s")
+
+    for name in ('predictive', 'window', 'lsq1', 'lsq2'):
+        def make_reader(addr):
+            return EncoderReader(FakeBus(), addr, use_native=False, estimators=(name, name))
+
+        start = time.perf_counter_ns()
+        decoded = replay_decoded(session, make_reader)[address]
+        elapsed_us = (time.perf_counter_ns() - start) / 1000.0
+
+        velocity = [data['enc1_velocity'] for _, data in decoded]
+        reference = [data['enc1_velocity_raw'] for _, data in decoded]
+        period_ms = session.duration_s * 1000.0 / max(1, len(decoded) - 1)
+
+        # Roughness: RMS of sample-to-sample change; lag: shift that best matches the
+        # per-period velocity the ESP32 measured
+        roughness = (sum((b - a) ** 2 for a, b in zip(velocity, velocity[1:])) / (len(velocity) - 1)) ** 0.5
+        lag = min(range(16), key=lambda k: sum(abs(v - r) for v, r in zip(velocity[k:], reference)))
+
+        report(f"{name} per packet", elapsed_us / len(decoded))
+        print(f"    roughness {roughness:6.1f} counts/s/sample, lag {lag * period_ms:5.0f} ms")
+
+
+class DummyElement:
+    """GStreamer element stand-in that only remembers its properties"""
+
+    def __init__(self):
+        self.properties = {}
+
+    def set_property(self, name, value):
+        self.properties[name] = value
+
+
+@benchmark
+def bench_deck_state():
+    """Deck state detection on an emulated scratch session: per-tick cost and reaction time"""
+    import os
+    import tempfile
+    from i2c import EncoderReader
+    from deck import DJDeck
+    from recording import Session, replay_decoded
+    from eventlog import log
+    from config import (CONTROL_MODE_TURNTABLE, NORMAL_SPEED_MIN, NORMAL_SPEED_MAX,
+                        DECK1_VELOCITY_ESTIMATOR)
+
+    path = os.path.join(tempfile.mkdtemp(), 'scratch.bdj')
+    record_emulated_session(path)
+    session = Session(path)
+    address = session.addresses[0]
+    samples = [data for _, data in replay_decoded(
+        session, lambda addr: EncoderReader(FakeBus(), addr, use_native=False,
+                                            estimators=(DECK1_VELOCITY_ESTIMATOR,) * 2))[address]]
+
+    def make_deck():
+        return DJDeck(1, None, DummyElement(), None, CONTROL_MODE_TURNTABLE, None)
+
+    def tick(deck, data):
+        deck.add_sample(data)
+        deck._update_state_turntable()
+        deck._update_rate()
+
+    # Previous detector: average of the last 100 samples, rebuilt as a list every tick
+    history = []
+
+    def list_rebuild(data):
+        history.append(data)
+        del history[:-100]
+        velocities = [entry['enc1_velocity'] for entry in history]
+        average = sum(velocities) / len(velocities)
+        return NORMAL_SPEED_MIN < average < NORMAL_SPEED_MAX
+
+    # Detector cost only - nothing logged
+    saved_mode, log.mode = log.mode, 'off'
+    try:
+        deck = make_deck()
+        index = [0]
+
+        def next_tick():
+            tick(deck, samples[index[0] % len(samples)])
+            index[0] += 1
+        tick_us = time_per_call_us(next_tick, iterations=len(samples))
+
+        index[0] = 0
+        def next_baseline():
+            list_rebuild(samples[index[0] % len(samples)])
+            index[0] += 1
+        baseline_us = time_per_call_us(next_baseline, iterations=len(samples))
+
+        # Replay once more, noting the state after every sample
+        deck = make_deck()
+        states = []
+        for data in samples:
+            tick(deck, data)
+            states.append((data['timestamp'] / 1000.0, deck.state.name))
+    finally:
+        log.mode = saved_mode
+
+    report("rolling stats + hysteresis per tick", tick_us)
+    report("list rebuild (previous, 100 samples) per tick", baseline_us)
+
+    # Hand lands at 2.0 s of every 6 s scenario loop; idle (motor only) from 1.0 s to 2.0 s
+    start = states[0][0]
+    latencies = []
+    idle_flips = 0
+    for loop in range(int(session.duration_s // 6.0)):
+        onset = start + loop * 6.0 + 2.0
+        flip = next((t for t, state in states if t >= onset and state == 'MODULATING_SPEED'), None)
+        if flip is not None:
+            latencies.append((flip - onset) * 1000.0)
+        idle = [state for t, state in states if onset - 1.0 <= t < onset]
+        idle_flips += sum(a != b for a, b in zip(idle, idle[1:]))
+    if latencies:
+        print(f"    scratch onset -> MODULATING: {min(latencies):.0f}-{max(latencies):.0f} ms "
+              f"over {len(latencies)} onsets; state flips while idle: {idle_flips}")
+
+
+class SlowStream:
+    """Output stream that blocks like a terminal or SSH session: every write takes write_us"""
+
+    def __init__(self, write_us):
+        self.write_s = write_us / 1e6
+        self.writes = 0
+
+    def write(self, text):
+        # Blocked in the kernel - other threads keep running
+        self.writes += 1
+        time.sleep(self.write_s)
+
+    def flush(self):
+        pass
+
+
+@benchmark
+def bench_log_jitter(period_ms=2.0, write_us=None):
+    """Control loop tick time and wake jitter with the event log async, printing, and off"""
+    import os
+    import tempfile
+    from acquisition import LatencyHistogram
+    from eventlog import log
+    from i2c import EncoderReader
+    from deck import DJDeck
+    from recording import Session, replay_decoded
+    from calibration import PlatterCalibration
+    from config import CONTROL_MODE_TURNTABLE
+
+    # Simulated terminal write time (BENCH_TTY_WRITE_US), all categories on so every message is emitted
+    write_us = float(os.environ.get('BENCH_TTY_WRITE_US', 200)) if write_us is None else write_us
+    path = os.path.join(tempfile.mkdtemp(), 'scratch.bdj')
+    record_emulated_session(path)
+    samples = [data for _, data in replay_decoded(
+        path, lambda addr: EncoderReader(FakeBus(), addr, use_native=False))[0x42]]
+    print(f"  {len(samples)} scratch samples, one per {period_ms} ms tick, terminal write {write_us:.0f} µs")
+
+    saved = (log.mode, set(log.categories), log.stream)
+    period_ns = int(period_ms * 1_000_000)
+    try:
+        log.set_categories('all')
+        for mode in ('print', 'async', 'off'):
+            log.stop()
+            log.mode = mode
+            log.stream = stream = SlowStream(write_us)
+            deck = DJDeck(1, None, DummyElement(), None, CONTROL_MODE_TURNTABLE, None,
+                          calibration=PlatterCalibration(-100.0, 2.0))
+            tick_time = LatencyHistogram("tick")
+            wake_jitter = LatencyHistogram("wake")
+
+            deadline = time.perf_counter_ns()
+            for data in samples:
+                deadline += period_ns
+                while time.perf_counter_ns() < deadline:
+                    pass
+                start = time.perf_counter_ns()
+                wake_jitter.add((start - deadline) / 1000.0)
+                deck.add_sample(data)
+                deck._update_state_turntable()
+                deck._update_rate()
+                tick_time.add((time.perf_counter_ns() - start) / 1000.0)
+            log.stop()
+
+            print(f"  {mode:<6} tick: mean {tick_time.sum_us / tick_time.total:6.1f} µs  "
+                  f"p99<{tick_time.percentile(0.99):5.0f} µs  max {tick_time.max_us:6.0f} µs  |  "
+                  f"wake jitter p99<{wake_jitter.percentile(0.99):5.0f} µs  max {wake_jitter.max_us:6.0f} µs  "
+                  f"|  {stream.writes} writes")
+    finally:
+        log.stop()
+        log.mode, categories, log.stream = saved
+        log.set_categories(categories)
+
+
+def synth_pcm(seconds=10.0, sample_rate=48000):
+    """Stereo float32 test signal: 440 Hz + 3.5 kHz tones (BENCH_AUDIO=file.wav to use a track)"""
+    import array
+    import math
+    import os
+    from engine import load_pcm
+
+    if os.environ.get('BENCH_AUDIO'):
+        return load_pcm(os.environ['BENCH_AUDIO'])
+    pcm = array.array('f', bytes(8 * int(seconds * sample_rate)))
+    for i in range(0, len(pcm), 2):
+        t = i / 2 / sample_rate
+        pcm[i] = 0.4 * math.sin(2 * math.pi * 440 * t) + 0.1 * math.sin(2 * math.pi * 3500 * t)
+        pcm[i + 1] = pcm[i]
+    return pcm.tobytes(), sample_rate, 2
+
+
+def synth_wav(path, seconds):
+    """synth_pcm written as a 16-bit WAV (a track source that needs no decoder)"""
+    import array
+    import wave
+
+    pcm, sample_rate, channels = synth_pcm(seconds)
+    with wave.open(path, 'wb') as f:
+        f.setnchannels(channels)
+        f.setsampwidth(2)
+        f.setframerate(sample_rate)
+        f.writeframes(array.array('h', (int(x * 32767) for x in array.array('f', pcm))).tobytes())
+    return path
+
+
+@benchmark
+def bench_deck_engine(seconds=10.0):
+    """Native deck engine: CPU % of one core per deck at 48 kHz, per rate and while scratching"""
+    import math
+    import platform
+    from engine import deckengine
+    from config import ENGINE_SAMPLE_RATE, ENGINE_BLOCK_FRAMES
+
+    if deckengine is None:
+        print("  deckengine not built (python3 setup.py build_ext --inplace)")
+        return
+    pcm, sample_rate, channels = synth_pcm(seconds)
+    blocks = int(seconds * ENGINE_SAMPLE_RATE / ENGINE_BLOCK_FRAMES)
+    audio_s = blocks * ENGINE_BLOCK_FRAMES / ENGINE_SAMPLE_RATE
+    print(f"  {platform.machine()}, {channels} ch, {sample_rate} Hz source, "
+          f"{ENGINE_BLOCK_FRAMES}-frame blocks, {audio_s:.1f} s rendered per run")
+
+    def run(rate_for_block):
+        deck = deckengine.Deck(pcm, channels, sample_rate, ENGINE_SAMPLE_RATE)
+        buffer = bytearray(ENGINE_BLOCK_FRAMES * channels * 4)
+        start = time.perf_counter_ns()
+        for block in range(blocks):
+            rate = rate_for_block(block)
+            if rate is not None:
+                deck.set_rate(rate)
+            if deck.position >= deck.duration - 1.0:
+                deck.seek(0.0)
+            deck.render_into(buffer)
+        elapsed_s = (time.perf_counter_ns() - start) / 1e9
+        return elapsed_s / blocks * 1e6, 100.0 * elapsed_s / audio_s
+
+    for rate in (1.0, 0.5, 1.5, 2.2, 3.0):
+        block_us, cpu = run(lambda block, rate=rate: rate if block == 0 else None)
+        print(f"  rate {rate:3.1f}x   {block_us:7.1f} µs/block   {cpu:5.2f} % CPU per deck")
+
+    # New rate every 20 ms (a 50 Hz control loop) swinging 0..3x
+    period = max(1, int(0.02 * ENGINE_SAMPLE_RATE / ENGINE_BLOCK_FRAMES))
+    block_us, cpu = run(lambda block: 1.5 + 1.5 * math.sin(block / period * 0.7) if block % period == 0 else None)
+    print(f"  scratch    {block_us:7.1f} µs/block   {cpu:5.2f} % CPU per deck")
+
+
+@benchmark
+def bench_position_lock():
+    """Playhead tracking error against the platter while scratching: position vs turntable mode
+    (emulated scratch session, or BENCH_SESSION=file)"""
+    import os
+    import tempfile
+    from i2c import EncoderReader
+    from deck import DJDeck, TurntableState
+    from recording import Session, replay_decoded
+    from engine import EngineDeck, deckengine
+    from eventlog import log
+    from config import (CONTROL_MODE_TURNTABLE, CONTROL_MODE_POSITION, DECK1_VELOCITY_ESTIMATOR,
+                        ENGINE_SAMPLE_RATE, ENGINE_BLOCK_FRAMES)
+
+    if deckengine is None:
+        print("  deckengine not built (python3 setup.py build_ext --inplace)")
+        return
+    path = os.environ.get('BENCH_SESSION')
+    if path is None:
+        path = os.path.join(tempfile.mkdtemp(), 'scratch.bdj')
+        record_emulated_session(path)
+    session = Session(path)
+    address = session.addresses[0]
+    samples = [data for _, data in replay_decoded(
+        session, lambda addr: EncoderReader(FakeBus(), addr, use_native=False,
+                                            estimators=(DECK1_VELOCITY_ESTIMATOR,) * 2))[address]]
+    start_s = 5.0
+    pcm, sample_rate, channels = synth_pcm(session.duration_s + 2 * start_s)
+    print(f"  session {path}: {len(session)} packets, {session.duration_s:.1f} s")
+
+    def run(mode):
+        """Render the deck on the session clock; error = playhead - platter angle on the vinyl"""
+        rate_element = EngineDeck(pcm, sample_rate, channels)
+        rate_element.deck.seek(start_s)
+        deck = DJDeck(1, None, rate_element, None, mode, None)
+        block = bytearray(ENGINE_BLOCK_FRAMES * channels * 4)
+        rendered = 0
+        anchor = None           # (count, playhead) at the last NORMAL sample
+        errors, held = [], []   # |error| in ms of track while MODULATING, and once held for 100 ms
+        counts = []
+        for data in samples:
+            due = (data['timestamp'] - samples[0]['timestamp']) * ENGINE_SAMPLE_RATE // 1000
+            while rendered + ENGINE_BLOCK_FRAMES <= due:
+                rate_element.deck.render_into(block)
+                rendered += ENGINE_BLOCK_FRAMES
+
+            count = data['enc1_position']
+            counts.append(count)
+            playhead = rate_element.position
+            if deck.state == TurntableState.MODULATING_SPEED and anchor is not None:
+                error_ms = abs(playhead - anchor[1] - (count - anchor[0]) * deck.seconds_per_count()) * 1000.0
+                errors.append(error_ms)
+                if len(counts) > 5 and len(set(counts[-6:])) == 1:
+                    held.append(error_ms)
+
+            deck.add_sample(data)
+            deck._update_state_turntable()
+            deck._update_rate()
+            if deck.state == TurntableState.NORMAL_SPEED:
+                anchor = (count, playhead)
+        return sorted(errors), held
+
+    saved_mode, log.mode = log.mode, 'off'
+    try:
+        results = [(name, run(mode)) for name, mode in (("position", CONTROL_MODE_POSITION),
+                                                         ("turntable", CONTROL_MODE_TURNTABLE))]
+    finally:
+        log.mode = saved_mode
+
+    for name, (errors, held) in results:
+        if not errors:
+            print(f"  {name:<10} never left NORMAL")
+            continue
+        print(f"  {name:<10} |playhead - platter| while scratching: p50 {errors[len(errors) // 2]:6.1f} ms  "
+              f"p99 {errors[int(len(errors) * 0.99)]:6.1f} ms  max {errors[-1]:6.1f} ms  |  "
+              f"held still: max {max(held, default=0.0):6.2f} ms ({len(held)} samples)")
+
+
+
+@benchmark
+def bench_track_load(seeks=50):
+    """Time to first audio and seek latency: decodebin vs the memory-mapped track cache
+    (BENCH_AUDIO=file, default the first example track)"""
+    import os
+    import random
+    import tempfile
+    import trackcache
+    from engine import EngineDeck, deckengine
+    from config import ENGINE_SAMPLE_RATE, ENGINE_BLOCK_FRAMES
+
+    here = os.path.dirname(os.path.abspath(__file__))
+    source = os.environ.get('BENCH_AUDIO') or os.path.join(
+        here, 'example-mp3', sorted(os.listdir(os.path.join(here, 'example-mp3')))[0])
+    print(f"  source {source} ({os.path.getsize(source) / 1e6:.1f} MB)")
+
+    def summary(latencies_ms):
+        latencies_ms = sorted(latencies_ms)
+        return f"p50 {latencies_ms[len(latencies_ms) // 2]:7.2f} ms  max {latencies_ms[-1]:7.2f} ms"
+
+    # decodebin: what every deck paid before - a pipeline decoding in real time
+    try:
+        from gi.repository import Gst
+        Gst.init(None)
+        start = time.perf_counter()
+        pipeline = Gst.parse_launch(
+            f'filesrc name=src ! decodebin ! audioconvert ! audioresample ! '
+            f'audio/x-raw,format=F32LE,layout=interleaved,rate={ENGINE_SAMPLE_RATE},channels=2 ! '
+            f'appsink name=sink sync=false')
+        pipeline.get_by_name("src").set_property("location", source)
+        sink = pipeline.get_by_name("sink")
+        pipeline.set_state(Gst.State.PLAYING)
+        sink.emit("pull-sample")
+        first_ms = (time.perf_counter() - start) * 1000.0
+        duration_s = pipeline.query_duration(Gst.Format.TIME)[1] / Gst.SECOND
+
+        rng = random.Random(1)
+        latencies = []
+        for _ in range(seeks):
+            start = time.perf_counter()
+            pipeline.seek_simple(Gst.Format.TIME, Gst.SeekFlags.FLUSH | Gst.SeekFlags.ACCURATE,
+                                 int(rng.uniform(0, duration_s - 1.0) * Gst.SECOND))
+            sink.emit("pull-sample")
+            latencies.append((time.perf_counter() - start) * 1000.0)
+        pipeline.set_state(Gst.State.NULL)
+        print(f"  decodebin    first audio {first_ms:8.2f} ms   seek {summary(latencies)}")
+    except Exception as e:
+        print(f"  decodebin    unavailable ({type(e).__name__}: {e})")
+
+    if deckengine is None:
+        print("  deckengine not built (python3 setup.py build_ext --inplace)")
+        return
+    cache_dir = tempfile.mkdtemp()
+    start = time.perf_counter()
+    try:
+        trackcache.open_track(source, cache_dir)
+    except Exception as e:
+        # No decoder here: time the cache on a synthetic 16-bit WAV instead
+        print(f"  cannot decode {source} ({type(e).__name__}), using a synthetic 60 s WAV")
+        source = synth_wav(os.path.join(cache_dir, 'synthetic.wav'), 60.0)
+        start = time.perf_counter()
+        trackcache.open_track(source, cache_dir)
+    print(f"  cache build  {time.perf_counter() - start:8.2f} s (once per track)")
+
+    # A fresh load, as in a new process: hash the source, map the entry, render the first block
+    trackcache._hashes.clear()
+    block = bytearray(ENGINE_BLOCK_FRAMES * 2 * 4)
+    start = time.perf_counter()
+    digest = trackcache.source_hash(source)
+    hashed = time.perf_counter()
+    track = trackcache.CachedTrack(trackcache.entry_path(digest, cache_dir), digest)
+    deck = EngineDeck(track.pcm, track.sample_rate, track.channels)
+    deck.deck.render_into(block)
+    first_ms = (time.perf_counter() - start) * 1000.0
+    print(f"  track cache  first audio {first_ms:8.2f} ms   (hash {(hashed - start) * 1000.0:.2f} ms, "
+          f"{track.duration_s:.0f} s of PCM mapped)")
+
+    # A seek takes effect in the next rendered block
+    rng = random.Random(1)
+    latencies = []
+    for _ in range(seeks):
+        start = time.perf_counter()
+        deck.deck.seek(rng.uniform(0, track.duration_s - 1.0))
+        deck.deck.render_into(block)
+        latencies.append((time.perf_counter() - start) * 1000.0)
+    print(f"  track cache  seek {summary(latencies)}   (+ up to one {ENGINE_BLOCK_FRAMES}-frame block "
+          f"= {ENGINE_BLOCK_FRAMES * 1000.0 / ENGINE_SAMPLE_RATE:.1f} ms until it is played)")
+
+
+
+@benchmark
+def bench_hot_load(loads=5, buffer_blocks=2):
+    """Hot loading a track into one deck: request-to-ready time, and late blocks (dropouts) on the
+    other deck, rendered in real time against an appsrc holding buffer_blocks blocks"""
+    import os
+    import tempfile
+    import threading
+    import engine
+    import trackcache
+    from engine import EngineDeck, TrackLoader, deckengine
+    from config import ENGINE_SAMPLE_RATE, ENGINE_BLOCK_FRAMES
+
+    if deckengine is None:
+        print("  deckengine not built (python3 setup.py build_ext --inplace)")
+        return
+    cache_dir = tempfile.mkdtemp()
+    engine.TRACK_CACHE_DIR = cache_dir
+    # Different lengths, so each is a new cache entry
+    sources = [synth_wav(os.path.join(cache_dir, f'track{i}.wav'), 30.0 + i) for i in range(loads)]
+
+    pcm, sample_rate, channels = synth_pcm(10.0)
+    playing = EngineDeck(pcm, sample_rate, channels)
+    loading = EngineDeck(pcm, sample_rate, channels)
+    period = ENGINE_BLOCK_FRAMES / ENGINE_SAMPLE_RATE
+
+    def play(stop, stats):
+        """The playing deck's streaming thread: block k is due buffer_blocks periods after its slot"""
+        block = bytearray(ENGINE_BLOCK_FRAMES * channels * 4)
+        t0 = time.perf_counter()
+        k = 0
+        while not stop.is_set():
+            slot = t0 + k * period
+            delay = slot - time.perf_counter()
+            if delay > 0:
+                time.sleep(delay)
+            playing.deck.render_into(block)
+            late = time.perf_counter() - (slot + buffer_blocks * period)
+            stats['blocks'] += 1
+            stats['worst'] = max(stats['worst'], late)
+            if late > 0:
+                stats['late'] += 1
+            k += 1
+
+    def run(action):
+        stop = threading.Event()
+        stats = {'blocks': 0, 'late': 0, 'worst': float('-inf')}
+        thread = threading.Thread(target=play, args=(stop, stats))
+        thread.start()
+        result = action()
+        stop.set()
+        thread.join()
+        return result, stats
+
+    def show(label, stats):
+        print(f"  {label:<22} {stats['blocks']:6d} blocks  {stats['late']:3d} late  "
+              f"worst margin {-stats['worst'] * 1000.0:6.2f} ms")
+
+    def load_all(warm):
+        times = []
+        for source in sources:
+            if warm:
+                trackcache._hashes.clear()      # As a fresh request would: hash, then map
+            ready = threading.Event()
+            loader = TrackLoader(source, 5.0, lambda _loader: ready.set()).start()
+            ready.wait()
+            if loader.error is not None:
+                raise loader.error
+            times.append(loader.load_s * 1000.0)
+            generation = loading.deck.generation
+            loading.load(loader)
+            loading.deck.render(ENGINE_BLOCK_FRAMES)
+            if loading.deck.generation == generation:
+                print(f"  ✗ {source} not swapped in")
+        return times
+
+    print(f"  {loads} loads of a 30 s track, {ENGINE_BLOCK_FRAMES}-frame blocks "
+          f"({period * 1000.0:.2f} ms), {buffer_blocks} blocks buffered")
+    _, stats = run(lambda: time.sleep(1.0))
+    show("idle", stats)
+    for warm in (False, True):
+        times, stats = run(lambda: load_all(warm))
+        times.sort()
+        label = "mapped from cache" if warm else "decoded into cache"
+        print(f"  {label:<22} ready p50 {times[len(times) // 2]:8.1f} ms  max {times[-1]:8.1f} ms")
+        show("  other deck", stats)
+
+
+@benchmark
+def bench_mixing(seconds=5.0):
+    """Mixing stage cost per block for 2 and 4 decks: deck engine renders with channel gains held,
+    and ramping on every control tick (faders moving); audiomixer summing if GStreamer is there"""
+    from engine import deckengine
+    from config import ENGINE_SAMPLE_RATE, ENGINE_BLOCK_FRAMES, FADER_RAMP_MS, I2C_POLL_RATE_MS
+
+    if deckengine is None:
+        print("  deckengine not built (python3 setup.py build_ext --inplace)")
+        return
+    pcm, sample_rate, channels = synth_pcm(seconds + 1.0)
+    blocks = int(seconds * ENGINE_SAMPLE_RATE / ENGINE_BLOCK_FRAMES)
+    block_ms = ENGINE_BLOCK_FRAMES * 1000.0 / ENGINE_SAMPLE_RATE
+    tick = max(1, int(I2C_POLL_RATE_MS / block_ms))
+    print(f"  {ENGINE_BLOCK_FRAMES}-frame blocks ({block_ms:.2f} ms), {seconds:.0f} s per run, "
+          f"gain ramps of {FADER_RAMP_MS:.0f} ms every {tick} blocks")
+
+    def run(count, gain_for_tick):
+        decks = [deckengine.Deck(pcm, channels, sample_rate, ENGINE_SAMPLE_RATE) for _ in range(count)]
+        buffers = [bytearray(ENGINE_BLOCK_FRAMES * channels * 4) for _ in range(count)]
+        start = time.perf_counter_ns()
+        for block in range(blocks):
+            if block % tick == 0:
+                gain = gain_for_tick(block // tick)
+                if gain is not None:
+                    for deck in decks:
+                        deck.set_gain(gain, FADER_RAMP_MS)
+            for deck, buffer in zip(decks, buffers):
+                deck.render_into(buffer)
+        return (time.perf_counter_ns() - start) / 1000.0 / blocks
+
+    for count in (2, 4):
+        unity_us = run(count, lambda t: None)
+        held_us = run(count, lambda t: 0.7 if t == 0 else None)
+        ramp_us = run(count, lambda t: 0.2 + 0.6 * (t % 2))
+        print(f"  {count} decks   unity {unity_us:6.1f} µs/block   gain held {held_us:6.1f}   "
+              f"ramping {ramp_us:6.1f}   ({100.0 * ramp_us / 1000.0 / block_ms:.2f} % CPU)")
+
+    # The summing itself happens in audiomixer
+    try:
+        from gi.repository import Gst
+        Gst.init(None)
+        for count in (2, 4):
+            sources = " ".join(
+                f"audiotestsrc num-buffers={blocks} samplesperbuffer={ENGINE_BLOCK_FRAMES} ! "
+                f"audio/x-raw,format=F32LE,rate={ENGINE_SAMPLE_RATE},channels=2 ! mix."
+                for _ in range(count))
+            pipeline = Gst.parse_launch(f"audiomixer name=mix ! fakesink sync=false {sources}")
+            start = time.perf_counter_ns()
+            pipeline.set_state(Gst.State.PLAYING)
+            pipeline.get_bus().timed_pop_filtered(Gst.CLOCK_TIME_NONE, Gst.MessageType.EOS | Gst.MessageType.ERROR)
+            elapsed_us = (time.perf_counter_ns() - start) / 1000.0
+            pipeline.set_state(Gst.State.NULL)
+            print(f"  {count} decks   audiomixer + test sources {elapsed_us / blocks:6.1f} µs/block")
+    except Exception as e:
+        print(f"  audiomixer unavailable ({type(e).__name__}: {e})")
+
+
+@benchmark
+def bench_output(seconds=2.0):
+    """Output latency and xruns per sink period, headless: the null sink (a software-clocked card)
+    drained while a deck engine deck renders into it on demand (python3 output.py report runs
+    the same through a real backend)"""
+    from engine import deckengine
+    from output import NullSink, OutputSettings
+    from config import OUTPUT_TUNE_PERIOD_FRAMES, AUDIO_PERIODS, ENGINE_SAMPLE_RATE
+
+    if deckengine is None:
+        print("  deckengine not built (python3 setup.py build_ext --inplace)")
+        return
+    pcm, sample_rate, channels = synth_pcm(seconds + 1.0)
+    print(f"  {AUDIO_PERIODS} periods per buffer, {seconds:.0f} s per setting")
+    for period_frames in OUTPUT_TUNE_PERIOD_FRAMES:
+        settings = OutputSettings(period_frames, AUDIO_PERIODS, ENGINE_SAMPLE_RATE)
+        deck = deckengine.Deck(pcm, channels, sample_rate, ENGINE_SAMPLE_RATE)
+
+        def pull(frames):
+            deck.render(frames)
+            return frames
+
+        sink = NullSink(settings, pull)
+        sink.start()
+        time.sleep(seconds)
+        sink.stop()
+        latency = sink.latency
+        print(f"  {settings}: buffered mean {latency.sum_us / max(1, latency.total) / 1000:5.2f} ms, "
+              f"max {latency.max_us / 1000:5.2f} ms, xruns {sink.xruns}")
+
+
+@benchmark
+def bench_latency_trace(seconds=10.0):
+    """Platter-to-output latency per stage (tracing.py) on a session replayed in real time, with
+    and without the acquisition thread; the deck renders into the null sink (emulated scratch
+    session, or BENCH_SESSION=file; BENCH_TRACE=file.json keeps the last run's Chrome trace)"""
+    import os
+    import tempfile
+    from i2c import EncoderReader
+    from deck import DJDeck
+    from acquisition import AcquisitionThread
+    from recording import Session, ReplayBus
+    from engine import EngineDeck, deckengine
+    from output import NullSink, OutputSettings
+    from tracing import tracer
+    from eventlog import log
+    from config import (CONTROL_MODE_TURNTABLE, DECK1_VELOCITY_ESTIMATOR, ENGINE_BLOCK_FRAMES, I2C_POLL_RATE_MS)
+
+    if deckengine is None:
+        print("  deckengine not built (python3 setup.py build_ext --inplace)")
+        return
+    path = os.environ.get('BENCH_SESSION')
+    if path is None:
+        path = os.path.join(tempfile.mkdtemp(), 'scratch.bdj')
+        record_emulated_session(path, seconds=seconds)
+    session = Session(path)
+    address = session.addresses[0]
+    pcm, sample_rate, channels = synth_pcm(min(seconds, session.duration_s) * 3.5 + 1.0)
+    settings = OutputSettings()
+    print(f"  session {path}: {len(session)} packets, {session.duration_s:.1f} s, output {settings}")
+
+    def run(acquisition):
+        rate_element = EngineDeck(pcm, sample_rate, channels)
+        reader = EncoderReader(ReplayBus(session, 1.0), address, use_native=False,
+                               estimators=(DECK1_VELOCITY_ESTIMATOR,) * 2)
+        deck = DJDeck(1, reader, rate_element, None, CONTROL_MODE_TURNTABLE, None)
+
+        def pull(frames):
+            """appsrc blocks, each behind the audio already queued in the sink"""
+            got = 0
+            while got < frames:
+                tracer.output_latency_ns = (sink.queued_frames + got) * 1_000_000_000 // settings.rate
+                rate_element.render(ENGINE_BLOCK_FRAMES)
+                got += ENGINE_BLOCK_FRAMES
+            return got
+
+        sink = NullSink(settings, pull)
+        thread = AcquisitionThread(readers=[reader]) if acquisition else None
+        if thread is not None:
+            deck.sample_ring = thread.ring_for(reader)
+            thread.start()
+        tracer.reset()
+        tracer.enabled = True
+        sink.start()
+        end = time.monotonic() + min(seconds, session.duration_s)
+        while time.monotonic() < end:
+            time.sleep(I2C_POLL_RATE_MS / 1000.0)   # Like the GLib timer: relative, so it drifts
+            deck.update_from_encoder()
+        tracer.enabled = False
+        sink.stop()
+        if thread is not None:
+            thread.stop()
+        return sink.xruns
+
+    saved_mode, log.mode = log.mode, 'off'
+    try:
+        for acquisition in (False, True):
+            xruns = run(acquisition)
+            print(f"  {'acquisition thread' if acquisition else 'GLib-style poll'}: xruns {xruns}")
+            for line in tracer.summary():
+                print(f"    {line}")
+    finally:
+        log.mode = saved_mode
+    trace_path = os.environ.get('BENCH_TRACE')
+    if trace_path:
+        print(f"  {tracer.export_chrome(trace_path)} traces written to {trace_path}")
+
+
+def main():
+    names = sys.argv[1:] or list(BENCHMARKS)
+    for name in names:
+        if name not in BENCHMARKS:
+            print(f"Unknown benchmark '{name}' (available: {', '.join(BENCHMARKS)})")
+            return 1
+        print(f"\n{name}: {BENCHMARKS[name].__doc__}")
+        BENCHMARKS[name]()
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,189 @@
+#!/usr/bin/env python3
+"""
+Platter Calibration Module
+Measures the motor-driven platter's steady-state velocity and jitter, derives the deck's
+"normal speed" band (and its direction) from them, keeps the estimate up to date during idle
+spin and persists it per controller, so the band follows the motor, encoder PPR and mounting
+without editing config.py
+
+Usage:
+    python3 calibration.py [FILE]   # show the saved calibrations
+"""
+
+import json
+import os
+import sys
+import time
+from config import (
+    ENCODER_PPR, NORMAL_SPEED_MIN, NORMAL_SPEED_MAX, PLATTER_CAL_FILE,
+    PLATTER_CAL_SETTLE_S, PLATTER_CAL_DURATION_S, PLATTER_CAL_MIN_SPEED, PLATTER_CAL_MAX_CV,
+    PLATTER_CAL_BAND_SIGMAS, PLATTER_CAL_MIN_BAND, PLATTER_CAL_TRACK_ALPHA
+)
+
+
+class PlatterCalibration:
+    """
+    Steady-state platter velocity (signed counts/s) and its jitter (std, counts/s)
+
+    The normal band is speed +/- half_width, half_width being PLATTER_CAL_BAND_SIGMAS x jitter
+    but at least PLATTER_CAL_MIN_BAND x |speed| (an ideal encoder has no jitter at all).
+    """
+
+    def __init__(self, speed, jitter, samples=0, updated=None, measured=True):
+        self.speed = float(speed)
+        self.jitter = float(jitter)
+        self.samples = samples
+        self.updated = time.time() if updated is None else updated
+        self.measured = measured    # False for the config.py default
+
+    @classmethod
+    def default(cls):
+        """The band from NORMAL_SPEED_MIN/MAX, used until a platter has been measured"""
+        speed = (NORMAL_SPEED_MIN + NORMAL_SPEED_MAX) / 2.0
+        jitter = abs(NORMAL_SPEED_MAX - NORMAL_SPEED_MIN) / 2.0 / PLATTER_CAL_BAND_SIGMAS
+        return cls(speed, jitter, measured=False)
+
+    @property
+    def direction(self):
+        """+1 if forward platter rotation counts up, -1 if it counts down"""
+        return 1 if self.speed >= 0 else -1
+
+    @property
+    def half_width(self):
+        return max(PLATTER_CAL_BAND_SIGMAS * self.jitter, PLATTER_CAL_MIN_BAND * abs(self.speed))
+
+    def band(self):
+        """(low, high) of the normal band in counts/s"""
+        return self.speed - self.half_width, self.speed + self.half_width
+
+    def track(self, velocity, alpha=PLATTER_CAL_TRACK_ALPHA):
+        """
+        Follow slow drift of the motor speed (call with velocities measured in normal state)
+
+        Values outside the band are ignored, so a hand on the platter cannot drag the estimate.
+        """
+        low, high = self.band()
+        if not low <= velocity <= high:
+            return False
+        error = velocity - self.speed
+        self.speed += alpha * error
+        self.jitter = ((1.0 - alpha) * self.jitter ** 2 + alpha * error * error) ** 0.5
+        self.samples += 1
+        self.updated = time.time()
+        return True
+
+    def to_dict(self):
+        return {'speed': round(self.speed, 3), 'jitter': round(self.jitter, 3),
+                'samples': self.samples, 'updated': round(self.updated, 1), 'ppr': ENCODER_PPR}
+
+    @classmethod
+    def from_dict(cls, entry):
+        return cls(entry['speed'], entry['jitter'], entry.get('samples', 0), entry.get('updated'))
+
+    def __str__(self):
+        low, high = self.band()
+        return (f"{self.speed:+.1f} counts/s (jitter {self.jitter:.1f}, band {low:.1f}..{high:.1f}, "
+                f"{'forward counts up' if self.direction > 0 else 'forward counts down'}"
+                f"{'' if self.measured else ', config default'})")
+
+
+class PlatterCalibrator:
+    """
+    One calibration run: lets the platter settle, then measures mean and jitter of its velocity
+
+    A run that ends too unsteady (std > PLATTER_CAL_MAX_CV x |mean|) or too slow (a stopped or
+    held platter) starts over.
+    """
+
+    def __init__(self, settle_s=PLATTER_CAL_SETTLE_S, duration_s=PLATTER_CAL_DURATION_S):
+        self.settle_s = settle_s
+        self.duration_s = duration_s
+        self.attempts = 0
+        self.last_reason = None
+        self._restart()
+
+    def _restart(self):
+        self.start_t = None
+        self.count = 0
+        self.mean = 0.0
+        self.m2 = 0.0
+        self.attempts += 1
+
+    def add(self, t, velocity):
+        """
+        Feed one sample (t in seconds)
+
+        Returns:
+            PlatterCalibration when the run is complete, else None
+        """
+        if self.start_t is None:
+            self.start_t = t
+        elapsed = t - self.start_t
+        if elapsed < self.settle_s:
+            return None
+
+        # Welford's running mean / variance
+        self.count += 1
+        delta = velocity - self.mean
+        self.mean += delta / self.count
+        self.m2 += delta * (velocity - self.mean)
+        if elapsed < self.settle_s + self.duration_s:
+            return None
+
+        std = (self.m2 / max(1, self.count - 1)) ** 0.5
+        if abs(self.mean) < PLATTER_CAL_MIN_SPEED:
+            self.last_reason = f"platter not turning ({self.mean:.1f} counts/s)"
+        elif std > PLATTER_CAL_MAX_CV * abs(self.mean):
+            self.last_reason = f"speed not steady ({self.mean:.1f} +/- {std:.1f} counts/s)"
+        else:
+            return PlatterCalibration(self.mean, std, self.count)
+        self._restart()
+        return None
+
+
+def load_calibrations(path=PLATTER_CAL_FILE):
+    """Saved calibrations by controller key; entries made with another encoder PPR are dropped"""
+    if path is None or not os.path.exists(path):
+        return {}
+    try:
+        with open(path) as f:
+            entries = json.load(f)
+        return {key: PlatterCalibration.from_dict(entry) for key, entry in entries.items()
+                if entry.get('ppr') == ENCODER_PPR}
+    except (OSError, ValueError, KeyError, TypeError) as e:
+        print(f"Ignoring platter calibration file {path}: {e}")
+        return {}
+
+
+def save_calibrations(calibrations, path=PLATTER_CAL_FILE):
+    """Write measured calibrations by controller key (atomically, so a crash leaves the old file)"""
+    if path is None:
+        return False
+    entries = {key: cal.to_dict() for key, cal in calibrations.items() if cal.measured}
+    try:
+        directory = os.path.dirname(os.path.abspath(path))
+        os.makedirs(directory, exist_ok=True)
+        temp_path = path + '.tmp'
+        with open(temp_path, 'w') as f:
+            json.dump(entries, f, indent=2, sort_keys=True)
+        os.replace(temp_path, path)
+        return True
+    except OSError as e:
+        print(f"Could not save platter calibration to {path}: {e}")
+        return False
+
+
+def main():
+    path = sys.argv[1] if len(sys.argv) > 1 else PLATTER_CAL_FILE
+    calibrations = load_calibrations(path)
+    if not calibrations:
+        print(f"No platter calibrations in {path} (default: {PlatterCalibration.default()})")
+        return 1
+    for key, cal in sorted(calibrations.items()):
+        print(f"{key}: {cal}, {cal.samples} samples, updated "
+              f"{time.strftime('%Y-%m-%d %H:%M:%S', time.localtime(cal.updated))}")
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
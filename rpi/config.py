@@ -14,9 +14,61 @@ DUAL_DECK_MODE = False  # Set to True for two-deck mixing, False for single deck
 # ==================== I2C CONFIGURATION ====================
 I2C_BUS = 1                    # RPi5 I2C bus (usually 1)
 ESP32_DECK1_ADDR = 0x42        # ESP32 slave address for Deck 1 (single ESP32 with dual encoders)
-ESP32_DECK2_ADDR = 0x43        # ESP32 slave address for Deck 2 (if using two ESP32s - not implemented yet)
-DATA_PACKET_SIZE = 25          # 25 bytes: enc1_pos(4) + enc1_vel(4) + enc2_pos(4) + enc2_vel(4) + timestamp(4) + button_flags(1) + volume_pot(2) + slider_pot(2)
+ESP32_DECK2_ADDR = 0x43        # ESP32 slave address for Deck 2 (if using two ESP32s)
+DATA_PACKET_SIZE = 27          # 27 bytes: enc1_pos(4) + enc1_vel(4) + enc2_pos(4) + enc2_vel(4) + timestamp(4) + button_flags(1) + volume_pot(2) + slider_pot(2) + cmd_ack_seq(1) + cmd_status(1)
 I2C_POLL_RATE_MS = 20          # Poll I2C every 20ms (50Hz)
+USE_NATIVE_I2C = True          # Use the fasti2c extension when built (python3 setup.py build_ext --inplace)
+
+# ==================== ACQUISITION THREAD ====================
+ACQ_THREAD_ENABLED = True      # Poll from a dedicated thread (False = poll on the GLib timer)
+ACQ_SCHED_FIFO_PRIORITY = 50   # SCHED_FIFO priority for the thread (0 = normal scheduling)
+ACQ_CPU = 3                    # CPU to pin the thread to (None = no pinning)
+ACQ_RING_SIZE = 64             # Samples buffered per encoder (power of two)
+ACQ_STATS_PERIOD_S = 10        # Print jitter/latency histograms this often (0 = only on stop)
+
+# ==================== MULTI-DEVICE POLLER ====================
+POLLER_DISCOVER = True         # Probe for ESP32 controllers at startup (False = only the addresses above)
+POLLER_BUSES = [I2C_BUS]       # I2C buses to probe
+POLLER_ADDRESSES = range(0x42, 0x4A)  # Addresses probed on each bus (0x42 = deck 1, 0x43 = deck 2, ...)
+POLLER_MAX_BATCH = 8           # Devices read per I2C_RDWR ioctl (kernel limit is 42 messages)
+POLLER_STALE_MS = 200          # A device with no good sample for this long is reported stale
+POLLER_ERROR_ALPHA = 0.05      # Smoothing of the per-device error rate
+
+# ==================== COMMAND CHANNEL (RPi -> ESP32) ====================
+# Frames written to the ESP32: command(1) + payload_length(1) + payload (matching comm.h)
+# send_command() writes its frames plus a COMMIT in one transaction; the ESP32 echoes the
+# commit sequence number and status in the cmd_ack_seq/cmd_status bytes of the data packet
+CMD_COMMIT = 0x01              # Payload: seq(1), 1-255
+CMD_CALIBRATION = 0x10         # Payload: calibration profile, stored in ESP32 NVS
+CMD_MOTOR_SETPOINT = 0x20      # Payload: deck(1) + rpm_x10(2, signed, negative = backward)
+CMD_LED_PATTERN = 0x21         # Payload: pattern(1) + beat_phase(2, 0-65535) + beat_period_us(4)
+CMD_LCD_TEXT = 0x22            # Payload: row(1) + text(0-16 chars)
+CMD_LED_LEVEL = 0x23           # Payload: level(1, 0-255) shown by LED_PATTERN_VU
+CMD_LCD_TITLE = 0x24           # Payload: now-playing title (0-16 chars, shown in the title field)
+CMD_LCD_STATUS = 0x25          # Payload: bpm_x10(2) + pitch_x10(2, signed, %) + elapsed_s(2)
+
+# Command status (matching I2C_CMD_STATUS_* in comm.h)
+CMD_STATUS_NAMES = ["OK", "UNKNOWN", "BAD_LENGTH", "BAD_ARG", "FAILED", "FRAMING"]
+
+CMD_ACK_TIMEOUT_S = 0.25       # Give up waiting for an acknowledgement after this long
+CMD_ACK_POLL_MS = 1            # Interval between acknowledgement checks while waiting
+CMD_RTT_BOUND_MS = 60          # Round-trip bound checked by test.py (write -> ack visible in a read)
+
+# LED patterns (matching LED_PATTERN_* in leds.h)
+LED_PATTERN_OFF = 0
+LED_PATTERN_SCROLL = 1         # One LED per beat, previous one fading out (default)
+LED_PATTERN_PULSE = 2          # All LEDs flash on the beat
+LED_PATTERN_VU = 3             # Bar graph of the level sent with CMD_LED_LEVEL
+LED_PATTERN_STROBE = 4         # Flash on every sixteenth note
+LED_PATTERN_SOLID = 5
+
+LCD_COLS = 16                  # Characters per LCD row
+
+# Calibration profile (matching calib_profile_t in calib.h, packed little-endian, 30 bytes):
+# version, [pot_min, pot_max] x2 (volume, slider), [duty, rpm_x10] x4 motor curve,
+# motor_target_rpm_x10, encoder_direction x2, encoder_ppr x2, i2c_address
+CALIBRATION_FORMAT = '<B' + 'HH' * 2 + 'BH' * 4 + 'H' + 'bb' + 'HH' + 'B'
+CALIBRATION_VERSION = 1
 
 # ==================== BUTTON CONFIGURATION ====================
 # Button bit indices (matching ESP32 inputs.h)
@@ -33,16 +85,13 @@ BUTTON_NAMES = ["SFX_1", "SFX_2", "SFX_3", "SFX_4", "SONG_1", "SONG_2"]
 POTENTIOMETER_MIN = 0          # Minimum ADC value (12-bit)
 POTENTIOMETER_MAX = 4095       # Maximum ADC value (12-bit)
 POTENTIOMETER_DEADZONE = 50    # Deadzone near edges to avoid noise
+POT_HYSTERESIS = 12            # Counts a reading must move before the level follows (ADC noise)
 
 # ==================== ENCODER SETTINGS ====================
 VELOCITY_WINDOW_SIZE = 10      # Longer window for low-resolution encoder (24 PPR)
 MIN_PLAYBACK_RATE = 0.0        # Minimum playback speed (0 = stopped)
 MAX_PLAYBACK_RATE = 3.0        # Maximum playback speed (3.0 = triple speed)
 
-# Position-based control settings (only used in POSITION mode)
-POSITION_CENTER = 1000         # Center position for neutral speed
-POSITION_RANGE = 500           # ±500 counts for ±50% speed change
-
 # Velocity-based control settings (only used in VELOCITY mode)
 VELOCITY_SCALE = 100.0         # Velocity divisor for rate control (adjust for sensitivity)
 
@@ -53,14 +102,77 @@ VELOCITY_PREDICTION = True     # Use predictive velocity tracking (recommended f
 VELOCITY_CHANGE_THRESHOLD = 0.15  # Only update rate if velocity changes by 15% or more
 VELOCITY_TIMEOUT_MS = 500      # If no encoder change for 500ms, assume stopped
 
+# Velocity estimator per encoder: 'predictive', 'window' (EncoderSmoother), 'lsq1' / 'lsq2'
+# (least-squares line / parabola over LSQ_WINDOW_MS). Compare them with: python3 bench.py estimators
+VELOCITY_ESTIMATORS = ('predictive', 'predictive')
+DECK1_VELOCITY_ESTIMATOR = 'predictive'
+DECK2_VELOCITY_ESTIMATOR = 'predictive'   # Deck 2 with its own ESP32 only
+LSQ_WINDOW_MS = 200            # Fit window
+LSQ_MIN_WINDOW_MS = 60         # Window after a sample that does not fit (reversal, hand on)
+LSQ_CHANGE_COUNTS = 1.5        # Distance from the fit (counts) that shrinks the window
+LSQ_OUTLIER_COUNTS = 40        # Distance from the fit (counts) of a glitch, dropped unless confirmed
+
+# Position-locked scratching (only used in POSITION mode, needs the deck engine): while the
+# platter is moved by hand the playhead follows its angle through a "virtual vinyl"
+POSITION_COUNTS_PER_REV = ENCODER_PPR * 4   # Encoder counts per platter revolution (quadrature)
+POSITION_SECONDS_PER_REV = None  # Track seconds per revolution (1.8 = 33 1/3 rpm record),
+                                 # None = whatever the calibrated motor speed plays at 1.0x
+POSITION_GLIDE_MS = 25.0       # Playhead glide to each new platter position (a bit over one poll)
+
 # ==================== AUDIO SETTINGS ====================
 DEFAULT_VOLUME = 1.0           # Default volume (0.0 to 1.0)
 VOLUME_STEP = 0.1              # Volume increment/decrement step
+CROSSFADER_CURVE = 'constant-power'  # Slider pot: 'linear', 'constant-power' or 'cut' (scratching)
+CROSSFADER_CUT_WIDTH = 0.05    # 'cut': slider travel at each end over which the far deck fades in
+VOLUME_POT_MODE = 'master'     # 'master': deck 1's controller pot sets the level of both decks;
+                               # 'channel': each controller's pot is its own deck's fader
+FADER_RAMP_MS = 20.0           # Deck engine gain ramp per fader change (about one control tick)
+
+# ==================== AUDIO OUTPUT (output.py) ====================
+AUDIO_BACKEND = "pulse"        # 'alsa', 'pipewire', 'jack', 'pulse', 'null' (a sound card clocked in software,
+                               # for headless runs) or any GStreamer sink; mixer.py --emulate/--replay use 'null'
+AUDIO_DEVICE = None            # 'alsa': PCM device ("hw:0", "hw:Dummy", "hw:Loopback,0"), None = default
+AUDIO_PERIOD_FRAMES = 256      # Frames the sink moves at a time (5.3 ms at 48 kHz)
+AUDIO_PERIODS = 3              # Periods in the sink buffer: output latency is about periods x period
+OUTPUT_TUNING_FILE = HOME_PATH + "rpi/output_tuning.json"  # Period picked by output.py tune, per backend
+                               # (used instead of AUDIO_PERIOD_FRAMES); None = always use the config
+OUTPUT_TUNE_PERIOD_FRAMES = (64, 128, 256, 512, 1024)  # Periods tried by output.py tune, smallest first
+OUTPUT_TUNE_SECONDS = 5.0      # Play time per tried period; a single xrun rejects it
+
+# ==================== DECK ENGINE (deckengine.cpp, engine.py) ====================
+DECK_ENGINE = "native"         # "native": track in memory, played by the deck engine; "pitch": GStreamer pitch element
+ENGINE_SAMPLE_RATE = 48000     # Engine output rate (Hz)
+ENGINE_BLOCK_FRAMES = 128      # Frames rendered per appsrc request (2.7 ms at 48 kHz, keeps reversals < 5 ms)
+ENGINE_RATE_SMOOTHING_MS = 10.0  # Time constant of the per-sample rate smoothing
+ENGINE_REVERSE_SMOOTHING_MS = 1.0  # Time constant while the rate changes sign (forward <-> reverse)
+ENGINE_RATE_RAMP_MS = I2C_POLL_RATE_MS  # Rate control points are reached this long after they are sent
+                               # (one control tick: the per-sample ramps join up; a reversal takes
+                               # ENGINE_REVERSE_SMOOTHING_MS)
+REVERSE_SWITCH_BOUND_MS = 5.0  # test.py: a direction change must be heard within this
+RATE_ARTIFACT_BOUND_DB = -60.0 # test.py: energy outside a modulated sine's band, relative to all of it
+TRACK_CACHE_DIR = HOME_PATH + "rpi/track_cache/"  # Decoded tracks, memory-mapped (trackcache.py); None = decode every run
+TRACK_PREROLL_S = 2.0          # Hot load: audio after the start position read in before the swap
+TRACK_LOADER_NICE = 10         # Hot load: the loader thread yields the CPU to the playing decks
+MIXER_CONTROL_SOCKET = "/tmp/box-dj-mixer.sock"  # Control messages from server.py (track loads)
+
+# ==================== SFX SAMPLER (sampler.py) ====================
+# One sample per SFX button, decoded at startup into locked memory and mixed over the decks
+# (needs the deck engine). None = no sample on that button; no samples = no sampler.
+SFX_SAMPLES = [None, None, None, None]  # SFX_1..SFX_4 audio files
+SFX_MODES = ['one-shot', 'one-shot', 'retrigger', 'gate']  # 'one-shot': every press plays the whole sample;
+                               # 'retrigger': a press restarts it; 'gate': a press starts it looping, the
+                               # next press stops it (the controller reports presses, not releases)
+SFX_VOICES = 8                 # Samples playing at once; a new one fades out the oldest
+SFX_RELEASE_MS = 2.0           # Fade-out of a stopped, restarted or stolen voice (no click)
+SFX_GAIN = 0.8                 # Sample level on the master bus
+SFX_QUEUE_BLOCKS = 4           # Blocks queued between the sampler and the sink (appsrc 2, null sink appsink 2)
+SFX_LATENCY_BOUND_MS = AUDIO_PERIOD_FRAMES * AUDIO_PERIODS * 1000.0 / ENGINE_SAMPLE_RATE  # test.py: packet
+                               # to the block holding the first sample, within one audio buffer
 
 # ==================== CONTROL MODES ====================
 # Control mode for deck speed
 CONTROL_MODE_VELOCITY = "velocity"      # Use velocity for scratching/dynamic control
-CONTROL_MODE_POSITION = "position"      # Use position for turntable-style pitch control
+CONTROL_MODE_POSITION = "position"      # Turntable, but scratches lock the playhead to the platter angle
 CONTROL_MODE_TURNTABLE = "turntable"    # Vinyl turntable mode - encoder velocity IS playback speed
 
 # Default control modes for each deck
@@ -90,17 +202,65 @@ ENABLE_EXTRAPOLATION = True
 # Allow negative velocity (playing backwards/scratching)
 ALLOW_REVERSE_PLAYBACK = True
 
+# ==================== EMULATOR (emulator.py) ====================
+EMU_COUNTS_PER_REV = ENCODER_PPR * 4   # Quadrature decoding
+EMU_ENCODER_DIRECTION = -1     # Forward platter rotation counts down (see NORMAL_SPEED_MIN/MAX)
+EMU_NORMAL_COUNTS_PER_SEC = -100.0  # Motor speed at boot
+EMU_MOTOR_TAU_S = 0.3          # Motor spin-up time constant (platter inertia)
+EMU_HAND_TAU_S = 0.02          # How fast a hand drags the platter to its own speed
+EMU_PHYSICS_STEP_S = 0.001     # Integration step
+EMU_POT_NOISE_COUNTS = 6       # Peak ADC noise on the pot readings
+
+# ==================== RECORD / REPLAY (recording.py) ====================
+RECORD_INDEX_INTERVAL = 256    # Index entry every this many records
+REPLAY_SPEED = 1.0             # Session time per host time (0 = one packet per read, deterministic)
+
+# ==================== PLATTER CALIBRATION (calibration.py) ====================
+# Measured at startup when a controller has no saved calibration (or with mixer.py --calibrate,
+# or on SIGUSR1): the motor-driven platter's speed and jitter give the normal band and direction
+PLATTER_CAL_FILE = HOME_PATH + "rpi/platter_calibration.json"
+PLATTER_CAL_SETTLE_S = 1.0     # Ignore this long after the start (motor spin-up)
+PLATTER_CAL_DURATION_S = 2.0   # Then measure for this long
+PLATTER_CAL_MIN_SPEED = 5.0    # Slower than this (counts/s) = platter stopped or held, measure again
+PLATTER_CAL_MAX_CV = 0.25      # Jitter above this fraction of the speed = not steady, measure again
+PLATTER_CAL_MAX_ATTEMPTS = 5   # Then give up and keep the previous calibration
+PLATTER_CAL_BAND_SIGMAS = 4.0  # Normal band half-width in jitter standard deviations...
+PLATTER_CAL_MIN_BAND = 0.2     # ...but at least this fraction of the speed
+PLATTER_CAL_TRACK_ALPHA = 0.002  # Re-estimation weight per tick in normal state (~10 s at 50 Hz)
+PLATTER_CAL_SAVE_PERIOD_S = 60  # Save the re-estimated calibration this often
+PLATTER_CAL_STEADY_RECAL_S = 10.0  # Recalibrate after turning steadily outside the band this long (0 = never)
+
+# ==================== LATENCY TRACING (tracing.py) ====================
+TRACE_MAX_TRACES = 20000       # Completed traces kept (oldest dropped), about 7 min of commands at 50 Hz
+TRACE_CLOCK_WINDOW = 500       # Packets over which the ESP32 clock is mapped to the host clock (10 s)
+
 # ==================== DEBUG SETTINGS ====================
 DEBUG_PRINT_I2C = True         # Print I2C read values
 DEBUG_PRINT_RATE = True        # Print rate changes
 DEBUG_PRINT_VOLUME = True      # Print volume changes
 
+# ==================== LOGGING (eventlog.py) ====================
+LOG_MODE = "async"             # "async" (writer thread), "print" (write from the caller) or "off"
+LOG_CATEGORIES = (("state", "cal", "timing", "error")
+                  + (("i2c",) if DEBUG_PRINT_I2C else ())
+                  + (("rate",) if DEBUG_PRINT_RATE else ())
+                  + (("volume",) if DEBUG_PRINT_VOLUME else ()))
+LOG_RING_SIZE = 1024           # Records buffered between flushes (full ring drops and counts)
+LOG_FLUSH_MS = 100             # Writer thread wake-up period
+LOG_REPEAT_MS = 1000           # Minimum interval of per-tick and error messages (per deck / address)
+
 # ==================== SMOOTHING SETTINGS ====================
-SMOOTHING_ALPHA = 0.9          # Exponential smoothing factor for rate transitions (0.0–1.0)
-MAX_RATE_DELTA_PER_SEC = 1.6   # Optional hard cap on rate change speed (per second)
+SMOOTHING_ALPHA = 0.9          # Weight of each new rate against the previous one, per tick (1.0 = none)
+MAX_RATE_DELTA_PER_SEC = 1000.0  # Deck engine slew limit (rate per second): 1x -> -1x takes >= 2 ms
 
 # ==================== SPEED THRESHOLDING ====================
+# The normal band comes from the platter calibration (see PLATTER CALIBRATION); these only
+# apply to a controller that has never been calibrated
 NORMAL_SPEED_MIN = -120          # Minimum normal speed for smoothing calculations
 NORMAL_SPEED_MAX = -80         # Maximum normal speed for smoothing calculations 
+DECK_STATS_WINDOW = 10         # Velocity samples in the state detection window (200 ms at 50 Hz)
+DECK_STATE_MARGIN = 0.5        # Hysteresis: leave the normal band only this far outside it (x band half-width)
+DECK_STATE_HOLD = 3            # Samples a state change must persist before it is taken
+DECK_NORMAL_MAX_STD = 1.0      # Velocity spread (x band half-width) above which the deck is modulating, whatever the mean
 # TIME_TO_AVERAGE_SECONDS = 5     # Number of samples to average for speed thresholding
 
@@ -0,0 +1,378 @@
+#!/usr/bin/env python3
+"""
+DJ Deck Module
+One deck's control loop without GStreamer: encoder samples in, rate/position commands and gain
+out to its rate element (the pitch element or a deck engine source), with the turntable state
+machine, platter calibration and hot loading. DJMixer (mixer.py) builds the pipeline around it;
+benchmarks drive it directly.
+"""
+
+import enum
+import time
+from acquisition import LatencyHistogram
+from stats import RollingStats, HysteresisBand
+from calibration import PlatterCalibration, PlatterCalibrator
+from eventlog import log
+from engine import TrackLoader
+from tracing import tracer
+from config import (
+    LOG_REPEAT_MS, DEFAULT_VOLUME, MIN_PLAYBACK_RATE, MAX_PLAYBACK_RATE, CONTROL_MODE_VELOCITY,
+    CONTROL_MODE_POSITION, CONTROL_MODE_TURNTABLE, ALLOW_REVERSE_PLAYBACK, DECK_STATS_WINDOW,
+    DECK_STATE_MARGIN, DECK_STATE_HOLD, DECK_NORMAL_MAX_STD, PLATTER_CAL_MIN_SPEED,
+    PLATTER_CAL_MAX_CV, PLATTER_CAL_MAX_ATTEMPTS, PLATTER_CAL_STEADY_RECAL_S,
+    POSITION_COUNTS_PER_REV, POSITION_SECONDS_PER_REV, POSITION_GLIDE_MS, SMOOTHING_ALPHA,
+    ENGINE_RATE_RAMP_MS, ENGINE_REVERSE_SMOOTHING_MS, FADER_RAMP_MS
+)
+
+# Deck messages (eventlog.py) - key is the deck id
+MSG_MODE = log.message('state', "Deck {key}: Control mode set to {text}")
+MSG_STATE = log.message('state', "Deck {key}: {text} (mean {0:.1f}, std {1:.1f}, slope {2:.1f} counts/s/s)")
+MSG_NORMAL = log.message('rate', "Deck {key}: at normal speed, rate 1.0x", LOG_REPEAT_MS)
+MSG_MODULATING = log.message('rate', "Deck {key}: modulating speed, velocity {0:.1f} counts/s", LOG_REPEAT_MS)
+MSG_RATE = log.message('rate', "Deck {key}: Velocity {0:6.1f}\tRate: {1:.2f}x")
+MSG_POSITION = log.message('rate', "Deck {key}: Platter {0:+.0f} counts\tPlayhead: {1:.3f} s")
+MSG_VOLUME = log.message('volume', "Deck {key}: Volume {0:.2f}")
+MSG_NO_VOLUME = log.message('volume', "Deck {key}: Volume control needs the deck engine in single deck mode",
+                            LOG_REPEAT_MS)
+MSG_CAL_START = log.message('cal', "Deck {key}: calibrating platter speed - let the motor turn it untouched")
+MSG_CAL_RESTART = log.message('cal', "Deck {key}: calibration restarted ({text})")
+MSG_CAL_FAILED = log.message('cal', "Deck {key}: calibration failed ({text})")
+MSG_CAL_DONE = log.message('cal', "Deck {key}: calibrated {text}")
+MSG_CAL_STEADY = log.message('cal', "Deck {key}: steady at {0:.1f} counts/s outside the normal band "
+                                    "for {1:.0f} s")
+MSG_LOADING = log.message('state', "Deck {key}: loading {text}")
+MSG_LOAD_READY = log.message('state', "Deck {key}: {text} ready after {0:.1f} ms")
+MSG_SWAPPED = log.message('state', "Deck {key}: playing {text}")
+MSG_LOAD_FAILED = log.message('error', "Deck {key}: cannot load {text}")
+
+
+class TurntableState(enum.Enum):
+    """States for the Turntable Speed Controller"""
+    CALIBRATING = 0
+    NORMAL_SPEED = 1
+    MODULATING_SPEED = 2
+
+
+class DJDeck:
+    """Represents a single DJ deck with its encoder and GStreamer elements"""
+
+    def __init__(self, deck_id, encoder_reader, rate_element, volume_pad, control_mode, pipeline,
+                 calibration=None):
+        self.deck_id = deck_id
+        self.encoder = encoder_reader
+        self.rate_element = rate_element
+        self.volume_pad = volume_pad
+        self.control_mode = control_mode
+        self.pipeline = pipeline
+        
+        self.state = TurntableState.NORMAL_SPEED
+
+        self.current_rate = 1.0
+        self.current_volume = DEFAULT_VOLUME
+        self.fader_gain = 1.0       # Master level x crossfader, set by DJMixer
+
+        # Zero and negative rates only if the rate element can play them (deck engine, not pitch)
+        self.reverse = ALLOW_REVERSE_PLAYBACK and getattr(rate_element, "supports_reverse", False)
+
+        # Position lock (CONTROL_MODE_POSITION): platter count and the playhead (s) it matches
+        self.lock_anchor = None
+        self.locked = False
+
+        # Hot loading (deck engine only): the next track's TrackLoader, and (at_s,) once its
+        # swap has been asked for
+        self.loader = None
+        self.swap_request = None
+        
+        # Recent encoder 1 velocities (O(1) mean/variance/slope) and the last full sample
+        self.velocity_stats = RollingStats(DECK_STATS_WINDOW)
+        self.last_data = None
+        self.normal_band = HysteresisBand(0.0, 0.0, 0.0, hold=DECK_STATE_HOLD)
+
+        # Platter calibration (normal band and direction); a run in progress while CALIBRATING
+        self.calibration = None
+        self.calibrator = None
+        self.on_calibrated = None   # callable(deck) when a calibration run completes
+        self.steady_since = None    # Sample time since the platter turns steadily outside the band
+        self.set_calibration(calibration or PlatterCalibration.default())
+
+        # Set by DJMixer when an acquisition thread feeds this deck; None = read directly
+        self.sample_ring = None
+        self.on_packet = None       # callable(data, read_time_ns) for directly read packets (SFX triggers)
+        self.sample_age = LatencyHistogram(f"deck{deck_id} sample age")
+        
+    @property
+    def position_lock(self):
+        """Scratches lock the playhead to the platter (position mode on the deck engine)"""
+        return (self.control_mode == CONTROL_MODE_POSITION
+                and getattr(self.rate_element, "supports_position", False))
+
+    def seconds_per_count(self):
+        """Track seconds per encoder count on the virtual vinyl (signed like the platter)"""
+        if POSITION_SECONDS_PER_REV:
+            return self.calibration.direction * POSITION_SECONDS_PER_REV / POSITION_COUNTS_PER_REV
+        return 1.0 / self.calibration.speed
+
+    def set_control_mode(self, mode):
+        """Switch between control modes"""
+        if mode in [CONTROL_MODE_VELOCITY, CONTROL_MODE_POSITION, CONTROL_MODE_TURNTABLE]:
+            self.control_mode = mode
+            log.emit(MSG_MODE, key=self.deck_id, text=mode)
+
+    def update_from_encoder(self):
+        """Take new encoder samples (from the acquisition ring or a direct read) and update playback rate/volume"""
+        if self.sample_ring is not None:
+            now = consume_ns = time.monotonic_ns()
+            received = 0
+            sample = self.sample_ring.pop()
+            while sample is not None:
+                read_time_ns, data = sample
+                self.sample_age.add((now - read_time_ns) / 1000.0)
+                self.add_sample(data)
+                received += 1
+                sample = self.sample_ring.pop()
+            if received == 0:
+                return
+        else:
+            read_time_ns = time.monotonic_ns()
+            data = self.encoder.read()
+
+            if data is None:
+                return
+
+            if self.on_packet is not None:
+                self.on_packet(data, read_time_ns)
+            self.add_sample(data)
+            consume_ns = time.monotonic_ns()
+
+        # Latency trace of the newest packet, kept if it leads to a command (deck engine only)
+        traced = tracer.enabled and hasattr(self.rate_element, "trace")
+        if traced:
+            self.rate_element.trace = tracer.begin(self.deck_id, data['timestamp'], read_time_ns, consume_ns)
+
+        # Update playback rate based on control mode
+        self._update_state_turntable()
+        self._update_rate()
+        if traced:
+            self.rate_element.trace = None
+
+    def add_sample(self, data):
+        """Add one decoded encoder sample to the deck history"""
+        t = data['timestamp'] / 1000.0
+        velocity = data['enc1_velocity']
+        self.velocity_stats.add(t, velocity)
+        self.last_data = data
+
+        if self.calibrator is not None:
+            attempts = self.calibrator.attempts
+            calibration = self.calibrator.add(t, velocity)
+            if calibration is not None:
+                self._finish_calibration(calibration)
+            elif self.calibrator.attempts > PLATTER_CAL_MAX_ATTEMPTS:
+                log.emit(MSG_CAL_FAILED, key=self.deck_id,
+                         text=f"{self.calibrator.last_reason}, keeping {self.calibration}")
+                self._finish_calibration(None)
+            elif self.calibrator.attempts != attempts:
+                log.emit(MSG_CAL_RESTART, key=self.deck_id, text=self.calibrator.last_reason)
+
+    def set_calibration(self, calibration):
+        """Use a platter calibration for the normal band and the rate mapping"""
+        self.calibration = calibration
+        self._apply_band()
+
+    def _apply_band(self):
+        low, high = self.calibration.band()
+        self.normal_band.set_band(low, high)
+        self.normal_band.margin = DECK_STATE_MARGIN * self.calibration.half_width
+
+    def start_calibration(self):
+        """Measure the platter's normal speed; plays at 1.0x until done"""
+        log.emit(MSG_CAL_START, key=self.deck_id)
+        self.calibrator = PlatterCalibrator()
+        self.state = TurntableState.CALIBRATING
+        self.steady_since = None
+        if self.locked or self.current_rate != 1.0:
+            self._set_rate(1.0)
+
+    def _finish_calibration(self, calibration):
+        self.calibrator = None
+        if calibration is not None:
+            self.set_calibration(calibration)
+            log.emit(MSG_CAL_DONE, key=self.deck_id, text=str(calibration))
+            if self.on_calibrated is not None:
+                self.on_calibrated(self)
+        self.state = TurntableState.NORMAL_SPEED
+        self.normal_band.inside = True
+        self.normal_band.pending = 0
+
+    def _update_state_turntable(self):
+        """NORMAL while the recent mean velocity stays in the normal band and the spread is small"""
+        if self.state == TurntableState.CALIBRATING or self.velocity_stats.count == 0:
+            return
+
+        stats = self.velocity_stats
+        max_std = DECK_NORMAL_MAX_STD * self.calibration.half_width
+        if self.normal_band.update(stats.mean, force_out=stats.std > max_std):
+            self.state = (TurntableState.NORMAL_SPEED if self.normal_band.inside
+                          else TurntableState.MODULATING_SPEED)
+            self.steady_since = None
+            log.emit(MSG_STATE, stats.mean, stats.std, stats.slope, key=self.deck_id, text=self.state.name)
+
+        if self.state == TurntableState.NORMAL_SPEED:
+            # Idle spin: follow slow motor drift
+            if self.calibration.track(stats.last):
+                self._apply_band()
+        elif PLATTER_CAL_STEADY_RECAL_S:
+            # Turning steadily outside the band for a long time: the motor speed has changed
+            t = self.last_data['timestamp'] / 1000.0
+            if abs(stats.mean) >= PLATTER_CAL_MIN_SPEED and stats.std <= PLATTER_CAL_MAX_CV * abs(stats.mean):
+                if self.steady_since is None:
+                    self.steady_since = t
+                elif t - self.steady_since >= PLATTER_CAL_STEADY_RECAL_S:
+                    log.emit(MSG_CAL_STEADY, stats.mean, PLATTER_CAL_STEADY_RECAL_S, key=self.deck_id)
+                    self.start_calibration()
+            else:
+                self.steady_since = None
+
+    def _update_rate(self):
+        match self.state:
+            case TurntableState.CALIBRATING:
+                # Rate stays at 1.0x (set by start_calibration) until the band is known
+                pass
+            case TurntableState.NORMAL_SPEED:
+                log.emit(MSG_NORMAL, key=self.deck_id)
+                if self.locked or self.current_rate != 1.0:
+                    self._set_rate(1.0)
+                if self.position_lock:
+                    self.lock_anchor = (self.last_data['enc1_position'], self.rate_element.position)
+            case TurntableState.MODULATING_SPEED if self.position_lock:
+                """Move the playhead with the platter (position-locked scratching)"""
+                # Target = where the playhead was at the last NORMAL sample + platter travel since;
+                # absolute, so the engine's glide ends on it every tick and nothing drifts
+                count = self.last_data['enc1_position']
+                if self.lock_anchor is None:
+                    self.lock_anchor = (count, self.rate_element.position)
+                anchor_count, anchor_seconds = self.lock_anchor
+                target = anchor_seconds + (count - anchor_count) * self.seconds_per_count()
+                self.rate_element.glide_to(target, POSITION_GLIDE_MS)
+                self.locked = True
+                log.emit(MSG_POSITION, count - anchor_count, target, key=self.deck_id)
+            case TurntableState.MODULATING_SPEED:
+                """Update playback rate based on encoder velocity (scratching)"""
+                # Rate = velocity relative to the calibrated motor speed (sign included)
+                velocity = self.velocity_stats.last
+                log.emit(MSG_MODULATING, velocity, key=self.deck_id)
+                new_rate = velocity / self.calibration.speed
+
+                # Clamp to allowed range (pulling the platter back plays backwards if supported)
+                min_rate = -MAX_PLAYBACK_RATE if self.reverse else MIN_PLAYBACK_RATE
+                new_rate = max(min_rate, min(MAX_PLAYBACK_RATE, new_rate))
+                if not self.locked:
+                    new_rate = SMOOTHING_ALPHA * new_rate + (1.0 - SMOOTHING_ALPHA) * self.current_rate
+
+                if self.locked or abs(new_rate - self.current_rate) > 0.01:  # Only update if significant change
+                    self._set_rate(new_rate if self.reverse else max(0.01, new_rate))
+                    log.emit(MSG_RATE, velocity, self.current_rate, key=self.deck_id)
+
+    def _set_rate(self, rate):
+        """
+        New playback rate: on the deck engine a control point, ramped to per sample over the next
+        control tick (through a reversal, over ENGINE_REVERSE_SMOOTHING_MS); the pitch element
+        can only step to it
+        """
+        reversing = rate * self.current_rate < 0.0
+        self.locked = False
+        self.current_rate = rate
+        if hasattr(self.rate_element, "schedule_rate"):
+            ramp_ms = ENGINE_REVERSE_SMOOTHING_MS if reversing else ENGINE_RATE_RAMP_MS
+            self.rate_element.schedule_rate(rate, ramp_ms / 1000.0)
+        else:
+            self.rate_element.set_property("rate", rate)
+
+    def prepare_track(self, path, start_s=0.0, swap=True, at_s=None, post=None):
+        """
+        Load a track in the background while this deck plays on
+
+        Args:
+            path: Audio file
+            start_s: Where the new track starts playing
+            swap: Swap it in when ready (at at_s, see swap_track) - else wait for swap_track()
+            post: Runs the ready callback on the control thread (None = GLib.idle_add)
+        """
+        if not hasattr(self.rate_element, "load"):
+            log.emit(MSG_LOAD_FAILED, key=self.deck_id, text=f"{path} (hot loading needs the deck engine)")
+            return False
+        log.emit(MSG_LOADING, key=self.deck_id, text=path)
+        if post is None:
+            from gi.repository import GLib
+            post = GLib.idle_add
+        self.swap_request = (at_s,) if swap else None
+        self.loader = TrackLoader(path, start_s, self._on_track_ready, post).start()
+        return True
+
+    def _on_track_ready(self, loader):
+        if loader is not self.loader:
+            return      # Superseded by a newer load
+        if loader.error is not None:
+            log.emit(MSG_LOAD_FAILED, key=self.deck_id, text=f"{loader.path} ({loader.error})")
+            self.loader = None
+            return
+        log.emit(MSG_LOAD_READY, loader.load_s * 1000.0, key=self.deck_id, text=loader.path)
+        if self.swap_request is not None:
+            self.swap_track(*self.swap_request)
+
+    def swap_track(self, at_s=None):
+        """
+        Switch to the prepared track (crossfaded) at deck output time at_s (None = now); if it
+        is still loading, as soon as it is ready
+        """
+        loader = self.loader
+        if loader is None:
+            return False
+        self.swap_request = (at_s,)
+        if not loader.ready:
+            return True
+        try:
+            if not self.rate_element.load(loader, at_s):
+                return False
+        except ValueError as e:
+            log.emit(MSG_LOAD_FAILED, key=self.deck_id, text=f"{loader.path} ({e})")
+            self.loader = None
+            return False
+        self.loader = None
+        self.swap_request = None
+        self.lock_anchor = None     # New playhead
+        log.emit(MSG_SWAPPED, key=self.deck_id, text=loader.path)
+        return True
+
+    def set_volume(self, volume):
+        """Set deck (channel fader) volume (0.0 to 1.0)"""
+        volume = max(0.0, min(1.0, volume))
+        self.current_volume = volume
+
+        if self._apply_gain():
+            log.emit(MSG_VOLUME, volume, key=self.deck_id)
+        else:
+            log.emit(MSG_NO_VOLUME, key=self.deck_id)
+
+    def set_fader_gain(self, gain):
+        """Master level x crossfader gain of this deck"""
+        self.fader_gain = gain
+        self._apply_gain()
+
+    def _apply_gain(self):
+        """
+        Channel volume x fader gain: ramped per sample by the deck engine, else stepped on the
+        mixer pad (dual deck mode only)
+        """
+        gain = self.current_volume * self.fader_gain
+        if hasattr(self.rate_element, "set_gain"):
+            self.rate_element.set_gain(gain, FADER_RAMP_MS)
+        elif self.volume_pad is not None:
+            self.volume_pad.set_property("volume", gain)
+        else:
+            return False
+        return True
+
+    def adjust_volume(self, delta):
+        """Adjust volume by delta"""
+        self.set_volume(self.current_volume + delta)
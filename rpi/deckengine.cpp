@@ -0,0 +1,1493 @@
+/*
+ * deckengine - native variable-speed playback for one deck
+ *
+ * Plays decoded PCM held in memory (float32, interleaved) through a fractional read head with
+ * windowed-sinc (band-limited) interpolation. The control thread posts rate and position
+ * targets through a lock-free single-producer/single-consumer queue; the audio thread applies
+ * them between samples and smooths the rate per sample, so a rate change is never quantised
+ * to a GStreamer block and never takes a lock on the audio path.
+ *
+ * Rates may be zero or negative: the read head runs backwards through the same PCM, so a
+ * direction change needs no seek. While the target and the current rate have opposite signs
+ * the faster reverse time constant applies, so the head passes through zero within a
+ * millisecond or two but still continuously (no click).
+ *
+ * Position lock (scratching with the record under the hand): each target is a source position
+ * the head glides to along a straight line over a given time - the expected interval to the
+ * next encoder sample - and holds until the next one. Targets are absolute, so the head ends
+ * every glide exactly where the platter was and no error accumulates.
+ *
+ * Rate automation: a control point (rate, output frame) is reached in a straight line from the
+ * current rate, interpolated per sample and slew-limited, so a control tick is a ramp and
+ * never a step. Timestamped one tick ahead, consecutive points join into a continuous curve.
+ *
+ * Gain: the channel level (faders, crossfader) is ramped to in a straight line per sample, so
+ * a fader move never steps the waveform (zipper noise).
+ *
+ * Hot loading: a new track's PCM can be queued while the deck plays, to take over at a given
+ * output frame (or the next block) with the seek crossfade from the old one. The buffers stay
+ * referenced until the audio thread reports it no longer reads them.
+ *
+ * Sampler: a separate player for short pre-decoded samples (the SFX pads). Its voices are
+ * mixed into one output; beyond the voice limit the oldest voice is faded out and reused.
+ * Sample memory is locked (mlock) so a trigger never waits for a page fault.
+ *
+ * Build in place:  python3 setup.py build_ext --inplace
+ * Used by engine.py (DeckEngineSource feeds an appsrc); mixer.py falls back to the pitch
+ * element when the module is not built.
+ */
+
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+
+#include <atomic>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <ctime>
+#include <vector>
+
+#include <sys/mman.h>
+
+namespace {
+
+/* ==================== SPSC COMMAND QUEUE ==================== */
+
+enum CommandType : uint8_t {
+    CMD_RATE = 1,       /* value: target rate, arg: smoothing time constant (ms, < 0 = keep) */
+    CMD_SEEK = 2,       /* value: seconds to jump to (crossfaded) */
+    CMD_GLIDE = 3,      /* value: seconds to glide to, arg: output frames to get there */
+    CMD_LOAD = 4,       /* source: new PCM, value: seconds to start at, at: output frame (0 = now) */
+    CMD_RAMP = 5,       /* value: rate at output frame at, arg: max rate change per second (0 = none) */
+    CMD_GAIN = 6,       /* value: gain, arg: output frames to ramp over */
+};
+
+/* PCM the read head plays; generation numbers tell the owner when a buffer can be released */
+struct Source {
+    const float *pcm = nullptr;
+    size_t frames = 0;
+    int rate = 48000;
+    double step_scale = 1.0;            /* Source frames per output frame at rate 1.0 */
+    uint64_t generation = 0;
+};
+
+struct Command {
+    CommandType type;
+    double value;
+    double arg;
+    Source source;
+    uint64_t at;
+};
+
+/*
+ * Fixed-size ring with one producer (control thread) and one consumer (audio thread). Each
+ * side owns one index and publishes it with a release store after the slot it covers is
+ * written or read; a full queue rejects the command and the producer counts it.
+ */
+template <typename T, size_t N>
+class SpscQueue {
+    static_assert((N & (N - 1)) == 0, "capacity must be a power of two");
+
+public:
+    bool push(const T &item)
+    {
+        const size_t head = head_.load(std::memory_order_relaxed);
+        if (head - tail_.load(std::memory_order_acquire) >= N) {
+            return false;
+        }
+        slots_[head & (N - 1)] = item;
+        head_.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool pop(T &item)
+    {
+        const size_t tail = tail_.load(std::memory_order_relaxed);
+        if (tail == head_.load(std::memory_order_acquire)) {
+            return false;
+        }
+        item = slots_[tail & (N - 1)];
+        tail_.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+private:
+    T slots_[N];
+    alignas(64) std::atomic<size_t> head_{0};
+    alignas(64) std::atomic<size_t> tail_{0};
+};
+
+/* ==================== INTERPOLATION KERNELS ==================== */
+
+constexpr int TAPS = 16;                /* Input frames under the kernel */
+constexpr int HALF = TAPS / 2;
+constexpr int PHASES = 256;             /* Kernel positions per input frame (linearly interpolated) */
+constexpr double KAISER_BETA = 7.0;
+constexpr int MAX_CHANNELS = 8;
+
+/* Cutoffs (fraction of the source Nyquist) for speeds up to 1.25x, 1.75x, 2.5x and above */
+constexpr int KERNELS = 4;
+constexpr double KERNEL_MAX_SPEED[KERNELS] = {1.25, 1.75, 2.5, 1e9};
+constexpr double KERNEL_CUTOFF[KERNELS] = {0.90, 0.90 / 1.5, 0.90 / 2.0, 0.90 / 3.0};
+
+double bessel_i0(double x)
+{
+    double sum = 1.0, term = 1.0;
+    for (int k = 1; k < 30; k++) {
+        term *= (x / (2.0 * k)) * (x / (2.0 * k));
+        sum += term;
+    }
+    return sum;
+}
+
+/*
+ * Polyphase Kaiser-windowed sinc: coefficient j of phase p weights input frame
+ * floor(pos) + j - (HALF - 1) when frac(pos) = p / PHASES. Each phase is normalised to unit
+ * DC gain; PHASES + 1 rows so the row after the last phase exists for interpolation.
+ */
+struct Kernel {
+    float coef[PHASES + 1][TAPS];
+
+    explicit Kernel(double cutoff)
+    {
+        const double i0_beta = bessel_i0(KAISER_BETA);
+        for (int p = 0; p <= PHASES; p++) {
+            const double frac = (double)p / PHASES;
+            double sum = 0.0;
+            double row[TAPS];
+            for (int j = 0; j < TAPS; j++) {
+                const double x = (j - (HALF - 1)) - frac;
+                const double r = x / HALF;
+                const double window = std::fabs(r) < 1.0 ? bessel_i0(KAISER_BETA * std::sqrt(1.0 - r * r)) / i0_beta : 0.0;
+                const double arg = M_PI * cutoff * x;
+                const double sinc = std::fabs(arg) < 1e-12 ? 1.0 : std::sin(arg) / arg;
+                row[j] = cutoff * sinc * window;
+                sum += row[j];
+            }
+            for (int j = 0; j < TAPS; j++) {
+                coef[p][j] = (float)(row[j] / sum);
+            }
+        }
+    }
+};
+
+const Kernel *kernels()
+{
+    static const std::vector<Kernel> table = [] {
+        std::vector<Kernel> k;
+        k.reserve(KERNELS);
+        for (int i = 0; i < KERNELS; i++) {
+            k.emplace_back(KERNEL_CUTOFF[i]);
+        }
+        return k;
+    }();
+    return table.data();
+}
+
+/* Kernel for reading at `speed` source frames per output frame */
+int kernel_index(double speed)
+{
+    int k = 0;
+    while (speed > KERNEL_MAX_SPEED[k]) {
+        k++;
+    }
+    return k;
+}
+
+/* Band-limited value of interleaved PCM at a fractional frame position (silence outside) */
+inline void interpolate(const Kernel &kernel, const float *pcm, size_t frames, int channels, double pos,
+                        float *frame)
+{
+    const double base = std::floor(pos);
+    const double phase = (pos - base) * PHASES;
+    const int p = (int)phase;
+    const float a = (float)(phase - p);
+    const float *row0 = kernel.coef[p];
+    const float *row1 = kernel.coef[p + 1];
+
+    float acc[MAX_CHANNELS] = {0.0f};
+    const long first = (long)base - (HALF - 1);
+
+    if (first >= 0 && first + TAPS <= (long)frames) {
+        const float *samples = pcm + first * channels;
+        for (int j = 0; j < TAPS; j++) {
+            const float w = row0[j] + a * (row1[j] - row0[j]);
+            for (int c = 0; c < channels; c++) {
+                acc[c] += w * samples[j * channels + c];
+            }
+        }
+    } else {
+        for (int j = 0; j < TAPS; j++) {
+            const long index = first + j;
+            if (index < 0 || index >= (long)frames) {
+                continue;
+            }
+            const float w = row0[j] + a * (row1[j] - row0[j]);
+            for (int c = 0; c < channels; c++) {
+                acc[c] += w * pcm[index * channels + c];
+            }
+        }
+    }
+    std::memcpy(frame, acc, channels * sizeof(float));
+}
+
+/* ==================== ENGINE ==================== */
+
+constexpr double SEEK_CROSSFADE_MS = 5.0;
+
+class Engine {
+public:
+    Engine(const Source &source, int channels, int output_rate, double smoothing_ms,
+           double reverse_smoothing_ms)
+        : channels_(channels), output_rate_(output_rate),
+          crossfade_frames_((int)(SEEK_CROSSFADE_MS * 0.001 * output_rate)),
+          kernels_(kernels()), src_(source)
+    {
+        set_smoothing(smoothing_ms);
+        reverse_coef_ = coefficient(reverse_smoothing_ms);
+        publish();
+    }
+
+    /* ---- Control thread ---- */
+
+    bool post(const Command &cmd)
+    {
+        if (!queue_.push(cmd)) {
+            dropped_.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        return true;
+    }
+
+    /* Source frames per output frame for PCM at source_rate */
+    double step_scale(int source_rate) const { return (double)source_rate / output_rate_; }
+
+    /* ---- Audio thread ---- */
+
+    void render(float *out, size_t count)
+    {
+        Command cmd;
+        while (queue_.pop(cmd)) {
+            apply(cmd);
+        }
+
+        /* A load due inside this block splits it at the exact frame */
+        size_t done = 0;
+        if (has_pending_ && pending_.at < frame_ + count) {
+            done = pending_.at > frame_ ? (size_t)(pending_.at - frame_) : 0;
+            render_span(out, done);
+            swap_source();
+        }
+        render_span(out + done * channels_, count - done);
+        publish();
+    }
+
+    double position() const { return position_.load(std::memory_order_relaxed); }
+    double duration() const { return duration_.load(std::memory_order_relaxed); }
+    double rate() const { return current_rate_.load(std::memory_order_relaxed); }
+    double gain() const { return current_gain_.load(std::memory_order_relaxed); }
+    bool locked() const { return locked_flag_.load(std::memory_order_relaxed); }
+    int source_rate() const { return source_rate_.load(std::memory_order_relaxed); }
+    uint64_t generation() const { return generation_.load(std::memory_order_relaxed); }
+    uint64_t oldest_in_use() const { return oldest_in_use_.load(std::memory_order_acquire); }
+    uint64_t rendered() const { return rendered_.load(std::memory_order_relaxed); }
+    uint64_t dropped() const { return dropped_.load(std::memory_order_relaxed); }
+    int channels() const { return channels_; }
+    int output_rate() const { return output_rate_; }
+
+private:
+    double coefficient(double ms) const
+    {
+        return ms > 0.0 ? 1.0 - std::exp(-1000.0 / (ms * output_rate_)) : 1.0;
+    }
+
+    void set_smoothing(double ms)
+    {
+        smoothing_coef_ = coefficient(ms);
+    }
+
+    void render_span(float *out, size_t count)
+    {
+        for (size_t n = 0; n < count; n++) {
+            if (locked_) {
+                /* Rate comes from the glide */
+            } else if (ramp_end_ > 0) {
+                /* Control point: straight line to its rate at its frame, then hold; slew-limited */
+                const uint64_t done = frame_ + n + 1;
+                double desired = target_rate_;
+                if (done < ramp_end_) {
+                    desired = ramp_from_ + (target_rate_ - ramp_from_) * (double)(done - ramp_start_) /
+                                           (double)(ramp_end_ - ramp_start_);
+                }
+                double step = desired - rate_;
+                if (max_slew_ > 0.0) {
+                    step = step > max_slew_ ? max_slew_ : (step < -max_slew_ ? -max_slew_ : step);
+                }
+                rate_ += step;
+            } else {
+                /* Per-sample one-pole smoothing towards the target rate (faster through a reversal) */
+                const double coef = target_rate_ * rate_ < 0.0 ? reverse_coef_ : smoothing_coef_;
+                rate_ += (target_rate_ - rate_) * coef;
+            }
+
+            float *frame = out + n * channels_;
+            read(src_, pos_, frame);
+            pos_ = advance(src_, pos_);
+
+            /* Position lock: straight line to the glide target, then hold there */
+            if (glide_left_ > 0 && --glide_left_ == 0) {
+                pos_ = glide_target_;
+                rate_ = 0.0;
+            }
+
+            if (fade_left_ > 0) {
+                float old[MAX_CHANNELS];
+                read(fade_src_, fade_pos_, old);
+                fade_pos_ = advance(fade_src_, fade_pos_);
+                const float gain = (float)fade_left_ / (crossfade_frames_ + 1);
+                for (int c = 0; c < channels_; c++) {
+                    frame[c] = frame[c] * (1.0f - gain) + old[c] * gain;
+                }
+                fade_left_--;
+            }
+
+            /* Channel gain, ramped */
+            if (gain_left_ > 0) {
+                gain_ = --gain_left_ == 0 ? target_gain_ : gain_ + gain_step_;
+            }
+            if (gain_ != 1.0f) {
+                for (int c = 0; c < channels_; c++) {
+                    frame[c] *= gain_;
+                }
+            }
+        }
+        frame_ += count;
+    }
+
+    void apply(const Command &cmd)
+    {
+        switch (cmd.type) {
+        case CMD_RATE:
+            /* Also releases a position lock; the rate is smoothed on from the glide's */
+            locked_ = false;
+            glide_left_ = 0;
+            ramp_end_ = 0;
+            target_rate_ = cmd.value;
+            if (cmd.arg >= 0.0) {
+                set_smoothing(cmd.arg);
+            }
+            break;
+        case CMD_RAMP:
+            /* From wherever the rate is now (a point arriving early cuts the last ramp short) */
+            locked_ = false;
+            glide_left_ = 0;
+            target_rate_ = cmd.value;
+            ramp_from_ = rate_;
+            ramp_start_ = frame_;
+            ramp_end_ = cmd.at > frame_ ? cmd.at : frame_ + 1;
+            max_slew_ = cmd.arg > 0.0 ? cmd.arg / output_rate_ : 0.0;
+            break;
+        case CMD_SEEK:
+            start_fade();
+            pos_ = clamp_position(src_, cmd.value * src_.rate);
+            glide_left_ = 0;
+            break;
+        case CMD_GLIDE:
+            locked_ = true;
+            glide_target_ = clamp_position(src_, cmd.value * src_.rate);
+            glide_left_ = cmd.arg < 1.0 ? 1 : (long)cmd.arg;
+            rate_ = (glide_target_ - pos_) / (glide_left_ * src_.step_scale);
+            break;
+        case CMD_GAIN:
+            target_gain_ = (float)cmd.value;
+            gain_left_ = cmd.arg < 1.0 ? 1 : (long)cmd.arg;
+            gain_step_ = (target_gain_ - gain_) / gain_left_;
+            break;
+        case CMD_LOAD:
+            /* A newer load replaces one still waiting */
+            pending_ = cmd;
+            has_pending_ = true;
+            if (cmd.at <= frame_) {
+                swap_source();
+            }
+            break;
+        }
+    }
+
+    void start_fade()
+    {
+        fade_src_ = src_;
+        fade_pos_ = pos_;
+        fade_left_ = crossfade_frames_;
+    }
+
+    void swap_source()
+    {
+        start_fade();
+        src_ = pending_.source;
+        pos_ = clamp_position(src_, pending_.value * src_.rate);
+        locked_ = false;
+        glide_left_ = 0;
+        has_pending_ = false;
+    }
+
+    /* Publish the state the control thread reads (once per block) */
+    void publish()
+    {
+        uint64_t oldest = src_.generation;
+        if (fade_left_ > 0 && fade_src_.generation < oldest) {
+            oldest = fade_src_.generation;
+        }
+        rendered_.store(frame_, std::memory_order_relaxed);
+        position_.store(pos_ / src_.rate, std::memory_order_relaxed);
+        duration_.store((double)src_.frames / src_.rate, std::memory_order_relaxed);
+        current_rate_.store(rate_, std::memory_order_relaxed);
+        current_gain_.store(gain_, std::memory_order_relaxed);
+        locked_flag_.store(locked_, std::memory_order_relaxed);
+        source_rate_.store(src_.rate, std::memory_order_relaxed);
+        generation_.store(src_.generation, std::memory_order_relaxed);
+        oldest_in_use_.store(oldest, std::memory_order_release);
+    }
+
+    static double clamp_position(const Source &src, double pos)
+    {
+        if (pos < 0.0) {
+            return 0.0;
+        }
+        return pos > (double)src.frames ? (double)src.frames : pos;
+    }
+
+    double advance(const Source &src, double pos) const
+    {
+        return clamp_position(src, pos + rate_ * src.step_scale);
+    }
+
+    /* Band-limited value of the source at a fractional frame position (silence outside) */
+    void read(const Source &src, double pos, float *frame) const
+    {
+        const double speed = std::fabs(rate_ * src.step_scale);
+        interpolate(kernels_[kernel_index(speed)], src.pcm, src.frames, channels_, pos, frame);
+    }
+
+    int channels_;
+    int output_rate_;
+    int crossfade_frames_;
+    const Kernel *kernels_;
+
+    SpscQueue<Command, 64> queue_;
+
+    /* Audio thread state */
+    Source src_;
+    uint64_t frame_ = 0;                /* Output frames rendered */
+    double pos_ = 0.0;                  /* Read head in source frames */
+    double rate_ = 1.0;
+    double target_rate_ = 1.0;
+    double smoothing_coef_ = 1.0;
+    double reverse_coef_ = 1.0;
+    double ramp_from_ = 1.0;            /* Rate automation: line from (ramp_start_, ramp_from_) */
+    uint64_t ramp_start_ = 0;
+    uint64_t ramp_end_ = 0;             /* Frame the line reaches target_rate_ (0 = smoothing) */
+    double max_slew_ = 0.0;             /* Max rate change per output frame (0 = none) */
+    Source fade_src_;                   /* Old source and read head during a crossfade */
+    double fade_pos_ = 0.0;
+    int fade_left_ = 0;
+    bool locked_ = false;               /* Position lock: rate_ comes from the glide */
+    double glide_target_ = 0.0;
+    long glide_left_ = 0;               /* Output frames until the head reaches glide_target_ */
+    float gain_ = 1.0f;
+    float target_gain_ = 1.0f;
+    float gain_step_ = 0.0f;
+    long gain_left_ = 0;                /* Output frames until gain_ reaches target_gain_ */
+    Command pending_ = {};              /* Load waiting for its frame */
+    bool has_pending_ = false;
+
+    /* Published for the control thread */
+    std::atomic<double> position_{0.0};     /* Seconds */
+    std::atomic<double> duration_{0.0};
+    std::atomic<double> current_rate_{1.0};
+    std::atomic<float> current_gain_{1.0f};
+    std::atomic<bool> locked_flag_{false};
+    std::atomic<int> source_rate_{0};
+    std::atomic<uint64_t> generation_{0};
+    std::atomic<uint64_t> oldest_in_use_{0};
+    std::atomic<uint64_t> rendered_{0};
+    std::atomic<uint64_t> dropped_{0};
+};
+
+/* ==================== DECK TYPE ==================== */
+
+/* A PCM buffer the engine may read, with the generation of its Source */
+struct HeldBuffer {
+    uint64_t generation;
+    Py_buffer view;             /* Keeps the PCM object alive and its memory pinned */
+};
+
+struct DeckObject {
+    PyObject_HEAD
+    Engine *engine;
+    std::vector<HeldBuffer> *held;
+    uint64_t next_generation;
+};
+
+/* Take a buffer of float32 frames; fills source (without a generation) */
+bool Deck_hold(PyObject *pcm, int channels, int sample_rate, Source &source,
+               Py_buffer &view)
+{
+    if (sample_rate <= 0) {
+        PyErr_SetString(PyExc_ValueError, "sample rates must be positive");
+        return false;
+    }
+    if (PyObject_GetBuffer(pcm, &view, PyBUF_C_CONTIGUOUS) < 0) {
+        return false;
+    }
+    const size_t frame_bytes = sizeof(float) * channels;
+    if (view.len % frame_bytes != 0) {
+        PyBuffer_Release(&view);
+        PyErr_Format(PyExc_ValueError, "pcm must be float32 frames of %d channels", channels);
+        return false;
+    }
+    source.pcm = static_cast<const float *>(view.buf);
+    source.frames = view.len / frame_bytes;
+    source.rate = sample_rate;
+    return true;
+}
+
+/* Release the buffers the audio thread has stopped reading (control thread: a release may unmap) */
+void Deck_release_retired(DeckObject *self)
+{
+    const uint64_t oldest = self->engine->oldest_in_use();
+    std::vector<HeldBuffer> &held = *self->held;
+    for (size_t i = 0; i < held.size();) {
+        if (held[i].generation < oldest) {
+            PyBuffer_Release(&held[i].view);
+            held.erase(held.begin() + i);
+        } else {
+            i++;
+        }
+    }
+}
+
+int Deck_init(DeckObject *self, PyObject *args, PyObject *kwds)
+{
+    static const char *kwlist[] = {"pcm", "channels", "sample_rate", "output_rate", "smoothing_ms",
+                                   "reverse_smoothing_ms", NULL};
+    PyObject *pcm = NULL;
+    int channels = 2;
+    int sample_rate = 48000;
+    int output_rate = 48000;
+    double smoothing_ms = 10.0;
+    double reverse_smoothing_ms = 1.0;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "O|iiidd", const_cast<char **>(kwlist),
+                                     &pcm, &channels, &sample_rate, &output_rate, &smoothing_ms,
+                                     &reverse_smoothing_ms)) {
+        return -1;
+    }
+    if (channels < 1 || channels > MAX_CHANNELS) {
+        PyErr_Format(PyExc_ValueError, "channels must be 1-%d", MAX_CHANNELS);
+        return -1;
+    }
+    if (output_rate <= 0) {
+        PyErr_SetString(PyExc_ValueError, "sample rates must be positive");
+        return -1;
+    }
+    if (self->engine != NULL) {
+        PyErr_SetString(PyExc_RuntimeError, "Deck is already initialised");
+        return -1;
+    }
+
+    Source source;
+    HeldBuffer buffer = {0, {}};
+    if (!Deck_hold(pcm, channels, sample_rate, source, buffer.view)) {
+        return -1;
+    }
+    source.step_scale = (double)sample_rate / output_rate;
+
+    self->held = new (std::nothrow) std::vector<HeldBuffer>{buffer};
+    self->engine = self->held == NULL ? NULL
+                   : new (std::nothrow) Engine(source, channels, output_rate, smoothing_ms,
+                                               reverse_smoothing_ms);
+    if (self->engine == NULL) {
+        delete self->held;
+        self->held = NULL;
+        PyBuffer_Release(&buffer.view);
+        PyErr_NoMemory();
+        return -1;
+    }
+    self->next_generation = 1;
+    return 0;
+}
+
+void Deck_dealloc(DeckObject *self)
+{
+    delete self->engine;
+    if (self->held != NULL) {
+        for (HeldBuffer &buffer : *self->held) {
+            PyBuffer_Release(&buffer.view);
+        }
+        delete self->held;
+    }
+    PyTypeObject *type = Py_TYPE(self);
+    type->tp_free((PyObject *)self);
+    Py_DECREF(type);
+}
+
+bool Deck_ready(DeckObject *self)
+{
+    if (self->engine == NULL) {
+        PyErr_SetString(PyExc_ValueError, "Deck is not initialised");
+        return false;
+    }
+    return true;
+}
+
+PyObject *Deck_load(DeckObject *self, PyObject *args, PyObject *kwds)
+{
+    static const char *kwlist[] = {"pcm", "sample_rate", "start", "at_frame", NULL};
+    PyObject *pcm = NULL;
+    int sample_rate = 48000;
+    double start = 0.0;
+    unsigned long long at_frame = 0;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "O|idK", const_cast<char **>(kwlist),
+                                     &pcm, &sample_rate, &start, &at_frame) || !Deck_ready(self)) {
+        return NULL;
+    }
+    Deck_release_retired(self);
+    Engine *engine = self->engine;
+    HeldBuffer buffer = {self->next_generation, {}};
+    Command cmd = {CMD_LOAD, start, 0.0, {}, at_frame};
+    if (!Deck_hold(pcm, engine->channels(), sample_rate, cmd.source, buffer.view)) {
+        return NULL;
+    }
+    cmd.source.step_scale = engine->step_scale(sample_rate);
+    cmd.source.generation = buffer.generation;
+
+    if (!engine->post(cmd)) {
+        PyBuffer_Release(&buffer.view);
+        Py_RETURN_FALSE;
+    }
+    self->held->push_back(buffer);
+    self->next_generation++;
+    Py_RETURN_TRUE;
+}
+
+PyObject *Deck_set_rate(DeckObject *self, PyObject *args, PyObject *kwds)
+{
+    static const char *kwlist[] = {"rate", "smoothing_ms", NULL};
+    double rate;
+    double smoothing_ms = -1.0;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "d|d", const_cast<char **>(kwlist),
+                                     &rate, &smoothing_ms) || !Deck_ready(self)) {
+        return NULL;
+    }
+    Deck_release_retired(self);
+    return PyBool_FromLong(self->engine->post({CMD_RATE, rate, smoothing_ms, {}, 0}));
+}
+
+PyObject *Deck_ramp_to(DeckObject *self, PyObject *args, PyObject *kwds)
+{
+    static const char *kwlist[] = {"rate", "at_frame", "max_slew", NULL};
+    double rate;
+    unsigned long long at_frame;
+    double max_slew = 0.0;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "dK|d", const_cast<char **>(kwlist),
+                                     &rate, &at_frame, &max_slew) || !Deck_ready(self)) {
+        return NULL;
+    }
+    Deck_release_retired(self);
+    return PyBool_FromLong(self->engine->post({CMD_RAMP, rate, max_slew, {}, (uint64_t)at_frame}));
+}
+
+PyObject *Deck_set_gain(DeckObject *self, PyObject *args, PyObject *kwds)
+{
+    static const char *kwlist[] = {"gain", "ramp_ms", NULL};
+    double gain;
+    double ramp_ms = 0.0;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "d|d", const_cast<char **>(kwlist),
+                                     &gain, &ramp_ms) || !Deck_ready(self)) {
+        return NULL;
+    }
+    return PyBool_FromLong(self->engine->post({CMD_GAIN, gain, ramp_ms * 0.001 * self->engine->output_rate(),
+                                               {}, 0}));
+}
+
+PyObject *Deck_seek(DeckObject *self, PyObject *arg)
+{
+    const double seconds = PyFloat_AsDouble(arg);
+    if ((seconds == -1.0 && PyErr_Occurred()) || !Deck_ready(self)) {
+        return NULL;
+    }
+    return PyBool_FromLong(self->engine->post({CMD_SEEK, seconds, 0.0, {}, 0}));
+}
+
+PyObject *Deck_glide_to(DeckObject *self, PyObject *args)
+{
+    double seconds, glide_ms;
+
+    if (!PyArg_ParseTuple(args, "dd", &seconds, &glide_ms) || !Deck_ready(self)) {
+        return NULL;
+    }
+    return PyBool_FromLong(self->engine->post({CMD_GLIDE, seconds, glide_ms * 0.001 * self->engine->output_rate(),
+                                               {}, 0}));
+}
+
+PyObject *Deck_render(DeckObject *self, PyObject *arg)
+{
+    const Py_ssize_t count = PyLong_AsSsize_t(arg);
+    if ((count == -1 && PyErr_Occurred()) || !Deck_ready(self)) {
+        return NULL;
+    }
+    if (count < 0) {
+        PyErr_SetString(PyExc_ValueError, "frame count must not be negative");
+        return NULL;
+    }
+
+    PyObject *out = PyBytes_FromStringAndSize(NULL, count * self->engine->channels() * sizeof(float));
+    if (out == NULL) {
+        return NULL;
+    }
+    float *samples = reinterpret_cast<float *>(PyBytes_AS_STRING(out));
+    Py_BEGIN_ALLOW_THREADS
+    self->engine->render(samples, count);
+    Py_END_ALLOW_THREADS
+    return out;
+}
+
+PyObject *Deck_render_into(DeckObject *self, PyObject *arg)
+{
+    Py_buffer view;
+
+    if (!Deck_ready(self) || PyObject_GetBuffer(arg, &view, PyBUF_WRITABLE | PyBUF_C_CONTIGUOUS) < 0) {
+        return NULL;
+    }
+    const size_t frame_bytes = sizeof(float) * self->engine->channels();
+    const size_t count = view.len / frame_bytes;
+    Py_BEGIN_ALLOW_THREADS
+    self->engine->render(static_cast<float *>(view.buf), count);
+    Py_END_ALLOW_THREADS
+    PyBuffer_Release(&view);
+    return PyLong_FromSize_t(count);
+}
+
+#define DECK_GETTER(name, expr)                                         \
+    PyObject *Deck_get_##name(DeckObject *self, void *c)                \
+    {                                                                   \
+        if (!Deck_ready(self)) {                                        \
+            return NULL;                                                \
+        }                                                               \
+        return (expr);                                                  \
+    }
+
+DECK_GETTER(position, PyFloat_FromDouble(self->engine->position()))
+DECK_GETTER(duration, PyFloat_FromDouble(self->engine->duration()))
+DECK_GETTER(rate, PyFloat_FromDouble(self->engine->rate()))
+DECK_GETTER(gain, PyFloat_FromDouble(self->engine->gain()))
+DECK_GETTER(locked, PyBool_FromLong(self->engine->locked()))
+DECK_GETTER(channels, PyLong_FromLong(self->engine->channels()))
+DECK_GETTER(sample_rate, PyLong_FromLong(self->engine->source_rate()))
+DECK_GETTER(output_rate, PyLong_FromLong(self->engine->output_rate()))
+DECK_GETTER(rendered_frames, PyLong_FromUnsignedLongLong(self->engine->rendered()))
+DECK_GETTER(commands_dropped, PyLong_FromUnsignedLongLong(self->engine->dropped()))
+DECK_GETTER(generation, PyLong_FromUnsignedLongLong(self->engine->generation()))
+DECK_GETTER(loads, PyLong_FromUnsignedLongLong(self->next_generation - 1))
+
+PyGetSetDef Deck_getset[] = {
+    {"position", (getter)Deck_get_position, NULL, "Read head after the last render (s)", NULL},
+    {"duration", (getter)Deck_get_duration, NULL, "Length of the PCM (s)", NULL},
+    {"rate", (getter)Deck_get_rate, NULL, "Smoothed rate after the last render", NULL},
+    {"gain", (getter)Deck_get_gain, NULL, "Channel gain after the last render", NULL},
+    {"locked", (getter)Deck_get_locked, NULL, "Position locked (glide_to) after the last render", NULL},
+    {"channels", (getter)Deck_get_channels, NULL, "Interleaved channels", NULL},
+    {"sample_rate", (getter)Deck_get_sample_rate, NULL, "PCM sample rate (Hz)", NULL},
+    {"output_rate", (getter)Deck_get_output_rate, NULL, "Rendered sample rate (Hz)", NULL},
+    {"rendered_frames", (getter)Deck_get_rendered_frames, NULL, "Frames rendered so far", NULL},
+    {"commands_dropped", (getter)Deck_get_commands_dropped, NULL, "Commands rejected by a full queue", NULL},
+    {"generation", (getter)Deck_get_generation, NULL, "Loads the audio thread has swapped in (0 = initial PCM)", NULL},
+    {"loads", (getter)Deck_get_loads, NULL, "Loads posted", NULL},
+    {NULL}
+};
+
+PyMethodDef Deck_methods[] = {
+    {"set_rate", (PyCFunction)(void (*)(void))Deck_set_rate, METH_VARARGS | METH_KEYWORDS,
+     "set_rate(rate, smoothing_ms=-1) - new target rate (smoothing_ms < 0 keeps the time constant); "
+     "False if the command queue is full"},
+    {"ramp_to", (PyCFunction)(void (*)(void))Deck_ramp_to, METH_VARARGS | METH_KEYWORDS,
+     "ramp_to(rate, at_frame, max_slew=0) - control point: reach rate when rendered_frames reaches "
+     "at_frame, interpolated per sample from the current rate and changing by at most max_slew per "
+     "second (0 = no limit); set_rate returns to smoothing. False if the command queue is full"},
+    {"set_gain", (PyCFunction)(void (*)(void))Deck_set_gain, METH_VARARGS | METH_KEYWORDS,
+     "set_gain(gain, ramp_ms=0) - channel gain, reached in a per-sample ramp over ramp_ms; "
+     "False if the command queue is full"},
+    {"seek", (PyCFunction)Deck_seek, METH_O,
+     "seek(seconds) - move the read head (5 ms crossfade); False if the command queue is full"},
+    {"glide_to", (PyCFunction)Deck_glide_to, METH_VARARGS,
+     "glide_to(seconds, glide_ms) - lock the read head to a position: move there in a straight line "
+     "over glide_ms and hold; set_rate releases the lock. False if the command queue is full"},
+    {"load", (PyCFunction)(void (*)(void))Deck_load, METH_VARARGS | METH_KEYWORDS,
+     "load(pcm, sample_rate=48000, start=0.0, at_frame=0) - play other PCM (same channels) from start "
+     "seconds once rendered_frames reaches at_frame (0 = next block), crossfaded; False if the queue is full"},
+    {"render", (PyCFunction)Deck_render, METH_O,
+     "render(frames) - next frames as float32 interleaved bytes (audio thread only)"},
+    {"render_into", (PyCFunction)Deck_render_into, METH_O,
+     "render_into(buffer) - fill a writable float32 buffer, returns the frames rendered"},
+    {NULL}
+};
+
+PyType_Slot Deck_slots[] = {
+    {Py_tp_doc, (void *)"Deck(pcm, channels=2, sample_rate=48000, output_rate=48000, smoothing_ms=10.0,\n"
+                        "     reverse_smoothing_ms=1.0)\n"
+                        "Variable-speed player over float32 interleaved PCM (kept referenced); "
+                        "negative rates play backwards"},
+    {Py_tp_new, (void *)PyType_GenericNew},
+    {Py_tp_init, (void *)Deck_init},
+    {Py_tp_dealloc, (void *)Deck_dealloc},
+    {Py_tp_methods, Deck_methods},
+    {Py_tp_getset, Deck_getset},
+    {0, NULL}
+};
+
+PyType_Spec Deck_spec = {
+    "deckengine.Deck",
+    sizeof(DeckObject),
+    0,
+    Py_TPFLAGS_DEFAULT,
+    Deck_slots,
+};
+
+/* ==================== SAMPLER ==================== */
+
+enum SamplerMode : uint8_t {
+    MODE_ONE_SHOT = 0,          /* Every trigger is a new voice, played to the end */
+    MODE_RETRIGGER = 1,         /* A trigger restarts the pad's voice */
+    MODE_GATE = 2,              /* A trigger starts the pad looping, the next one stops it */
+};
+
+enum SamplerCommandType : uint8_t {
+    SFX_TRIGGER = 1,
+    SFX_STOP = 2,
+};
+
+struct SamplerCommand {
+    SamplerCommandType type;
+    SamplerMode mode;
+    int pad;
+    float gain;
+    const float *pcm;
+    size_t frames;
+    uint64_t packet_ns;         /* CLOCK_MONOTONIC arrival of the triggering packet (0 = unknown) */
+};
+
+struct Voice {
+    int pad = -1;               /* -1 = idle */
+    const float *pcm = nullptr;
+    size_t frames = 0;
+    size_t pos = 0;
+    float gain = 1.0f;
+    bool loop = false;
+    int release_left = 0;       /* > 0: fading out */
+    uint64_t order = 0;         /* Trigger order: the oldest voice is stolen first */
+    uint64_t packet_ns = 0;     /* Set until the first sample is rendered */
+};
+
+constexpr int MAX_VOICES = 64;
+
+uint64_t monotonic_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+class Sampler {
+public:
+    Sampler(int channels, int output_rate, int polyphony, double release_ms)
+        : channels_(channels), output_rate_(output_rate), polyphony_(polyphony),
+          release_frames_(release_ms > 0.0 ? (int)(release_ms * 0.001 * output_rate) + 1 : 1),
+          voices_(2 * polyphony)    /* Room for as many releasing voices as playing ones */
+    {
+    }
+
+    /* ---- Trigger thread (one) ---- */
+
+    bool post(const SamplerCommand &cmd)
+    {
+        if (!queue_.push(cmd)) {
+            dropped_.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        return true;
+    }
+
+    /* Packet-to-first-sample delays, oldest first (any one thread) */
+    bool pop_latency(uint64_t &ns) { return latencies_.pop(ns); }
+
+    /* ---- Audio thread ---- */
+
+    void render(float *out, size_t count)
+    {
+        SamplerCommand cmd;
+        while (queue_.pop(cmd)) {
+            apply(cmd);
+        }
+
+        std::memset(out, 0, count * channels_ * sizeof(float));
+        const uint64_t now = monotonic_ns();
+        int playing = 0;
+        for (Voice &voice : voices_) {
+            if (voice.pad < 0) {
+                continue;
+            }
+            if (voice.packet_ns != 0) {
+                latencies_.push(now > voice.packet_ns ? now - voice.packet_ns : 0);
+                voice.packet_ns = 0;
+            }
+            mix(voice, out, count);
+            if (voice.pad >= 0 && voice.release_left == 0) {
+                playing++;
+            }
+        }
+        rendered_.store(rendered_.load(std::memory_order_relaxed) + count, std::memory_order_relaxed);
+        playing_.store(playing, std::memory_order_relaxed);
+    }
+
+    int playing() const { return playing_.load(std::memory_order_relaxed); }
+    uint64_t stolen() const { return stolen_.load(std::memory_order_relaxed); }
+    uint64_t rendered() const { return rendered_.load(std::memory_order_relaxed); }
+    uint64_t dropped() const { return dropped_.load(std::memory_order_relaxed); }
+    int channels() const { return channels_; }
+    int output_rate() const { return output_rate_; }
+    int polyphony() const { return polyphony_; }
+
+private:
+    void apply(const SamplerCommand &cmd)
+    {
+        switch (cmd.type) {
+        case SFX_TRIGGER:
+            if (cmd.mode != MODE_ONE_SHOT && release_pad(cmd.pad) && cmd.mode == MODE_GATE) {
+                break;      /* Second press of a gate: stop */
+            }
+            start(cmd);
+            break;
+        case SFX_STOP:
+            release_pad(cmd.pad);
+            break;
+        }
+    }
+
+    /* Fade out the pad's voices; true if one was playing */
+    bool release_pad(int pad)
+    {
+        bool found = false;
+        for (Voice &voice : voices_) {
+            if (voice.pad == pad && voice.release_left == 0) {
+                voice.release_left = release_frames_;
+                found = true;
+            }
+        }
+        return found;
+    }
+
+    void start(const SamplerCommand &cmd)
+    {
+        /* Over the limit: release the oldest playing voice */
+        Voice *oldest = nullptr;
+        int playing = 0;
+        for (Voice &voice : voices_) {
+            if (voice.pad >= 0 && voice.release_left == 0) {
+                playing++;
+                if (oldest == nullptr || voice.order < oldest->order) {
+                    oldest = &voice;
+                }
+            }
+        }
+        if (playing >= polyphony_ && oldest != nullptr) {
+            oldest->release_left = release_frames_;
+            stolen_.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        /* An idle voice, else cut the releasing voice closest to silence */
+        Voice *target = nullptr;
+        for (Voice &voice : voices_) {
+            if (voice.pad < 0) {
+                target = &voice;
+                break;
+            }
+            if (voice.release_left > 0 && (target == nullptr || voice.release_left < target->release_left)) {
+                target = &voice;
+            }
+        }
+        if (target == nullptr) {
+            return;
+        }
+        *target = Voice();
+        target->pad = cmd.pad;
+        target->pcm = cmd.pcm;
+        target->frames = cmd.frames;
+        target->gain = cmd.gain;
+        target->loop = cmd.mode == MODE_GATE;
+        target->order = ++order_;
+        target->packet_ns = cmd.packet_ns;
+    }
+
+    void mix(Voice &voice, float *out, size_t count)
+    {
+        for (size_t n = 0; n < count; n++) {
+            if (voice.pos >= voice.frames) {
+                if (!voice.loop || voice.frames == 0) {
+                    voice.pad = -1;
+                    return;
+                }
+                voice.pos = 0;
+            }
+            float gain = voice.gain;
+            if (voice.release_left > 0) {
+                gain *= (float)voice.release_left / (release_frames_ + 1);
+            }
+            const float *in = voice.pcm + voice.pos * channels_;
+            float *frame = out + n * channels_;
+            for (int c = 0; c < channels_; c++) {
+                frame[c] += gain * in[c];
+            }
+            voice.pos++;
+            if (voice.release_left > 0 && --voice.release_left == 0) {
+                voice.pad = -1;
+                return;
+            }
+        }
+    }
+
+    int channels_;
+    int output_rate_;
+    int polyphony_;
+    int release_frames_;
+
+    SpscQueue<SamplerCommand, 64> queue_;
+    SpscQueue<uint64_t, 256> latencies_;    /* Audio thread -> reader; full = dropped */
+
+    /* Audio thread state */
+    std::vector<Voice> voices_;
+    uint64_t order_ = 0;
+
+    /* Published */
+    std::atomic<int> playing_{0};
+    std::atomic<uint64_t> stolen_{0};
+    std::atomic<uint64_t> rendered_{0};
+    std::atomic<uint64_t> dropped_{0};
+};
+
+/* ==================== SAMPLER TYPE ==================== */
+
+struct SampleBuffer {
+    Py_buffer view;
+    size_t frames;
+    bool locked;                /* mlock succeeded */
+};
+
+struct SamplerObject {
+    PyObject_HEAD
+    Sampler *sampler;
+    std::vector<SampleBuffer> *samples;
+};
+
+int Sampler_init(SamplerObject *self, PyObject *args, PyObject *kwds)
+{
+    static const char *kwlist[] = {"channels", "output_rate", "voices", "release_ms", NULL};
+    int channels = 2;
+    int output_rate = 48000;
+    int voices = 8;
+    double release_ms = 2.0;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "|iiid", const_cast<char **>(kwlist),
+                                     &channels, &output_rate, &voices, &release_ms)) {
+        return -1;
+    }
+    if (channels < 1 || channels > MAX_CHANNELS) {
+        PyErr_Format(PyExc_ValueError, "channels must be 1-%d", MAX_CHANNELS);
+        return -1;
+    }
+    if (voices < 1 || voices > MAX_VOICES) {
+        PyErr_Format(PyExc_ValueError, "voices must be 1-%d", MAX_VOICES);
+        return -1;
+    }
+    if (output_rate <= 0) {
+        PyErr_SetString(PyExc_ValueError, "sample rates must be positive");
+        return -1;
+    }
+    if (self->sampler != NULL) {
+        PyErr_SetString(PyExc_RuntimeError, "Sampler is already initialised");
+        return -1;
+    }
+
+    self->samples = new (std::nothrow) std::vector<SampleBuffer>();
+    self->sampler = self->samples == NULL ? NULL
+                    : new (std::nothrow) Sampler(channels, output_rate, voices, release_ms);
+    if (self->sampler == NULL) {
+        delete self->samples;
+        self->samples = NULL;
+        PyErr_NoMemory();
+        return -1;
+    }
+    return 0;
+}
+
+void Sampler_dealloc(SamplerObject *self)
+{
+    delete self->sampler;
+    if (self->samples != NULL) {
+        for (SampleBuffer &sample : *self->samples) {
+            if (sample.locked) {
+                munlock(sample.view.buf, sample.view.len);
+            }
+            PyBuffer_Release(&sample.view);
+        }
+        delete self->samples;
+    }
+    PyTypeObject *type = Py_TYPE(self);
+    type->tp_free((PyObject *)self);
+    Py_DECREF(type);
+}
+
+bool Sampler_ready(SamplerObject *self)
+{
+    if (self->sampler == NULL) {
+        PyErr_SetString(PyExc_ValueError, "Sampler is not initialised");
+        return false;
+    }
+    return true;
+}
+
+PyObject *Sampler_add(SamplerObject *self, PyObject *pcm)
+{
+    if (!Sampler_ready(self)) {
+        return NULL;
+    }
+    SampleBuffer sample = {{}, 0, false};
+    if (PyObject_GetBuffer(pcm, &sample.view, PyBUF_C_CONTIGUOUS) < 0) {
+        return NULL;
+    }
+    const size_t frame_bytes = sizeof(float) * self->sampler->channels();
+    if (sample.view.len % frame_bytes != 0) {
+        PyBuffer_Release(&sample.view);
+        PyErr_Format(PyExc_ValueError, "pcm must be float32 frames of %d channels", self->sampler->channels());
+        return NULL;
+    }
+    sample.frames = sample.view.len / frame_bytes;
+    /* Best effort: needs RLIMIT_MEMLOCK room (or CAP_IPC_LOCK) */
+    sample.locked = sample.view.len > 0 && mlock(sample.view.buf, sample.view.len) == 0;
+    self->samples->push_back(sample);
+    return PyLong_FromSize_t(self->samples->size() - 1);
+}
+
+PyObject *Sampler_trigger(SamplerObject *self, PyObject *args, PyObject *kwds)
+{
+    static const char *kwlist[] = {"pad", "mode", "gain", "packet_ns", NULL};
+    int pad;
+    int mode = MODE_ONE_SHOT;
+    double gain = 1.0;
+    unsigned long long packet_ns = 0;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "i|idK", const_cast<char **>(kwlist),
+                                     &pad, &mode, &gain, &packet_ns) || !Sampler_ready(self)) {
+        return NULL;
+    }
+    if (pad < 0 || (size_t)pad >= self->samples->size()) {
+        PyErr_Format(PyExc_IndexError, "no sample on pad %d", pad);
+        return NULL;
+    }
+    if (mode < MODE_ONE_SHOT || mode > MODE_GATE) {
+        PyErr_SetString(PyExc_ValueError, "mode must be ONE_SHOT, RETRIGGER or GATE");
+        return NULL;
+    }
+    const SampleBuffer &sample = (*self->samples)[pad];
+    return PyBool_FromLong(self->sampler->post({SFX_TRIGGER, (SamplerMode)mode, pad, (float)gain,
+                                                static_cast<const float *>(sample.view.buf), sample.frames,
+                                                (uint64_t)packet_ns}));
+}
+
+PyObject *Sampler_stop(SamplerObject *self, PyObject *arg)
+{
+    const long pad = PyLong_AsLong(arg);
+    if ((pad == -1 && PyErr_Occurred()) || !Sampler_ready(self)) {
+        return NULL;
+    }
+    return PyBool_FromLong(self->sampler->post({SFX_STOP, MODE_ONE_SHOT, (int)pad, 0.0f, nullptr, 0, 0}));
+}
+
+PyObject *Sampler_latencies(SamplerObject *self, PyObject *unused)
+{
+    if (!Sampler_ready(self)) {
+        return NULL;
+    }
+    PyObject *list = PyList_New(0);
+    uint64_t ns;
+    while (list != NULL && self->sampler->pop_latency(ns)) {
+        PyObject *value = PyLong_FromUnsignedLongLong(ns);
+        if (value == NULL || PyList_Append(list, value) < 0) {
+            Py_XDECREF(value);
+            Py_CLEAR(list);
+            break;
+        }
+        Py_DECREF(value);
+    }
+    return list;
+}
+
+PyObject *Sampler_render(SamplerObject *self, PyObject *arg)
+{
+    const Py_ssize_t count = PyLong_AsSsize_t(arg);
+    if ((count == -1 && PyErr_Occurred()) || !Sampler_ready(self)) {
+        return NULL;
+    }
+    if (count < 0) {
+        PyErr_SetString(PyExc_ValueError, "frame count must not be negative");
+        return NULL;
+    }
+
+    PyObject *out = PyBytes_FromStringAndSize(NULL, count * self->sampler->channels() * sizeof(float));
+    if (out == NULL) {
+        return NULL;
+    }
+    float *samples = reinterpret_cast<float *>(PyBytes_AS_STRING(out));
+    Py_BEGIN_ALLOW_THREADS
+    self->sampler->render(samples, count);
+    Py_END_ALLOW_THREADS
+    return out;
+}
+
+PyObject *Sampler_render_into(SamplerObject *self, PyObject *arg)
+{
+    Py_buffer view;
+
+    if (!Sampler_ready(self) || PyObject_GetBuffer(arg, &view, PyBUF_WRITABLE | PyBUF_C_CONTIGUOUS) < 0) {
+        return NULL;
+    }
+    const size_t count = view.len / (sizeof(float) * self->sampler->channels());
+    Py_BEGIN_ALLOW_THREADS
+    self->sampler->render(static_cast<float *>(view.buf), count);
+    Py_END_ALLOW_THREADS
+    PyBuffer_Release(&view);
+    return PyLong_FromSize_t(count);
+}
+
+size_t Sampler_locked_bytes(SamplerObject *self)
+{
+    size_t bytes = 0;
+    for (const SampleBuffer &sample : *self->samples) {
+        bytes += sample.locked ? sample.view.len : 0;
+    }
+    return bytes;
+}
+
+#define SAMPLER_GETTER(name, expr)                                      \
+    PyObject *Sampler_get_##name(SamplerObject *self, void *c)          \
+    {                                                                   \
+        if (!Sampler_ready(self)) {                                     \
+            return NULL;                                                \
+        }                                                               \
+        return (expr);                                                  \
+    }
+
+SAMPLER_GETTER(pads, PyLong_FromSize_t(self->samples->size()))
+SAMPLER_GETTER(playing, PyLong_FromLong(self->sampler->playing()))
+SAMPLER_GETTER(voices, PyLong_FromLong(self->sampler->polyphony()))
+SAMPLER_GETTER(stolen, PyLong_FromUnsignedLongLong(self->sampler->stolen()))
+SAMPLER_GETTER(channels, PyLong_FromLong(self->sampler->channels()))
+SAMPLER_GETTER(output_rate, PyLong_FromLong(self->sampler->output_rate()))
+SAMPLER_GETTER(rendered_frames, PyLong_FromUnsignedLongLong(self->sampler->rendered()))
+SAMPLER_GETTER(commands_dropped, PyLong_FromUnsignedLongLong(self->sampler->dropped()))
+SAMPLER_GETTER(locked_bytes, PyLong_FromSize_t(Sampler_locked_bytes(self)))
+
+PyGetSetDef Sampler_getset[] = {
+    {"pads", (getter)Sampler_get_pads, NULL, "Samples added", NULL},
+    {"playing", (getter)Sampler_get_playing, NULL, "Voices playing after the last render (not fading out)", NULL},
+    {"voices", (getter)Sampler_get_voices, NULL, "Voice limit", NULL},
+    {"stolen", (getter)Sampler_get_stolen, NULL, "Voices released to make room for a new one", NULL},
+    {"channels", (getter)Sampler_get_channels, NULL, "Interleaved channels", NULL},
+    {"output_rate", (getter)Sampler_get_output_rate, NULL, "Rendered sample rate (Hz)", NULL},
+    {"rendered_frames", (getter)Sampler_get_rendered_frames, NULL, "Frames rendered so far", NULL},
+    {"commands_dropped", (getter)Sampler_get_commands_dropped, NULL, "Commands rejected by a full queue", NULL},
+    {"locked_bytes", (getter)Sampler_get_locked_bytes, NULL, "Sample memory locked in RAM (mlock)", NULL},
+    {NULL}
+};
+
+PyMethodDef Sampler_methods[] = {
+    {"add", (PyCFunction)Sampler_add, METH_O,
+     "add(pcm) - sample for the next pad (float32 interleaved at output_rate, kept referenced and "
+     "locked in RAM if allowed); returns the pad number. Add every sample before the first trigger"},
+    {"trigger", (PyCFunction)(void (*)(void))Sampler_trigger, METH_VARARGS | METH_KEYWORDS,
+     "trigger(pad, mode=ONE_SHOT, gain=1.0, packet_ns=0) - play a pad from the next block; packet_ns "
+     "(time.monotonic_ns() of the packet) is measured to the first rendered sample. One thread only; "
+     "False if the command queue is full"},
+    {"stop", (PyCFunction)Sampler_stop, METH_O,
+     "stop(pad) - fade out the pad's voices (same thread as trigger)"},
+    {"latencies", (PyCFunction)Sampler_latencies, METH_NOARGS,
+     "latencies() - packet-to-first-sample delays (ns) measured since the last call"},
+    {"render", (PyCFunction)Sampler_render, METH_O,
+     "render(frames) - next frames as float32 interleaved bytes (audio thread only)"},
+    {"render_into", (PyCFunction)Sampler_render_into, METH_O,
+     "render_into(buffer) - fill a writable float32 buffer, returns the frames rendered"},
+    {NULL}
+};
+
+PyType_Slot Sampler_slots[] = {
+    {Py_tp_doc, (void *)"Sampler(channels=2, output_rate=48000, voices=8, release_ms=2.0)\n"
+                        "Polyphonic player of short samples (SFX pads); beyond `voices` the oldest "
+                        "voice fades out over release_ms"},
+    {Py_tp_new, (void *)PyType_GenericNew},
+    {Py_tp_init, (void *)Sampler_init},
+    {Py_tp_dealloc, (void *)Sampler_dealloc},
+    {Py_tp_methods, Sampler_methods},
+    {Py_tp_getset, Sampler_getset},
+    {0, NULL}
+};
+
+PyType_Spec Sampler_spec = {
+    "deckengine.Sampler",
+    sizeof(SamplerObject),
+    0,
+    Py_TPFLAGS_DEFAULT,
+    Sampler_slots,
+};
+
+/* ==================== PCM CONVERSION ==================== */
+
+/*
+ * 16-bit interleaved PCM to float32 in the engine's layout: a mono source is copied to every
+ * output channel, a mono output averages the source channels, extra source channels are
+ * dropped, and the rate is converted with the playback kernels (as if played at rate 1.0).
+ */
+void convert_s16_frames(const int16_t *in, size_t frames, int channels, int rate, float *out,
+                        size_t out_frames, int out_channels, int out_rate)
+{
+    std::vector<float> mapped;
+    float *dst = out;
+    if (rate != out_rate) {
+        mapped.resize(frames * out_channels);
+        dst = mapped.data();
+    }
+
+    constexpr float scale = 1.0f / 32768.0f;
+    for (size_t n = 0; n < frames; n++) {
+        const int16_t *frame = in + n * channels;
+        float *mapped_frame = dst + n * out_channels;
+        if (out_channels == 1 && channels > 1) {
+            float sum = 0.0f;
+            for (int c = 0; c < channels; c++) {
+                sum += frame[c];
+            }
+            mapped_frame[0] = sum * scale / channels;
+        } else {
+            for (int c = 0; c < out_channels; c++) {
+                mapped_frame[c] = frame[channels == 1 ? 0 : c] * scale;
+            }
+        }
+    }
+
+    if (rate != out_rate) {
+        const double step = (double)rate / out_rate;
+        const Kernel &kernel = kernels()[kernel_index(step)];
+        for (size_t n = 0; n < out_frames; n++) {
+            interpolate(kernel, dst, frames, out_channels, n * step, out + n * out_channels);
+        }
+    }
+}
+
+PyObject *deckengine_convert_s16(PyObject *module, PyObject *args, PyObject *kwds)
+{
+    static const char *kwlist[] = {"pcm", "channels", "sample_rate", "out_channels", "out_rate", NULL};
+    Py_buffer view;
+    int channels, sample_rate;
+    int out_channels = 2;
+    int out_rate = 48000;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "y*ii|ii", const_cast<char **>(kwlist),
+                                     &view, &channels, &sample_rate, &out_channels, &out_rate)) {
+        return NULL;
+    }
+    const char *error = NULL;
+    if (channels < 1 || out_channels < 1 || out_channels > MAX_CHANNELS) {
+        error = "channels must be positive and out_channels 1-8";
+    } else if (channels < out_channels && channels != 1) {
+        error = "only a mono source can be spread over more channels";
+    } else if (sample_rate <= 0 || out_rate <= 0) {
+        error = "sample rates must be positive";
+    } else if (view.len % (sizeof(int16_t) * channels) != 0) {
+        error = "pcm must be 16-bit frames of `channels` channels";
+    }
+    if (error != NULL) {
+        PyBuffer_Release(&view);
+        PyErr_SetString(PyExc_ValueError, error);
+        return NULL;
+    }
+
+    const size_t frames = view.len / (sizeof(int16_t) * channels);
+    const size_t out_frames = sample_rate == out_rate ? frames
+                              : (size_t)((unsigned long long)frames * out_rate / sample_rate);
+    PyObject *out = PyBytes_FromStringAndSize(NULL, out_frames * out_channels * sizeof(float));
+    if (out == NULL) {
+        PyBuffer_Release(&view);
+        return NULL;
+    }
+    float *samples = reinterpret_cast<float *>(PyBytes_AS_STRING(out));
+    Py_BEGIN_ALLOW_THREADS
+    convert_s16_frames(static_cast<const int16_t *>(view.buf), frames, channels, sample_rate, samples,
+                       out_frames, out_channels, out_rate);
+    Py_END_ALLOW_THREADS
+    PyBuffer_Release(&view);
+    return out;
+}
+
+/* ==================== MODULE ==================== */
+
+PyMethodDef deckengine_methods[] = {
+    {"convert_s16", (PyCFunction)(void (*)(void))deckengine_convert_s16, METH_VARARGS | METH_KEYWORDS,
+     "convert_s16(pcm, channels, sample_rate, out_channels=2, out_rate=48000) - 16-bit interleaved "
+     "PCM as float32 interleaved bytes with out_channels at out_rate (converted without the GIL)"},
+    {NULL}
+};
+
+struct PyModuleDef deckengine_module = {
+    PyModuleDef_HEAD_INIT,
+    "deckengine",
+    "Native variable-speed deck playback (band-limited interpolation, lock-free rate commands) "
+    "and the SFX sampler",
+    -1,
+    deckengine_methods,
+};
+
+}  /* namespace */
+
+PyMODINIT_FUNC PyInit_deckengine(void)
+{
+    PyObject *module = PyModule_Create(&deckengine_module);
+    if (module == NULL) {
+        return NULL;
+    }
+
+    PyObject *deck_type = PyType_FromSpec(&Deck_spec);
+    if (deck_type == NULL || PyModule_AddObject(module, "Deck", deck_type) < 0) {
+        Py_XDECREF(deck_type);
+        Py_DECREF(module);
+        return NULL;
+    }
+
+    PyObject *sampler_type = PyType_FromSpec(&Sampler_spec);
+    if (sampler_type == NULL || PyModule_AddObject(module, "Sampler", sampler_type) < 0) {
+        Py_XDECREF(sampler_type);
+        Py_DECREF(module);
+        return NULL;
+    }
+
+    PyModule_AddIntConstant(module, "ONE_SHOT", MODE_ONE_SHOT);
+    PyModule_AddIntConstant(module, "RETRIGGER", MODE_RETRIGGER);
+    PyModule_AddIntConstant(module, "GATE", MODE_GATE);
+    PyModule_AddIntConstant(module, "TAPS", TAPS);
+    PyModule_AddIntConstant(module, "PHASES", PHASES);
+    kernels();      /* Build the kernel tables now rather than in the first render */
+    return module;
+}
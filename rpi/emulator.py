@@ -0,0 +1,387 @@
+#!/usr/bin/env python3
+"""
+ESP32 Emulator Module
+Software stand-in for the ESP32 I2C slave, so the RPi stack runs without the box:
+EmulatedBus replaces smbus2.SMBus and answers reads with the 27-byte data packet from comm.c,
+and EmulatedESP32 applies command frames with the same checks and acknowledgement rules.
+Platter physics (motor, inertia, hand), buttons and pots are driven by scripted scenarios.
+
+Usage:
+    python3 emulator.py [scenario]      # print the packets of a scenario
+    python3 mixer.py --emulate scratch  # run the mixer against the emulator
+"""
+
+import ctypes
+import errno
+import random
+import struct
+import sys
+import time
+from config import (
+    I2C_BUS, ESP32_DECK1_ADDR, BUTTON_NAMES, POTENTIOMETER_MAX,
+    CMD_COMMIT, CMD_CALIBRATION, CMD_MOTOR_SETPOINT, CMD_LED_PATTERN, CMD_LED_LEVEL,
+    CMD_LCD_TEXT, CMD_LCD_TITLE, CMD_LCD_STATUS, CALIBRATION_FORMAT, LCD_COLS,
+    EMU_COUNTS_PER_REV, EMU_ENCODER_DIRECTION, EMU_NORMAL_COUNTS_PER_SEC,
+    EMU_MOTOR_TAU_S, EMU_HAND_TAU_S, EMU_PHYSICS_STEP_S, EMU_POT_NOISE_COUNTS
+)
+
+# Data packet (comm.h): enc1_pos, enc1_vel_x100, enc2_pos, enc2_vel_x100, timestamp_ms,
+# button_flags, volume_pot, slider_pot, cmd_ack_seq, cmd_status
+PACKET_STRUCT = struct.Struct('<iiiiIBHHBB')
+
+# Command status (I2C_CMD_STATUS_* in comm.h)
+STATUS_OK = 0
+STATUS_UNKNOWN = 1
+STATUS_BAD_LENGTH = 2
+STATUS_BAD_ARG = 3
+STATUS_FAILED = 4
+STATUS_FRAMING = 5
+
+# Firmware limits mirrored by the command checks (leds.h, lcd.h, motors.h)
+NUM_LED_PATTERNS = 6
+LEDS_MIN_PERIOD_US = 100000
+LEDS_MAX_PERIOD_US = 2000000
+LCD_ROWS = 2
+NUM_MOTOR_DECKS = 1
+
+
+class Platter:
+    """
+    One platter and its encoder
+
+    The motor pulls the speed towards its target with a first-order lag (inertia); a hand on
+    the platter overrides the motor and drags it to the hand speed much faster.
+    """
+
+    def __init__(self, motor_counts_per_sec=EMU_NORMAL_COUNTS_PER_SEC):
+        self.position = 0.0             # Counts (fractional; the encoder reports the floor)
+        self.velocity = motor_counts_per_sec    # Counts/s (already up to speed)
+        self.motor_target = motor_counts_per_sec
+        self.hand = None                # Hand speed in counts/s, None = hand off
+
+    def step(self, dt):
+        remaining = dt
+        while remaining > 0:
+            h = min(remaining, EMU_PHYSICS_STEP_S)
+            if self.hand is not None:
+                self.velocity += (self.hand - self.velocity) * min(1.0, h / EMU_HAND_TAU_S)
+            else:
+                self.velocity += (self.motor_target - self.velocity) * min(1.0, h / EMU_MOTOR_TAU_S)
+            self.position += self.velocity * h
+            remaining -= h
+
+    @property
+    def count(self):
+        return int(self.position // 1)
+
+
+# Scenario events: (time_s, action, *args), replayed in order and repeated every `length` s
+#   ('motor', counts_per_sec[, deck])   motor target
+#   ('hand', counts_per_sec[, deck])    hand on the platter moving at this speed (0 = hold)
+#   ('release'[, deck])                 hand off, motor takes over again
+#   ('press', button_name)              button press (latched until the next read, like inputs.c)
+#   ('pot', 'volume' | 'slider', raw)   potentiometer position, 0-4095
+SCENARIOS = {
+    'idle': {
+        'length': 10.0,
+        'events': [],
+    },
+    'scratch': {
+        'length': 6.0,
+        'events': [
+            (2.0, 'hand', 0.0),
+            (2.4, 'hand', 300.0), (2.55, 'hand', -300.0),
+            (2.7, 'hand', 300.0), (2.85, 'hand', -300.0),
+            (3.0, 'hand', 150.0), (3.3, 'hand', -150.0),
+            (3.6, 'hand', 0.0),
+            (4.0, 'release'),
+        ],
+    },
+    'controls': {
+        'length': 8.0,
+        'events': [
+            (1.0, 'press', 'SFX_1'), (2.0, 'press', 'SFX_2'),
+            (3.0, 'pot', 'volume', 1024), (3.5, 'pot', 'volume', 2048),
+            (4.0, 'pot', 'slider', 0), (5.0, 'pot', 'slider', POTENTIOMETER_MAX),
+            (6.0, 'press', 'SONG_2'),
+            (7.0, 'pot', 'volume', POTENTIOMETER_MAX),
+        ],
+    },
+}
+
+
+class EmulatedESP32:
+    """
+    ESP32 slave state: two platters, latched buttons, pots and the command channel
+
+    All time comes from `clock` (seconds), so a scenario can run in real time or on a
+    VirtualClock as fast as the host allows.
+    """
+
+    def __init__(self, scenario='idle', clock=time.monotonic):
+        self.clock = clock
+        self.boot_time = clock()
+        self.platters = [Platter(), Platter(motor_counts_per_sec=0.0)]
+        self.button_flags = 0
+        self.pots = {'volume': POTENTIOMETER_MAX, 'slider': POTENTIOMETER_MAX // 2}
+        self.noise = random.Random(0)   # ADC noise, the same in every run
+
+        self.scenario = SCENARIOS[scenario] if isinstance(scenario, str) else scenario
+        self.event_index = 0
+        self.scenario_start = self.boot_time
+        self.last_step_time = self.boot_time
+
+        # Velocity is measured per read, like encoder_get_velocity() over the sample period
+        self.last_read_time = self.boot_time
+        self.last_read_counts = [0, 0]
+
+        # Command channel (comm.c)
+        self.cmd_ack_seq = 0
+        self.cmd_ack_status = STATUS_OK
+        self.cmd_pending_status = STATUS_OK
+        self.commands = []              # (cmd, payload) of every applied frame, for inspection
+        self.led_pattern = None
+        self.led_level = 0
+        self.lcd_rows = [' ' * LCD_COLS for _ in range(LCD_ROWS)]
+        self.lcd_title = ''
+        self.lcd_status = None
+
+    # ---------------- Simulation ----------------
+
+    def advance(self):
+        """Run scenario events and physics up to the current clock time"""
+        now = self.clock()
+        events = self.scenario['events']
+        length = self.scenario['length']
+
+        while True:
+            if self.event_index >= len(events):
+                # End of the script - wait for the next repetition
+                next_start = self.scenario_start + length
+                if now < next_start:
+                    break
+                self._step_to(next_start)
+                self.scenario_start = next_start
+                self.event_index = 0
+                if not events:
+                    continue
+            event_time = self.scenario_start + events[self.event_index][0]
+            if event_time > now:
+                break
+            self._step_to(event_time)
+            self._apply_event(events[self.event_index])
+            self.event_index += 1
+
+        self._step_to(now)
+
+    def _step_to(self, t):
+        dt = t - self.last_step_time
+        if dt > 0:
+            for platter in self.platters:
+                platter.step(dt)
+            self.last_step_time = t
+
+    def _apply_event(self, event):
+        action, args = event[1], event[2:]
+        if action == 'motor':
+            self.platters[args[1] if len(args) > 1 else 0].motor_target = args[0]
+        elif action == 'hand':
+            self.platters[args[1] if len(args) > 1 else 0].hand = args[0]
+        elif action == 'release':
+            self.platters[args[0] if args else 0].hand = None
+        elif action == 'press':
+            self.button_flags |= 1 << BUTTON_NAMES.index(args[0])
+        elif action == 'pot':
+            self.pots[args[0]] = max(0, min(POTENTIOMETER_MAX, int(args[1])))
+        else:
+            raise ValueError(f"Unknown scenario action '{action}'")
+
+    # ---------------- Bus side ----------------
+
+    def read_packet(self):
+        """Data packet for one master read (comm_update_data + the transmit)"""
+        self.advance()
+        now = self.clock()
+        dt = now - self.last_read_time
+
+        fields = []
+        for index, platter in enumerate(self.platters):
+            count = platter.count
+            velocity = (count - self.last_read_counts[index]) / dt if dt > 0 else 0.0
+            self.last_read_counts[index] = count
+            fields += [count, int(velocity * 100)]
+        self.last_read_time = now
+
+        pots = [max(0, min(POTENTIOMETER_MAX, self.pots[name] + self.noise.randint(-EMU_POT_NOISE_COUNTS,
+                                                                                    EMU_POT_NOISE_COUNTS)))
+                for name in ('volume', 'slider')]
+        packet = PACKET_STRUCT.pack(
+            *fields, int((now - self.boot_time) * 1000) & 0xFFFFFFFF,
+            self.button_flags, *pots,
+            self.cmd_ack_seq, self.cmd_ack_status)
+
+        # Button presses are latched until they have been sent once
+        self.button_flags = 0
+        return packet
+
+    def write(self, data):
+        """Apply the command frames of one master write (comm_process_commands)"""
+        self.advance()
+        offset = 0
+        while offset < len(data):
+            if offset + 2 > len(data) or offset + 2 + data[offset + 1] > len(data):
+                # Truncated frame - the rest of the write is dropped
+                status = STATUS_FRAMING
+                offset = len(data)
+            else:
+                cmd, length = data[offset], data[offset + 1]
+                payload = bytes(data[offset + 2:offset + 2 + length])
+                offset += 2 + length
+                status = self._handle_command(cmd, payload)
+
+            if status != STATUS_OK and self.cmd_pending_status == STATUS_OK:
+                self.cmd_pending_status = status
+
+    def _handle_command(self, cmd, payload):
+        length = len(payload)
+
+        if cmd == CMD_COMMIT:
+            if length != 1 or payload[0] == 0:
+                return STATUS_BAD_LENGTH
+            self.cmd_ack_status = self.cmd_pending_status
+            self.cmd_ack_seq = payload[0]
+            self.cmd_pending_status = STATUS_OK
+            return STATUS_OK
+
+        self.commands.append((cmd, payload))
+
+        if cmd == CMD_CALIBRATION:
+            if length != struct.calcsize(CALIBRATION_FORMAT):
+                return STATUS_BAD_LENGTH
+            return STATUS_OK
+
+        if cmd == CMD_MOTOR_SETPOINT:
+            if length != 3:
+                return STATUS_BAD_LENGTH
+            deck, rpm_x10 = struct.unpack('<Bh', payload)
+            if deck >= NUM_MOTOR_DECKS:
+                return STATUS_BAD_ARG
+            self.platters[deck].motor_target = (EMU_ENCODER_DIRECTION * rpm_x10 / 10.0 / 60.0
+                                                * EMU_COUNTS_PER_REV)
+            return STATUS_OK
+
+        if cmd == CMD_LED_PATTERN:
+            if length != 7:
+                return STATUS_BAD_LENGTH
+            pattern, phase, period_us = struct.unpack('<BHI', payload)
+            if pattern >= NUM_LED_PATTERNS or not LEDS_MIN_PERIOD_US <= period_us <= LEDS_MAX_PERIOD_US:
+                return STATUS_BAD_ARG
+            self.led_pattern = (pattern, phase, period_us)
+            return STATUS_OK
+
+        if cmd == CMD_LED_LEVEL:
+            if length != 1:
+                return STATUS_BAD_LENGTH
+            self.led_level = payload[0]
+            return STATUS_OK
+
+        if cmd == CMD_LCD_TEXT:
+            if length < 1 or length > 1 + LCD_COLS:
+                return STATUS_BAD_LENGTH
+            if payload[0] >= LCD_ROWS:
+                return STATUS_BAD_ARG
+            self.lcd_rows[payload[0]] = payload[1:].decode('ascii', 'replace').ljust(LCD_COLS)
+            return STATUS_OK
+
+        if cmd == CMD_LCD_TITLE:
+            if length > LCD_COLS:
+                return STATUS_BAD_LENGTH
+            self.lcd_title = payload.decode('ascii', 'replace')
+            return STATUS_OK
+
+        if cmd == CMD_LCD_STATUS:
+            if length != 6:
+                return STATUS_BAD_LENGTH
+            self.lcd_status = struct.unpack('<HhH', payload)
+            return STATUS_OK
+
+        return STATUS_UNKNOWN
+
+
+class EmulatedBus:
+    """
+    smbus2.SMBus drop-in with EmulatedESP32s attached
+
+    Only what the RPi code uses is provided: i2c_rdwr (reads and writes, several messages per
+    call like the I2C_RDWR ioctl) and close. An address with no device
+    raises the same OSError as a NACK on the real bus.
+    """
+    fd = None   # No kernel device - EncoderReader stays on the smbus2 path
+
+    def __init__(self, devices=None):
+        self.devices = dict(devices or {})
+
+    def _device(self, address):
+        device = self.devices.get(address)
+        if device is None:
+            raise OSError(errno.EREMOTEIO, "Remote I/O error")
+        return device
+
+    def i2c_rdwr(self, *msgs):
+        for msg in msgs:
+            device = self._device(msg.addr)
+            if msg.flags & 0x0001:      # I2C_M_RD
+                packet = device.read_packet()
+                ctypes.memmove(msg.buf, packet, min(len(packet), msg.len))
+            else:
+                device.write(bytes(msg))
+
+    def close(self):
+        pass
+
+
+class VirtualClock:
+    """Clock for EmulatedESP32 that only moves when told to (accelerated runs)"""
+
+    def __init__(self, start=0.0):
+        self.now = start
+
+    def __call__(self):
+        return self.now
+
+    def advance(self, seconds):
+        self.now += seconds
+
+
+def bus_factory(scenario='idle', addresses=(ESP32_DECK1_ADDR,), clock=time.monotonic):
+    """
+    Replacement for smbus2.SMBus(bus_id): I2C_BUS gets one EmulatedESP32 per address running
+    the scenario, other buses are empty
+    """
+    def open_bus(bus_id):
+        if bus_id != I2C_BUS:
+            return EmulatedBus()
+        return EmulatedBus({address: EmulatedESP32(scenario, clock) for address in addresses})
+    return open_bus
+
+
+def main():
+    """Print decoded packets of a scenario at 50 Hz of virtual time"""
+    name = sys.argv[1] if len(sys.argv) > 1 else 'scratch'
+    if name not in SCENARIOS:
+        print(f"Unknown scenario '{name}' (available: {', '.join(SCENARIOS)})")
+        return 1
+
+    clock = VirtualClock()
+    device = EmulatedESP32(name, clock)
+    for _ in range(int(SCENARIOS[name]['length'] / 0.02)):
+        clock.advance(0.02)
+        (enc1_pos, enc1_vel, _, _, timestamp, buttons, volume, slider,
+         _, _) = PACKET_STRUCT.unpack(device.read_packet())
+        print(f"t={timestamp:6d}ms  E1: {enc1_pos:6d} ({enc1_vel / 100.0:7.1f}/s)  "
+              f"buttons={buttons:06b}  vol={volume:4d}  sld={slider:4d}")
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,294 @@
+#!/usr/bin/env python3
+"""
+Deck Engine Module
+Connects the native deck playback engine (deckengine.cpp) to the GStreamer pipeline: the track
+is decoded once (into the memory-mapped track cache, trackcache.py, or into memory), and an
+appsrc pulls blocks rendered by the engine at the current rate. DeckEngineSource takes set_property("rate", ...) like the pitch element it replaces, so
+DJDeck drives either one - and unlike pitch it plays zero and negative rates (reverse), can
+lock the playhead to a position (glide_to, position-locked scratching) and can switch to
+another track while the pipeline runs (TrackLoader prepares it, load() swaps it in).
+
+Build the engine with:  python3 setup.py build_ext --inplace
+"""
+
+import os
+import threading
+import time
+import wave
+from tracing import tracer
+from config import (
+    ENGINE_SAMPLE_RATE, ENGINE_BLOCK_FRAMES, ENGINE_RATE_SMOOTHING_MS, ENGINE_REVERSE_SMOOTHING_MS,
+    TRACK_CACHE_DIR, TRACK_PREROLL_S, TRACK_LOADER_NICE, MAX_RATE_DELTA_PER_SEC
+)
+
+try:
+    import deckengine
+except ImportError:
+    deckengine = None
+
+
+def load_pcm(path, sample_rate=ENGINE_SAMPLE_RATE, channels=2):
+    """
+    Decode an audio file into memory, converted to sample_rate and channels whatever the source
+    has (16-bit WAV natively, everything else through GStreamer)
+
+    Returns:
+        tuple: (float32 interleaved PCM bytes, sample rate, channels)
+    """
+    if deckengine is not None and path.lower().endswith('.wav'):
+        pcm = _load_wav(path, sample_rate, channels)
+        if pcm is not None:
+            return pcm, sample_rate, channels
+
+    from gi.repository import Gst
+    pipeline = Gst.parse_launch(
+        f'filesrc name=src ! decodebin ! audioconvert ! audioresample ! '
+        f'audio/x-raw,format=F32LE,layout=interleaved,rate={sample_rate},channels={channels} ! '
+        f'appsink name=sink sync=false')
+    pipeline.get_by_name("src").set_property("location", path)
+    sink = pipeline.get_by_name("sink")
+    pipeline.set_state(Gst.State.PLAYING)
+
+    pcm = bytearray()
+    try:
+        while True:
+            sample = sink.emit("pull-sample")
+            if sample is None:
+                break
+            buffer = sample.get_buffer()
+            pcm += buffer.extract_dup(0, buffer.get_size())
+    finally:
+        pipeline.set_state(Gst.State.NULL)
+
+    if not pcm:
+        raise RuntimeError(f"could not decode {path}")
+    return bytes(pcm), sample_rate, channels
+
+
+def open_pcm(path):
+    """
+    Decoded PCM of a track: mapped from the track cache when TRACK_CACHE_DIR is set (decoded
+    into it on first use), else decoded into memory
+
+    Returns:
+        tuple: (float32 interleaved PCM buffer, sample rate, channels)
+    """
+    if TRACK_CACHE_DIR:
+        from trackcache import open_track
+        try:
+            track = open_track(path, TRACK_CACHE_DIR)
+            return track.pcm, track.sample_rate, track.channels
+        except OSError as e:
+            print(f"Track cache unavailable ({e}), decoding {path} into memory")
+    return load_pcm(path)
+
+
+def _load_wav(path, sample_rate, channels):
+    """
+    16-bit PCM WAV without GStreamer: converted by the deck engine with the GIL released, so a
+    hot load does not hold up the streaming threads. None for other WAV formats (float, 24-bit,
+    compressed), which load_pcm decodes through GStreamer.
+    """
+    try:
+        with wave.open(path, 'rb') as f:
+            if f.getsampwidth() != 2:
+                return None
+            data = f.readframes(f.getnframes())
+            source_rate, source_channels = f.getframerate(), f.getnchannels()
+    except wave.Error:
+        return None
+    return deckengine.convert_s16(data, source_channels, source_rate, channels, sample_rate)
+
+
+class TrackLoader:
+    """
+    Prepares a track for a running deck on a background thread
+
+    The track is decoded or mapped (open_pcm) and the pages after the start position are
+    touched, so the first blocks after the swap do not wait for the disk. on_ready(loader) is
+    then called through post (GLib.idle_add in the mixer) - on the control thread, the only one
+    that may send commands to the deck engine.
+    """
+
+    def __init__(self, path, start_s=0.0, on_ready=None, post=None):
+        self.path = path
+        self.start_s = start_s
+        self.on_ready = on_ready
+        self.post = post
+        self.pcm = None
+        self.sample_rate = None
+        self.channels = None
+        self.error = None
+        self.ready = False
+        self.load_s = None          # Request to ready (decode or map + pre-roll)
+        self.thread = threading.Thread(target=self._run, name="trackloader", daemon=True)
+
+    def start(self):
+        self.thread.start()
+        return self
+
+    def _run(self):
+        start = time.perf_counter()
+        try:
+            # Below the streaming threads (Linux: per thread), so a decode never delays a block
+            os.setpriority(os.PRIO_PROCESS, threading.get_native_id(), TRACK_LOADER_NICE)
+        except (AttributeError, OSError):
+            pass
+        try:
+            self.pcm, self.sample_rate, self.channels = open_pcm(self.path)
+            frame_bytes = 4 * self.channels
+            first = int(self.start_s * self.sample_rate) * frame_bytes
+            memoryview(self.pcm)[first:first + int(TRACK_PREROLL_S * self.sample_rate) * frame_bytes].tobytes()
+        except Exception as e:
+            self.error = e
+        self.load_s = time.perf_counter() - start
+        self.ready = True
+        if self.on_ready is not None:
+            if self.post is not None:
+                self.post(self._notify)
+            else:
+                self.on_ready(self)
+
+    def _notify(self):
+        self.on_ready(self)
+        return False    # GLib: run once
+
+
+class EngineDeck:
+    """
+    Rate control of a deckengine.Deck with the pitch element's interface, without GStreamer
+    (DeckEngineSource adds the appsrc; tests and benchmarks render the deck themselves)
+    """
+
+    supports_reverse = True
+    supports_position = True
+
+    def __init__(self, pcm, sample_rate, channels=2, output_rate=ENGINE_SAMPLE_RATE):
+        self.deck = deckengine.Deck(pcm, channels, sample_rate, output_rate, ENGINE_RATE_SMOOTHING_MS,
+                                    ENGINE_REVERSE_SMOOTHING_MS)
+        self.output_rate = output_rate
+        self.channels = channels
+        self.rate = 1.0
+
+        # Latency tracing: the trace of the packet being handled (control thread), then of its
+        # command until a block is rendered with it
+        self.trace = None
+        self.pending_trace = None
+
+    @property
+    def position(self):
+        """Playhead (s) as of the last rendered block"""
+        return self.deck.position
+
+    def schedule_rate(self, rate, after_s):
+        """
+        Rate control point: reach `rate` after_s seconds of output from now, in a per-sample
+        ramp from the current rate (slew-limited to MAX_RATE_DELTA_PER_SEC)
+        """
+        self.rate = rate
+        self.deck.ramp_to(rate, self.deck.rendered_frames + max(1, int(after_s * self.output_rate)),
+                          MAX_RATE_DELTA_PER_SEC)
+        self._command_sent()
+
+    def _command_sent(self):
+        """Stamp the traced packet's command (after it is queued, so the render that takes it sees it)"""
+        trace = self.trace
+        if trace is not None:
+            trace.command_ns = time.monotonic_ns()
+            self.trace = None
+            self.pending_trace = trace
+
+    def render(self, frames):
+        """Next frames as float32 bytes (audio thread only); completes the last command's trace"""
+        trace = self.pending_trace
+        if trace is not None:
+            self.pending_trace = None
+            tracer.applied(trace, time.monotonic_ns())
+        return self.deck.render(frames)
+
+    def set_gain(self, gain, ramp_ms):
+        """Channel gain (faders x crossfader), ramped to per sample over ramp_ms"""
+        self.deck.set_gain(gain, ramp_ms)
+
+    def glide_to(self, seconds, glide_ms):
+        """Lock the playhead: reach `seconds` in a straight line over glide_ms, then hold"""
+        self.rate = None
+        self.deck.glide_to(seconds, glide_ms)
+        self._command_sent()
+
+    def load(self, loader, at_s=None):
+        """
+        Swap in a track prepared by a TrackLoader (crossfaded), at output time at_s (seconds of
+        audio this deck has rendered; None = the next block)
+
+        Returns:
+            bool: False if the engine's command queue is full
+        """
+        if loader.channels != self.channels:
+            raise ValueError(f"{loader.path}: {loader.channels} channels, the deck plays {self.channels}")
+        at_frame = 0 if at_s is None else max(1, int(at_s * self.output_rate))
+        return self.deck.load(loader.pcm, loader.sample_rate, loader.start_s, at_frame)
+
+    @property
+    def output_time(self):
+        """Seconds of audio rendered so far (the clock load(at_s=...) counts in)"""
+        return self.deck.rendered_frames / self.output_rate
+
+    def set_property(self, name, value):
+        """Same interface as the pitch element for "rate" (which also releases a position lock)"""
+        if name != "rate":
+            raise AttributeError(f"EngineDeck has no property '{name}'")
+        self.rate = value
+        self.deck.set_rate(value)
+        self._command_sent()
+
+    def get_property(self, name):
+        if name != "rate":
+            raise AttributeError(f"EngineDeck has no property '{name}'")
+        return self.rate
+
+
+class DeckEngineSource(EngineDeck):
+    """
+    appsrc fed by a deckengine.Deck
+
+    The appsrc asks for data from its streaming thread; each request renders one block of
+    ENGINE_BLOCK_FRAMES (the GIL is released while rendering). Rate changes go through the
+    engine's command queue and are smoothed per sample, so they take effect within one block.
+    """
+
+    def __init__(self, name, pcm, sample_rate, channels=2, output_rate=ENGINE_SAMPLE_RATE):
+        from gi.repository import Gst
+        super().__init__(pcm, sample_rate, channels, output_rate)
+        self.Gst = Gst
+        self.frames_pushed = 0
+
+        self.appsrc = Gst.ElementFactory.make("appsrc", name)
+        self.appsrc.set_property("caps", Gst.Caps.from_string(
+            f"audio/x-raw,format=F32LE,layout=interleaved,rate={output_rate},channels={channels}"))
+        self.appsrc.set_property("format", Gst.Format.TIME)
+        self.appsrc.set_property("max-bytes", 2 * ENGINE_BLOCK_FRAMES * channels * 4)
+        self.appsrc.connect("need-data", self._on_need_data)
+
+    @classmethod
+    def from_file(cls, name, path):
+        pcm, sample_rate, channels = open_pcm(path)
+        return cls(name, pcm, sample_rate, channels)
+
+    def _on_need_data(self, appsrc, length):
+        Gst = self.Gst
+        buffer = Gst.Buffer.new_wrapped(self.render(ENGINE_BLOCK_FRAMES))
+        buffer.pts = self.frames_pushed * Gst.SECOND // self.output_rate
+        buffer.duration = ENGINE_BLOCK_FRAMES * Gst.SECOND // self.output_rate
+        self.frames_pushed += ENGINE_BLOCK_FRAMES
+        appsrc.emit("push-buffer", buffer)
+
+    def set_property(self, name, value):
+        """Same interface as the pitch element for "rate"; anything else goes to the appsrc"""
+        if name == "rate":
+            super().set_property(name, value)
+        else:
+            self.appsrc.set_property(name, value)
+
+    def get_property(self, name):
+        return self.rate if name == "rate" else self.appsrc.get_property(name)
@@ -0,0 +1,217 @@
+#!/usr/bin/env python3
+"""
+Event Log Module
+Logging for the control path that never blocks on terminal I/O: emit() packs a binary record
+(timestamp, message id, key, up to MAX_ARGS numbers) into a preallocated ring and returns; a
+background writer thread formats the records and writes them in batches
+
+Messages are declared once with a category and a format string. Categories are selected at
+runtime (config LOG_CATEGORIES, mixer.py --log, log.set_categories()), and a message can be
+rate limited per key - the next line that gets through reports how many were suppressed.
+
+LOG_MODE / mixer.py --log-mode:
+    async   records in the ring, written by the writer thread (default)
+    print   formatted and written by the caller, like print() (to measure the difference)
+    off     nothing is logged
+"""
+
+import atexit
+import struct
+import sys
+import threading
+import time
+from config import LOG_MODE, LOG_CATEGORIES, LOG_RING_SIZE, LOG_FLUSH_MS
+
+MAX_ARGS = 4
+
+# t_ns (since the log was created), message id, key, suppressed count, args
+RECORD_STRUCT = struct.Struct('<QHHI' + 'd' * MAX_ARGS)
+CATEGORIES = ('state', 'rate', 'volume', 'cal', 'i2c', 'timing', 'error')
+
+
+class Message:
+    """A log message declared with EventLog.message()"""
+
+    def __init__(self, message_id, category, fmt, min_interval_ms):
+        self.id = message_id
+        self.category = category
+        self.fmt = fmt
+        self.min_interval_ns = int(min_interval_ms * 1_000_000)
+        self.enabled = False
+
+
+class EventLog:
+    """
+    Multi-producer ring of binary log records and the thread that writes them
+
+    Producers (GLib main loop, acquisition thread) reserve a slot under a short lock; the
+    writer copies out everything published so far and formats it outside the lock. A full ring
+    drops the new record and counts it, so a stalled terminal can never stall a producer.
+    """
+
+    def __init__(self, mode=LOG_MODE, categories=LOG_CATEGORIES, capacity=LOG_RING_SIZE,
+                 flush_ms=LOG_FLUSH_MS, stream=None):
+        self.capacity = capacity
+        self.buffer = bytearray(RECORD_STRUCT.size * capacity)
+        self.texts = [None] * capacity      # Optional str per slot (rare messages only)
+        self.head = 0                       # Records written out (writer)
+        self.tail = 0                       # Records published (producers)
+        self.lock = threading.Lock()
+        self.dropped = 0
+        self.reported_dropped = 0
+
+        self.messages = []
+        self.limits = {}                    # (message id, key) -> [next allowed ns, suppressed]
+        self.categories = set()
+        self.start_ns = time.monotonic_ns()
+        self.mode = mode
+        self.flush_s = flush_ms / 1000.0
+        self.stream = stream
+        self.thread = None
+        self.wake = threading.Event()
+        self.running = False
+        self.set_categories(categories)
+
+    def message(self, category, fmt, min_interval_ms=0):
+        """
+        Declare a message
+
+        Args:
+            category: One of CATEGORIES
+            fmt: str.format() template; positional fields are the numeric args, {key} the key
+                 and {text} the optional text
+            min_interval_ms: At most one line per key this often (0 = no limit)
+        """
+        if category not in CATEGORIES:
+            raise ValueError(f"unknown log category '{category}'")
+        message = Message(len(self.messages), category, fmt, min_interval_ms)
+        message.enabled = category in self.categories
+        self.messages.append(message)
+        return message
+
+    def set_categories(self, categories):
+        """Select categories: an iterable, or a comma-separated string ('all', 'none')"""
+        if isinstance(categories, str):
+            categories = [c.strip() for c in categories.split(',') if c.strip()]
+        if 'all' in categories:
+            categories = CATEGORIES
+        elif 'none' in categories:
+            categories = ()
+        unknown = set(categories) - set(CATEGORIES)
+        if unknown:
+            raise ValueError(f"unknown log categories: {', '.join(sorted(unknown))} "
+                             f"(available: {', '.join(CATEGORIES)})")
+        self.categories = set(categories)
+        for message in self.messages:
+            message.enabled = message.category in self.categories
+
+    def emit(self, message, *args, key=0, text=None):
+        """Log one message (numeric args only - formatting happens on the writer thread)"""
+        if not message.enabled or self.mode == 'off':
+            return
+        now = time.monotonic_ns()
+
+        suppressed = 0
+        if message.min_interval_ns:
+            limit = self.limits.get((message.id, key))
+            if limit is None:
+                limit = self.limits[(message.id, key)] = [0, 0]
+            if now < limit[0]:
+                limit[1] += 1
+                return
+            suppressed = limit[1]
+            limit[0] = now + message.min_interval_ns
+            limit[1] = 0
+
+        if self.mode == 'print':
+            self._write([self._format(message, now - self.start_ns, key, suppressed, args, text)])
+            return
+
+        if len(args) < MAX_ARGS:
+            args = args + (0.0,) * (MAX_ARGS - len(args))
+        with self.lock:
+            tail = self.tail
+            if tail - self.head >= self.capacity:
+                self.dropped += 1
+                return
+            slot = tail % self.capacity
+            RECORD_STRUCT.pack_into(self.buffer, slot * RECORD_STRUCT.size, now - self.start_ns,
+                                    message.id, key, suppressed, *args)
+            self.texts[slot] = text
+            self.tail = tail + 1
+
+        if self.thread is None:
+            self.start()
+        elif tail + 1 - self.head >= self.capacity // 2:
+            self.wake.set()
+
+    def _format(self, message, t_ns, key, suppressed, args, text):
+        line = f"[{t_ns / 1e9:9.3f}] " + message.fmt.format(*args, key=key, text=text)
+        if suppressed:
+            line += f" (+{suppressed} suppressed)"
+        return line
+
+    def _write(self, lines):
+        stream = self.stream or sys.stdout
+        try:
+            stream.write("\n".join(lines) + "\n")
+            stream.flush()
+        except (OSError, ValueError):
+            pass
+
+    def flush(self):
+        """Format and write every published record (writer thread, or the caller on stop)"""
+        with self.lock:
+            head, tail = self.head, self.tail
+            if head == tail and self.dropped == self.reported_dropped:
+                return
+            # Copy the published slots out so producers are only held up for a memcpy
+            size = RECORD_STRUCT.size
+            first, count = head % self.capacity, tail - head
+            if first + count <= self.capacity:
+                data = bytes(self.buffer[first * size:(first + count) * size])
+                texts = self.texts[first:first + count]
+            else:
+                data = bytes(self.buffer[first * size:]) + bytes(self.buffer[:(first + count - self.capacity) * size])
+                texts = self.texts[first:] + self.texts[:first + count - self.capacity]
+            for index in range(first, first + count):
+                self.texts[index % self.capacity] = None
+            self.head = tail
+            dropped = self.dropped - self.reported_dropped
+            self.reported_dropped = self.dropped
+
+        lines = []
+        for index, record in enumerate(RECORD_STRUCT.iter_unpack(data)):
+            t_ns, message_id, key, suppressed = record[:4]
+            lines.append(self._format(self.messages[message_id], t_ns, key, suppressed,
+                                      record[4:], texts[index]))
+        if dropped:
+            lines.append(f"log: {dropped} records dropped (ring full)")
+        self._write(lines)
+
+    def start(self):
+        """Start the writer thread (done by the first async emit)"""
+        if self.thread is not None:
+            return
+        self.running = True
+        self.thread = threading.Thread(target=self._run, name="eventlog", daemon=True)
+        self.thread.start()
+
+    def _run(self):
+        while self.running:
+            self.wake.wait(self.flush_s)
+            self.wake.clear()
+            self.flush()
+
+    def stop(self):
+        """Stop the writer thread and write what is left"""
+        if self.thread is not None:
+            self.running = False
+            self.wake.set()
+            self.thread.join()
+            self.thread = None
+        self.flush()
+
+
+log = EventLog()
+atexit.register(log.stop)
@@ -0,0 +1,66 @@
+#!/usr/bin/env python3
+"""
+Fader Module
+Crossfader curves and pot dezippering: the slider pot becomes a crossfader and the volume pot a
+master or channel level. Deck gains are ramped per sample by the deck engine (the pitch
+fallback can only step its audiomixer pad volume).
+"""
+
+import math
+from config import POTENTIOMETER_MAX, POTENTIOMETER_DEADZONE, POT_HYSTERESIS, CROSSFADER_CUT_WIDTH
+
+CURVES = ('linear', 'constant-power', 'cut')
+
+
+def crossfade_gains(position, curve, cut_width=CROSSFADER_CUT_WIDTH):
+    """
+    Deck gains at a crossfader position
+
+    Args:
+        position: 0.0 = deck 1 only, 1.0 = deck 2 only
+        curve: 'linear', 'constant-power' (same loudness all the way across for unrelated
+               tracks) or 'cut' (both at full level except within cut_width of either end)
+
+    Returns:
+        tuple: (deck 1 gain, deck 2 gain)
+    """
+    if curve == 'linear':
+        return 1.0 - position, position
+    if curve == 'constant-power':
+        return math.cos(position * math.pi / 2), math.sin(position * math.pi / 2)
+    if curve == 'cut':
+        return min(1.0, (1.0 - position) / cut_width), min(1.0, position / cut_width)
+    raise ValueError(f"unknown crossfader curve '{curve}' (one of {', '.join(CURVES)})")
+
+
+class PotFilter:
+    """
+    A 12-bit pot reading as a 0.0-1.0 level that only moves when the pot does
+
+    ADC noise moves the raw reading by several counts from one packet to the next; the level
+    follows only when the reading leaves +-hysteresis counts around the last one it accepted.
+    Within the deadzone of either end the level is exactly 0.0 or 1.0, so full cut and full
+    level are reachable through the noise.
+    """
+
+    def __init__(self, hysteresis=POT_HYSTERESIS, deadzone=POTENTIOMETER_DEADZONE, full_scale=POTENTIOMETER_MAX):
+        self.hysteresis = hysteresis
+        self.deadzone = deadzone
+        self.full_scale = full_scale
+        self.counts = None      # Last accepted raw reading
+        self.value = None
+
+    def update(self, counts):
+        """
+        Returns:
+            float: New level, or None if it has not changed
+        """
+        if self.counts is not None and abs(counts - self.counts) <= self.hysteresis:
+            return None
+        self.counts = counts
+        value = (counts - self.deadzone) / (self.full_scale - 2 * self.deadzone)
+        value = max(0.0, min(1.0, value))
+        if value == self.value:
+            return None
+        self.value = value
+        return value
@@ -0,0 +1,463 @@
+/*
+ * fasti2c - native read path for the ESP32 data packet
+ *
+ * Opens /dev/i2c-N once, reads the 27-byte packet with a single I2C_RDWR ioctl into a
+ * preallocated buffer and decodes it into one reusable Packet record. Nothing is allocated per
+ * read; the record's fields are available as attributes or through the buffer protocol
+ * (struct.unpack(PACKET_FORMAT, packet), numpy.frombuffer, or a memoryview kept across reads).
+ *
+ * Build in place:  python3 setup.py build_ext --inplace
+ * Used by EncoderReader in i2c.py when importable; the pure Python path stays as the fallback.
+ */
+
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+#include <structmember.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+#include <linux/i2c.h>
+#include <linux/i2c-dev.h>
+
+/* ==================== PACKET LAYOUT ==================== */
+
+/* Wire layout (little-endian, matching comm.h) */
+#define PACKET_SIZE         27
+#define OFF_ENC1_POS        0
+#define OFF_ENC1_VEL        4
+#define OFF_ENC2_POS        8
+#define OFF_ENC2_VEL        12
+#define OFF_TIMESTAMP       16
+#define OFF_BUTTONS         20
+#define OFF_VOLUME          21
+#define OFF_SLIDER          23
+#define OFF_CMD_ACK_SEQ     25
+#define OFF_CMD_STATUS      26
+
+/* Decoded record, native byte order - exported through the buffer protocol */
+typedef struct {
+    int32_t enc1_position;
+    int32_t enc1_velocity_x100;
+    int32_t enc2_position;
+    int32_t enc2_velocity_x100;
+    uint32_t timestamp;
+    uint16_t volume_pot;
+    uint16_t slider_pot;
+    uint8_t button_flags;
+    uint8_t cmd_ack_seq;
+    uint8_t cmd_status;
+    uint8_t reserved;
+} packet_t;
+
+#define PACKET_FORMAT       "=iiiiIHHBBBx"
+
+static uint32_t le32(const uint8_t *p)
+{
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static uint16_t le16(const uint8_t *p)
+{
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static void packet_decode(packet_t *rec, const uint8_t *raw)
+{
+    rec->enc1_position = (int32_t)le32(&raw[OFF_ENC1_POS]);
+    rec->enc1_velocity_x100 = (int32_t)le32(&raw[OFF_ENC1_VEL]);
+    rec->enc2_position = (int32_t)le32(&raw[OFF_ENC2_POS]);
+    rec->enc2_velocity_x100 = (int32_t)le32(&raw[OFF_ENC2_VEL]);
+    rec->timestamp = le32(&raw[OFF_TIMESTAMP]);
+    rec->button_flags = raw[OFF_BUTTONS];
+    rec->volume_pot = le16(&raw[OFF_VOLUME]);
+    rec->slider_pot = le16(&raw[OFF_SLIDER]);
+    rec->cmd_ack_seq = raw[OFF_CMD_ACK_SEQ];
+    rec->cmd_status = raw[OFF_CMD_STATUS];
+    rec->reserved = 0;
+}
+
+/* ==================== PACKET TYPE ==================== */
+
+typedef struct {
+    PyObject_HEAD
+    packet_t rec;
+    Py_ssize_t shape;       /* Always 1 - one record per buffer */
+} PacketObject;
+
+static PyTypeObject PacketType;
+
+static PyObject *Packet_new(PyTypeObject *type, PyObject *args, PyObject *kwds)
+{
+    PacketObject *self = (PacketObject *)type->tp_alloc(type, 0);
+    if (self != NULL) {
+        memset(&self->rec, 0, sizeof(self->rec));
+        self->shape = 1;
+    }
+    return (PyObject *)self;
+}
+
+static int Packet_getbuffer(PyObject *obj, Py_buffer *view, int flags)
+{
+    PacketObject *self = (PacketObject *)obj;
+
+    if (flags & PyBUF_WRITABLE) {
+        PyErr_SetString(PyExc_BufferError, "Packet is read-only");
+        return -1;
+    }
+
+    /* Plain byte consumers (bytes(), struct.unpack) get the record as unsigned bytes */
+    if (!(flags & PyBUF_FORMAT)) {
+        return PyBuffer_FillInfo(view, obj, &self->rec, sizeof(self->rec), 1, flags);
+    }
+
+    view->obj = Py_NewRef(obj);
+    view->buf = &self->rec;
+    view->len = sizeof(self->rec);
+    view->readonly = 1;
+    view->itemsize = sizeof(self->rec);
+    view->format = PACKET_FORMAT;
+    view->ndim = 1;
+    view->shape = &self->shape;
+    view->strides = (flags & PyBUF_STRIDES) ? &view->itemsize : NULL;
+    view->suboffsets = NULL;
+    view->internal = NULL;
+    return 0;
+}
+
+static PyBufferProcs Packet_as_buffer = {
+    .bf_getbuffer = Packet_getbuffer,
+};
+
+#define PACKET_INT_GETTER(name, expr)                                   \
+    static PyObject *Packet_get_##name(PacketObject *self, void *c)    \
+    {                                                                   \
+        return PyLong_FromLong((long)(expr));                           \
+    }
+
+PACKET_INT_GETTER(enc1_position, self->rec.enc1_position)
+PACKET_INT_GETTER(enc2_position, self->rec.enc2_position)
+PACKET_INT_GETTER(button_flags, self->rec.button_flags)
+PACKET_INT_GETTER(volume_pot, self->rec.volume_pot)
+PACKET_INT_GETTER(slider_pot, self->rec.slider_pot)
+PACKET_INT_GETTER(cmd_ack_seq, self->rec.cmd_ack_seq)
+PACKET_INT_GETTER(cmd_status, self->rec.cmd_status)
+
+static PyObject *Packet_get_timestamp(PacketObject *self, void *c)
+{
+    return PyLong_FromUnsignedLong(self->rec.timestamp);
+}
+
+static PyObject *Packet_get_enc1_velocity_raw(PacketObject *self, void *c)
+{
+    return PyFloat_FromDouble(self->rec.enc1_velocity_x100 / 100.0);
+}
+
+static PyObject *Packet_get_enc2_velocity_raw(PacketObject *self, void *c)
+{
+    return PyFloat_FromDouble(self->rec.enc2_velocity_x100 / 100.0);
+}
+
+static PyObject *Packet_astuple(PacketObject *self, PyObject *unused)
+{
+    /* Same order as EncoderReader.read_raw_data() */
+    return Py_BuildValue("(idid" "kiII)",
+                         (int)self->rec.enc1_position, self->rec.enc1_velocity_x100 / 100.0,
+                         (int)self->rec.enc2_position, self->rec.enc2_velocity_x100 / 100.0,
+                         (unsigned long)self->rec.timestamp, (int)self->rec.button_flags,
+                         (unsigned int)self->rec.volume_pot, (unsigned int)self->rec.slider_pot);
+}
+
+static PyObject *Packet_copy(PacketObject *self, PyObject *unused)
+{
+    PacketObject *copy = (PacketObject *)Packet_new(&PacketType, NULL, NULL);
+    if (copy != NULL) {
+        copy->rec = self->rec;
+    }
+    return (PyObject *)copy;
+}
+
+static PyGetSetDef Packet_getset[] = {
+    {"enc1_position", (getter)Packet_get_enc1_position, NULL, "Encoder 1 position (counts)", NULL},
+    {"enc1_velocity_raw", (getter)Packet_get_enc1_velocity_raw, NULL, "Encoder 1 velocity from the ESP32 (counts/s)", NULL},
+    {"enc2_position", (getter)Packet_get_enc2_position, NULL, "Encoder 2 position (counts)", NULL},
+    {"enc2_velocity_raw", (getter)Packet_get_enc2_velocity_raw, NULL, "Encoder 2 velocity from the ESP32 (counts/s)", NULL},
+    {"timestamp", (getter)Packet_get_timestamp, NULL, "ESP32 timestamp (ms)", NULL},
+    {"button_flags", (getter)Packet_get_button_flags, NULL, "Button bit field", NULL},
+    {"volume_pot", (getter)Packet_get_volume_pot, NULL, "Volume pot (0-4095)", NULL},
+    {"slider_pot", (getter)Packet_get_slider_pot, NULL, "Slider pot (0-4095)", NULL},
+    {"cmd_ack_seq", (getter)Packet_get_cmd_ack_seq, NULL, "Last acknowledged command commit", NULL},
+    {"cmd_status", (getter)Packet_get_cmd_status, NULL, "Status of that commit", NULL},
+    {NULL}
+};
+
+static PyMethodDef Packet_methods[] = {
+    {"astuple", (PyCFunction)Packet_astuple, METH_NOARGS,
+     "Fields in EncoderReader.read_raw_data() order"},
+    {"copy", (PyCFunction)Packet_copy, METH_NOARGS,
+     "Independent copy (the record returned by Device.read() is overwritten by the next read)"},
+    {NULL}
+};
+
+static PyTypeObject PacketType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    .tp_name = "fasti2c.Packet",
+    .tp_doc = "Decoded ESP32 data packet (reused between reads)",
+    .tp_basicsize = sizeof(PacketObject),
+    .tp_flags = Py_TPFLAGS_DEFAULT,
+    .tp_new = Packet_new,
+    .tp_getset = Packet_getset,
+    .tp_methods = Packet_methods,
+    .tp_as_buffer = &Packet_as_buffer,
+};
+
+/* ==================== DEVICE TYPE ==================== */
+
+typedef struct {
+    PyObject_HEAD
+    int fd;
+    int owns_fd;
+    uint16_t address;
+    uint8_t raw[PACKET_SIZE];
+    struct i2c_msg msg;
+    struct i2c_rdwr_ioctl_data xfer;
+    PacketObject *packet;
+    uint8_t *loopback;          /* Fake device: packet returned instead of the ioctl */
+    unsigned long long reads;
+    unsigned long long errors;
+} DeviceObject;
+
+static void Device_close_fd(DeviceObject *self)
+{
+    if (self->owns_fd && self->fd >= 0) {
+        close(self->fd);
+    }
+    self->fd = -1;
+    self->owns_fd = 0;
+}
+
+static int Device_init(DeviceObject *self, PyObject *args, PyObject *kwds)
+{
+    static char *kwlist[] = {"bus", "address", "fd", "loopback", NULL};
+    int bus = -1;
+    int address = 0;
+    int fd = -1;
+    Py_buffer loopback = {0};
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "ii|$iy*", kwlist,
+                                     &bus, &address, &fd, &loopback)) {
+        return -1;
+    }
+
+    /* The descriptor, loopback packet and Packet record are set up once per object */
+    if (self->packet != NULL || self->fd >= 0 || self->loopback != NULL) {
+        PyBuffer_Release(&loopback);
+        PyErr_SetString(PyExc_RuntimeError, "Device is already initialised");
+        return -1;
+    }
+
+    if (address < 0 || address > 0x7F) {
+        PyBuffer_Release(&loopback);
+        PyErr_SetString(PyExc_ValueError, "address must be a 7-bit I2C address");
+        return -1;
+    }
+
+    if (loopback.buf != NULL) {
+        if (loopback.len != PACKET_SIZE) {
+            PyBuffer_Release(&loopback);
+            PyErr_Format(PyExc_ValueError, "loopback packet must be %d bytes", PACKET_SIZE);
+            return -1;
+        }
+        self->loopback = PyMem_Malloc(PACKET_SIZE);
+        if (self->loopback == NULL) {
+            PyBuffer_Release(&loopback);
+            PyErr_NoMemory();
+            return -1;
+        }
+        memcpy(self->loopback, loopback.buf, PACKET_SIZE);
+        PyBuffer_Release(&loopback);
+    } else if (fd >= 0) {
+        /* Share the descriptor of an open smbus2.SMBus */
+        self->fd = fd;
+        self->owns_fd = 0;
+    } else {
+        char path[32];
+        snprintf(path, sizeof(path), "/dev/i2c-%d", bus);
+        self->fd = open(path, O_RDWR | O_CLOEXEC);
+        if (self->fd < 0) {
+            PyErr_SetFromErrnoWithFilename(PyExc_OSError, path);
+            return -1;
+        }
+        self->owns_fd = 1;
+    }
+
+    self->address = (uint16_t)address;
+    self->msg.addr = self->address;
+    self->msg.flags = I2C_M_RD;
+    self->msg.len = PACKET_SIZE;
+    self->msg.buf = self->raw;
+    self->xfer.msgs = &self->msg;
+    self->xfer.nmsgs = 1;
+
+    self->packet = (PacketObject *)Packet_new(&PacketType, NULL, NULL);
+    if (self->packet == NULL) {
+        Device_close_fd(self);
+        return -1;
+    }
+    return 0;
+}
+
+static PyObject *Device_new(PyTypeObject *type, PyObject *args, PyObject *kwds)
+{
+    DeviceObject *self = (DeviceObject *)type->tp_alloc(type, 0);
+    if (self != NULL) {
+        self->fd = -1;
+    }
+    return (PyObject *)self;
+}
+
+static void Device_dealloc(DeviceObject *self)
+{
+    Device_close_fd(self);
+    PyMem_Free(self->loopback);
+    Py_XDECREF(self->packet);
+    Py_TYPE(self)->tp_free((PyObject *)self);
+}
+
+static PyObject *Device_read(DeviceObject *self, PyObject *unused)
+{
+    int ret;
+
+    if (self->loopback != NULL) {
+        memcpy(self->raw, self->loopback, PACKET_SIZE);
+        ret = 1;
+    } else if (self->fd < 0) {
+        PyErr_SetString(PyExc_ValueError, "device is closed");
+        return NULL;
+    } else {
+        /* Release the GIL so an acquisition thread does not stall the rest of the process */
+        Py_BEGIN_ALLOW_THREADS
+        ret = ioctl(self->fd, I2C_RDWR, &self->xfer);
+        Py_END_ALLOW_THREADS
+    }
+
+    if (ret < 0) {
+        self->errors++;
+        return PyErr_SetFromErrno(PyExc_OSError);
+    }
+
+    packet_decode(&self->packet->rec, self->raw);
+    self->reads++;
+    return Py_NewRef((PyObject *)self->packet);
+}
+
+static PyObject *Device_set_loopback(DeviceObject *self, PyObject *arg)
+{
+    Py_buffer data;
+
+    if (self->loopback == NULL) {
+        PyErr_SetString(PyExc_ValueError, "not a loopback device");
+        return NULL;
+    }
+    if (PyObject_GetBuffer(arg, &data, PyBUF_SIMPLE) < 0) {
+        return NULL;
+    }
+    if (data.len != PACKET_SIZE) {
+        PyBuffer_Release(&data);
+        PyErr_Format(PyExc_ValueError, "loopback packet must be %d bytes", PACKET_SIZE);
+        return NULL;
+    }
+    memcpy(self->loopback, data.buf, PACKET_SIZE);
+    PyBuffer_Release(&data);
+    Py_RETURN_NONE;
+}
+
+static PyObject *Device_close(DeviceObject *self, PyObject *unused)
+{
+    Device_close_fd(self);
+    Py_RETURN_NONE;
+}
+
+static PyObject *Device_get_raw(DeviceObject *self, void *c)
+{
+    /* Read-only view of the last raw packet (no copy) */
+    return PyMemoryView_FromMemory((char *)self->raw, PACKET_SIZE, PyBUF_READ);
+}
+
+static PyObject *Device_get_packet(DeviceObject *self, void *c)
+{
+    return Py_NewRef((PyObject *)self->packet);
+}
+
+static PyMemberDef Device_members[] = {
+    {"address", T_USHORT, offsetof(DeviceObject, address), READONLY, "7-bit I2C address"},
+    {"reads", T_ULONGLONG, offsetof(DeviceObject, reads), READONLY, "Successful reads"},
+    {"errors", T_ULONGLONG, offsetof(DeviceObject, errors), READONLY, "Failed reads"},
+    {NULL}
+};
+
+static PyGetSetDef Device_getset[] = {
+    {"raw", (getter)Device_get_raw, NULL, "Last raw packet (memoryview)", NULL},
+    {"packet", (getter)Device_get_packet, NULL, "The reused Packet record", NULL},
+    {NULL}
+};
+
+static PyMethodDef Device_methods[] = {
+    {"read", (PyCFunction)Device_read, METH_NOARGS,
+     "Read and decode one packet; returns the reused Packet, raises OSError on bus errors"},
+    {"set_loopback", (PyCFunction)Device_set_loopback, METH_O,
+     "Replace the packet a loopback device returns"},
+    {"close", (PyCFunction)Device_close, METH_NOARGS, "Close the bus if this device opened it"},
+    {NULL}
+};
+
+static PyTypeObject DeviceType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    .tp_name = "fasti2c.Device",
+    .tp_doc = "Device(bus, address, *, fd=-1, loopback=None) - ESP32 packet reader.\n\n"
+              "fd shares an already open bus (smbus2.SMBus.fd); loopback is a 27-byte packet\n"
+              "returned by every read instead of touching the bus (benchmarks, emulation).",
+    .tp_basicsize = sizeof(DeviceObject),
+    .tp_flags = Py_TPFLAGS_DEFAULT,
+    .tp_new = Device_new,
+    .tp_init = (initproc)Device_init,
+    .tp_dealloc = (destructor)Device_dealloc,
+    .tp_members = Device_members,
+    .tp_getset = Device_getset,
+    .tp_methods = Device_methods,
+};
+
+/* ==================== MODULE ==================== */
+
+static struct PyModuleDef fasti2c_module = {
+    PyModuleDef_HEAD_INIT,
+    .m_name = "fasti2c",
+    .m_doc = "Allocation-free I2C read path for the ESP32 data packet",
+    .m_size = -1,
+};
+
+PyMODINIT_FUNC PyInit_fasti2c(void)
+{
+    if (PyType_Ready(&PacketType) < 0 || PyType_Ready(&DeviceType) < 0) {
+        return NULL;
+    }
+
+    PyObject *m = PyModule_Create(&fasti2c_module);
+    if (m == NULL) {
+        return NULL;
+    }
+
+    if (PyModule_AddObjectRef(m, "Packet", (PyObject *)&PacketType) < 0 ||
+        PyModule_AddObjectRef(m, "Device", (PyObject *)&DeviceType) < 0 ||
+        PyModule_AddIntConstant(m, "PACKET_SIZE", PACKET_SIZE) < 0 ||
+        PyModule_AddStringConstant(m, "PACKET_FORMAT", PACKET_FORMAT) < 0) {
+        Py_DECREF(m);
+        return NULL;
+    }
+
+    return m;
+}
@@ -12,10 +12,31 @@ import struct
 import time
 from collections import deque
 from config import (
-    DATA_PACKET_SIZE, VELOCITY_WINDOW_SIZE, DEBUG_PRINT_I2C,
+    DATA_PACKET_SIZE, VELOCITY_WINDOW_SIZE, LOG_REPEAT_MS,
     ENCODER_PPR, VELOCITY_PREDICTION, VELOCITY_TIMEOUT_MS,
-    BUTTON_NAMES, POTENTIOMETER_MIN, POTENTIOMETER_MAX
+    BUTTON_NAMES, POTENTIOMETER_MIN, POTENTIOMETER_MAX,
+    CMD_CALIBRATION, CALIBRATION_FORMAT, CALIBRATION_VERSION,
+    CMD_COMMIT, CMD_MOTOR_SETPOINT, CMD_LED_PATTERN, CMD_LCD_TEXT, CMD_LED_LEVEL,
+    CMD_LCD_TITLE, CMD_LCD_STATUS,
+    CMD_STATUS_NAMES, CMD_ACK_TIMEOUT_S, CMD_ACK_POLL_MS, LCD_COLS, USE_NATIVE_I2C,
+    VELOCITY_ESTIMATORS, LSQ_WINDOW_MS, LSQ_MIN_WINDOW_MS, LSQ_CHANGE_COUNTS, LSQ_OUTLIER_COUNTS
 )
+from eventlog import log
+
+# Bus messages (eventlog.py) - key is the I2C address
+MSG_READ_ERROR = log.message('i2c', "Error reading I2C from 0x{key:02X}: {text}", LOG_REPEAT_MS)
+MSG_WRITE_ERROR = log.message('i2c', "Error writing command to 0x{key:02X}: {text}")
+MSG_CMD_REJECTED = log.message('i2c', "0x{key:02X}: command {0:.0f} rejected: {text}")
+MSG_CMD_TIMEOUT = log.message('i2c', "0x{key:02X}: command {0:.0f} not acknowledged within {1:.0f} ms")
+
+# Native read path (fasti2c.c) - optional, the smbus2 path below is the fallback
+try:
+    import fasti2c
+except ImportError:
+    fasti2c = None
+
+# Data packet layout for the Python path (matching comm.h, little-endian, 27 bytes)
+PACKET_STRUCT = struct.Struct('<iiiiIBHHBB')
 
 class PredictiveVelocityTracker:
     """
@@ -42,7 +63,8 @@ class PredictiveVelocityTracker:
         Returns:
             float: Predicted velocity in counts/second
         """
-        current_time_ms = time.time() * 1000  # Get actual system time
+        # ESP32 time rather than host time, so replayed sessions give the same result every run
+        current_time_ms = timestamp
 
         # First reading - initialize
         if self.last_position is None:
@@ -131,12 +153,164 @@ class EncoderSmoother:
         self.last_velocity = 0.0
 
 
+class LeastSquaresVelocityEstimator:
+    """
+    Velocity from a least-squares fit of position over a sliding time window
+
+    Running sums of t^k and t^k * x are updated as samples enter and leave the window, so an
+    update costs the same whatever the window length. order=1 fits a line (velocity = slope),
+    order=2 a parabola (velocity = its slope at the newest sample, follows acceleration).
+
+    A sample further than change_counts from the fit shrinks the window to min_window_ms, so
+    a reversal is followed within a few samples instead of a full window. A sample further
+    than outlier_counts is held back and dropped unless the next sample confirms it.
+    """
+    REBASE_S = 10.0     # Re-reference times after this long to keep the sums well conditioned
+
+    def __init__(self, order=1, window_ms=LSQ_WINDOW_MS, min_window_ms=LSQ_MIN_WINDOW_MS,
+                 change_counts=LSQ_CHANGE_COUNTS, outlier_counts=LSQ_OUTLIER_COUNTS):
+        self.order = order
+        self.window_s = window_ms / 1000.0
+        self.min_window_s = min_window_ms / 1000.0
+        self.change_counts = change_counts
+        self.outlier_counts = outlier_counts
+        self.reset()
+
+    def reset(self):
+        """Reset the estimator"""
+        self.samples = deque()          # (t, x) relative to t_ref / x_ref
+        self.t_ref = None
+        self.x_ref = 0
+        # n, sum t, t^2, t^3, t^4, sum x, t*x, t^2*x
+        self.s0 = self.s1 = self.s2 = self.s3 = self.s4 = 0.0
+        self.x0 = self.x1 = self.x2 = 0.0
+        self.suspect = None
+        self.last_velocity = 0.0
+
+    def _accumulate(self, t, x, sign):
+        t2 = t * t
+        self.s0 += sign
+        self.s1 += sign * t
+        self.s2 += sign * t2
+        self.s3 += sign * t2 * t
+        self.s4 += sign * t2 * t2
+        self.x0 += sign * x
+        self.x1 += sign * t * x
+        self.x2 += sign * t2 * x
+
+    def _push(self, t, x):
+        self.samples.append((t, x))
+        self._accumulate(t, x, 1)
+
+    def _drop_before(self, t_min):
+        while self.samples and self.samples[0][0] < t_min:
+            self._accumulate(*self.samples.popleft(), -1)
+
+    def _rebase(self, t_abs, x_abs):
+        """Move the reference to the oldest sample and recompute the sums (rare, O(window))"""
+        samples = [(t + self.t_ref, x + self.x_ref) for t, x in self.samples]
+        self.t_ref, self.x_ref = (samples[0] if samples else (t_abs, x_abs))
+        self.s0 = self.s1 = self.s2 = self.s3 = self.s4 = 0.0
+        self.x0 = self.x1 = self.x2 = 0.0
+        self.samples.clear()
+        for t, x in samples:
+            self._push(t - self.t_ref, x - self.x_ref)
+
+    def _fit(self):
+        """Polynomial coefficients (a, b, c) of the current window, None if underdetermined"""
+        n = self.s0
+        if self.order == 2 and n >= 3:
+            # Normal equations [s0 s1 s2; s1 s2 s3; s2 s3 s4] [a b c] = [x0 x1 x2], Cramer's rule
+            s0, s1, s2, s3, s4 = self.s0, self.s1, self.s2, self.s3, self.s4
+            det = s0 * (s2 * s4 - s3 * s3) - s1 * (s1 * s4 - s3 * s2) + s2 * (s1 * s3 - s2 * s2)
+            if abs(det) > 1e-12:
+                x0, x1, x2 = self.x0, self.x1, self.x2
+                a = (x0 * (s2 * s4 - s3 * s3) - s1 * (x1 * s4 - s3 * x2) + s2 * (x1 * s3 - s2 * x2)) / det
+                b = (s0 * (x1 * s4 - x2 * s3) - x0 * (s1 * s4 - s3 * s2) + s2 * (s1 * x2 - x1 * s2)) / det
+                c = (s0 * (s2 * x2 - s3 * x1) - s1 * (s1 * x2 - s2 * x1) + x0 * (s1 * s3 - s2 * s2)) / det
+                return a, b, c
+        if n >= 2:
+            det = n * self.s2 - self.s1 * self.s1
+            if det > 1e-12:
+                b = (n * self.x1 - self.s1 * self.x0) / det
+                return (self.x0 - b * self.s1) / n, b, 0.0
+        return None
+
+    def update(self, position, timestamp):
+        """
+        Add a position sample and return the fitted velocity
+
+        Args:
+            position: Current encoder position (counts)
+            timestamp: Current timestamp (milliseconds)
+
+        Returns:
+            float: Velocity in counts/second
+        """
+        t_abs = timestamp / 1000.0
+        if self.t_ref is None:
+            self.t_ref, self.x_ref = t_abs, position
+        if t_abs - self.t_ref > self.REBASE_S:
+            self._rebase(t_abs, position)
+
+        t = t_abs - self.t_ref
+        x = position - self.x_ref
+        if self.samples and t <= self.samples[-1][0]:
+            return self.last_velocity   # Same packet read twice - nothing new
+
+        fit = self._fit()
+        if fit is not None:
+            a, b, c = fit
+            residual = abs(x - (a + b * t + c * t * t))
+
+            if residual > self.outlier_counts:
+                if self.suspect is None:
+                    # Hold the sample until the next one says whether it was a glitch
+                    self.suspect = (t, x)
+                    return self.last_velocity
+                # Confirmed by a second sample - a real jump, restart the window from it
+                suspect, self.suspect = self.suspect, None
+                self._drop_before(float('inf'))
+                self._push(*suspect)
+            else:
+                self.suspect = None
+                if residual > self.change_counts:
+                    self._drop_before(t - self.min_window_s)
+
+        self._push(t, x)
+        self._drop_before(t - self.window_s)
+
+        fit = self._fit()
+        if fit is not None:
+            self.last_velocity = fit[1] + 2.0 * fit[2] * t
+        return self.last_velocity
+
+
+def make_velocity_estimator(name):
+    """
+    Velocity estimator by name (config VELOCITY_ESTIMATORS)
+
+    'predictive' PredictiveVelocityTracker, 'window' EncoderSmoother,
+    'lsq1' / 'lsq2' LeastSquaresVelocityEstimator of order 1 / 2
+    """
+    if name == 'predictive':
+        return PredictiveVelocityTracker()
+    if name == 'window':
+        return EncoderSmoother()
+    if name == 'lsq1':
+        return LeastSquaresVelocityEstimator(order=1)
+    if name == 'lsq2':
+        return LeastSquaresVelocityEstimator(order=2)
+    raise ValueError(f"Unknown velocity estimator '{name}'")
+
+
 class EncoderReader:
     """
     Reads dual encoder data from ESP32 via I2C
     Supports both traditional smoothing and predictive velocity tracking for each encoder
     """
-    def __init__(self, bus, i2c_address, smoother=None, use_predictive=VELOCITY_PREDICTION):
+    def __init__(self, bus, i2c_address, smoother=None, use_predictive=VELOCITY_PREDICTION,
+                 use_native=USE_NATIVE_I2C, estimators=None):
         """
         Initialize encoder reader
 
@@ -145,20 +319,28 @@ class EncoderReader:
             i2c_address: I2C address of ESP32 slave
             smoother: EncoderSmoother instance (creates new one if None)
             use_predictive: Use predictive velocity tracking for low-PPR encoders
+            use_native: Read through the fasti2c extension (shares the bus file descriptor)
+            estimators: Velocity estimator name per encoder (see make_velocity_estimator),
+                        None = VELOCITY_ESTIMATORS, or 'window' for both if not use_predictive
         """
         self.bus = bus
         self.i2c_address = i2c_address
-        self.use_predictive = use_predictive
 
-        # Separate trackers/smoothers for each encoder
-        if use_predictive:
-            self.tracker_enc1 = PredictiveVelocityTracker()
-            self.tracker_enc2 = PredictiveVelocityTracker()
-            print(f"EncoderReader@0x{i2c_address:02X}: Using predictive velocity for 2 encoders (PPR={ENCODER_PPR})")
-        else:
-            self.smoother_enc1 = smoother if smoother else EncoderSmoother()
-            self.smoother_enc2 = EncoderSmoother()
-            print(f"EncoderReader@0x{i2c_address:02X}: Using traditional smoothing for 2 encoders")
+        # Native reader - one preallocated ioctl buffer and one reused Packet record
+        self.device = None
+        if use_native and fasti2c is not None and getattr(bus, 'fd', None) is not None:
+            self.device = fasti2c.Device(0, i2c_address, fd=bus.fd)
+        self.read_msg = i2c_msg.read(i2c_address, DATA_PACKET_SIZE)
+
+        # Separate velocity estimator for each encoder
+        if estimators is None:
+            estimators = VELOCITY_ESTIMATORS if use_predictive else ('window', 'window')
+        self.estimator_names = list(estimators)
+        self.estimators = [make_velocity_estimator(name) for name in estimators]
+        if smoother is not None and self.estimator_names[0] == 'window':
+            self.estimators[0] = smoother
+        print(f"EncoderReader@0x{i2c_address:02X}: Velocity estimators {'/'.join(self.estimator_names)} "
+              f"(PPR={ENCODER_PPR})")
 
         self.last_enc1_position = 0
         self.last_enc2_position = 0
@@ -166,55 +348,78 @@ class EncoderReader:
         self.read_errors = 0
         self.total_reads = 0
 
+        # Session recording (recording.SessionRecorder), None = off
+        self.recorder = None
+
+        # Command channel - last sequence number sent and last acknowledgement seen, stored as
+        # one (seq, status) tuple so another thread never sees the seq of one packet with the
+        # status of another
+        self.cmd_seq = 0
+        self.cmd_ack = (0, 0)
+
+        # Newest packet read by send_command(wait=True), with the button flags of every packet
+        # polled before it ORed in - the ESP32 clears its latched button flags after every packet
+        # it sends, so read() merges them into its next bus read (or returns this one if it fails)
+        self.held = None
+
+        # Set while an AcquisitionThread reads this device; send_command(wait=True) then waits
+        # for the acknowledgement in the thread's samples instead of reading the bus itself
+        self.acquired = False
+
+    @property
+    def cmd_ack_seq(self):
+        return self.cmd_ack[0]
+
+    @property
+    def cmd_status(self):
+        return self.cmd_ack[1]
+
     def read_raw_data(self):
         """
         Read raw data from ESP32 via I2C
 
         Returns:
             tuple: (enc1_pos, enc1_vel, enc2_pos, enc2_vel, timestamp, button_flags, volume_pot, slider_pot) or None on error
+            The command acknowledgement bytes are stored in cmd_ack_seq / cmd_status.
         """
         try:
-            # Read 25 bytes from ESP32 slave (no register addressing)
+            if self.device is not None:
+                # Native path - ioctl and decode in C, no per-read allocation until astuple()
+                packet = self.device.read()
+                if self.recorder is not None:
+                    self.recorder.record(self.i2c_address, bytes(self.device.raw))
+                self.cmd_ack = (packet.cmd_ack_seq, packet.cmd_status)
+                self.total_reads += 1
+                return packet.astuple()
+
+            # Read 27 bytes from ESP32 slave (no register addressing)
             # ESP32 is a simple I2C slave - just read data directly
-            msg = i2c_msg.read(self.i2c_address, DATA_PACKET_SIZE)
-            self.bus.i2c_rdwr(msg)
-            data = list(msg)
-
-            # Unpack data (little-endian format)
-            # Encoder 1 Position (4 bytes, signed int32)
-            enc1_position = struct.unpack('<i', bytes(data[0:4]))[0]
-
-            # Encoder 1 Velocity (4 bytes, signed int32, fixed-point * 100)
-            enc1_vel_fixed = struct.unpack('<i', bytes(data[4:8]))[0]
-            enc1_velocity_raw = enc1_vel_fixed / 100.0
-
-            # Encoder 2 Position (4 bytes, signed int32)
-            enc2_position = struct.unpack('<i', bytes(data[8:12]))[0]
-
-            # Encoder 2 Velocity (4 bytes, signed int32, fixed-point * 100)
-            enc2_vel_fixed = struct.unpack('<i', bytes(data[12:16]))[0]
-            enc2_velocity_raw = enc2_vel_fixed / 100.0
+            self.bus.i2c_rdwr(self.read_msg)
+            return self.unpack_packet(bytes(self.read_msg))
 
-            # Timestamp (4 bytes, unsigned int32)
-            timestamp = struct.unpack('<I', bytes(data[16:20]))[0]
-
-            # Button flags (1 byte, unsigned int8)
-            button_flags = data[20]
+        except Exception as e:
+            self.read_errors += 1
+            log.emit(MSG_READ_ERROR, key=self.i2c_address, text=str(e))
+            return None
 
-            # Volume Potentiometer (2 bytes, unsigned int16)
-            volume_pot = struct.unpack('<H', bytes(data[21:23]))[0]
+    def unpack_packet(self, packet):
+        """
+        Decode a packet read into read_msg (by read_raw_data or a batched poller transaction)
 
-            # Slider Potentiometer (2 bytes, unsigned int16)
-            slider_pot = struct.unpack('<H', bytes(data[23:25]))[0]
+        Returns:
+            tuple: same layout as read_raw_data()
+        """
+        if self.recorder is not None:
+            self.recorder.record(self.i2c_address, packet)
 
-            self.total_reads += 1
-            return enc1_position, enc1_velocity_raw, enc2_position, enc2_velocity_raw, timestamp, button_flags, volume_pot, slider_pot
+        # Unpack data (little-endian format, velocities are fixed-point * 100)
+        (enc1_position, enc1_vel_fixed, enc2_position, enc2_vel_fixed, timestamp,
+         button_flags, volume_pot, slider_pot, ack_seq, status) = PACKET_STRUCT.unpack(packet)
+        self.cmd_ack = (ack_seq, status)
 
-        except Exception as e:
-            self.read_errors += 1
-            if DEBUG_PRINT_I2C:
-                print(f"Error reading I2C from 0x{self.i2c_address:02X}: {e}")
-            return None
+        self.total_reads += 1
+        return (enc1_position, enc1_vel_fixed / 100.0, enc2_position, enc2_vel_fixed / 100.0,
+                timestamp, button_flags, volume_pot, slider_pot)
 
     def read(self):
         """
@@ -236,29 +441,30 @@ class EncoderReader:
                 'volume_pot_normalized': float (0.0-1.0),
                 'slider_pot': int (0-4095),
                 'slider_pot_normalized': float (0.0-1.0),
-                'predicted': bool (True if using prediction)
+                'predicted': bool (True if encoder 1 uses the predictive tracker)
             } or None on error
         """
         raw_data = self.read_raw_data()
+        held, self.held = self.held, None
+        if held is not None:
+            if raw_data is None:
+                raw_data = held
+            else:
+                raw_data = raw_data[:5] + (raw_data[5] | held[5],) + raw_data[6:]
 
         if raw_data is None:
             return None
 
+        return self.decode(raw_data)
+
+    def decode(self, raw_data):
+        """Velocity tracking and button/pot decoding for one read_raw_data() tuple (see read())"""
         enc1_position, enc1_velocity_raw, enc2_position, enc2_velocity_raw, timestamp, button_flags, volume_pot, slider_pot = raw_data
 
-        # Calculate velocity for encoder 1
-        if self.use_predictive:
-            enc1_velocity = self.tracker_enc1.update(enc1_position, timestamp)
-            predicted = True
-        else:
-            enc1_velocity = self.smoother_enc1.update(enc1_position, timestamp)
-            predicted = False
-
-        # Calculate velocity for encoder 2
-        if self.use_predictive:
-            enc2_velocity = self.tracker_enc2.update(enc2_position, timestamp)
-        else:
-            enc2_velocity = self.smoother_enc2.update(enc2_position, timestamp)
+        # Calculate velocity for each encoder
+        enc1_velocity = self.estimators[0].update(enc1_position, timestamp)
+        enc2_velocity = self.estimators[1].update(enc2_position, timestamp)
+        predicted = self.estimator_names[0] == 'predictive'
 
         self.last_enc1_position = enc1_position
         self.last_enc2_position = enc2_position
@@ -295,20 +501,150 @@ class EncoderReader:
             'predicted': predicted
         }
 
+    def write_calibration(self, pot_endpoints, motor_curve, motor_target_rpm,
+                          encoder_direction=(1, 1), encoder_ppr=(ENCODER_PPR, ENCODER_PPR),
+                          i2c_address=None):
+        """
+        Send a calibration profile to the ESP32, which applies it and stores it in NVS
+
+        Args:
+            pot_endpoints: ((volume_min, volume_max), (slider_min, slider_max)) raw ADC values
+            motor_curve: 4 (duty, rpm) points sorted by duty
+            motor_target_rpm: Platter speed for normal playback
+            encoder_direction: +1/-1 per encoder
+            encoder_ppr: Pulses per revolution per encoder
+            i2c_address: New ESP32 address (applied after ESP32 reboot), None to keep current
+
+        Returns:
+            bool: True if the write was acknowledged on the bus
+        """
+        fields = [CALIBRATION_VERSION]
+        for pot_min, pot_max in pot_endpoints:
+            fields += [pot_min, pot_max]
+        for duty, rpm in motor_curve:
+            fields += [duty, int(round(rpm * 10))]
+        fields.append(int(round(motor_target_rpm * 10)))
+        fields += list(encoder_direction)
+        fields += list(encoder_ppr)
+        fields.append(self.i2c_address if i2c_address is None else i2c_address)
+
+        payload = struct.pack(CALIBRATION_FORMAT, *fields)
+        return self.send_command([(CMD_CALIBRATION, payload)]) is not None
+
+    def send_command(self, frames, wait=False, timeout=CMD_ACK_TIMEOUT_S):
+        """
+        Write command frames to the ESP32 in a single transaction, followed by a commit
+
+        Args:
+            frames: list of (command_id, payload_bytes)
+            wait: Wait until the ESP32 acknowledges the commit - by polling the device every
+                  CMD_ACK_POLL_MS (the newest packet read is held for read(), with the
+                  button presses of all of them), or by watching the
+                  acquisition thread's samples while one reads this device
+            timeout: Maximum time to wait for the acknowledgement (seconds)
+
+        Returns:
+            int: Commit sequence number (1-255) once written (and acknowledged with status OK
+                 when wait=True), None on a bus error, a timeout or a non-OK status
+        """
+        self.cmd_seq = self.cmd_seq % 255 + 1
+
+        data = bytearray()
+        for cmd, payload in frames:
+            data += bytes([cmd, len(payload)]) + bytes(payload)
+        data += bytes([CMD_COMMIT, 1, self.cmd_seq])
+
+        try:
+            self.bus.i2c_rdwr(i2c_msg.write(self.i2c_address, bytes(data)))
+        except Exception as e:
+            log.emit(MSG_WRITE_ERROR, key=self.i2c_address, text=str(e))
+            return None
+
+        if not wait:
+            return self.cmd_seq
+
+        deadline = time.monotonic() + timeout
+        while True:
+            if not self.acquired:
+                raw_data = self.read_raw_data()
+                if raw_data is not None:
+                    if self.held is not None:
+                        raw_data = raw_data[:5] + (raw_data[5] | self.held[5],) + raw_data[6:]
+                    self.held = raw_data
+            ack_seq, status = self.cmd_ack
+            if ack_seq == self.cmd_seq:
+                if status != 0:
+                    log.emit(MSG_CMD_REJECTED, self.cmd_seq, key=self.i2c_address,
+                             text=self.command_status_name())
+                    return None
+                return self.cmd_seq
+            remaining = deadline - time.monotonic()
+            if remaining <= 0:
+                break
+            time.sleep(min(remaining, CMD_ACK_POLL_MS / 1000.0))
+
+        log.emit(MSG_CMD_TIMEOUT, self.cmd_seq, timeout * 1000, key=self.i2c_address)
+        return None
+
+    def command_status_name(self):
+        """Name of the status reported with the last acknowledgement"""
+        if self.cmd_status < len(CMD_STATUS_NAMES):
+            return CMD_STATUS_NAMES[self.cmd_status]
+        return f"0x{self.cmd_status:02X}"
+
+    @staticmethod
+    def motor_setpoint_frame(deck, rpm):
+        """Frame setting a deck's platter speed (RPM, negative = backward, 0 = stop)"""
+        return CMD_MOTOR_SETPOINT, struct.pack('<Bh', deck, int(round(rpm * 10)))
+
+    @staticmethod
+    def led_pattern_frame(pattern, beat_phase=0.0, beat_period_ms=500.0):
+        """
+        Frame selecting an LED pattern; beat_phase is the position in the current beat (0.0-1.0)
+
+        Re-send it every beat or so with the current phase - the ESP32 slews small phase errors
+        out instead of jumping, so frequent updates keep the LEDs locked without stutter.
+        """
+        phase = int(round((beat_phase % 1.0) * 65536)) & 0xFFFF
+        return CMD_LED_PATTERN, struct.pack('<BHI', pattern, phase, int(round(beat_period_ms * 1000)))
+
+    @staticmethod
+    def led_level_frame(level):
+        """Frame setting the level shown by LED_PATTERN_VU (0.0-1.0)"""
+        return CMD_LED_LEVEL, bytes([max(0, min(255, int(level * 255)))])
+
+    @staticmethod
+    def lcd_text_frame(row, text):
+        """Frame setting one LCD row (truncated to LCD_COLS characters)"""
+        return CMD_LCD_TEXT, bytes([row]) + text[:LCD_COLS].encode('ascii', 'replace')
+
+    @staticmethod
+    def lcd_title_frame(title):
+        """Frame setting the now-playing title (the ESP32 truncates it to its title field)"""
+        return CMD_LCD_TITLE, title[:LCD_COLS].encode('ascii', 'replace')
+
+    @staticmethod
+    def lcd_status_frame(bpm, pitch_percent, elapsed_s):
+        """Frame updating BPM, pitch (%, drives the rate bar) and elapsed time on the LCD"""
+        bpm_x10 = max(0, min(0xFFFF, int(round(bpm * 10))))
+        pitch_x10 = max(-0x8000, min(0x7FFF, int(round(pitch_percent * 10))))
+        return CMD_LCD_STATUS, struct.pack('<HhH', bpm_x10, pitch_x10, max(0, min(0xFFFF, int(elapsed_s))))
+
     def get_error_rate(self):
         """Get the I2C read error rate"""
         if self.total_reads == 0:
             return 0.0
         return self.read_errors / self.total_reads
 
+    def set_velocity_estimator(self, encoder, name):
+        """Switch one encoder (0 or 1) to another velocity estimator"""
+        self.estimators[encoder] = make_velocity_estimator(name)
+        self.estimator_names[encoder] = name
+
     def reset_tracker(self):
-        """Reset the velocity trackers/smoothers for both encoders"""
-        if self.use_predictive:
-            self.tracker_enc1.reset()
-            self.tracker_enc2.reset()
-        else:
-            self.smoother_enc1.reset()
-            self.smoother_enc2.reset()
+        """Reset the velocity estimators for both encoders"""
+        for estimator in self.estimators:
+            estimator.reset()
 
 
 def test_encoder_reader():
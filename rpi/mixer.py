@@ -4,139 +4,55 @@ DJ Mixer Application
 Combines GStreamer audio processing with I2C encoder control
 """
 
+import argparse
 import gi
+import json
 import sys
 import os
+import signal
 import smbus2
+import socket
+import time
 
 gi.require_version('Gst', '1.0')
 from gi.repository import Gst, GLib
 
 from i2c import EncoderReader, EncoderSmoother
+from acquisition import AcquisitionThread, LatencyHistogram
+from poller import DevicePoller
+from calibration import load_calibrations, save_calibrations
+from eventlog import log
+from engine import DeckEngineSource, deckengine
+from deck import DJDeck
 from config import (
-    HOME_PATH, MUSIC_PATH_1, MUSIC_PATH_2, DUAL_DECK_MODE,
-    I2C_BUS, ESP32_DECK1_ADDR, ESP32_DECK2_ADDR,
-    I2C_POLL_RATE_MS, DEFAULT_VOLUME, NORMAL_SPEED_MAX, NORMAL_SPEED_MIN,
-    VELOCITY_SCALE, MIN_PLAYBACK_RATE, MAX_PLAYBACK_RATE,
-    DECK1_CONTROL_MODE, DECK2_CONTROL_MODE,
-    CONTROL_MODE_VELOCITY, CONTROL_MODE_POSITION, CONTROL_MODE_TURNTABLE,
-    NORMAL_SPEED_COUNTS_PER_SEC, STOP_THRESHOLD_COUNTS_PER_SEC, ALLOW_REVERSE_PLAYBACK,
-    VELOCITY_PREDICTION, VELOCITY_CHANGE_THRESHOLD, ENCODER_PPR,
-    DEBUG_PRINT_RATE, DEBUG_PRINT_VOLUME
+    HOME_PATH, MUSIC_PATH_1, MUSIC_PATH_2, DUAL_DECK_MODE, I2C_BUS, ESP32_DECK1_ADDR,
+    ESP32_DECK2_ADDR, I2C_POLL_RATE_MS, DEFAULT_VOLUME, DECK1_CONTROL_MODE, DECK2_CONTROL_MODE,
+    CONTROL_MODE_POSITION, CONTROL_MODE_TURNTABLE, STOP_THRESHOLD_COUNTS_PER_SEC,
+    ALLOW_REVERSE_PLAYBACK, VELOCITY_PREDICTION, VELOCITY_CHANGE_THRESHOLD, ENCODER_PPR,
+    LOG_CATEGORIES, LOG_MODE, LOG_REPEAT_MS, DECK_ENGINE, ACQ_THREAD_ENABLED, ACQ_STATS_PERIOD_S,
+    POLLER_DISCOVER, POLLER_BUSES, AUDIO_BACKEND, REPLAY_SPEED, DECK1_VELOCITY_ESTIMATOR,
+    DECK2_VELOCITY_ESTIMATOR, PLATTER_CAL_FILE, PLATTER_CAL_SAVE_PERIOD_S, POSITION_COUNTS_PER_REV,
+    MIXER_CONTROL_SOCKET, CROSSFADER_CURVE, VOLUME_POT_MODE, SFX_SAMPLES
 )
-import enum
-from collections import deque
-
-
-class TurntableState(enum.Enum):
-    """States for the Turntable Speed Controller"""
-    CALIBRATING = 0
-    NORMAL_SPEED = 1
-    MODULATING_SPEED = 2
-
-
-
-class DJDeck:
-    """Represents a single DJ deck with its encoder and GStreamer elements"""
-
-    def __init__(self, deck_id, encoder_reader, rate_element, volume_pad, control_mode, pipeline):
-        self.deck_id = deck_id
-        self.encoder = encoder_reader
-        self.rate_element = rate_element
-        self.volume_pad = volume_pad
-        self.control_mode = control_mode
-        self.pipeline = pipeline
-        
-        self.state = TurntableState.NORMAL_SPEED
-
-        self.current_rate = 1.0
-        self.current_volume = DEFAULT_VOLUME
-        
-        self.encoder_read_history = deque(maxlen=100)
-        
-    def set_control_mode(self, mode):
-        """Switch between control modes"""
-        if mode in [CONTROL_MODE_VELOCITY, CONTROL_MODE_POSITION, CONTROL_MODE_TURNTABLE]:
-            self.control_mode = mode
-            print(f"Deck {self.deck_id}: Control mode set to {mode}")
-
-    def update_from_encoder(self):
-        """Read encoder and update playback rate/volume"""
-        data = self.encoder.read()
-
-        if data is None:
-            return
-
-        self.encoder_read_history.append(data)
+from faders import PotFilter, crossfade_gains
+from sampler import SfxSource
+from output import OutputSink
+from tracing import tracer
 
-        # Update playback rate based on control mode
-        self._update_state_turntable()
-        self._update_rate()
-
-    def _update_state_turntable(self):
-        prev_velocities = [entry['velocity'] for entry in self.encoder_read_history]
-
-        if not self.encoder_read_history:
-            return
-        avg_recent_velocity = sum(prev_velocities) / len(prev_velocities)
-        print("AVG RECENT VEL", avg_recent_velocity)
-        if NORMAL_SPEED_MIN < avg_recent_velocity < NORMAL_SPEED_MAX:
-            self.state = TurntableState.NORMAL_SPEED
-        else:
-            self.state = TurntableState.MODULATING_SPEED
-        
-        print("STATE:", self.state)
-        print()
-        
-    
-    def _update_rate(self):
-        match self.state:
-            case TurntableState.CALIBRATING:
-                # Not sure if even to go with this
-                print("Still calibrating...")
-            case TurntableState.NORMAL_SPEED:
-                print("At normal speed, reset rate to 1.0x")
-                self.current_rate = 1.0
-            case TurntableState.MODULATING_SPEED:
-                print("Modulating speed...")
-                """Update playback rate based on encoder velocity (scratching)"""
-                velocity = self.encoder_read_history[-1]['velocity']
-                rate_change = velocity / VELOCITY_SCALE
-                new_rate = 1.0 + rate_change
-
-                # Clamp to allowed range
-                new_rate = max(max(MIN_PLAYBACK_RATE, new_rate), min(MAX_PLAYBACK_RATE, new_rate))
-
-                if abs(new_rate - self.current_rate) > 0.01:  # Only update if significant change
-                    self.current_rate = new_rate
-                    self.rate_element.set_property("rate", max(0.01, self.current_rate))
-
-                    if DEBUG_PRINT_RATE:
-                        print(f"State: {self.state}\tDeck {self.deck_id}: Velocity {velocity:6.1f}\tRate: {self.current_rate:.2f}x")
-
-    def set_volume(self, volume):
-        """Set deck volume (0.0 to 1.0)"""
-        volume = max(0.0, min(1.0, volume))
-        self.current_volume = volume
-
-        # Only set volume if we have a mixer pad (dual deck mode)
-        if self.volume_pad is not None:
-            self.volume_pad.set_property("volume", volume)
-
-            if DEBUG_PRINT_VOLUME:
-                print(f"Deck {self.deck_id}: Volume {volume:.2f}")
-        elif DEBUG_PRINT_VOLUME:
-            print(f"Deck {self.deck_id}: Volume control not available in single deck mode")
-
-    def adjust_volume(self, delta):
-        """Adjust volume by delta"""
-        self.set_volume(self.current_volume + delta)
+# Mixer messages (eventlog.py)
+MSG_CROSSFADER = log.message('volume', "Crossfader {0:.2f} ({text}): deck 1 {1:.2f}, deck 2 {2:.2f}")
+MSG_MASTER = log.message('volume', "Master {0:.2f}")
+MSG_CONTROL_ERROR = log.message('error', "Control message ignored: {text}")
+MSG_UPDATE_ERROR = log.message('error', "Error in I2C update: {text}", LOG_REPEAT_MS)
+MSG_TIMING = log.message('timing', "Timing: {text}")
 
 
 class DJMixer:
     """Main DJ mixer application"""
 
-    def __init__(self, file_path1, file_path2=None, use_dual_encoders=False):
+    def __init__(self, file_path1, file_path2=None, use_dual_encoders=False,
+                 open_bus=smbus2.SMBus, audio_sink=AUDIO_BACKEND, calibration_file=PLATTER_CAL_FILE,
+                 calibrate=False, control_socket=MIXER_CONTROL_SOCKET, trace_path=None):
         """
         Initialize DJ Mixer
 
@@ -144,6 +60,13 @@ class DJMixer:
             file_path1: Path to audio file for deck 1
             file_path2: Path to audio file for deck 2 (None for single deck mode)
             use_dual_encoders: If True, use two separate ESP32s for each deck
+            open_bus: Opens an I2C bus by number (smbus2.SMBus, or emulator.bus_factory())
+            audio_sink: Output backend (output.py: 'alsa', 'pipewire', 'jack', 'pulse', 'null' to run
+                        headless) or a GStreamer sink element
+            calibration_file: Saved platter calibrations (None = calibrate, do not save)
+            calibrate: Calibrate every deck at startup even if a saved calibration exists
+            control_socket: Unix datagram socket for control messages (server.py), None = none
+            trace_path: Trace every command's latency (tracing.py), written here as Chrome trace JSON on stop
         """
         Gst.init(None)
 
@@ -154,80 +77,88 @@ class DJMixer:
         self.deck2 = None
         self.dual_deck_mode = file_path2 is not None
         self.use_dual_encoders = use_dual_encoders
+        self.open_bus = open_bus
+        self.audio_sink = audio_sink
+        self.poller = None
+        self.acquisition = None
+        self.sfx = None
+        self.output = None
+        self.recorder = None
+        self.control = None
+        self.control_socket = control_socket
+        self.trace_path = trace_path
+        tracer.enabled = trace_path is not None
+        self.calibration_file = calibration_file
+        self.calibrations = load_calibrations(calibration_file)
+        self.last_calibration_save_ns = time.monotonic_ns()
+
+        # Jitter of the GLib poll timer, kept to compare against the acquisition thread
+        self.timer_jitter = LatencyHistogram("glib timer jitter")
+        self.last_update_ns = None
+        self.last_stats_ns = time.monotonic_ns()
+
+        # Slider = crossfader, volume pot = master level (or each controller's pot = its deck's fader)
+        self.crossfader = PotFilter()
+        self.volume_pots = {1: PotFilter(), 2: PotFilter()}
+        self.crossfade = (1.0, 1.0)
+        self.master = DEFAULT_VOLUME
 
         # Build GStreamer pipeline
         self._build_pipeline(file_path1, file_path2)
 
         # Initialize I2C and encoders
         self._init_encoders()
+        self._init_calibration(calibrate)
+        self._init_control()
 
     def _build_pipeline(self, file_path1, file_path2):
         """Build the GStreamer audio pipeline"""
         self.pipeline = Gst.Pipeline.new("dj-pipeline")
 
         # === Deck 1 Elements (Always created) ===
-        src1 = Gst.ElementFactory.make("filesrc", "src1")
-        src1.set_property("location", file_path1)
-        decode1 = Gst.ElementFactory.make("decodebin", "decode1")
-        convert1 = Gst.ElementFactory.make("audioconvert", "convert1")
-        rate1 = Gst.ElementFactory.make("pitch", "rate1")
+        out1, rate1 = self._build_deck(1, file_path1)
 
         # === Output Elements ===
         output_convert = Gst.ElementFactory.make("audioconvert", "output_convert")
-        output_sink = Gst.ElementFactory.make("pulsesink", "output_sink")
+        self.output = OutputSink(self.audio_sink)
+        output_sink = self.output.element
 
         # Check essential elements
-        if not all([src1, decode1, convert1, rate1, output_convert, output_sink]):
+        if not all([output_convert, output_sink]):
             raise RuntimeError("Failed to create essential GStreamer elements. Check plugins.")
 
-        # Add deck 1 elements to pipeline
-        self.pipeline.add(src1)
-        self.pipeline.add(decode1)
-        self.pipeline.add(convert1)
-        self.pipeline.add(rate1)
         self.pipeline.add(output_convert)
         self.pipeline.add(output_sink)
 
+        # === SFX Sampler (only with samples configured) ===
+        sfx_out = self._build_sfx()
+
         if self.dual_deck_mode:
             # === Dual Deck Mode ===
             print("Building DUAL DECK pipeline...")
 
             # Create deck 2 elements
-            src2 = Gst.ElementFactory.make("filesrc", "src2")
-            src2.set_property("location", file_path2)
-            decode2 = Gst.ElementFactory.make("decodebin", "decode2")
-            convert2 = Gst.ElementFactory.make("audioconvert", "convert2")
-            rate2 = Gst.ElementFactory.make("pitch", "rate2")
+            out2, rate2 = self._build_deck(2, file_path2)
             mixer = Gst.ElementFactory.make("audiomixer", "mixer")
 
-            if not all([src2, decode2, convert2, rate2, mixer]):
+            if not mixer:
                 raise RuntimeError("Failed to create deck 2 GStreamer elements.")
-
-            # Add deck 2 and mixer to pipeline
-            self.pipeline.add(src2)
-            self.pipeline.add(decode2)
-            self.pipeline.add(convert2)
-            self.pipeline.add(rate2)
             self.pipeline.add(mixer)
 
-            # Link Deck 1: src → decode → convert → rate → mixer
-            src1.link(decode1)
-            decode1.connect("pad-added", self._on_pad_added, convert1)
-            convert1.link(rate1)
-
-            src_pad_1 = rate1.get_static_pad("src")
+            # Link Deck 1 → mixer
+            src_pad_1 = out1.get_static_pad("src")
             sink_pad_1 = mixer.get_request_pad("sink_%u")
             src_pad_1.link(sink_pad_1)
 
-            # Link Deck 2: src → decode → convert → rate → mixer
-            src2.link(decode2)
-            decode2.connect("pad-added", self._on_pad_added, convert2)
-            convert2.link(rate2)
-
-            src_pad_2 = rate2.get_static_pad("src")
+            # Link Deck 2 → mixer
+            src_pad_2 = out2.get_static_pad("src")
             sink_pad_2 = mixer.get_request_pad("sink_%u")
             src_pad_2.link(sink_pad_2)
 
+            # Link sampler → mixer
+            if sfx_out is not None:
+                sfx_out.get_static_pad("src").link(mixer.get_request_pad("sink_%u"))
+
             # Link mixer to output
             mixer.link(output_convert)
             output_convert.link(output_sink)
@@ -242,11 +173,18 @@ class DJMixer:
             # === Single Deck Mode ===
             print("Building SINGLE DECK pipeline...")
 
-            # Link Deck 1: src → decode → convert → rate → output
-            src1.link(decode1)
-            decode1.connect("pad-added", self._on_pad_added, convert1)
-            convert1.link(rate1)
-            rate1.link(output_convert)
+            if sfx_out is not None:
+                # Link Deck 1 and the sampler → mixer → output
+                mixer = Gst.ElementFactory.make("audiomixer", "mixer")
+                if not mixer:
+                    raise RuntimeError("Failed to create the SFX mixer.")
+                self.pipeline.add(mixer)
+                out1.link(mixer)
+                sfx_out.link(mixer)
+                mixer.link(output_convert)
+            else:
+                # Link Deck 1 → output
+                out1.link(output_convert)
             output_convert.link(output_sink)
 
             # Store elements for control
@@ -257,6 +195,69 @@ class DJMixer:
 
         print("GStreamer pipeline built successfully")
 
+    def _build_deck(self, n, file_path):
+        """
+        Add one deck's elements to the pipeline
+
+        native: appsrc (deck engine, track decoded into memory) → convert
+        pitch:  filesrc → decode → convert → pitch
+
+        Returns:
+            tuple: (element whose src pad is the deck output, element that takes "rate")
+        """
+        if DECK_ENGINE == "native":
+            if deckengine is None:
+                print(f"Deck {n}: deck engine not built (python3 setup.py build_ext --inplace), using pitch")
+            else:
+                try:
+                    source = DeckEngineSource.from_file(f"engine{n}", file_path)
+                except Exception as e:
+                    print(f"Deck {n}: cannot load {file_path} into the deck engine ({e}), using pitch")
+                else:
+                    convert = Gst.ElementFactory.make("audioconvert", f"convert{n}")
+                    self.pipeline.add(source.appsrc)
+                    self.pipeline.add(convert)
+                    source.appsrc.link(convert)
+                    print(f"Deck {n}: deck engine, {source.deck.duration:.1f} s in memory")
+                    return convert, source
+
+        src = Gst.ElementFactory.make("filesrc", f"src{n}")
+        src.set_property("location", file_path)
+        decode = Gst.ElementFactory.make("decodebin", f"decode{n}")
+        convert = Gst.ElementFactory.make("audioconvert", f"convert{n}")
+        rate = Gst.ElementFactory.make("pitch", f"rate{n}")
+        if not all([src, decode, convert, rate]):
+            raise RuntimeError(f"Failed to create deck {n} GStreamer elements. Check plugins.")
+
+        for element in (src, decode, convert, rate):
+            self.pipeline.add(element)
+        src.link(decode)
+        decode.connect("pad-added", self._on_pad_added, convert)
+        convert.link(rate)
+        return rate, rate
+
+    def _build_sfx(self):
+        """
+        Add the SFX sampler's elements to the pipeline: appsrc (sampler) → convert
+
+        Returns:
+            element whose src pad is the sampler output, or None (no samples or no deck engine)
+        """
+        if not any(SFX_SAMPLES):
+            return None
+        try:
+            self.sfx = SfxSource("sfx")
+        except Exception as e:
+            print(f"SFX sampler disabled: {e}")
+            return None
+
+        convert = Gst.ElementFactory.make("audioconvert", "sfx_convert")
+        self.pipeline.add(self.sfx.appsrc)
+        self.pipeline.add(convert)
+        self.sfx.appsrc.link(convert)
+        print(f"SFX sampler: {len(self.sfx.pads)} pads, {self.sfx.sampler.locked_bytes / 1e6:.1f} MB locked in RAM")
+        return convert
+
     def _on_pad_added(self, element, pad, target_element):
         """Callback when decodebin creates a new pad"""
         sink_pad = target_element.get_static_pad("sink")
@@ -272,46 +273,248 @@ class DJMixer:
 
     def _init_encoders(self):
         """Initialize I2C bus and encoder readers"""
-        self.i2c_bus = smbus2.SMBus(I2C_BUS)
+        self.i2c_bus = self.open_bus(I2C_BUS)
+
+        # Probe for controllers; decks take them in (bus, address) order
+        self.poller = DevicePoller()
+        self.poller.buses[I2C_BUS] = self.i2c_bus
+        self.discovered = []
+        if POLLER_DISCOVER:
+            self.discovered = self.poller.discover(POLLER_BUSES, open_bus=self.open_bus)
+            if self.dual_deck_mode and len(self.discovered) >= 2:
+                self.use_dual_encoders = True
 
         if self.dual_deck_mode:
             # Dual deck mode
             if self.use_dual_encoders:
                 # Two separate ESP32s for independent deck control
-                encoder1 = EncoderReader(self.i2c_bus, ESP32_DECK1_ADDR, EncoderSmoother())
-                encoder2 = EncoderReader(self.i2c_bus, ESP32_DECK2_ADDR, EncoderSmoother())
-                print(f"Dual encoder mode: Deck1@0x{ESP32_DECK1_ADDR:02X}, Deck2@0x{ESP32_DECK2_ADDR:02X}")
+                encoder1 = self._new_reader(0, ESP32_DECK1_ADDR)
+                encoder2 = self._new_reader(1, ESP32_DECK2_ADDR)
+                print(f"Dual encoder mode: Deck1@0x{encoder1.i2c_address:02X}, Deck2@0x{encoder2.i2c_address:02X}")
             else:
                 # Single ESP32 controls both decks (same modulation)
-                encoder1 = EncoderReader(self.i2c_bus, ESP32_DECK1_ADDR, EncoderSmoother())
+                encoder1 = self._new_reader(0, ESP32_DECK1_ADDR)
                 encoder2 = encoder1  # Both decks use same encoder
-                print(f"Single encoder mode: Both decks@0x{ESP32_DECK1_ADDR:02X}")
+                print(f"Single encoder mode: Both decks@0x{encoder1.i2c_address:02X}")
 
             self.deck1 = DJDeck(1, encoder1, self._rate1, self._sink_pad_1, DECK1_CONTROL_MODE, self.pipeline)
             self.deck2 = DJDeck(2, encoder2, self._rate2, self._sink_pad_2, DECK2_CONTROL_MODE, self.pipeline)
         else:
-            encoder1 = EncoderReader(self.i2c_bus, ESP32_DECK1_ADDR, EncoderSmoother())
-            print(f"Single deck mode: Encoder@0x{ESP32_DECK1_ADDR:02X}")
+            encoder1 = self._new_reader(0, ESP32_DECK1_ADDR)
+            print(f"Single deck mode: Encoder@0x{encoder1.i2c_address:02X}")
 
             self.deck1 = DJDeck(1, encoder1, self._rate1, None, DECK1_CONTROL_MODE, self.pipeline)
             self.deck2 = None
 
+        # Velocity estimator per deck - decks read encoder 1 of their ESP32; a deck 2 sharing deck
+        # 1's ESP32 is never updated from it, so it has no estimator of its own
+        self.deck1.encoder.set_velocity_estimator(0, DECK1_VELOCITY_ESTIMATOR)
+        if self.deck2 is not None and self.use_dual_encoders:
+            self.deck2.encoder.set_velocity_estimator(0, DECK2_VELOCITY_ESTIMATOR)
+
+        if ACQ_THREAD_ENABLED:
+            polled = [self.deck1]
+            if self.deck2 is not None and self.use_dual_encoders:
+                polled.append(self.deck2)
+            self.poller.select([deck.encoder for deck in polled])
+            self.acquisition = AcquisitionThread(poller=self.poller)
+            for deck in polled:
+                deck.sample_ring = self.acquisition.ring_for(deck.encoder)
+
+        # SFX presses trigger as soon as their packet is read - from a single thread
+        if self.sfx is not None:
+            if self.acquisition is not None:
+                self.acquisition.on_sample = lambda reader, read_time_ns, data: self.sfx.on_packet(data, read_time_ns)
+            else:
+                for deck in self._decks():
+                    deck.on_packet = self.sfx.on_packet
+
+    def _init_calibration(self, calibrate):
+        """Saved calibration for each deck's controller, or a calibration run at startup"""
+        for deck in self._decks():
+            key = f"0x{deck.encoder.i2c_address:02X}"
+            deck.on_calibrated = lambda deck, key=key: self._on_calibrated(key, deck)
+            saved = self.calibrations.get(key)
+            if saved is not None and not calibrate:
+                deck.set_calibration(saved)
+                print(f"Deck {deck.deck_id}: platter calibration {saved}")
+            else:
+                deck.start_calibration()
+
+        # kill -USR1 <pid> recalibrates every deck
+        signal.signal(signal.SIGUSR1, lambda signum, frame: self.recalibrate())
+        # kill -USR2 <pid> toggles between the selected log categories and all of them
+        self.log_categories = set(log.categories)
+        signal.signal(signal.SIGUSR2, lambda signum, frame: self.toggle_verbose_log())
+
+    def _init_control(self):
+        """Listen for control messages (JSON datagrams, see _on_control) on the control socket"""
+        if self.control_socket is None:
+            return
+        try:
+            if os.path.exists(self.control_socket):
+                os.unlink(self.control_socket)
+            self.control = socket.socket(socket.AF_UNIX, socket.SOCK_DGRAM)
+            self.control.bind(self.control_socket)
+        except OSError as e:
+            print(f"No control socket at {self.control_socket}: {e}")
+            self.control = None
+            return
+        self.control.setblocking(False)
+        GLib.io_add_watch(self.control.fileno(), GLib.PRIORITY_DEFAULT, GLib.IOCondition.IN, self._on_control)
+        print(f"Control socket: {self.control_socket}")
+
+    def _on_control(self, fd, condition):
+        """
+        {"action": "load", "deck": 1, "path": FILE, "start": 0.0, "swap": true, "at": null}
+        {"action": "swap", "deck": 1, "at": null}
+        """
+        try:
+            message = json.loads(self.control.recv(65536))
+            deck = self.deck1 if message.get("deck", 1) == 1 else self.deck2
+            if deck is None:
+                raise ValueError(f"no deck {message.get('deck')}")
+            if message.get("action") == "load":
+                deck.prepare_track(message["path"], message.get("start", 0.0), message.get("swap", True),
+                                   message.get("at"))
+            elif message.get("action") == "swap":
+                deck.swap_track(message.get("at"))
+            else:
+                raise ValueError(f"unknown action {message.get('action')}")
+        except BlockingIOError:
+            pass
+        except (OSError, ValueError, KeyError, AttributeError) as e:
+            log.emit(MSG_CONTROL_ERROR, text=str(e))
+        return True
+
+    def load_track(self, deck_id, path, start_s=0.0, swap=True, at_s=None):
+        """Load a track into a running deck (see DJDeck.prepare_track)"""
+        deck = self.deck1 if deck_id == 1 else self.deck2
+        return deck is not None and deck.prepare_track(path, start_s, swap, at_s)
+
+    def _decks(self):
+        """Decks that read their own encoder samples"""
+        decks = [self.deck1]
+        if self.deck2 is not None and self.use_dual_encoders:
+            decks.append(self.deck2)
+        return decks
+
+    def recalibrate(self):
+        for deck in self._decks():
+            deck.start_calibration()
+
+    def toggle_verbose_log(self):
+        verbose = log.categories != self.log_categories
+        log.set_categories(self.log_categories if verbose else 'all')
+        print(f"Log categories: {', '.join(sorted(log.categories)) or 'none'}")
+
+    def _on_calibrated(self, key, deck):
+        self.calibrations[key] = deck.calibration
+        self.save_calibrations()
+
+    def save_calibrations(self):
+        if save_calibrations(self.calibrations, self.calibration_file):
+            self.last_calibration_save_ns = time.monotonic_ns()
+
+    def _new_reader(self, index, address):
+        """Reader for the index-th controller - a discovered one if there is one, else the configured address"""
+        if index < len(self.discovered):
+            return self.discovered[index].reader
+        return EncoderReader(self.i2c_bus, address, EncoderSmoother())
+
+    def start_recording(self, path):
+        """Record every packet the decks read to a session file (see recording.py)"""
+        from recording import SessionRecorder
+
+        self.recorder = SessionRecorder(path)
+        for deck in (self.deck1, self.deck2):
+            if deck is not None:
+                deck.encoder.recorder = self.recorder
+        print(f"Recording session to {path}")
+
     def _on_i2c_update(self):
         """Called periodically to read encoders and update playback"""
+        now = time.monotonic_ns()
+        if self.last_update_ns is not None:
+            self.timer_jitter.add((now - self.last_update_ns) / 1000.0 - I2C_POLL_RATE_MS * 1000.0)
+        self.last_update_ns = now
+
+        if ACQ_STATS_PERIOD_S and now - self.last_stats_ns >= ACQ_STATS_PERIOD_S * 1_000_000_000:
+            self.last_stats_ns = now
+            self.print_timing_stats()
+
+        # Calibrations re-estimated during idle spin
+        if (self.calibration_file is not None and
+                now - self.last_calibration_save_ns >= PLATTER_CAL_SAVE_PERIOD_S * 1_000_000_000):
+            self.save_calibrations()
+
         try:
+            # Traces end at the output latency the sink reports, once it does
+            if tracer.enabled and not tracer.output_latency_ns:
+                latency_ms = self.output.latency_ms(self.pipeline)
+                tracer.output_latency_ns = int(latency_ms * 1e6) if latency_ms else 0
+
             self.deck1.update_from_encoder()
             
             if self.deck2 is not None:
                 if self.use_dual_encoders:
                     self.deck2.update_from_encoder()
 
+            self._update_faders()
+
         except Exception as e:
-            print(f"Error in I2C update: {e}")
+            log.emit(MSG_UPDATE_ERROR, text=str(e))
 
         return True  # Keep timer running
 
-    def run(self):
-        """Start the DJ mixer"""
+    def _update_faders(self):
+        """Pots -> deck gains (only when a dezippered pot level changes)"""
+        decks = [deck for deck in (self.deck1, self.deck2) if deck is not None]
+        changed = False
+
+        for deck in decks:
+            data = deck.last_data     # None for a deck without its own controller
+            if data is None:
+                continue
+            level = self.volume_pots[deck.deck_id].update(data['volume_pot'])
+            if level is None:
+                continue
+            if VOLUME_POT_MODE == 'channel':
+                deck.set_volume(level)
+            elif deck.deck_id == 1:
+                self.master = level
+                changed = True
+                log.emit(MSG_MASTER, level)
+
+        if self.deck2 is not None and self.deck1.last_data is not None:
+            position = self.crossfader.update(self.deck1.last_data['slider_pot'])
+            if position is not None:
+                self.crossfade = crossfade_gains(position, CROSSFADER_CURVE)
+                changed = True
+                log.emit(MSG_CROSSFADER, position, *self.crossfade, text=CROSSFADER_CURVE)
+
+        if changed:
+            for deck, gain in zip(decks, self.crossfade):
+                deck.set_fader_gain(self.master * gain)
+
+    def print_timing_stats(self):
+        """Print poll timing histograms (GLib timer vs acquisition thread), the SFX trigger latency and the output"""
+        lines = [self.timer_jitter.summary()]
+        if self.acquisition is not None:
+            lines += self.acquisition.summary()
+            for deck in (self.deck1, self.deck2):
+                if deck is not None and deck.sample_ring is not None:
+                    lines.append(deck.sample_age.summary())
+        if self.sfx is not None:
+            lines += self.sfx.summary()
+        if self.output is not None:
+            lines += self.output.summary(self.pipeline)
+        if tracer.enabled:
+            lines += tracer.summary()
+        log.emit(MSG_TIMING, text="\n        ".join(lines))
+
+    def run(self, duration_s=None):
+        """Start the DJ mixer (for duration_s seconds if given, else until Ctrl+C)"""
         print("\n" + "="*70)
         print(f"DJ MIXER RUNNING - {'DUAL DECK' if self.dual_deck_mode else 'SINGLE DECK'} MODE")
         print("="*70)
@@ -319,52 +522,147 @@ class DJMixer:
         if self.dual_deck_mode:
             print(f"Deck 2: {DECK2_CONTROL_MODE} mode")
 
-        if DECK1_CONTROL_MODE == CONTROL_MODE_TURNTABLE or (self.dual_deck_mode and DECK2_CONTROL_MODE == CONTROL_MODE_TURNTABLE):
+        platter_modes = (CONTROL_MODE_TURNTABLE, CONTROL_MODE_POSITION)
+        if DECK1_CONTROL_MODE in platter_modes or (self.dual_deck_mode and DECK2_CONTROL_MODE in platter_modes):
             print(f"\nTurntable Settings:")
             print(f"  Encoder PPR: {ENCODER_PPR}")
-            print(f"  Normal speed: {NORMAL_SPEED_COUNTS_PER_SEC:.1f} counts/s = 1.0x playback")
+            for deck in self._decks():
+                print(f"  Deck {deck.deck_id} normal speed: {deck.calibration} = 1.0x playback")
             print(f"  Stop threshold: {STOP_THRESHOLD_COUNTS_PER_SEC:.1f} counts/s")
             if VELOCITY_PREDICTION:
                 print(f"  Predictive velocity: ENABLED (smooth playback between clicks)")
                 print(f"  Velocity change threshold: {VELOCITY_CHANGE_THRESHOLD:.1%}")
             print(f"  Reverse playback: {'Enabled' if ALLOW_REVERSE_PLAYBACK else 'Disabled'}")
-
-        print(f"\nI2C Poll Rate: {I2C_POLL_RATE_MS}ms")
+            for deck in self._decks():
+                if deck.position_lock:
+                    print(f"  Deck {deck.deck_id} position lock: {abs(deck.seconds_per_count()) * POSITION_COUNTS_PER_REV:.2f} s "
+                          f"of track per platter revolution")
+                elif deck.control_mode == CONTROL_MODE_POSITION:
+                    print(f"  Deck {deck.deck_id} position lock: needs the deck engine - velocity rate instead")
+
+        print(f"\nI2C Poll Rate: {I2C_POLL_RATE_MS}ms "
+              f"({'acquisition thread' if self.acquisition is not None else 'GLib timer'})")
         print("\nPress Ctrl+C to stop")
         print("="*70 + "\n")
 
         # Start pipeline
         self.pipeline.set_state(Gst.State.PLAYING)
+        self.output.start()
 
         # Create main loop
         self.loop = GLib.MainLoop()
 
+        # Start the acquisition thread; the GLib timer then only consumes its samples
+        if self.acquisition is not None:
+            self.acquisition.start()
+
         # Add I2C polling timer
         GLib.timeout_add(I2C_POLL_RATE_MS, self._on_i2c_update)
 
+        if duration_s is not None:
+            GLib.timeout_add(int(duration_s * 1000), self._on_duration_end)
+
         try:
             self.loop.run()
         except KeyboardInterrupt:
             print("\n\nStopping DJ mixer...")
             self.stop()
 
+    def _on_duration_end(self):
+        print(f"\nRun time over, stopping DJ mixer...")
+        self.stop()
+        return False
+
     def stop(self):
         """Stop the DJ mixer and cleanup"""
+        if self.output is not None:
+            self.output.stop()
         if self.pipeline:
             self.pipeline.set_state(Gst.State.NULL)
 
+        # Stop polling before the bus is closed under it
+        if self.acquisition is not None:
+            self.acquisition.stop()
+        self.print_timing_stats()
+
+        if self.recorder is not None:
+            self.recorder.close()
+
+        if self.control is not None:
+            self.control.close()
+            self.control = None
+            os.unlink(self.control_socket)
+
+        if self.calibration_file is not None:
+            self.save_calibrations()
+
+        if self.trace_path is not None:
+            print(f"Latency trace: {tracer.export_chrome(self.trace_path)} commands written to {self.trace_path}")
+
         if self.i2c_bus:
             self.i2c_bus.close()
 
+        # Extra buses opened by discovery
+        if self.poller:
+            for bus in self.poller.buses.values():
+                if bus is not self.i2c_bus:
+                    bus.close()
+
         if self.loop:
             self.loop.quit()
 
+        # Write out what the control loop logged before the final message
+        log.stop()
         print("DJ mixer stopped")
 
 
 def main():
     """Main entry point"""
-    file_path1 = os.path.join(HOME_PATH, MUSIC_PATH_1)
+    parser = argparse.ArgumentParser(description="Box-DJ mixer")
+    parser.add_argument("files", nargs="*", help="Audio files for deck 1 (and deck 2), default from config.py")
+    parser.add_argument("--emulate", nargs="?", const="scratch", metavar="SCENARIO",
+                        help="Use the software ESP32 (emulator.py) instead of the I2C bus")
+    parser.add_argument("--record", metavar="FILE", help="Record the controller session to FILE")
+    parser.add_argument("--replay", metavar="FILE", help="Replay a recorded session instead of the I2C bus")
+    parser.add_argument("--speed", type=float, default=REPLAY_SPEED,
+                        help="Replay speed (1.0 = real time)")
+    parser.add_argument("--sink", help=f"Output backend (alsa, pipewire, jack, pulse, null) or GStreamer sink "
+                                       f"(default {AUDIO_BACKEND}, null with --emulate/--replay)")
+    parser.add_argument("--duration", type=float, help="Stop after this many seconds")
+    parser.add_argument("--trace", metavar="FILE",
+                        help="Trace the latency of every rate command, written to FILE as Chrome trace JSON")
+    parser.add_argument("--log", metavar="CATEGORIES",
+                        help=f"Log categories, comma-separated, 'all' or 'none' "
+                             f"(default {','.join(LOG_CATEGORIES)})")
+    parser.add_argument("--log-mode", choices=("async", "print", "off"), default=LOG_MODE,
+                        help="async: writer thread, print: write from the control loop, off: no log")
+    parser.add_argument("--calibrate", action="store_true",
+                        help="Measure the platter speed at startup even if a calibration is saved")
+    parser.add_argument("--calibration", metavar="FILE",
+                        help=f"Platter calibration file (default {PLATTER_CAL_FILE}; "
+                             f"none with --emulate/--replay)")
+    args = parser.parse_args()
+
+    log.mode = args.log_mode
+    if args.log is not None:
+        log.set_categories(args.log)
+
+    open_bus = smbus2.SMBus
+    audio_sink = args.sink or AUDIO_BACKEND
+    calibration_file = args.calibration or (None if args.emulate or args.replay else PLATTER_CAL_FILE)
+    if args.emulate:
+        import emulator
+        open_bus = emulator.bus_factory(args.emulate)
+        audio_sink = args.sink or "null"
+    elif args.replay:
+        from recording import Session, ReplayBus
+        session = Session(args.replay)
+        open_bus = lambda bus_id: ReplayBus(session, args.speed)
+        audio_sink = args.sink or "null"
+        if args.duration is None and args.speed > 0:
+            args.duration = session.duration_s / args.speed
+
+    file_path1 = args.files[0] if args.files else os.path.join(HOME_PATH, MUSIC_PATH_1)
 
     if not os.path.exists(file_path1):
         print(f"Error: File not found: {file_path1}")
@@ -372,15 +670,19 @@ def main():
 
     # Handle dual deck mode
     file_path2 = None
-    if DUAL_DECK_MODE:
-        file_path2 = os.path.join(HOME_PATH, MUSIC_PATH_2)
+    if len(args.files) > 1 or (DUAL_DECK_MODE and not args.files):
+        file_path2 = args.files[1] if len(args.files) > 1 else os.path.join(HOME_PATH, MUSIC_PATH_2)
         if not os.path.exists(file_path2):
             print(f"Error: File not found: {file_path2}")
             print(f"Set DUAL_DECK_MODE = False in config.py for single deck mode")
             sys.exit(1)
 
-    mixer = DJMixer(file_path1, file_path2, use_dual_encoders=False)
-    mixer.run()
+    mixer = DJMixer(file_path1, file_path2, use_dual_encoders=False,
+                    open_bus=open_bus, audio_sink=audio_sink,
+                    calibration_file=calibration_file, calibrate=args.calibrate, trace_path=args.trace)
+    if args.record:
+        mixer.start_recording(args.record)
+    mixer.run(duration_s=args.duration)
 
 
 if __name__ == "__main__":
@@ -0,0 +1,350 @@
+#!/usr/bin/env python3
+"""
+Audio Output Module
+The mixer's output stage: the sink of an audio backend (ALSA, PipeWire, JACK, PulseAudio, or a
+null sink clocked in software for machines without a sound card) with a set period and buffer
+size, xrun counting, and a tuner that plays every candidate period and keeps the smallest one
+that ran without xruns
+
+Usage:
+    python3 output.py report [BACKEND]   # achieved latency and xruns of every candidate period
+    python3 output.py tune [BACKEND]     # the same, then save the smallest stable period
+    python3 output.py show               # saved periods
+"""
+
+import array
+import json
+import math
+import os
+import sys
+import threading
+import time
+from acquisition import LatencyHistogram
+from config import (
+    AUDIO_BACKEND, AUDIO_DEVICE, AUDIO_PERIOD_FRAMES, AUDIO_PERIODS, OUTPUT_TUNING_FILE,
+    OUTPUT_TUNE_PERIOD_FRAMES, OUTPUT_TUNE_SECONDS, ENGINE_SAMPLE_RATE
+)
+
+# Backend -> GStreamer sink element
+BACKENDS = {
+    'alsa': 'alsasink',
+    'pipewire': 'pipewiresink',
+    'jack': 'jackaudiosink',
+    'pulse': 'pulsesink',
+    'null': 'appsink',      # Drained by NullSink
+}
+
+
+class OutputSettings:
+    """Sink period and buffer, in frames at `rate`"""
+
+    def __init__(self, period_frames=AUDIO_PERIOD_FRAMES, periods=AUDIO_PERIODS, rate=ENGINE_SAMPLE_RATE):
+        self.period_frames = int(period_frames)
+        self.periods = max(2, int(periods))
+        self.rate = rate
+
+    @property
+    def period_us(self):
+        return self.period_frames * 1_000_000 // self.rate
+
+    @property
+    def buffer_us(self):
+        return self.periods * self.period_us
+
+    def to_dict(self):
+        return {'period_frames': self.period_frames, 'periods': self.periods, 'rate': self.rate}
+
+    @classmethod
+    def from_dict(cls, entry):
+        return cls(entry['period_frames'], entry['periods'], entry['rate'])
+
+    def __str__(self):
+        return (f"{self.period_frames} x {self.periods} frames "
+                f"({self.period_us / 1000:.2f} ms period, {self.buffer_us / 1000:.2f} ms buffer)")
+
+
+def load_tuning(path=OUTPUT_TUNING_FILE):
+    """Tuned settings by backend key ("alsa", "alsa:hw:Dummy", ...)"""
+    if path is None or not os.path.exists(path):
+        return {}
+    try:
+        with open(path) as f:
+            return {key: OutputSettings.from_dict(entry) for key, entry in json.load(f).items()}
+    except (OSError, ValueError, KeyError, TypeError) as e:
+        print(f"Ignoring output tuning file {path}: {e}")
+        return {}
+
+
+def save_tuning(key, settings, path=OUTPUT_TUNING_FILE):
+    """Add one backend's tuned settings to the file (atomically, so a crash leaves the old file)"""
+    if path is None:
+        return False
+    entries = {name: tuned.to_dict() for name, tuned in load_tuning(path).items()}
+    entries[key] = settings.to_dict()
+    try:
+        os.makedirs(os.path.dirname(os.path.abspath(path)), exist_ok=True)
+        temp_path = path + '.tmp'
+        with open(temp_path, 'w') as f:
+            json.dump(entries, f, indent=2, sort_keys=True)
+        os.replace(temp_path, path)
+        return True
+    except OSError as e:
+        print(f"Could not save output tuning to {path}: {e}")
+        return False
+
+
+def tuning_key(backend, device=AUDIO_DEVICE):
+    return f"{backend}:{device}" if device else backend
+
+
+def configured_settings(backend=AUDIO_BACKEND, device=AUDIO_DEVICE, path=OUTPUT_TUNING_FILE):
+    """The backend's tuned settings if output.py tune saved some, else the config's"""
+    return load_tuning(path).get(tuning_key(backend, device)) or OutputSettings()
+
+
+class NullSink:
+    """
+    A sound card without the card, for headless runs and benchmarks
+
+    The card's buffer (periods x period frames) drains at the sample rate by the monotonic
+    clock; a thread wakes once per period and refills it through pull(frames) -> frames got,
+    like an ALSA writer. When a wake-up finds the buffer already drained the card would have
+    played silence: that is an xrun, and the buffer restarts empty.
+    """
+
+    def __init__(self, settings, pull):
+        self.settings = settings
+        self.pull = pull
+        self.xruns = 0
+        self.latency = LatencyHistogram("null sink buffered")    # Queued audio after each refill
+        self.queued_frames = 0      # Ahead of the frames being pulled (their output latency)
+        self.running = False
+        self.thread = None
+
+    def start(self):
+        self.running = True
+        self.thread = threading.Thread(target=self.run, name="nullsink", daemon=True)
+        self.thread.start()
+
+    def stop(self):
+        self.running = False
+        if self.thread is not None and self.thread.is_alive():
+            self.thread.join(timeout=1.0)
+
+    def run(self):
+        rate = self.settings.rate
+        period_ns = self.settings.period_frames * 1_000_000_000 // rate
+        buffer_frames = self.settings.periods * self.settings.period_frames
+
+        start = time.monotonic_ns()
+        written = self.pull(buffer_frames)
+        deadline = start + period_ns
+        while self.running:
+            now = time.monotonic_ns()
+            if deadline > now:
+                time.sleep((deadline - now) / 1e9)
+                now = time.monotonic_ns()
+
+            played = (now - start) * rate // 1_000_000_000
+            if played >= written:
+                self.xruns += 1
+                start, played, written = now, 0, 0
+            self.queued_frames = written - played
+            written += self.pull(played + buffer_frames - written)
+            self.latency.add((written - played) * 1_000_000 / rate)
+
+            deadline += period_ns
+            if now - deadline >= period_ns:
+                deadline += (now - deadline) // period_ns * period_ns
+
+
+class OutputSink:
+    """
+    The pipeline's sink element for a backend, with its period/buffer set and xruns counted
+
+    The real backends count an xrun whenever a buffer reaches the sink after the time it should
+    have started playing (running time = pts, the mixer's output segment starts at 0): the
+    sink's ring buffer ran dry before it. Any other GStreamer sink element name is used as is.
+    """
+
+    def __init__(self, backend=AUDIO_BACKEND, settings=None, device=AUDIO_DEVICE, name="output_sink"):
+        from gi.repository import Gst
+        self.Gst = Gst
+        self.backend = backend
+        self.settings = settings or configured_settings(backend, device)
+        self.xruns = 0
+        self.late = False
+        self.null = None
+        self.reported_ms = None
+
+        self.element = Gst.ElementFactory.make(BACKENDS.get(backend, backend), name)
+        if self.element is None:
+            raise RuntimeError(f"no GStreamer sink for '{backend}' ({BACKENDS.get(backend, backend)}). Check plugins.")
+
+        if backend == 'null':
+            self.frame_bytes = 2 * 4
+            self.leftover = 0
+            self.element.set_property("caps", Gst.Caps.from_string(
+                f"audio/x-raw,format=F32LE,layout=interleaved,rate={self.settings.rate},channels=2"))
+            self.element.set_property("sync", False)    # Paced by NullSink pulling
+            self.element.set_property("max-buffers", 2)
+            self.null = NullSink(self.settings, self._pull)
+            return
+
+        if backend in ('alsa', 'pulse', 'jack'):
+            # GstAudioBaseSink: ring buffer of buffer-time in segments of latency-time
+            self.element.set_property("latency-time", self.settings.period_us)
+            self.element.set_property("buffer-time", self.settings.buffer_us)
+        elif backend == 'pipewire':
+            self.element.set_property("stream-properties", Gst.Structure.new_from_string(
+                f"props,node.latency=(string){self.settings.period_frames}/{self.settings.rate}"))
+        if backend == 'alsa' and device:
+            self.element.set_property("device", device)
+        if backend in BACKENDS:
+            self.element.get_static_pad("sink").add_probe(Gst.PadProbeType.BUFFER, self._on_buffer)
+
+    def _on_buffer(self, pad, info):
+        Gst = self.Gst
+        buffer = info.get_buffer()
+        clock = self.element.get_clock()
+        if clock is not None and buffer.pts != Gst.CLOCK_TIME_NONE:
+            running_time = clock.get_time() - self.element.get_base_time()
+            late = running_time > buffer.pts + self.element.get_latency()
+            if late and not self.late:
+                self.xruns += 1
+            self.late = late
+        return Gst.PadProbeReturn.OK
+
+    def _pull(self, frames):
+        """Up to `frames` frames from the appsink, without waiting"""
+        got = self.leftover
+        while got < frames:
+            sample = self.element.try_pull_sample(0)
+            if sample is None:
+                break
+            got += sample.get_buffer().get_size() // self.frame_bytes
+        self.leftover = max(0, got - frames)
+        return min(got, frames)
+
+    def start(self):
+        """Call once the pipeline is PLAYING"""
+        if self.null is not None:
+            self.null.start()
+
+    def stop(self):
+        if self.null is not None:
+            self.null.stop()
+
+    @property
+    def xrun_count(self):
+        return self.null.xruns if self.null is not None else self.xruns
+
+    def latency_ms(self, pipeline):
+        """Output latency achieved: the null sink's mean buffered audio, else what the pipeline reports"""
+        if self.null is not None:
+            total = self.null.latency.total
+            return self.null.latency.sum_us / total / 1000.0 if total else None
+        query = self.Gst.Query.new_latency()
+        if pipeline.query(query):
+            live, min_latency, max_latency = query.parse_latency()
+            self.reported_ms = min_latency / 1e6
+        return self.reported_ms     # Last answer once the pipeline has stopped
+
+    def summary(self, pipeline):
+        latency = self.latency_ms(pipeline)
+        achieved = f"{latency:.2f} ms" if latency is not None else "unknown"
+        return [f"output {self.backend}: {self.settings}, latency {achieved}, xruns={self.xrun_count}"]
+
+
+def _tone(seconds, rate=ENGINE_SAMPLE_RATE):
+    """Stereo 440 Hz float32 PCM"""
+    pcm = array.array('f', bytes(2 * 4 * int(seconds * rate)))
+    for i in range(0, len(pcm), 2):
+        pcm[i] = pcm[i + 1] = 0.3 * math.sin(2 * math.pi * 440 * (i // 2) / rate)
+    return pcm
+
+
+def measure(backend, settings, seconds=OUTPUT_TUNE_SECONDS, device=AUDIO_DEVICE, pcm=None):
+    """
+    Play a deck engine tone through the backend for `seconds`
+
+    Returns:
+        tuple: (xruns, achieved latency in ms or None)
+    """
+    from gi.repository import Gst
+    from engine import DeckEngineSource
+
+    Gst.init(None)
+    pipeline = Gst.Pipeline.new("output-tune")
+    source = DeckEngineSource("tone", pcm if pcm is not None else _tone(seconds + 1.0), settings.rate)
+    convert = Gst.ElementFactory.make("audioconvert", "convert")
+    output = OutputSink(backend, settings, device)
+    for element in (source.appsrc, convert, output.element):
+        pipeline.add(element)
+    source.appsrc.link(convert)
+    convert.link(output.element)
+
+    pipeline.set_state(Gst.State.PLAYING)
+    output.start()
+    error = pipeline.get_bus().timed_pop_filtered(int(seconds * Gst.SECOND), Gst.MessageType.ERROR)
+    latency = output.latency_ms(pipeline)
+    output.stop()
+    pipeline.set_state(Gst.State.NULL)
+    if error is not None:
+        raise RuntimeError(error.parse_error()[0].message)
+    return output.xrun_count, latency
+
+
+def tune(backend=AUDIO_BACKEND, device=AUDIO_DEVICE, candidates=OUTPUT_TUNE_PERIOD_FRAMES,
+         periods=AUDIO_PERIODS, seconds=OUTPUT_TUNE_SECONDS):
+    """
+    Measure every candidate period (smallest first), print the achieved latency and xruns
+
+    Returns:
+        OutputSettings: the smallest period without xruns, or None
+    """
+    pcm = _tone(seconds + 1.0)
+    stable = None
+    print(f"Output {tuning_key(backend, device)}: {seconds:.0f} s per setting")
+    for period_frames in candidates:
+        settings = OutputSettings(period_frames, periods)
+        try:
+            xruns, latency = measure(backend, settings, seconds, device, pcm)
+        except Exception as e:
+            print(f"  {settings}: failed ({e})")
+            continue
+        achieved = f"{latency:6.2f} ms" if latency is not None else "unknown"
+        print(f"  {settings}: latency {achieved}, xruns {xruns}")
+        if xruns == 0 and stable is None:
+            stable = settings
+    return stable
+
+
+def main():
+    command = sys.argv[1] if len(sys.argv) > 1 else "report"
+    backend = sys.argv[2] if len(sys.argv) > 2 else AUDIO_BACKEND
+
+    if command == "show":
+        tuning = load_tuning()
+        if not tuning:
+            print(f"No tuned outputs in {OUTPUT_TUNING_FILE} (default: {OutputSettings()})")
+            return 1
+        for key, settings in sorted(tuning.items()):
+            print(f"{key}: {settings}")
+        return 0
+    if command not in ("report", "tune"):
+        print(__doc__)
+        return 1
+
+    stable = tune(backend)
+    if stable is None:
+        print("No candidate ran without xruns")
+        return 1
+    print(f"Smallest stable: {stable}")
+    if command == "tune" and save_tuning(tuning_key(backend), stable):
+        print(f"Saved to {OUTPUT_TUNING_FILE}")
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,201 @@
+#!/usr/bin/env python3
+"""
+Multi-Device Poller Module
+Discovers ESP32 controllers on one or more I2C buses and schedules their reads: round-robin
+with a per-device period and priority, several devices batched into one I2C_RDWR ioctl, and
+per-device error rate and staleness tracking
+"""
+
+import time
+import smbus2
+from i2c import EncoderReader
+from config import (
+    DATA_PACKET_SIZE, I2C_POLL_RATE_MS, POLLER_ADDRESSES, POLLER_MAX_BATCH, POLLER_STALE_MS,
+    POLLER_ERROR_ALPHA
+)
+
+
+class PolledDevice:
+    """One ESP32 controller and its scheduling/health state"""
+
+    def __init__(self, reader, bus_id, period_ms=I2C_POLL_RATE_MS, priority=0):
+        self.reader = reader
+        self.bus_id = bus_id
+        self.period_ns = int(period_ms * 1_000_000)
+        self.priority = priority        # Higher is served first when a tick is over budget
+        self.next_due_ns = 0
+
+        self.attempts = 0
+        self.errors = 0
+        self.error_rate = 0.0           # Exponentially weighted, 0.0-1.0
+        self.last_ok_ns = None
+
+    @property
+    def address(self):
+        return self.reader.i2c_address
+
+    def note_result(self, ok, now_ns):
+        self.attempts += 1
+        if ok:
+            self.last_ok_ns = now_ns
+        else:
+            self.errors += 1
+        self.error_rate += POLLER_ERROR_ALPHA * ((0.0 if ok else 1.0) - self.error_rate)
+
+    def staleness_ms(self, now_ns):
+        """Time since the last good sample (inf if there never was one)"""
+        if self.last_ok_ns is None:
+            return float('inf')
+        return (now_ns - self.last_ok_ns) / 1e6
+
+    def is_stale(self, now_ns):
+        return self.staleness_ms(now_ns) > POLLER_STALE_MS
+
+    def __repr__(self):
+        return f"PolledDevice(bus={self.bus_id}, addr=0x{self.address:02X})"
+
+
+class DevicePoller:
+    """
+    Schedules reads of any number of EncoderReaders, grouped by bus
+
+    poll() is called once per tick (by AcquisitionThread). The devices due on each bus are
+    ordered by priority and then by how overdue they are, and read POLLER_MAX_BATCH at a time
+    per ioctl. If a batched transaction fails, its devices are retried one by one so the error
+    is charged to the device that NACKed.
+    """
+
+    def __init__(self, max_batch=POLLER_MAX_BATCH):
+        self.max_batch = max_batch
+        self.devices = []
+        self.buses = {}                 # bus_id -> SMBus
+
+    def add_reader(self, reader, bus_id=None, period_ms=I2C_POLL_RATE_MS, priority=0):
+        """Poll an existing EncoderReader (bus_id defaults to the id already given to its bus)"""
+        if bus_id is None:
+            bus_id = next((i for i, bus in self.buses.items() if bus is reader.bus), len(self.buses))
+        self.buses.setdefault(bus_id, reader.bus)
+        device = PolledDevice(reader, bus_id, period_ms, priority)
+        self.devices.append(device)
+        return device
+
+    @classmethod
+    def from_readers(cls, readers):
+        poller = cls()
+        for reader in readers:
+            poller.add_reader(reader)
+        return poller
+
+    def discover(self, bus_ids, addresses=POLLER_ADDRESSES, open_bus=smbus2.SMBus, **reader_args):
+        """
+        Probe every address on every bus with one packet read and add the ones that answer
+
+        Returns:
+            list: PolledDevice for each controller found, in (bus, address) order
+        """
+        found = []
+        for bus_id in bus_ids:
+            bus = self.buses.get(bus_id)
+            if bus is None:
+                try:
+                    bus = open_bus(bus_id)
+                except OSError as e:
+                    print(f"Poller: cannot open I2C bus {bus_id}: {e}")
+                    continue
+                self.buses[bus_id] = bus
+
+            for address in addresses:
+                if any(d.bus_id == bus_id and d.address == address for d in self.devices):
+                    continue
+                probe = smbus2.i2c_msg.read(address, DATA_PACKET_SIZE)
+                try:
+                    bus.i2c_rdwr(probe)
+                except OSError:
+                    continue
+                reader = EncoderReader(bus, address, **reader_args)
+                found.append(self.add_reader(reader, bus_id))
+                print(f"Poller: found controller on bus {bus_id} at 0x{address:02X}")
+        return found
+
+    def select(self, readers):
+        """Poll exactly these readers - keeps the devices that use them and adds the rest"""
+        self.devices = [device for device in self.devices
+                        if any(device.reader is reader for reader in readers)]
+        for reader in readers:
+            if not any(device.reader is reader for device in self.devices):
+                self.add_reader(reader)
+
+    @property
+    def readers(self):
+        return [device.reader for device in self.devices]
+
+    def _due(self, bus_id, now_ns):
+        # Half a period of slack so a tick that wakes early on the device's grid still reads it
+        due = [d for d in self.devices
+               if d.bus_id == bus_id and d.next_due_ns <= now_ns + d.period_ns // 2]
+        due.sort(key=lambda d: (-d.priority, d.next_due_ns))
+        return due
+
+    def poll(self, now_ns=None):
+        """
+        Read every device that is due
+
+        Returns:
+            list: (reader, data) per successful read, data as returned by EncoderReader.read()
+        """
+        now_ns = time.monotonic_ns() if now_ns is None else now_ns
+        samples = []
+
+        for bus_id, bus in self.buses.items():
+            due = self._due(bus_id, now_ns)
+            for device in due:
+                # Next slot on the device's own grid; slots missed while late are skipped
+                device.next_due_ns += device.period_ns
+                if device.next_due_ns <= now_ns:
+                    device.next_due_ns = now_ns + device.period_ns
+
+            for start in range(0, len(due), self.max_batch):
+                self._read_batch(bus, due[start:start + self.max_batch], now_ns, samples)
+
+        return samples
+
+    def _read_batch(self, bus, batch, now_ns, samples):
+        if len(batch) > 1:
+            try:
+                bus.i2c_rdwr(*(device.reader.read_msg for device in batch))
+            except OSError:
+                pass
+            else:
+                for device in batch:
+                    raw_data = self._unpack(device)
+                    device.note_result(raw_data is not None, now_ns)
+                    if raw_data is not None:
+                        samples.append((device.reader, device.reader.decode(raw_data)))
+                return
+
+        # Single device, or a batch that failed - read individually
+        for device in batch:
+            raw_data = device.reader.read_raw_data()
+            device.note_result(raw_data is not None, now_ns)
+            if raw_data is not None:
+                samples.append((device.reader, device.reader.decode(raw_data)))
+
+    @staticmethod
+    def _unpack(device):
+        reader = device.reader
+        try:
+            return reader.unpack_packet(bytes(reader.read_msg))
+        except Exception:
+            reader.read_errors += 1
+            return None
+
+    def summary(self, now_ns=None):
+        """One line per device: reads, errors, error rate and staleness"""
+        now_ns = time.monotonic_ns() if now_ns is None else now_ns
+        lines = []
+        for device in self.devices:
+            stale = device.staleness_ms(now_ns)
+            lines.append(f"bus {device.bus_id} 0x{device.address:02X}: reads={device.attempts} "
+                         f"errors={device.errors} error_rate={device.error_rate:.1%} "
+                         f"stale={stale:.0f}ms{' STALE' if device.is_stale(now_ns) else ''}")
+        return lines
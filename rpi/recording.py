@@ -0,0 +1,267 @@
+#!/usr/bin/env python3
+"""
+Session Recording Module
+Records every raw data packet read from the ESP32s, with host-monotonic timestamps, into a
+compact append-only file, and replays recorded sessions into EncoderReader / DJMixer so
+smoothing and control changes can be compared on the same performance
+
+File layout (little-endian):
+    header   32 bytes   magic, version, record size, packet size, created (unix time), index interval
+    records  N x 36     t_ns (u64, since the first record), address (u8), packet (27 bytes)
+    index    M x 12     record number (u32), t_ns (u64) of every index-interval-th record
+    trailer  16 bytes   index magic, index entries (u32), record count (u32)
+
+The index and trailer are written by close(). A file without them (recording interrupted) is
+still readable - the index is rebuilt by scanning the fixed-size records.
+
+Usage:
+    python3 recording.py info FILE
+    python3 recording.py dump FILE [COUNT]
+"""
+
+import bisect
+import ctypes
+import errno
+import struct
+import sys
+import threading
+import time
+from config import DATA_PACKET_SIZE, REPLAY_SPEED, RECORD_INDEX_INTERVAL
+
+MAGIC = b'BDJREC1\0'
+INDEX_MAGIC = b'BDJIDX1\0'
+VERSION = 1
+
+HEADER_STRUCT = struct.Struct('<8sHHHHdI4x')
+RECORD_HEAD_STRUCT = struct.Struct('<QB')
+INDEX_STRUCT = struct.Struct('<IQ')
+TRAILER_STRUCT = struct.Struct('<8sII')
+
+RECORD_SIZE = RECORD_HEAD_STRUCT.size + DATA_PACKET_SIZE
+
+
+class SessionRecorder:
+    """Appends packets to a session file; shared by every EncoderReader of a session"""
+
+    def __init__(self, path, index_interval=RECORD_INDEX_INTERVAL):
+        self.path = path
+        self.index_interval = index_interval
+        self.file = open(path, 'wb')
+        self.file.write(HEADER_STRUCT.pack(MAGIC, VERSION, RECORD_SIZE, DATA_PACKET_SIZE, 0,
+                                           time.time(), index_interval))
+        self.lock = threading.Lock()
+        self.start_ns = None
+        self.count = 0
+        self.index = []
+
+    def record(self, address, packet, t_ns=None):
+        """Append one packet (the raw bytes read from the ESP32)"""
+        if len(packet) != DATA_PACKET_SIZE:
+            return
+        t_ns = time.monotonic_ns() if t_ns is None else t_ns
+        with self.lock:
+            if self.file is None:
+                return
+            if self.start_ns is None:
+                self.start_ns = t_ns
+            t_rel = t_ns - self.start_ns
+            if self.count % self.index_interval == 0:
+                self.index.append((self.count, t_rel))
+            self.file.write(RECORD_HEAD_STRUCT.pack(t_rel, address))
+            self.file.write(packet)
+            self.count += 1
+
+    def close(self):
+        with self.lock:
+            if self.file is None:
+                return
+            for entry in self.index:
+                self.file.write(INDEX_STRUCT.pack(*entry))
+            self.file.write(TRAILER_STRUCT.pack(INDEX_MAGIC, len(self.index), self.count))
+            self.file.close()
+            self.file = None
+        print(f"Recorded {self.count} packets to {self.path}")
+
+
+class Session:
+    """
+    A recorded session
+
+    Records are decoded on demand from the file contents; the index (or the rebuilt one) finds
+    the record at a given time without decoding the ones before it.
+    """
+
+    def __init__(self, path):
+        with open(path, 'rb') as f:
+            self.data = f.read()
+
+        (magic, version, record_size, packet_size, _flags, self.created,
+         self.index_interval) = HEADER_STRUCT.unpack_from(self.data, 0)
+        if magic != MAGIC or version != VERSION:
+            raise ValueError(f"{path}: not a session recording (version {VERSION})")
+        if record_size != RECORD_SIZE or packet_size != DATA_PACKET_SIZE:
+            raise ValueError(f"{path}: recorded with {packet_size}-byte packets, "
+                             f"expected {DATA_PACKET_SIZE}")
+
+        # Index and record count from the trailer, or rebuilt if the file was never closed
+        self.complete = False
+        if len(self.data) >= HEADER_STRUCT.size + TRAILER_STRUCT.size:
+            index_magic, entries, count = TRAILER_STRUCT.unpack_from(
+                self.data, len(self.data) - TRAILER_STRUCT.size)
+            if index_magic == INDEX_MAGIC:
+                self.complete = True
+                self.count = count
+                offset = HEADER_STRUCT.size + count * RECORD_SIZE
+                self.index = [INDEX_STRUCT.unpack_from(self.data, offset + i * INDEX_STRUCT.size)
+                              for i in range(entries)]
+
+        if not self.complete:
+            self.count = (len(self.data) - HEADER_STRUCT.size) // RECORD_SIZE
+            self.index = [(i, self.record(i)[0]) for i in range(0, self.count, self.index_interval)]
+        self.index_times = [t_ns for _, t_ns in self.index]
+
+    def __len__(self):
+        return self.count
+
+    def record(self, number):
+        """(t_ns, address, packet) of one record"""
+        offset = HEADER_STRUCT.size + number * RECORD_SIZE
+        t_ns, address = RECORD_HEAD_STRUCT.unpack_from(self.data, offset)
+        start = offset + RECORD_HEAD_STRUCT.size
+        return t_ns, address, self.data[start:start + DATA_PACKET_SIZE]
+
+    def records(self, start=0):
+        for number in range(start, self.count):
+            yield self.record(number)
+
+    @property
+    def duration_s(self):
+        return self.record(self.count - 1)[0] / 1e9 if self.count else 0.0
+
+    @property
+    def addresses(self):
+        offset = HEADER_STRUCT.size + 8
+        return sorted({self.data[offset + i * RECORD_SIZE] for i in range(self.count)})
+
+    def seek(self, t_ns):
+        """Number of the first record at or after t_ns"""
+        entry = max(0, bisect.bisect_right(self.index_times, t_ns) - 1)
+        number = self.index[entry][0] if self.index else 0
+        while number < self.count and self.record(number)[0] < t_ns:
+            number += 1
+        return number
+
+    def packets(self, address):
+        """(t_ns, packet) of one address, in order"""
+        return [(t_ns, packet) for t_ns, addr, packet in self.records() if addr == address]
+
+
+class ReplayBus:
+    """
+    smbus2.SMBus drop-in that answers reads with the packets of a recorded session
+
+    speed > 0: session time runs at `speed` x host time, and a read returns the latest packet
+               recorded at or before the current session time (real or accelerated playback)
+    speed = 0: every read returns the next packet of that address (deterministic step mode)
+
+    Writes (commands) are accepted and ignored. Reads of an address that is not in the session
+    fail like a NACK, and so does every read once the session is over.
+    """
+    fd = None   # No kernel device - EncoderReader stays on the smbus2 path
+
+    def __init__(self, session, speed=REPLAY_SPEED, clock=time.monotonic_ns):
+        self.session = session if isinstance(session, Session) else Session(session)
+        self.speed = speed
+        self.clock = clock
+        self.start_ns = None
+        self.streams = {}
+        for address in self.session.addresses:
+            packets = self.session.packets(address)
+            self.streams[address] = ([t for t, _ in packets], [p for _, p in packets])
+        self.positions = {address: 0 for address in self.streams}
+
+    @property
+    def finished(self):
+        return all(self.positions[a] >= len(self.streams[a][0]) for a in self.streams)
+
+    def _next_packet(self, address):
+        if address not in self.streams:
+            raise OSError(errno.EREMOTEIO, "Remote I/O error")
+        times, packets = self.streams[address]
+
+        if self.speed <= 0:
+            index = self.positions[address]
+            self.positions[address] = index + 1
+        else:
+            now = self.clock()
+            if self.start_ns is None:
+                self.start_ns = now
+            session_ns = (now - self.start_ns) * self.speed
+            index = bisect.bisect_right(times, session_ns) - 1
+            if index < 0:
+                index = 0
+            elif index == len(times) - 1 and session_ns > times[-1]:
+                index = len(times)
+            self.positions[address] = index + 1
+
+        if index >= len(packets):
+            raise OSError(errno.ENODATA, "End of recorded session")
+        return packets[index]
+
+    def i2c_rdwr(self, *msgs):
+        for msg in msgs:
+            if msg.flags & 0x0001:      # I2C_M_RD
+                packet = self._next_packet(msg.addr)
+                ctypes.memmove(msg.buf, packet, min(len(packet), msg.len))
+
+    def close(self):
+        pass
+
+
+def replay_decoded(session, reader_factory):
+    """
+    Feed every packet of a session through fresh EncoderReaders (step mode, no bus timing)
+
+    Args:
+        session: Session or path
+        reader_factory: callable(address) -> EncoderReader (its bus is not used)
+
+    Returns:
+        dict: address -> list of (t_ns, data) with data as returned by EncoderReader.read()
+    """
+    session = session if isinstance(session, Session) else Session(session)
+    readers = {}
+    results = {}
+    for t_ns, address, packet in session.records():
+        reader = readers.get(address)
+        if reader is None:
+            reader = readers[address] = reader_factory(address)
+            results[address] = []
+        results[address].append((t_ns, reader.decode(reader.unpack_packet(packet))))
+    return results
+
+
+def main():
+    if len(sys.argv) < 3 or sys.argv[1] not in ('info', 'dump'):
+        print(__doc__)
+        return 1
+
+    session = Session(sys.argv[2])
+    print(f"{sys.argv[2]}: {len(session)} packets, {session.duration_s:.1f} s, "
+          f"addresses {', '.join(f'0x{a:02X}' for a in session.addresses)}, "
+          f"recorded {time.strftime('%Y-%m-%d %H:%M:%S', time.localtime(session.created))}"
+          f"{'' if session.complete else ' (not closed - index rebuilt)'}")
+
+    if sys.argv[1] == 'dump':
+        from i2c import PACKET_STRUCT
+        count = int(sys.argv[3]) if len(sys.argv) > 3 else len(session)
+        for t_ns, address, packet in session.records():
+            if count == 0:
+                break
+            count -= 1
+            print(f"{t_ns / 1e6:10.3f} ms  0x{address:02X}  {PACKET_STRUCT.unpack(packet)}")
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,93 @@
+#!/usr/bin/env python3
+"""
+SFX Sampler Module
+Plays a sample per SFX button over the decks. The samples are decoded once at startup into
+memory locked in RAM, and the native sampler (deckengine.Sampler) mixes up to SFX_VOICES of them
+into one appsrc on the master bus. Each press is triggered with the arrival time of its packet,
+and the sampler measures from there to the first sample it renders.
+"""
+
+from acquisition import LatencyHistogram
+from engine import load_pcm, deckengine
+from config import (
+    BUTTON_NAMES, BUTTON_SFX_1, SFX_SAMPLES, SFX_MODES, SFX_VOICES, SFX_RELEASE_MS, SFX_GAIN,
+    ENGINE_SAMPLE_RATE, ENGINE_BLOCK_FRAMES
+)
+
+MODES = ('one-shot', 'retrigger', 'gate')   # deckengine.ONE_SHOT, RETRIGGER, GATE
+
+
+class SfxSampler:
+    """
+    deckengine.Sampler loaded with the SFX samples, without GStreamer (SfxSource adds the
+    appsrc; tests render the sampler themselves)
+
+    on_packet() is the only trigger path and must always run on the same thread - the
+    acquisition thread when there is one, else the GLib main loop.
+    """
+
+    def __init__(self, samples=SFX_SAMPLES, modes=SFX_MODES, voices=SFX_VOICES, release_ms=SFX_RELEASE_MS,
+                 gain=SFX_GAIN, channels=2, output_rate=ENGINE_SAMPLE_RATE):
+        if deckengine is None:
+            raise RuntimeError("deck engine not built (python3 setup.py build_ext --inplace)")
+        self.sampler = deckengine.Sampler(channels, output_rate, voices, release_ms)
+        self.gain = gain
+        self.channels = channels
+        self.output_rate = output_rate
+        self.pads = {}      # Button name -> (pad, mode)
+
+        for index, path in enumerate(samples):
+            if path is None:
+                continue
+            pcm, sample_rate, sample_channels = load_pcm(path, output_rate, channels)
+            if sample_rate != output_rate or sample_channels != channels:
+                raise ValueError(f"{path}: {sample_rate} Hz {sample_channels} ch, the sampler plays "
+                                 f"{output_rate} Hz {channels} ch")
+            if modes[index] not in MODES:
+                raise ValueError(f"unknown SFX mode '{modes[index]}' (one of {', '.join(MODES)})")
+            self.pads[BUTTON_NAMES[BUTTON_SFX_1 + index]] = (self.sampler.add(pcm), MODES.index(modes[index]))
+
+        self.latency = LatencyHistogram("sfx packet to first sample")
+
+    def on_packet(self, data, arrival_ns):
+        """Trigger the pads of the SFX buttons pressed in one controller packet"""
+        for name in data['buttons_pressed']:
+            pad = self.pads.get(name)
+            if pad is not None:
+                self.sampler.trigger(pad[0], pad[1], self.gain, arrival_ns)
+
+    def collect_latency(self):
+        """Move the packet-to-first-sample delays measured so far into the histogram"""
+        for ns in self.sampler.latencies():
+            self.latency.add(ns / 1000.0)
+
+    def summary(self):
+        self.collect_latency()
+        return [self.latency.summary(),
+                f"sfx voices={self.sampler.voices} stolen={self.sampler.stolen} "
+                f"dropped={self.sampler.commands_dropped} locked={self.sampler.locked_bytes / 1e6:.1f} MB"]
+
+
+class SfxSource(SfxSampler):
+    """appsrc fed by the sampler, one block of ENGINE_BLOCK_FRAMES per request like DeckEngineSource"""
+
+    def __init__(self, name, **kwargs):
+        from gi.repository import Gst
+        super().__init__(**kwargs)
+        self.Gst = Gst
+        self.frames_pushed = 0
+
+        self.appsrc = Gst.ElementFactory.make("appsrc", name)
+        self.appsrc.set_property("caps", Gst.Caps.from_string(
+            f"audio/x-raw,format=F32LE,layout=interleaved,rate={self.output_rate},channels={self.channels}"))
+        self.appsrc.set_property("format", Gst.Format.TIME)
+        self.appsrc.set_property("max-bytes", 2 * ENGINE_BLOCK_FRAMES * self.channels * 4)
+        self.appsrc.connect("need-data", self._on_need_data)
+
+    def _on_need_data(self, appsrc, length):
+        Gst = self.Gst
+        buffer = Gst.Buffer.new_wrapped(self.sampler.render(ENGINE_BLOCK_FRAMES))
+        buffer.pts = self.frames_pushed * Gst.SECOND // self.output_rate
+        buffer.duration = ENGINE_BLOCK_FRAMES * Gst.SECOND // self.output_rate
+        self.frames_pushed += ENGINE_BLOCK_FRAMES
+        appsrc.emit("push-buffer", buffer)
@@ -6,11 +6,13 @@ import time
 import requests
 import base64
 import hashlib
+import socket
 from dotenv import load_dotenv
 from flask import Flask, jsonify, render_template_string, request
 from flask_socketio import SocketIO, emit
 from flask_cors import CORS 
 import logging
+from config import MIXER_CONTROL_SOCKET
 
 
 # ============ LOGGING ============ #
@@ -162,6 +164,16 @@ def handle_disconnect():
     
     
 @socketio.on('message')
+def send_to_mixer(message: dict) -> bool:
+    """Sends a control message to the running mixer (mixer.py) over its Unix socket."""
+    try:
+        with socket.socket(socket.AF_UNIX, socket.SOCK_DGRAM) as sock:
+            sock.sendto(json.dumps(message).encode('utf-8'), MIXER_CONTROL_SOCKET)
+        return True
+    except OSError as e:
+        app.logger.error(f"Mixer not reachable at {MIXER_CONTROL_SOCKET}: {e}")
+        return False
+
 def handle_json_message(data):
     """Handles generic messages sent by the client."""
     app.logger.info(f"< Received message: {data}")
@@ -198,6 +210,14 @@ def handle_json_message(data):
 
             elif action == "PLAY_SONG":
                 app.logger.info(f"PLAY_SONG request for song ID: {song_data.get('id')}")
+                song = next((s for s in PLAYLISTS.get(deck_id, []) if s['id'] == song_data['id']), None)
+                if song is None or not song.get('download_path'):
+                    app.logger.error(f"Cannot play song ID {song_data['id']} on {deck_id}: not downloaded yet.")
+                    return
+
+                # The mixer loads it in the background and swaps it in; the other deck keeps playing
+                send_to_mixer({'action': 'load', 'deck': 1 if deck_id == 'deck1' else 2,
+                               'path': song['download_path']})
                 
             elif data == "resume" or data == "pause":
                 app.logger.info(f"Playback control: {data} - Not Implemented")
@@ -0,0 +1,21 @@
+#!/usr/bin/env python3
+"""
+Build the native extensions
+
+    python3 setup.py build_ext --inplace
+
+fasti2c     I2C read path used by i2c.py (without it EncoderReader uses the smbus2 path)
+deckengine  Deck playback engine used by engine.py (without it the decks use the pitch element)
+"""
+
+from setuptools import setup, Extension
+
+setup(
+    name="fasti2c",
+    version="0.1",
+    ext_modules=[
+        Extension("fasti2c", sources=["fasti2c.c"], extra_compile_args=["-O2", "-Wall"]),
+        Extension("deckengine", sources=["deckengine.cpp"], language="c++",
+                  extra_compile_args=["-O2", "-Wall", "-std=c++17"]),
+    ],
+)
@@ -0,0 +1,144 @@
+#!/usr/bin/env python3
+"""
+Streaming Statistics Module
+Fixed-size numeric history with running mean, variance and slope, and the hysteresis band
+used for deck state detection
+"""
+
+from array import array
+
+
+class RollingStats:
+    """
+    Last `size` (t, value) samples as two preallocated arrays (struct-of-arrays ring)
+
+    Running sums are updated as samples enter and leave, so add() and every statistic are O(1).
+    The sums are recomputed from the arrays every RESUM_INTERVAL adds to stop floating-point
+    drift from accumulating; times are kept relative to the oldest sample at that point.
+    """
+    RESUM_INTERVAL = 4096
+
+    def __init__(self, size):
+        self.size = size
+        self.times = array('d', bytes(8 * size))
+        self.values = array('d', bytes(8 * size))
+        self.reset()
+
+    def reset(self):
+        self.count = 0
+        self.head = 0           # Next slot to write
+        self.t_ref = None
+        self.adds = 0
+        self.sum_v = self.sum_vv = 0.0
+        self.sum_t = self.sum_tt = self.sum_tv = 0.0
+
+    def _accumulate(self, t, v, sign):
+        self.sum_v += sign * v
+        self.sum_vv += sign * v * v
+        self.sum_t += sign * t
+        self.sum_tt += sign * t * t
+        self.sum_tv += sign * t * v
+
+    def add(self, t, value):
+        """Add a sample (t in seconds)"""
+        if self.t_ref is None:
+            self.t_ref = t
+        t -= self.t_ref
+
+        if self.count == self.size:
+            self._accumulate(self.times[self.head], self.values[self.head], -1)
+        else:
+            self.count += 1
+        self.times[self.head] = t
+        self.values[self.head] = value
+        self._accumulate(t, value, 1)
+        self.head = (self.head + 1) % self.size
+
+        self.adds += 1
+        if self.adds % self.RESUM_INTERVAL == 0:
+            self._resum()
+
+    def _resum(self):
+        """Recompute the sums exactly, with times relative to the oldest sample"""
+        oldest = self.times[(self.head - self.count) % self.size]
+        self.t_ref += oldest
+        self.sum_v = self.sum_vv = self.sum_t = self.sum_tt = self.sum_tv = 0.0
+        for i in range(self.count):
+            index = (self.head - self.count + i) % self.size
+            self.times[index] -= oldest
+            self._accumulate(self.times[index], self.values[index], 1)
+
+    @property
+    def last(self):
+        return self.values[(self.head - 1) % self.size] if self.count else 0.0
+
+    @property
+    def mean(self):
+        return self.sum_v / self.count if self.count else 0.0
+
+    @property
+    def variance(self):
+        if self.count < 2:
+            return 0.0
+        mean = self.sum_v / self.count
+        return max(0.0, self.sum_vv / self.count - mean * mean)
+
+    @property
+    def std(self):
+        return self.variance ** 0.5
+
+    @property
+    def slope(self):
+        """Least-squares trend of the values (units per second)"""
+        n = self.count
+        denominator = n * self.sum_tt - self.sum_t * self.sum_t
+        if n < 2 or denominator <= 1e-12:
+            return 0.0
+        return (n * self.sum_tv - self.sum_t * self.sum_v) / denominator
+
+
+class HysteresisBand:
+    """
+    In/out decision on a band with separate entry and exit thresholds
+
+    A value enters the band only inside [low, high] and leaves it only outside
+    [low - margin, high + margin]; either change also needs `hold` consecutive samples, so a
+    value sitting on a threshold does not flip the state every tick.
+    """
+
+    def __init__(self, low, high, margin, hold=1, inside=True):
+        self.low = low
+        self.high = high
+        self.margin = margin
+        self.hold = hold
+        self.inside = inside
+        self.pending = 0
+
+    def set_band(self, low, high):
+        self.low = min(low, high)
+        self.high = max(low, high)
+
+    def update(self, value, force_out=False):
+        """
+        Feed one value
+
+        Args:
+            force_out: Treat the value as outside the exit band (e.g. the spread is too large)
+
+        Returns:
+            bool: True if the state changed on this sample
+        """
+        if self.inside:
+            crossing = force_out or value < self.low - self.margin or value > self.high + self.margin
+        else:
+            crossing = not force_out and self.low <= value <= self.high
+
+        if not crossing:
+            self.pending = 0
+            return False
+        self.pending += 1
+        if self.pending < self.hold:
+            return False
+        self.pending = 0
+        self.inside = not self.inside
+        return True
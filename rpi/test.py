@@ -2,12 +2,23 @@
 """
 Test I2C connection to ESP32
 Run this first to verify your I2C setup is working
+
+Usage:
+    python3 test.py                     # real ESP32 on I2C_BUS
+    python3 test.py --emulate [SCENARIO] # software ESP32 (emulator.py), runs every test
+    python3 test.py --reverse           # reverse playback test only (deck engine, no ESP32)
+    python3 test.py --automation        # rate automation spectral test only (deck engine, no ESP32)
+    python3 test.py --sfx               # SFX sampler modes and trigger latency only (deck engine, no ESP32)
 """
 
 import sys
 import time
 import smbus2
-from config import I2C_BUS, ESP32_DECK1_ADDR
+from smbus2 import i2c_msg
+from config import I2C_BUS, ESP32_DECK1_ADDR, DATA_PACKET_SIZE
+
+# Opens the bus used by every test - replaced by the emulator with --emulate
+open_bus = smbus2.SMBus
 
 
 def test_i2c_connection():
@@ -20,7 +31,7 @@ def test_i2c_connection():
     print("-"*70)
 
     try:
-        bus = smbus2.SMBus(I2C_BUS)
+        bus = open_bus(I2C_BUS)
         print("✓ I2C bus opened successfully")
     except Exception as e:
         print(f"✗ Failed to open I2C bus: {e}")
@@ -38,9 +49,11 @@ def test_i2c_connection():
 
     for i in range(10):
         try:
-            data = bus.read_i2c_block_data(ESP32_DECK1_ADDR, 0, 12)
+            # Plain read - the ESP32 has no registers, a register write would be taken as a command
+            msg = i2c_msg.read(ESP32_DECK1_ADDR, DATA_PACKET_SIZE)
+            bus.i2c_rdwr(msg)
             success_count += 1
-            print(f"  Read {i+1}/10: ✓ Received {len(data)} bytes")
+            print(f"  Read {i+1}/10: ✓ Received {len(msg)} bytes")
             time.sleep(0.1)
         except Exception as e:
             fail_count += 1
@@ -69,13 +82,13 @@ def test_i2c_connection():
         return True
     else:
         print("\n✓ I2C CONNECTION PERFECT")
-        print("  You can now run: python3 dj_mixer.py")
+        print("  You can now run: python3 mixer.py")
         return True
 
 
 def test_encoder_data():
     """Test reading actual encoder data"""
-    from encoder_reader import EncoderReader, EncoderSmoother
+    from i2c import EncoderReader, EncoderSmoother
 
     print("\n" + "="*70)
     print("ENCODER DATA TEST")
@@ -84,7 +97,7 @@ def test_encoder_data():
     print("Press Ctrl+C to stop")
     print("-"*70)
 
-    bus = smbus2.SMBus(I2C_BUS)
+    bus = open_bus(I2C_BUS)
     encoder = EncoderReader(bus, ESP32_DECK1_ADDR, EncoderSmoother())
 
     try:
@@ -92,9 +105,9 @@ def test_encoder_data():
             data = encoder.read()
 
             if data:
-                print(f"Pos: {data['position']:6d} | "
-                      f"Vel(smooth): {data['velocity']:7.1f} | "
-                      f"Vel(raw): {data['velocity_raw']:6.1f}")
+                print(f"Pos: {data['enc1_position']:6d} | "
+                      f"Vel(smooth): {data['enc1_velocity']:7.1f} | "
+                      f"Vel(raw): {data['enc1_velocity_raw']:6.1f}")
             else:
                 print("Read failed")
 
@@ -107,10 +120,430 @@ def test_encoder_data():
         print(f"Error rate: {encoder.get_error_rate():.2%}")
 
 
+def test_command_round_trip(samples=50):
+    """Measure command round-trip time (write -> acknowledgement visible in a read)"""
+    from i2c import EncoderReader
+    from config import CMD_RTT_BOUND_MS, CMD_ACK_TIMEOUT_S, LED_PATTERN_PULSE, LED_PATTERN_SCROLL
+
+    print("\n" + "="*70)
+    print("COMMAND ROUND-TRIP TEST")
+    print("="*70)
+    print(f"Sending {samples} LED pattern commands, bound {CMD_RTT_BOUND_MS} ms")
+    print("-"*70)
+
+    bus = open_bus(I2C_BUS)
+    encoder = EncoderReader(bus, ESP32_DECK1_ADDR)
+    times_ms = []
+    failures = 0
+
+    try:
+        for i in range(samples):
+            frame = EncoderReader.led_pattern_frame(LED_PATTERN_PULSE, beat_phase=i / samples)
+            start = time.perf_counter()
+            seq = encoder.send_command([frame], wait=True, timeout=CMD_ACK_TIMEOUT_S)
+            elapsed_ms = (time.perf_counter() - start) * 1000
+
+            if seq is None:
+                failures += 1
+                print(f"  Command {i+1}/{samples}: ✗ no ack (status {encoder.command_status_name()})")
+            else:
+                times_ms.append(elapsed_ms)
+            time.sleep(0.02)
+
+        # Leave the LEDs in their default pattern
+        encoder.send_command([EncoderReader.led_pattern_frame(LED_PATTERN_SCROLL)])
+    finally:
+        bus.close()
+
+    print("\n" + "-"*70)
+    if not times_ms:
+        print("✗ NO COMMANDS ACKNOWLEDGED")
+        return False
+
+    times_ms.sort()
+    p50 = times_ms[len(times_ms) // 2]
+    p99 = times_ms[min(len(times_ms) - 1, int(len(times_ms) * 0.99))]
+    print(f"Round trip: p50 {p50:.1f} ms, p99 {p99:.1f} ms, max {times_ms[-1]:.1f} ms, "
+          f"{failures} failures")
+
+    if failures or times_ms[-1] > CMD_RTT_BOUND_MS:
+        print(f"✗ ROUND TRIP EXCEEDS {CMD_RTT_BOUND_MS} ms OR COMMANDS LOST")
+        return False
+
+    print("✓ COMMAND CHANNEL WITHIN BOUND")
+    return True
+
+
+def test_reverse_playback(reversals=10, tick_ms=20, chunk_frames=16):
+    """
+    Drive the deck engine with synthetic velocity reversals (no hardware needed)
+
+    Every control tick maps a velocity to a rate like DJDeck does (velocity / normal speed) and
+    renders the tick's audio in small chunks. Measured per reversal: time from the rate command
+    to the read head moving the other way, and the largest sample step around it compared with
+    steady playback (a click would be a step far above it).
+    """
+    import array
+    import math
+    from engine import deckengine
+    from config import (ENGINE_SAMPLE_RATE, ENGINE_BLOCK_FRAMES, ENGINE_RATE_SMOOTHING_MS, ENGINE_REVERSE_SMOOTHING_MS,
+                        REVERSE_SWITCH_BOUND_MS)
+
+    print("\n" + "="*70)
+    print("REVERSE PLAYBACK TEST")
+    print("="*70)
+    if deckengine is None:
+        print("✗ deckengine not built (python3 setup.py build_ext --inplace)")
+        return False
+    print(f"{reversals} reversals, {tick_ms} ms control ticks, bound {REVERSE_SWITCH_BOUND_MS} ms")
+    print("-"*70)
+
+    # 4 s of a 440 Hz tone; start in the middle so reverse has room
+    rate_hz = ENGINE_SAMPLE_RATE
+    pcm = array.array('f', bytes(8 * 4 * rate_hz))
+    for i in range(0, len(pcm), 2):
+        pcm[i] = pcm[i + 1] = 0.5 * math.sin(2 * math.pi * 440 * (i // 2) / rate_hz)
+    deck = deckengine.Deck(pcm, 2, rate_hz, rate_hz, ENGINE_RATE_SMOOTHING_MS, ENGINE_REVERSE_SMOOTHING_MS)
+    deck.seek(2.0)
+    deck.render(rate_hz // 10)      # Past the seek crossfade
+
+    normal_speed = -100.0           # counts/s, as calibrated
+    tick_frames = rate_hz * tick_ms // 1000
+    latencies_ms = []
+    steps = []                      # (max step near a reversal, max step in steady playback)
+    previous_sample = None
+    chunk = bytearray(chunk_frames * 2 * 4)
+
+    for tick in range((reversals + 1) * 5):
+        # Platter pushed forward for 5 ticks, pulled back for 5 ticks, ...
+        reversing = tick % 5 == 0 and tick > 0
+        velocity = normal_speed if (tick // 5) % 2 == 0 else -normal_speed
+        deck.set_rate(velocity / normal_speed)
+
+        direction = 1.0 if velocity / normal_speed > 0 else -1.0
+        position = deck.position
+        switched_at = None
+        max_step = 0.0
+        for rendered in range(0, tick_frames, chunk_frames):
+            deck.render_into(chunk)
+            samples = array.array('f', chunk)[::2]
+            for sample in samples:
+                if previous_sample is not None:
+                    max_step = max(max_step, abs(sample - previous_sample))
+                previous_sample = sample
+            if switched_at is None and (deck.position - position) * direction > 0:
+                switched_at = rendered + chunk_frames
+            position = deck.position
+
+        if reversing:
+            latencies_ms.append(switched_at * 1000.0 / rate_hz if switched_at is not None else float('inf'))
+            steps.append((max_step, None))
+        elif tick % 5 == 3:
+            steps.append((None, max_step))
+
+    reversal_step = max(step for step, _ in steps if step is not None)
+    steady_step = max(step for _, step in steps if step is not None)
+    print(f"Direction change: max {max(latencies_ms):.2f} ms (resolution {chunk_frames * 1000 / rate_hz:.2f} ms), "
+          f"mean {sum(latencies_ms) / len(latencies_ms):.2f} ms")
+    # A command lands while the appsrc block before it is already rendered
+    worst_ms = max(latencies_ms) + ENGINE_BLOCK_FRAMES * 1000.0 / rate_hz
+    print(f"Through the appsrc (+1 block of {ENGINE_BLOCK_FRAMES} frames): max {worst_ms:.2f} ms")
+    print(f"Largest sample step: {reversal_step:.4f} around reversals, {steady_step:.4f} in steady playback")
+
+    if worst_ms > REVERSE_SWITCH_BOUND_MS:
+        print(f"✗ DIRECTION CHANGE SLOWER THAN {REVERSE_SWITCH_BOUND_MS} ms")
+        return False
+    if reversal_step > 1.1 * steady_step:
+        print("✗ DISCONTINUITY (CLICK) AT A REVERSAL")
+        return False
+    print("✓ REVERSALS WITHIN BOUND, NO CLICKS")
+    return True
+
+
+def _power_spectrum(samples, size):
+    """Hann-windowed power spectrum of samples[:size] (size a power of two; plain radix-2 FFT)"""
+    import cmath
+    import math
+
+    def fft(x):
+        if len(x) == 1:
+            return x
+        even, odd = fft(x[0::2]), fft(x[1::2])
+        half = len(x) // 2
+        twiddled = [cmath.exp(-2j * math.pi * k / len(x)) * odd[k] for k in range(half)]
+        return [even[k] + twiddled[k] for k in range(half)] + [even[k] - twiddled[k] for k in range(half)]
+
+    window = [samples[i] * (0.5 - 0.5 * math.cos(2 * math.pi * i / size)) for i in range(size)]
+    return [abs(x) ** 2 for x in fft(window)[:size // 2]]
+
+
+def test_rate_automation(tone_hz=1000.0, tick_ms=20, seconds=1.5, fft_size=16384):
+    """
+    Spectral test of rate changes on a sine track (deck engine, no hardware needed)
+
+    The rate follows a slow sweep (1.0 +- 0.3 at 1.5 Hz), updated once per control tick in three
+    ways: stepped (what the pitch element gets), the engine's one-pole smoothing (set_rate) and
+    control points one tick ahead (ramp_to, as DJDeck sends them). A swept sine only has energy
+    between its lowest and highest frequency; everything outside that band is step artifacts.
+    """
+    import array
+    import math
+    from engine import deckengine
+    from config import ENGINE_SAMPLE_RATE, MAX_RATE_DELTA_PER_SEC, RATE_ARTIFACT_BOUND_DB
+
+    print("\n" + "="*70)
+    print("RATE AUTOMATION TEST")
+    print("="*70)
+    if deckengine is None:
+        print("✗ deckengine not built (python3 setup.py build_ext --inplace)")
+        return False
+    print(f"{tone_hz:.0f} Hz tone, rate 1.0 +- 0.3, {tick_ms} ms control ticks, bound {RATE_ARTIFACT_BOUND_DB} dB")
+    print("-"*70)
+
+    rate_hz = ENGINE_SAMPLE_RATE
+    pcm = array.array('f', bytes(2 * 4 * rate_hz * 4))
+    for i in range(0, len(pcm), 2):
+        pcm[i] = pcm[i + 1] = 0.5 * math.sin(2 * math.pi * tone_hz * (i // 2) / rate_hz)
+    tick_frames = rate_hz * tick_ms // 1000
+    low, high = tone_hz * 0.7 - 100.0, tone_hz * 1.3 + 100.0     # Sweep band + window leakage
+
+    def run(mode):
+        deck = deckengine.Deck(pcm, 2, rate_hz, rate_hz)
+        out = array.array('f')
+        missed = 0.0
+        for tick in range(int(seconds * 1000 / tick_ms)):
+            rate = 1.0 + 0.3 * math.sin(2 * math.pi * 1.5 * tick * tick_ms / 1000)
+            if mode == "stepped":
+                deck.set_rate(rate, 0.0)
+            elif mode == "smoothed":
+                deck.set_rate(rate)
+            else:
+                deck.ramp_to(rate, deck.rendered_frames + tick_frames, MAX_RATE_DELTA_PER_SEC)
+            out.extend(array.array('f', deck.render(tick_frames))[::2])
+            if mode == "control points":
+                missed = max(missed, abs(deck.rate - rate))   # Point reached at its frame?
+        power = [0.0] * (fft_size // 2)
+        for start in (rate_hz // 10, rate_hz // 10 + fft_size // 2, rate_hz // 10 + fft_size):
+            for b, p in enumerate(_power_spectrum(out[start:start + fft_size], fft_size)):
+                power[b] += p
+        outside = sum(p for b, p in enumerate(power) if not low <= b * rate_hz / fft_size <= high)
+        return 10 * math.log10(outside / sum(power)), missed
+
+    results = {mode: run(mode) for mode in ("stepped", "smoothed", "control points")}
+    for mode, (db, _) in results.items():
+        print(f"  {mode:<15} {db:7.1f} dB outside the sweep band")
+    db, missed = results["control points"]
+    print(f"Control points: rate off by {missed:.2e} at their frames")
+
+    if missed > 1e-9:
+        print("✗ CONTROL POINTS NOT REACHED AT THEIR FRAMES")
+        return False
+    if db > RATE_ARTIFACT_BOUND_DB or db > results["stepped"][0]:
+        print(f"✗ STEP ARTIFACTS ABOVE {RATE_ARTIFACT_BOUND_DB} dB")
+        return False
+    print("✓ RATE CHANGES WITHOUT STEP ARTIFACTS")
+    return True
+
+
+def test_sfx_latency(seconds=3.0, voices=8):
+    """
+    SFX sampler modes and packet-to-first-sample delay (deck engine, no hardware needed)
+
+    The modes and voice stealing are checked block by block. Then the null sink plays the
+    sampler in real time while this thread triggers pads at random times the way the
+    acquisition thread does. The sampler's own delay, from the trigger's packet time to the
+    render of the block holding the first sample, must stay within SFX_LATENCY_BOUND_MS (one
+    audio buffer). The delay to that sample leaving the card - plus the blocks queued after the
+    sampler and the card's buffer - is printed next to it but not checked.
+    """
+    import math
+    import os
+    import random
+    import tempfile
+    import wave
+    from engine import deckengine
+    from sampler import SfxSampler
+    from output import NullSink, OutputSettings
+    from config import (ENGINE_SAMPLE_RATE, ENGINE_BLOCK_FRAMES, SFX_LATENCY_BOUND_MS, SFX_QUEUE_BLOCKS,
+                        AUDIO_PERIOD_FRAMES, AUDIO_PERIODS)
+
+    print("\n" + "="*70)
+    print("SFX SAMPLER TEST")
+    print("="*70)
+    if deckengine is None:
+        print("✗ deckengine not built (python3 setup.py build_ext --inplace)")
+        return False
+    print(f"{voices} voices, {ENGINE_BLOCK_FRAMES}-frame blocks, bound {SFX_LATENCY_BOUND_MS:.2f} ms "
+          f"(packet to first sample rendered)")
+    print("-"*70)
+
+    # Four 0.25 s tones as 16-bit WAVs
+    rate_hz = ENGINE_SAMPLE_RATE
+    directory = tempfile.mkdtemp(prefix="sfx-test-")
+    paths = []
+    for pad, tone_hz in enumerate((440, 660, 880, 1320)):
+        path = os.path.join(directory, f"sfx{pad + 1}.wav")
+        frames = bytearray()
+        for i in range(rate_hz // 4):
+            value = int(16000 * math.sin(2 * math.pi * tone_hz * i / rate_hz))
+            frames += value.to_bytes(2, 'little', signed=True) * 2
+        with wave.open(path, 'wb') as f:
+            f.setnchannels(2)
+            f.setsampwidth(2)
+            f.setframerate(rate_hz)
+            f.writeframes(bytes(frames))
+        paths.append(path)
+
+    def press(sfx, *names):
+        sfx.on_packet({'buttons_pressed': list(names)}, time.monotonic_ns())
+
+    def run_blocks(sfx, seconds):
+        for _ in range(int(seconds * rate_hz) // ENGINE_BLOCK_FRAMES):
+            sfx.sampler.render(ENGINE_BLOCK_FRAMES)
+
+    failures = []
+    modes = ['one-shot', 'one-shot', 'retrigger', 'gate']
+
+    sfx = SfxSampler(paths, modes, voices)
+    print(f"Samples: {sfx.sampler.pads} pads, {sfx.sampler.locked_bytes} bytes locked in RAM")
+    for _ in range(voices + 4):
+        press(sfx, 'SFX_1')
+    run_blocks(sfx, 0.01)
+    print(f"One-shot x{voices + 4}: {sfx.sampler.playing} playing, {sfx.sampler.stolen} stolen")
+    if sfx.sampler.playing != voices or sfx.sampler.stolen != 4:
+        failures.append("VOICE STEALING")
+    run_blocks(sfx, 0.5)
+    if sfx.sampler.playing != 0:
+        failures.append("ONE-SHOTS DID NOT END")
+
+    press(sfx, 'SFX_3')
+    run_blocks(sfx, 0.1)
+    press(sfx, 'SFX_3')
+    run_blocks(sfx, 0.01)
+    print(f"Retrigger x2: {sfx.sampler.playing} playing")
+    if sfx.sampler.playing != 1:
+        failures.append("RETRIGGER")
+
+    run_blocks(sfx, 0.5)
+    press(sfx, 'SFX_4')
+    run_blocks(sfx, 1.0)
+    looping = sfx.sampler.playing
+    press(sfx, 'SFX_4')
+    run_blocks(sfx, 0.01)
+    print(f"Gate: {looping} playing after 4 sample lengths, {sfx.sampler.playing} after the second press")
+    if looping != 1 or sfx.sampler.playing != 0:
+        failures.append("GATE")
+
+    # Real-time latency run, through the output chain: the null sink (a sound card clocked in
+    # software) pulls a period at a time, and blocks are rendered when the SFX_QUEUE_BLOCKS
+    # queued in front of it run short, as the appsrc and the sink's appsink do
+    sfx = SfxSampler(paths, modes, voices)
+    settings = OutputSettings(AUDIO_PERIOD_FRAMES, AUDIO_PERIODS, rate_hz)
+    queue_frames = SFX_QUEUE_BLOCKS * ENGINE_BLOCK_FRAMES
+    queued = [0]        # Frames rendered and not yet pulled by the sink
+    pending = []        # (frames queued ahead of the block, render time, its packet-to-render delays)
+    render_ms = []      # Packet to the block holding the first sample (the sampler)
+    latencies_ms = []   # Packet to that sample leaving the card (the whole output path)
+
+    def pull(frames):
+        now = time.monotonic_ns()
+        while queued[0] < frames + queue_frames:
+            rendered = time.monotonic_ns()
+            sfx.sampler.render(ENGINE_BLOCK_FRAMES)
+            delays = sfx.sampler.latencies()
+            if delays:
+                render_ms.extend(ns / 1e6 for ns in delays)
+                pending.append((queued[0], rendered, delays))
+            queued[0] += ENGINE_BLOCK_FRAMES
+        # A block's first frame is played once the card's buffer and the frames ahead of it are
+        while pending and pending[0][0] < frames:
+            ahead, rendered, delays = pending.pop(0)
+            heard = now + (sink.queued_frames + ahead) * 1_000_000_000 // rate_hz
+            latencies_ms.extend((ns + heard - rendered) / 1e6 for ns in delays)
+        pending[:] = [(ahead - frames, rendered, delays) for ahead, rendered, delays in pending]
+        queued[0] -= frames
+        return frames
+
+    sink = NullSink(settings, pull)
+    sink.start()
+    noise = random.Random(0)
+    end = time.monotonic() + seconds
+    while time.monotonic() < end:
+        time.sleep(noise.uniform(0.005, 0.03))
+        press(sfx, noise.choice(['SFX_1', 'SFX_2', 'SFX_3']))
+    time.sleep(0.1)
+    sink.stop()
+
+    def percentiles(values):
+        values.sort()
+        return values[len(values) // 2], values[min(len(values) - 1, int(len(values) * 0.99))], values[-1]
+
+    p50, p99, worst = percentiles(render_ms)
+    print(f"Packet to first sample rendered: n={len(render_ms)} p50 {p50:.2f} ms, p99 {p99:.2f} ms, "
+          f"max {worst:.2f} ms (stolen {sfx.sampler.stolen}, dropped {sfx.sampler.commands_dropped})")
+    card_p50, card_p99, card_worst = percentiles(latencies_ms)
+    print(f"Packet to first sample out of the card: p50 {card_p50:.2f} ms, p99 {card_p99:.2f} ms, "
+          f"max {card_worst:.2f} ms (not checked: the {SFX_QUEUE_BLOCKS} queued blocks and the card buffer "
+          f"alone take {(queue_frames + settings.periods * settings.period_frames) * 1000.0 / rate_hz:.2f} ms)")
+    print(f"Output: {settings}, {SFX_QUEUE_BLOCKS} blocks queued, xruns {sink.xruns}")
+    if p99 > SFX_LATENCY_BOUND_MS:
+        failures.append(f"TRIGGER LATENCY ABOVE {SFX_LATENCY_BOUND_MS:.2f} ms")
+    if sink.xruns:
+        failures.append("OUTPUT XRUNS")
+
+    for path in paths:
+        os.unlink(path)
+    os.rmdir(directory)
+
+    for failure in failures:
+        print(f"✗ {failure}")
+    if failures:
+        return False
+    print(f"✓ SFX MODES CORRECT, TRIGGERS RENDERED WITHIN {SFX_LATENCY_BOUND_MS:.2f} ms")
+    return True
+
+
 if __name__ == "__main__":
+    if "--reverse" in sys.argv:
+        sys.exit(0 if test_reverse_playback() else 1)
+    if "--automation" in sys.argv:
+        sys.exit(0 if test_rate_automation() else 1)
+    if "--sfx" in sys.argv:
+        sys.exit(0 if test_sfx_latency() else 1)
+
+    emulate = "--emulate" in sys.argv
+    if emulate:
+        import emulator
+        index = sys.argv.index("--emulate")
+        scenario = sys.argv[index + 1] if index + 1 < len(sys.argv) else "scratch"
+        open_bus = emulator.bus_factory(scenario)
+
     # Test basic I2C connection
     if test_i2c_connection():
         print("\n" + "="*70)
-        response = input("\nRun encoder data test? (y/n): ")
+        response = "y" if emulate else input("\nRun encoder data test? (y/n): ")
         if response.lower() == 'y':
-            test_encoder_data()
\ No newline at end of file
+            test_encoder_data()
+
+        response = "y" if emulate else input("\nRun command round-trip test? (y/n): ")
+        if response.lower() == 'y':
+            if not test_command_round_trip():
+                sys.exit(1)
+    elif emulate:
+        sys.exit(1)
+
+    # No I2C needed
+    response = "y" if emulate else input("\nRun reverse playback test? (y/n): ")
+    if response.lower() == 'y':
+        if not test_reverse_playback():
+            sys.exit(1)
+
+    response = "y" if emulate else input("\nRun rate automation test? (y/n): ")
+    if response.lower() == 'y':
+        if not test_rate_automation():
+            sys.exit(1)
+
+    response = "y" if emulate else input("\nRun SFX sampler test? (y/n): ")
+    if response.lower() == 'y':
+        if not test_sfx_latency():
+            sys.exit(1)
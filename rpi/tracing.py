@@ -0,0 +1,130 @@
+#!/usr/bin/env python3
+"""
+Latency Tracing Module
+Follows a platter movement from the ESP32 to the speaker: every packet that makes a deck send
+a rate (or glide) command gets a trace of five spans on the host monotonic clock -
+
+    packet   device sample time -> packet read (ESP32 packing, I2C FIFO, poll wait)
+    ring     packet read -> taken by the control loop (acquisition ring, GLib poll)
+    control  taken -> command sent to the deck engine (Python control logic)
+    engine   command sent -> first block rendered with it (appsrc request)
+    output   that block rendered -> its first sample played (output buffering)
+
+Device times are mapped to the host clock by the smallest (read time - device timestamp) seen
+over the last TRACE_CLOCK_WINDOW packets, so `packet` excludes the fixed part of the transit.
+`output` is the output latency the sink reports (the null sink's queued audio when it is used),
+not a measurement. Completed traces are kept in a ring of TRACE_MAX_TRACES and exported as
+Chrome trace JSON (chrome://tracing, ui.perfetto.dev) with p50/p99 per span.
+
+Usage:
+    python3 mixer.py --replay scratch.bdj --trace trace.json    # through the full pipeline
+    python3 bench.py latency_trace                              # headless (BENCH_SESSION=file)
+"""
+
+import collections
+import json
+from config import TRACE_MAX_TRACES, TRACE_CLOCK_WINDOW
+
+SPANS = ('packet', 'ring', 'control', 'engine', 'output')
+
+
+class Trace:
+    """Timestamps (host monotonic ns) of one packet on its way to the output"""
+
+    __slots__ = ('deck_id', 'device_ns', 'read_ns', 'consume_ns', 'command_ns', 'applied_ns', 'heard_ns')
+
+    def __init__(self, deck_id, device_ns, read_ns, consume_ns):
+        self.deck_id = deck_id
+        self.device_ns = device_ns
+        self.read_ns = read_ns
+        self.consume_ns = consume_ns
+        self.command_ns = None
+        self.applied_ns = None
+        self.heard_ns = None
+
+    def spans(self):
+        """(name, start_ns, end_ns) of each span"""
+        points = (self.device_ns, self.read_ns, self.consume_ns, self.command_ns, self.applied_ns, self.heard_ns)
+        return [(name, points[i], points[i + 1]) for i, name in enumerate(SPANS)]
+
+
+class Tracer:
+    """
+    Collects traces: begun by the control loop, stamped by EngineDeck when it sends the command
+    and completed by the audio thread (applied) - each step is one attribute store or deque
+    append, so no lock is needed
+    """
+
+    def __init__(self, capacity=TRACE_MAX_TRACES, clock_window=TRACE_CLOCK_WINDOW):
+        self.enabled = False
+        self.traces = collections.deque(maxlen=capacity)
+        self.clock_window = clock_window
+        self.offsets = {}               # Deck id -> recent (read time - device timestamp), ns
+        self.output_latency_ns = 0      # Set by whoever knows it (the sink, the null sink)
+
+    def begin(self, deck_id, device_ms, read_ns, consume_ns):
+        """A packet taken by the control loop; the trace is kept only if a command follows"""
+        offsets = self.offsets.get(deck_id)
+        if offsets is None:
+            offsets = self.offsets[deck_id] = collections.deque(maxlen=self.clock_window)
+        device_ns = int(device_ms * 1_000_000)
+        offsets.append(read_ns - device_ns)
+        return Trace(deck_id, device_ns + min(offsets), read_ns, consume_ns)
+
+    def applied(self, trace, applied_ns):
+        """First block with the trace's command rendered at applied_ns - the trace is complete"""
+        trace.applied_ns = applied_ns
+        trace.heard_ns = applied_ns + self.output_latency_ns
+        self.traces.append(trace)
+
+    def reset(self):
+        self.traces.clear()
+        self.offsets.clear()
+
+    def percentiles(self):
+        """{span: (p50, p99, max) in ms} over the completed traces, 'total' = device to output"""
+        traces = list(self.traces)
+        durations = {name: [] for name in SPANS + ('total',)}
+        for trace in traces:
+            for name, start, end in trace.spans():
+                durations[name].append((end - start) / 1e6)
+            durations['total'].append((trace.heard_ns - trace.device_ns) / 1e6)
+        result = {}
+        for name, values in durations.items():
+            if values:
+                values.sort()
+                result[name] = (values[len(values) // 2], values[min(len(values) - 1, int(len(values) * 0.99))],
+                                values[-1])
+        return result
+
+    def summary(self):
+        stats = self.percentiles()
+        if not stats:
+            return ["trace: no commands traced"]
+        lines = [f"trace: {len(self.traces)} commands, device sample to output"]
+        for name, (p50, p99, worst) in stats.items():
+            lines.append(f"  {name:<8} p50 {p50:7.2f} ms   p99 {p99:7.2f} ms   max {worst:7.2f} ms")
+        return lines
+
+    def export_chrome(self, path):
+        """Write the traces as Chrome trace event JSON (one row per deck and span)"""
+        traces = list(self.traces)
+        events = []
+        rows = set()
+        origin = min((trace.device_ns for trace in traces), default=0)
+        for index, trace in enumerate(traces):
+            for row, (name, start, end) in enumerate(trace.spans()):
+                tid = trace.deck_id * 10 + row
+                rows.add((tid, f"deck {trace.deck_id} {name}"))
+                events.append({'name': name, 'cat': 'latency', 'ph': 'X', 'pid': 1, 'tid': tid,
+                               'ts': (start - origin) / 1000.0, 'dur': max(0, end - start) / 1000.0,
+                               'args': {'trace': index}})
+        events += [{'name': 'thread_name', 'ph': 'M', 'pid': 1, 'tid': tid, 'args': {'name': name}}
+                   for tid, name in sorted(rows)]
+        events.append({'name': 'process_name', 'ph': 'M', 'pid': 1, 'args': {'name': 'box-dj'}})
+        with open(path, 'w') as f:
+            json.dump({'traceEvents': events, 'displayTimeUnit': 'ms'}, f)
+        return len(traces)
+
+
+tracer = Tracer()
@@ -0,0 +1,185 @@
+#!/usr/bin/env python3
+"""
+Track Cache Module
+Decodes each library track once into a fixed-format PCM file (48 kHz float32 interleaved, the
+deck engine's own format) and opens it with mmap, so loading a deck is a hash and an mmap
+instead of a real-time decode, and a seek or hot-cue jump is just a new read position. The
+pages live in the kernel page cache, shared read-only by every process that opens the track.
+
+Entries are named by a hash of the source file's contents, and the header repeats the hash:
+an edited or replaced source gets a new entry, and a stale or damaged entry is rebuilt.
+
+File layout (little-endian):
+    header   4096 bytes  magic, version, sample format, channels, sample rate, frames,
+                         source size, source hash (blake2b-256), zero padding to a page
+    data     frames x channels x float32
+
+Usage:
+    python3 trackcache.py build FILE|DIR...   # decode tracks into the cache ahead of time
+    python3 trackcache.py info                # list the cache
+"""
+
+import hashlib
+import mmap
+import os
+import struct
+import sys
+import time
+from config import TRACK_CACHE_DIR
+
+MAGIC = b'BDJPCM1\0'
+VERSION = 2          # 2: every source converted to the engine layout (48 kHz stereo)
+FORMAT_F32 = 1
+DATA_OFFSET = 4096      # Page-aligned PCM
+
+HEADER_STRUCT = struct.Struct('<8sHHHHIQQ32s')
+AUDIO_EXTENSIONS = ('.mp3', '.flac', '.ogg', '.m4a', '.aac', '.wav', '.opus')
+
+# Source hashes by (path, size, mtime_ns): reopening a track in the same process skips hashing
+_hashes = {}
+
+
+def source_hash(path):
+    """blake2b-256 of the file contents"""
+    st = os.stat(path)
+    key = (os.path.abspath(path), st.st_size, st.st_mtime_ns)
+    digest = _hashes.get(key)
+    if digest is None:
+        h = hashlib.blake2b(digest_size=32)
+        with open(path, 'rb') as f:
+            while True:
+                chunk = f.read(1 << 20)
+                if not chunk:
+                    break
+                h.update(chunk)
+        digest = _hashes[key] = h.digest()
+    return digest
+
+
+def entry_path(digest, cache_dir=TRACK_CACHE_DIR):
+    return os.path.join(cache_dir, digest.hex()[:40] + '.pcm')
+
+
+class CachedTrack:
+    """
+    A decoded track mapped read-only from the cache
+
+    `pcm` is a memoryview of the float32 frames, usable wherever decoded PCM bytes are (the
+    deck engine keeps it referenced, and with it the mapping).
+    """
+
+    def __init__(self, path, digest=None):
+        self.path = path
+        with open(path, 'rb') as f:
+            self.map = mmap.mmap(f.fileno(), 0, access=mmap.ACCESS_READ)
+        try:
+            (magic, version, sample_format, self.channels, _reserved, self.sample_rate,
+             self.frames, self.source_size, self.digest) = HEADER_STRUCT.unpack_from(self.map, 0)
+            if magic != MAGIC or version != VERSION or sample_format != FORMAT_F32:
+                raise ValueError(f"{path}: not a version {VERSION} track cache entry")
+            if digest is not None and digest != self.digest:
+                raise ValueError(f"{path}: source hash does not match")
+            if len(self.map) != DATA_OFFSET + self.frames * self.channels * 4:
+                raise ValueError(f"{path}: truncated ({len(self.map)} bytes)")
+        except (ValueError, struct.error):
+            self.map.close()
+            raise
+        if hasattr(mmap, 'MADV_WILLNEED'):
+            # Start reading the whole track in the background; the first render then rarely faults
+            self.map.madvise(mmap.MADV_WILLNEED)
+        self.pcm = memoryview(self.map)[DATA_OFFSET:]
+
+    @property
+    def duration_s(self):
+        return self.frames / self.sample_rate
+
+
+def build_entry(source, digest, cache_dir=TRACK_CACHE_DIR):
+    """Decode a source file into a cache entry (written atomically, readable by everyone)"""
+    from engine import load_pcm
+    pcm, sample_rate, channels = load_pcm(source)
+    frames = len(pcm) // (4 * channels)
+
+    os.makedirs(cache_dir, exist_ok=True)
+    path = entry_path(digest, cache_dir)
+    temp_path = f"{path}.{os.getpid()}.tmp"
+    header = HEADER_STRUCT.pack(MAGIC, VERSION, FORMAT_F32, channels, 0, sample_rate, frames,
+                                os.path.getsize(source), digest)
+    with open(temp_path, 'wb') as f:
+        f.write(header.ljust(DATA_OFFSET, b'\0'))
+        f.write(pcm)
+    os.chmod(temp_path, 0o644)
+    os.replace(temp_path, path)
+    return path
+
+
+def open_track(source, cache_dir=TRACK_CACHE_DIR):
+    """
+    The cached, memory-mapped PCM of a track, decoding it into the cache first if needed
+
+    Returns:
+        CachedTrack
+    """
+    digest = source_hash(source)
+    path = entry_path(digest, cache_dir)
+    if os.path.exists(path):
+        try:
+            return CachedTrack(path, digest)
+        except ValueError as e:
+            print(f"Rebuilding track cache entry: {e}")
+    return CachedTrack(build_entry(source, digest, cache_dir), digest)
+
+
+def library_files(paths):
+    """Audio files among paths (directories are searched recursively)"""
+    for path in paths:
+        if os.path.isdir(path):
+            for root, _dirs, names in os.walk(path):
+                for name in sorted(names):
+                    if name.lower().endswith(AUDIO_EXTENSIONS):
+                        yield os.path.join(root, name)
+        else:
+            yield path
+
+
+def main():
+    if len(sys.argv) < 2 or sys.argv[1] not in ('build', 'info'):
+        print(__doc__)
+        return 1
+
+    if sys.argv[1] == 'build':
+        failed = 0
+        for source in library_files(sys.argv[2:]):
+            start = time.perf_counter()
+            try:
+                track = open_track(source)
+            except Exception as e:
+                print(f"  {source}: {e}")
+                failed += 1
+                continue
+            print(f"  {source}: {track.duration_s:.1f} s, {time.perf_counter() - start:.2f} s -> {track.path}")
+        return 1 if failed else 0
+
+    if not os.path.isdir(TRACK_CACHE_DIR):
+        print(f"No track cache in {TRACK_CACHE_DIR}")
+        return 0
+    total = 0
+    for name in sorted(os.listdir(TRACK_CACHE_DIR)):
+        if not name.endswith('.pcm'):
+            continue
+        path = os.path.join(TRACK_CACHE_DIR, name)
+        try:
+            track = CachedTrack(path)
+        except ValueError as e:
+            print(f"  {name}: {e}")
+            continue
+        size = os.path.getsize(path)
+        total += size
+        print(f"  {name}: {track.duration_s:6.1f} s, {track.channels} ch, {track.sample_rate} Hz, "
+              f"{size / 1e6:.1f} MB")
+    print(f"{TRACK_CACHE_DIR}: {total / 1e6:.1f} MB")
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())